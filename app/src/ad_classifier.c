@@ -0,0 +1,161 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Single pass classifier for advertising reports
+ *
+ * Replaces running bt_data_parse() once per scan target. The AD structures are
+ * walked in place (no buffer clones) and 16-bit UUIDs are matched on their
+ * value instead of through bt_uuid_cmp().
+ */
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/audio/audio.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "broadcast_assistant.h"
+#include "ad_classifier.h"
+
+LOG_MODULE_REGISTER(ad_classifier, LOG_LEVEL_INF);
+
+static void copy_name(char *dst, const uint8_t *src, uint8_t len)
+{
+	len = MIN(len, BT_NAME_LEN - 1);
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+static void parse_uuid16_list(const uint8_t *data, uint8_t len, struct scan_recv_data *sr_data)
+{
+	/* NOTE: According to the BAP 1.0.1 Spec,
+	 * Section 3.9.2. Additional Broadcast Audio Scan Service requirements,
+	 * If the Scan Delegator implements a Broadcast Sink, it should also
+	 * advertise a Service Data field containing the Broadcast Audio
+	 * Scan Service (BASS) UUID.
+	 *
+	 * However, it seems that this is not the case with the sinks available
+	 * while developing this sample application.  Therefore, we instead,
+	 * search for the existence of BASS and PACS in the list of service UUIDs,
+	 * which does seem to exist in the sinks available.
+	 */
+	if (len % sizeof(uint16_t) != 0U) {
+		LOG_DBG("UUID16 AD malformed");
+		return;
+	}
+
+	for (uint8_t i = 0; i < len; i += sizeof(uint16_t)) {
+		switch (sys_get_le16(&data[i])) {
+		case BT_UUID_BASS_VAL:
+			sr_data->has_bass = true;
+			break;
+		case BT_UUID_PACS_VAL:
+			sr_data->has_pacs = true;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void parse_svc_data16(const uint8_t *data, uint8_t len, struct scan_recv_data *sr_data)
+{
+	if (len < BT_UUID_SIZE_16) {
+		return;
+	}
+
+	switch (sys_get_le16(data)) {
+	case BT_UUID_BROADCAST_AUDIO_VAL:
+		/* Broadcast Audio Announcement */
+		if (len >= BT_UUID_SIZE_16 + BT_AUDIO_BROADCAST_ID_SIZE) {
+			sr_data->broadcast_id = sys_get_le24(data + BT_UUID_SIZE_16);
+		}
+		break;
+	case BT_UUID_BASS_VAL:
+		sr_data->has_bass = true;
+		break;
+	default:
+		break;
+	}
+}
+
+enum ad_class ad_candidate(uint16_t adv_props, uint16_t interval, uint8_t targets)
+{
+	/* Sinks are connectable, sources are non-connectable periodic advertisers */
+	if ((adv_props & BT_GAP_ADV_PROP_CONNECTABLE) != 0) {
+		return (targets & BROADCAST_ASSISTANT_SCAN_TARGET_SINK) ? AD_CLASS_SINK
+									: AD_CLASS_NONE;
+	}
+
+	if ((targets & BROADCAST_ASSISTANT_SCAN_TARGET_SOURCE) == 0 || interval == 0) {
+		return AD_CLASS_NONE;
+	}
+
+	return AD_CLASS_SOURCE;
+}
+
+enum ad_class ad_classify(uint16_t adv_props, uint16_t interval, uint8_t targets,
+			  const uint8_t *data, uint16_t len, struct scan_recv_data *sr_data)
+{
+	enum ad_class candidate;
+
+	candidate = ad_candidate(adv_props, interval, targets);
+	if (candidate == AD_CLASS_NONE) {
+		return AD_CLASS_NONE;
+	}
+
+	memset(sr_data, 0, sizeof(*sr_data));
+	sr_data->broadcast_id = INVALID_BROADCAST_ID;
+
+	/* Same termination rules as bt_data_parse(): stop at a zero length or a
+	 * structure that does not fit in the remaining data.
+	 */
+	for (uint16_t i = 0; i + 1 < len;) {
+		const uint8_t ad_len = data[i];
+		const uint8_t *ad_data = &data[i + 2];
+		uint8_t data_len;
+
+		if (ad_len == 0U || i + 1 + ad_len > len) {
+			break;
+		}
+
+		data_len = ad_len - 1;
+
+		switch (data[i + 1]) {
+		case BT_DATA_NAME_SHORTENED:
+		case BT_DATA_NAME_COMPLETE:
+			copy_name(sr_data->bt_name, ad_data, data_len);
+			sr_data->bt_name_type = data[i + 1];
+			break;
+		case BT_DATA_BROADCAST_NAME:
+			copy_name(sr_data->broadcast_name, ad_data, data_len);
+			break;
+		case BT_DATA_SVC_DATA16:
+			parse_svc_data16(ad_data, data_len, sr_data);
+			break;
+		case BT_DATA_UUID16_SOME:
+		case BT_DATA_UUID16_ALL:
+			if (candidate == AD_CLASS_SINK) {
+				parse_uuid16_list(ad_data, data_len, sr_data);
+			}
+			break;
+		default:
+			break;
+		}
+
+		i += 1 + ad_len;
+	}
+
+	if (candidate == AD_CLASS_SOURCE && sr_data->broadcast_id != INVALID_BROADCAST_ID) {
+		return AD_CLASS_SOURCE;
+	}
+
+	if (candidate == AD_CLASS_SINK && sr_data->has_bass) {
+		return AD_CLASS_SINK;
+	}
+
+	return AD_CLASS_NONE;
+}
@@ -0,0 +1,65 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Single pass classifier for advertising reports
+ *
+ * Walks the advertising data of a report once and at the same time decides
+ * whether the report is from a broadcast source, a broadcast sink or neither,
+ * and extracts the names, broadcast ID and BASS/PACS flags.
+ */
+
+#ifndef __AD_CLASSIFIER_H__
+#define __AD_CLASSIFIER_H__
+
+#include <zephyr/types.h>
+
+#define BT_NAME_LEN 30
+#define INVALID_BROADCAST_ID 0xFFFFFFFFU
+
+enum ad_class {
+	AD_CLASS_NONE,
+	AD_CLASS_SOURCE,
+	AD_CLASS_SINK,
+};
+
+struct scan_recv_data {
+	char bt_name[BT_NAME_LEN];
+	uint8_t bt_name_type;
+	char broadcast_name[BT_NAME_LEN];
+	uint32_t broadcast_id;
+	bool has_bass;
+	bool has_pacs;
+};
+
+/**
+ * @brief Class a report can have, based on its advertising properties only
+ *
+ * Cheap check that does not look at the advertising data.
+ *
+ * @return AD_CLASS_NONE if the report cannot match any of the @p targets
+ */
+enum ad_class ad_candidate(uint16_t adv_props, uint16_t interval, uint8_t targets);
+
+/**
+ * @brief Classify an advertising report
+ *
+ * Only connectable reports are considered sinks and only non-connectable
+ * periodic advertisers are considered sources. Reports that cannot match any
+ * of the requested targets are rejected without looking at the data.
+ *
+ * @param adv_props   Advertising properties of the report (BT_GAP_ADV_PROP_*)
+ * @param interval    Periodic advertising interval, 0 if not periodic
+ * @param targets     BROADCAST_ASSISTANT_SCAN_TARGET_* bitmask
+ * @param data        Advertising data
+ * @param len         Length of the advertising data
+ * @param sr_data     Extracted data, valid if the report is a source or sink
+ *
+ * @return Class of the report
+ */
+enum ad_class ad_classify(uint16_t adv_props, uint16_t interval, uint8_t targets,
+			  const uint8_t *data, uint16_t len, struct scan_recv_data *sr_data);
+
+#endif /* __AD_CLASSIFIER_H__ */
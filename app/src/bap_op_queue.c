@@ -0,0 +1,309 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Per connection queue of Broadcast Assistant (BAP) GATT procedures
+ *
+ * All state transitions (start, completion, retry, timeout and flush) are
+ * handled on the system workqueue. The Bluetooth callbacks only record the
+ * result and kick the queue.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/audio/bap.h>
+
+#include "bap_op_queue.h"
+
+LOG_MODULE_REGISTER(bap_op_queue, LOG_LEVEL_INF);
+
+struct bap_op_queue {
+	struct bt_conn *conn;
+	sys_slist_t ops;
+	sys_slist_t flushed;
+	struct bap_op *current;
+	bool in_flight;
+	bool done;
+	int result;
+	struct k_work_delayable run_work;
+	struct k_work_delayable timeout_work;
+};
+
+K_MEM_SLAB_DEFINE_STATIC(bap_op_slab, sizeof(struct bap_op), CONFIG_BAP_OP_QUEUE_MAX_OPS, 4);
+
+static struct bap_op_queue queues[CONFIG_BT_MAX_CONN];
+static struct k_spinlock queue_lock;
+static bap_op_done_cb_t op_done_cb;
+
+static const char *op_type_str(enum bap_op_type type)
+{
+	switch (type) {
+	case BAP_OP_DISCOVER:
+		return "discover";
+	case BAP_OP_ADD_SRC:
+		return "add_src";
+	case BAP_OP_MOD_SRC:
+		return "mod_src";
+	case BAP_OP_REM_SRC:
+		return "rem_src";
+	default:
+		return "unknown";
+	}
+}
+
+static int op_start(struct bt_conn *conn, struct bap_op *op)
+{
+	switch (op->type) {
+	case BAP_OP_DISCOVER:
+		return bt_bap_broadcast_assistant_discover(conn);
+	case BAP_OP_ADD_SRC: {
+		struct bt_bap_scan_delegator_subgroup subgroup = {0};
+		struct bt_bap_broadcast_assistant_add_src_param param = {0};
+
+		subgroup.bis_sync = BT_BAP_BIS_SYNC_NO_PREF; /* We might want to hard code to BIT(1) */
+
+		bt_addr_le_copy(&param.addr, &op->add_src.addr);
+		param.adv_sid = op->add_src.adv_sid;
+		param.pa_interval = op->add_src.pa_interval;
+		param.broadcast_id = op->add_src.broadcast_id;
+		param.pa_sync = true;
+		param.num_subgroups = 1;
+		param.subgroups = &subgroup;
+
+		return bt_bap_broadcast_assistant_add_src(conn, &param);
+	}
+	case BAP_OP_MOD_SRC: {
+		struct bt_bap_scan_delegator_subgroup subgroups[CONFIG_BT_BAP_BASS_MAX_SUBGROUPS] = {0};
+		struct bt_bap_broadcast_assistant_mod_src_param param = {0};
+
+		param.src_id = op->mod_src.src_id;
+		param.pa_sync = op->mod_src.pa_sync;
+		param.pa_interval = BT_BAP_PA_INTERVAL_UNKNOWN;
+		param.num_subgroups = CLAMP(op->mod_src.num_subgroups, 1,
+					    CONFIG_BT_BAP_BASS_MAX_SUBGROUPS);
+		param.subgroups = subgroups;
+
+		for (uint8_t i = 0; i < param.num_subgroups; i++) {
+			subgroups[i].bis_sync = op->mod_src.bis_sync;
+		}
+
+		return bt_bap_broadcast_assistant_mod_src(conn, &param);
+	}
+	case BAP_OP_REM_SRC:
+		return bt_bap_broadcast_assistant_rem_src(conn, op->rem_src.src_id);
+	default:
+		return -EINVAL;
+	}
+}
+
+static void op_finish(struct bap_op_queue *q, struct bap_op *op, int err)
+{
+	LOG_INF("%s done on %p (err %d)", op_type_str(op->type), (void *)q->conn, err);
+
+	if (op_done_cb) {
+		op_done_cb(q->conn, op, err);
+	}
+
+	if (op->type == BAP_OP_MOD_SRC && op->mod_src.remove_after && err == 0) {
+		/* Chain the remove directly after the modify, ahead of other operations */
+		struct bap_op *rem_op = op;
+
+		rem_op->type = BAP_OP_REM_SRC;
+		rem_op->retries = 0;
+		rem_op->rem_src.src_id = op->mod_src.src_id;
+
+		K_SPINLOCK(&queue_lock) {
+			sys_slist_prepend(&q->ops, &rem_op->node);
+		}
+
+		return;
+	}
+
+	k_mem_slab_free(&bap_op_slab, (void *)op);
+}
+
+static void run_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct bap_op_queue *q = CONTAINER_OF(dwork, struct bap_op_queue, run_work);
+	struct bap_op *finished = NULL;
+	struct bap_op *op = NULL;
+	sys_slist_t flushed;
+	sys_snode_t *node;
+	int result = 0;
+	int err;
+
+	K_SPINLOCK(&queue_lock) {
+		flushed = q->flushed;
+		sys_slist_init(&q->flushed);
+
+		if (q->current != NULL && q->done) {
+			finished = q->current;
+			result = q->result;
+			q->current = NULL;
+			q->in_flight = false;
+			q->done = false;
+		}
+	}
+
+	while ((node = sys_slist_get(&flushed)) != NULL) {
+		struct bap_op *flushed_op = CONTAINER_OF(node, struct bap_op, node);
+
+		if (op_done_cb) {
+			op_done_cb(q->conn, flushed_op, -ENOTCONN);
+		}
+		k_mem_slab_free(&bap_op_slab, (void *)flushed_op);
+	}
+
+	if (finished != NULL) {
+		(void)k_work_cancel_delayable(&q->timeout_work);
+		op_finish(q, finished, result);
+	}
+
+	K_SPINLOCK(&queue_lock) {
+		if (q->current == NULL) {
+			node = sys_slist_get(&q->ops);
+			q->current = node != NULL ? CONTAINER_OF(node, struct bap_op, node) : NULL;
+		}
+
+		/* Nothing to do if idle or waiting for completion/timeout */
+		if (q->current != NULL && !q->in_flight && !q->done) {
+			op = q->current;
+			q->in_flight = true;
+		}
+	}
+
+	if (op == NULL) {
+		return;
+	}
+
+	LOG_DBG("Starting %s on %p", op_type_str(op->type), (void *)q->conn);
+
+	err = op_start(q->conn, op);
+	if (err == 0) {
+		k_work_reschedule(&q->timeout_work, K_MSEC(CONFIG_BAP_OP_TIMEOUT_MS));
+		return;
+	}
+
+	if (err == -EBUSY && op->retries < CONFIG_BAP_OP_BUSY_MAX_RETRIES) {
+		LOG_DBG("%s busy, retry %u", op_type_str(op->type), op->retries);
+		op->retries++;
+
+		K_SPINLOCK(&queue_lock) {
+			if (!q->done) {
+				q->in_flight = false;
+			}
+		}
+
+		k_work_reschedule(&q->run_work, K_MSEC(CONFIG_BAP_OP_BUSY_RETRY_MS));
+		return;
+	}
+
+	LOG_ERR("Failed to start %s (err %d)", op_type_str(op->type), err);
+
+	K_SPINLOCK(&queue_lock) {
+		if (!q->done) {
+			q->done = true;
+			q->result = err;
+		}
+	}
+
+	k_work_reschedule(&q->run_work, K_NO_WAIT);
+}
+
+static void timeout_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct bap_op_queue *q = CONTAINER_OF(dwork, struct bap_op_queue, timeout_work);
+	enum bap_op_type type;
+	bool timed_out = false;
+
+	K_SPINLOCK(&queue_lock) {
+		if (q->current != NULL && q->in_flight && !q->done) {
+			q->done = true;
+			q->result = -ETIMEDOUT;
+			type = q->current->type;
+			timed_out = true;
+		}
+	}
+
+	if (timed_out) {
+		LOG_WRN("%s timed out on %p", op_type_str(type), (void *)q->conn);
+		k_work_reschedule(&q->run_work, K_NO_WAIT);
+	}
+}
+
+void bap_op_queue_init(bap_op_done_cb_t done_cb)
+{
+	op_done_cb = done_cb;
+
+	for (size_t i = 0; i < ARRAY_SIZE(queues); i++) {
+		sys_slist_init(&queues[i].ops);
+		sys_slist_init(&queues[i].flushed);
+		k_work_init_delayable(&queues[i].run_work, run_work_handler);
+		k_work_init_delayable(&queues[i].timeout_work, timeout_work_handler);
+	}
+}
+
+int bap_op_queue_submit(struct bt_conn *conn, const struct bap_op *op)
+{
+	struct bap_op_queue *q = &queues[bt_conn_index(conn)];
+	struct bap_op *new_op;
+
+	if (k_mem_slab_alloc(&bap_op_slab, (void **)&new_op, K_NO_WAIT) != 0) {
+		LOG_ERR("No free operation for %s", op_type_str(op->type));
+		return -ENOMEM;
+	}
+
+	memcpy(new_op, op, sizeof(*new_op));
+	new_op->retries = 0;
+
+	K_SPINLOCK(&queue_lock) {
+		q->conn = conn;
+		sys_slist_append(&q->ops, &new_op->node);
+	}
+
+	LOG_DBG("Queued %s on %p", op_type_str(op->type), (void *)conn);
+
+	/* Only kick an idle queue, a retry that is pending must keep its delay */
+	k_work_schedule(&q->run_work, K_NO_WAIT);
+
+	return 0;
+}
+
+void bap_op_queue_complete(struct bt_conn *conn, enum bap_op_type type, int err)
+{
+	struct bap_op_queue *q = &queues[bt_conn_index(conn)];
+	bool matched = false;
+
+	K_SPINLOCK(&queue_lock) {
+		if (q->current != NULL && q->in_flight && !q->done && q->current->type == type) {
+			q->done = true;
+			q->result = err;
+			matched = true;
+		}
+	}
+
+	if (matched) {
+		k_work_reschedule(&q->run_work, K_NO_WAIT);
+	}
+}
+
+void bap_op_queue_flush(struct bt_conn *conn)
+{
+	struct bap_op_queue *q = &queues[bt_conn_index(conn)];
+
+	K_SPINLOCK(&queue_lock) {
+		sys_slist_merge_slist(&q->flushed, &q->ops);
+
+		if (q->current != NULL && !q->done) {
+			q->done = true;
+			q->result = -ENOTCONN;
+		}
+	}
+
+	k_work_reschedule(&q->run_work, K_NO_WAIT);
+}
@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Per connection queue of Broadcast Assistant (BAP) GATT procedures
+ *
+ * Only one BAP procedure can be in flight at a time. Operations submitted for a
+ * sink are executed strictly in order, one at a time, and complete
+ * asynchronously through the registered done callback. Operations that fail with
+ * -EBUSY (e.g. because the stack is still busy with a procedure it started on
+ * its own) are retried and operations that never complete are failed with
+ * -ETIMEDOUT.
+ *
+ * The queues are kept per connection, but the firmware connects one sink at a
+ * time for now (see connect_to_sink()).
+ */
+
+#ifndef __BAP_OP_QUEUE_H__
+#define __BAP_OP_QUEUE_H__
+
+#include <zephyr/types.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/bluetooth/conn.h>
+
+enum bap_op_type {
+	/* Discovery also reads all receive states of the sink */
+	BAP_OP_DISCOVER,
+	BAP_OP_ADD_SRC,
+	BAP_OP_MOD_SRC,
+	BAP_OP_REM_SRC,
+};
+
+struct bap_op {
+	sys_snode_t node;
+	enum bap_op_type type;
+	uint8_t retries;
+	union {
+		struct {
+			bt_addr_le_t addr;
+			uint8_t adv_sid;
+			uint16_t pa_interval;
+			uint32_t broadcast_id;
+		} add_src;
+		struct {
+			uint8_t src_id;
+			uint8_t num_subgroups;
+			bool pa_sync;
+			uint32_t bis_sync;
+			/* Queue a remove source operation when the modify succeeds */
+			bool remove_after;
+		} mod_src;
+		struct {
+			uint8_t src_id;
+		} rem_src;
+	};
+};
+
+/**
+ * @brief Callback for completed operations
+ *
+ * Called from the system workqueue. The operation is freed when the callback
+ * returns.
+ *
+ * @param conn Connection the operation was executed on
+ * @param op   The completed operation
+ * @param err  0 on success, negative error code from the stack, -ETIMEDOUT or
+ *             -ENOTCONN if the sink disconnected before the operation completed
+ */
+typedef void (*bap_op_done_cb_t)(struct bt_conn *conn, const struct bap_op *op, int err);
+
+/**
+ * @brief Initialize the operation queues
+ *
+ * @param done_cb Callback for completed operations
+ */
+void bap_op_queue_init(bap_op_done_cb_t done_cb);
+
+/**
+ * @brief Queue an operation for a sink
+ *
+ * The operation is copied, so @p op can be on the stack.
+ *
+ * @return 0 if the operation was queued, -ENOMEM if the queue is full
+ */
+int bap_op_queue_submit(struct bt_conn *conn, const struct bap_op *op);
+
+/**
+ * @brief Report the completion of a BAP procedure
+ *
+ * To be called from the Broadcast Assistant callbacks. Completions that do not
+ * match the operation in flight (e.g. notifications) are ignored.
+ */
+void bap_op_queue_complete(struct bt_conn *conn, enum bap_op_type type, int err);
+
+/**
+ * @brief Fail all pending operations of a sink with -ENOTCONN
+ */
+void bap_op_queue_flush(struct bt_conn *conn);
+
+#endif /* __BAP_OP_QUEUE_H__ */
@@ -17,19 +17,45 @@
 #include "webusb.h"
 #include "message_handler.h"
 #include "broadcast_assistant.h"
+#include "bap_op_queue.h"
+#include "ad_classifier.h"
+#include "scan_filter.h"
+#include "rssi_report.h"
 
 LOG_MODULE_REGISTER(broadcast_assistant, LOG_LEVEL_INF);
 
-#define BT_NAME_LEN 30
-#define INVALID_BROADCAST_ID 0xFFFFFFFFU
+/* Default link parameters (intervals in units of 1.25 ms, timeout in units of 10 ms).
+ * A short interval is used while discovering BASS and reading receive states, after
+ * which the link is relaxed to save power on both sides.
+ */
+#define LINK_SETUP_INTERVAL_MIN  6   /* 7.5 ms */
+#define LINK_SETUP_INTERVAL_MAX  12  /* 15 ms */
+#define LINK_STEADY_INTERVAL_MIN 80  /* 100 ms */
+#define LINK_STEADY_INTERVAL_MAX 160 /* 200 ms */
+#define LINK_LATENCY             0
+#define LINK_TIMEOUT             400 /* 4 s */
+
+/* Connection interval range allowed by the spec */
+#define LINK_INTERVAL_MIN 6    /* 7.5 ms */
+#define LINK_INTERVAL_MAX 3200 /* 4 s */
+
+#define RECV_STATE_COUNT CONFIG_BT_BAP_BROADCAST_ASSISTANT_RECV_STATE_COUNT
+
+/* Wait for a TX buffer of a snapshot event, the snapshot needs more than the pool holds */
+#define SNAPSHOT_ALLOC_TIMEOUT K_MSEC(100)
+#define SNAPSHOT_WORKQUEUE_STACK_SIZE 2048
+#define SNAPSHOT_WORKQUEUE_PRIORITY K_PRIO_PREEMPT(2)
+
+/* CONN_STATE of SINK_STATE */
+enum sink_conn_state {
+	SINK_CONN_STATE_CONNECTING = 1,
+	SINK_CONN_STATE_CONNECTED = 2,
+	SINK_CONN_STATE_READY = 3,
+};
 
-struct scan_recv_data {
-	char bt_name[BT_NAME_LEN];
-	uint8_t bt_name_type;
-	char broadcast_name[BT_NAME_LEN];
-	uint32_t broadcast_id;
-	bool has_bass;
-	bool has_pacs;
+struct recv_state_entry {
+	bool used;
+	struct bt_bap_scan_delegator_recv_state state;
 };
 
 static void broadcast_assistant_discover_cb(struct bt_conn *conn, int err,
@@ -48,14 +74,16 @@ static void security_changed_cb(struct bt_conn *conn, bt_security_t level,
 static void identity_resolved_cb(struct bt_conn *conn,
 				 const bt_addr_le_t *rpa,
 				 const bt_addr_le_t *identity);
+static void le_param_updated_cb(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+				uint16_t timeout);
+static void le_phy_updated_cb(struct bt_conn *conn, struct bt_conn_le_phy_info *param);
+static void le_data_len_updated_cb(struct bt_conn *conn, struct bt_conn_le_data_len_info *info);
+static void link_tune_setup(struct bt_conn *conn);
+static void link_tune_steady(struct bt_conn *conn);
 static void restart_scanning_if_needed(void);
-static bool device_found(struct bt_data *data, void *user_data);
-static bool scan_for_source(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad,
-			    struct scan_recv_data *sr_data);
-static bool scan_for_sink(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad,
-			  struct scan_recv_data *sr_data);
 static void scan_recv_cb(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad);
 static void scan_timeout_cb(void);
+static void snapshot_work_handler(struct k_work *work);
 
 static struct bt_le_scan_cb scan_callbacks = {
 	.recv = scan_recv_cb,
@@ -75,14 +103,36 @@ BT_CONN_CB_DEFINE(conn_callbacks) = {
 	.connected = connected,
 	.disconnected = disconnected,
 	.security_changed = security_changed_cb,
-	.identity_resolved = identity_resolved_cb
+	.identity_resolved = identity_resolved_cb,
+	.le_param_updated = le_param_updated_cb,
+	.le_phy_updated = le_phy_updated_cb,
+	.le_data_len_updated = le_data_len_updated_cb,
 };
 
-static struct bt_conn *ba_sink_conn; /* TODO: Make a list of sinks */
+/* One sink at a time: the Broadcast Assistant of the Zephyr revision used (west.yml) serves a
+ * single connection. The receive states and BAP operation queues are kept per connection index
+ * already. TODO: Make a list of sinks
+ */
+static struct bt_conn *ba_sink_conn;
 static uint8_t ba_scan_target;
-static uint32_t ba_source_broadcast_id;
-static uint8_t ba_source_id; /* Source ID of the receive state */
-static struct bt_bap_scan_delegator_recv_state recv_state = {0};
+/* Last known receive state per sink (connection index) and src_id. Only changed from the Bluetooth
+ * callbacks, under recv_state_lock as the snapshot reads them from its own work queue.
+ */
+static struct recv_state_entry recv_states[CONFIG_BT_MAX_CONN][RECV_STATE_COUNT];
+static struct k_spinlock recv_state_lock;
+/* BASS discovered per sink (connection index) */
+static bool sink_ready[CONFIG_BT_MAX_CONN];
+static struct broadcast_assistant_link_params ba_link_params = {
+	.setup = BT_LE_CONN_PARAM_INIT(LINK_SETUP_INTERVAL_MIN, LINK_SETUP_INTERVAL_MAX,
+				       LINK_LATENCY, LINK_TIMEOUT),
+	.steady = BT_LE_CONN_PARAM_INIT(LINK_STEADY_INTERVAL_MIN, LINK_STEADY_INTERVAL_MAX,
+					LINK_LATENCY, LINK_TIMEOUT),
+	.phy = BT_GAP_LE_PHY_2M,
+};
+/* Built on its own work queue, it waits for the webusb workqueue to free TX buffers */
+static struct k_work_q snapshot_workqueue;
+static K_THREAD_STACK_DEFINE(snapshot_workqueue_stack, SNAPSHOT_WORKQUEUE_STACK_SIZE);
+static K_WORK_DEFINE(snapshot_work, snapshot_work_handler);
 
 /*
  * Private functions
@@ -96,187 +146,325 @@ static void broadcast_assistant_discover_cb(struct bt_conn *conn, int err, uint8
 
 	LOG_INF("Broadcast assistant discover callback (%p, %d, %u)", (void *)conn, err, recv_state_count);
 	if (err) {
-		err = bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
-		if (err) {
-			LOG_ERR("Failed to disconnect (err %d)", err);
-		}
-		restart_scanning_if_needed();
+		/* Failure is handled when the discover operation completes */
+		bap_op_queue_complete(conn, BAP_OP_DISCOVER, err);
 
-		return; /* return and wait for disconnected callback (assume no err) */
+		return;
 	}
 
 	/* Succesful connected to sink */
-	evt_msg = message_alloc_tx_message();
+	sink_ready[bt_conn_index(conn)] = true;
+
 	bt_addr_le = bt_conn_get_dst(conn);
 	bt_addr_le_to_str(bt_addr_le, addr_str, sizeof(addr_str));
 	LOG_DBG("Connected to %s", addr_str);
 
-	/* Bluetooth LE Device Address */
-	net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-	net_buf_add_u8(evt_msg, bt_addr_le_is_identity(bt_addr_le) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-	net_buf_add_u8(evt_msg, bt_addr_le->type);
-	net_buf_add_mem(evt_msg, &bt_addr_le->a, sizeof(bt_addr_t));
+	evt_msg = message_alloc_tx_event();
+	if (evt_msg) {
+		proto_evt_sink_connected(evt_msg, bt_addr_le, 0 /* OK */);
+		send_net_buf_event(MESSAGE_SUBTYPE_SINK_CONNECTED, evt_msg);
+	} else {
+		LOG_ERR("Failed to allocate sink connected event");
+	}
 
-	/* error code */
-	net_buf_add_u8(evt_msg, 1 /* len of BT_DATA type */ + sizeof(int32_t));
-	net_buf_add_u8(evt_msg, BT_DATA_ERROR_CODE);
-	net_buf_add_le32(evt_msg, 0 /* OK */);
+	/* BASS discovery done, sink is in steady state */
+	link_tune_steady(conn);
 
-	send_net_buf_event(MESSAGE_SUBTYPE_SINK_CONNECTED, evt_msg);
 	restart_scanning_if_needed();
+
+	bap_op_queue_complete(conn, BAP_OP_DISCOVER, 0);
 }
 
-static void broadcast_assistant_recv_state_cb(struct bt_conn *conn, int err,
-			   const struct bt_bap_scan_delegator_recv_state *state)
+static struct recv_state_entry *recv_state_entry_get(struct bt_conn *conn, uint8_t src_id,
+						     bool alloc)
 {
-	LOG_INF("Broadcast assistant recv_state callback (%p, %d)", (void *)conn, err);
+	struct recv_state_entry *entries = recv_states[bt_conn_index(conn)];
+	struct recv_state_entry *free_entry = NULL;
 
-	if (state->pa_sync_state != recv_state.pa_sync_state) {
-		struct net_buf *evt_msg;
-		enum message_sub_type evt_msg_sub_type;
-		const bt_addr_le_t *bt_addr_le;
+	for (size_t i = 0; i < RECV_STATE_COUNT; i++) {
+		if (entries[i].used && entries[i].state.src_id == src_id) {
+			return &entries[i];
+		}
 
-		LOG_INF("Going from PA state %u to %u", recv_state.pa_sync_state, state->pa_sync_state);
-
-		switch (state->pa_sync_state) {
-		case BT_BAP_PA_STATE_NOT_SYNCED:
-			LOG_INF("BT_BAP_PA_STATE_NOT_SYNCED");
-			evt_msg_sub_type = MESSAGE_SUBTYPE_NEW_PA_STATE_NOT_SYNCED;
-			break;
-		case BT_BAP_PA_STATE_INFO_REQ:
-			LOG_INF("BT_BAP_PA_STATE_INFO_REQ");
-			evt_msg_sub_type = MESSAGE_SUBTYPE_NEW_PA_STATE_INFO_REQ;
-			break;
-		case BT_BAP_PA_STATE_SYNCED:
-			LOG_INF("BT_BAP_PA_STATE_SYNCED (src_id = %u)", state->src_id);
-			ba_source_id = state->src_id; /* store source ID of the receive state */
-			evt_msg_sub_type = MESSAGE_SUBTYPE_NEW_PA_STATE_SYNCED;
-			break;
-		case BT_BAP_PA_STATE_FAILED:
-			LOG_INF("BT_BAP_PA_STATE_FAILED");
-			evt_msg_sub_type = MESSAGE_SUBTYPE_NEW_PA_STATE_FAILED;
-			break;
-		case BT_BAP_PA_STATE_NO_PAST:
-			LOG_INF("BT_BAP_PA_STATE_NO_PAST");
-			evt_msg_sub_type = MESSAGE_SUBTYPE_NEW_PA_STATE_NO_PAST;
-			break;
-		default:
-			LOG_INF("Invalid State Transition");
-			return;
+		if (!entries[i].used && free_entry == NULL) {
+			free_entry = &entries[i];
 		}
+	}
+
+	if (alloc && free_entry != NULL) {
+		memset(free_entry, 0, sizeof(*free_entry));
+		free_entry->used = true;
+		free_entry->state.src_id = src_id;
+	}
+
+	return alloc ? free_entry : NULL;
+}
 
-		evt_msg = message_alloc_tx_message();
+static void recv_state_entries_clear(struct bt_conn *conn)
+{
+	K_SPINLOCK(&recv_state_lock) {
+		memset(recv_states[bt_conn_index(conn)], 0, sizeof(recv_states[0]));
+	}
+}
 
-		/* Bluetooth LE Device Address */
-		bt_addr_le = bt_conn_get_dst(conn);
-		net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-		net_buf_add_u8(evt_msg, bt_addr_le_is_identity(bt_addr_le) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-		net_buf_add_u8(evt_msg, bt_addr_le->type);
-		net_buf_add_mem(evt_msg, &bt_addr_le->a, sizeof(bt_addr_t));
+/* A receive state event without metadata always fits, with a BIS_SYNC for each subgroup (present
+ * or removed). Metadata is added while there is room left for those.
+ */
+BUILD_ASSERT(PROTO_LTV_TIMESTAMP_SIZE + PROTO_LTV_ADDR_SIZE + PROTO_LTV_SOURCE_ID_SIZE +
+	     PROTO_LTV_BROADCAST_ID_SIZE + PROTO_LTV_PA_SYNC_STATE_SIZE + PROTO_LTV_ENC_STATE_SIZE +
+	     CONFIG_BT_BAP_BASS_MAX_SUBGROUPS * PROTO_LTV_BIS_SYNC_SIZE +
+	     PROTO_LTV_ERROR_CODE_SIZE <= CONFIG_TX_MSG_MAX_PAYLOAD_LEN,
+	     "Receive state event does not fit in a TX message");
+
+/* Append the fields of state that differ from old (all fields if old is NULL). Metadata that
+ * does not fit in the event is left out and the event ends with ERROR_CODE -EMSGSIZE.
+ */
+static bool recv_state_append(struct net_buf *evt_msg,
+			      const struct bt_bap_scan_delegator_recv_state *state,
+			      const struct bt_bap_scan_delegator_recv_state *old)
+{
+	static const struct bt_bap_scan_delegator_recv_state none;
+	bool is_new = old == NULL;
+	uint8_t num_subgroups;
+	uint8_t old_num_subgroups;
+	bool truncated = false;
+	bool changed = false;
+
+	if (is_new) {
+		old = &none;
+	}
 
-		/* broadcast id */
-		net_buf_add_u8(evt_msg, 5);
-		net_buf_add_u8(evt_msg, BT_DATA_BROADCAST_ID);
-		net_buf_add_le32(evt_msg, state->broadcast_id);
+	if (is_new || state->pa_sync_state != old->pa_sync_state) {
+		LOG_INF("src_id %u: PA state %u -> %u", state->src_id, old->pa_sync_state,
+			state->pa_sync_state);
 
-		send_net_buf_event(evt_msg_sub_type, evt_msg);
+		proto_add_pa_sync_state(evt_msg, state->pa_sync_state);
+		changed = true;
 	}
 
-	for (int i = 0; i < state->num_subgroups; i++) {
-		if (state->subgroups[i].bis_sync != recv_state.subgroups[i].bis_sync) {
-			struct net_buf *evt_msg;
-			enum message_sub_type evt_msg_sub_type;
-			const bt_addr_le_t *bt_addr_le;
+	if (is_new || state->encrypt_state != old->encrypt_state) {
+		LOG_INF("src_id %u: encryption state %u -> %u", state->src_id, old->encrypt_state,
+			state->encrypt_state);
 
-			/* BIS sync changed */
-			evt_msg_sub_type = state->subgroups[i].bis_sync == 0
-						   ? MESSAGE_SUBTYPE_BIS_NOT_SYNCED
-						   : MESSAGE_SUBTYPE_BIS_SYNCED;
+		proto_add_enc_state(evt_msg, state->encrypt_state);
+		changed = true;
+	}
 
-			LOG_INF("%s", evt_msg_sub_type == MESSAGE_SUBTYPE_BIS_SYNCED
-					      ? "MESSAGE_SUBTYPE_BIS_SYNCED"
-					      : "MESSAGE_SUBTYPE_BIS_NOT_SYNCED");
+	num_subgroups = MIN(state->num_subgroups, CONFIG_BT_BAP_BASS_MAX_SUBGROUPS);
+	old_num_subgroups = is_new ? 0 : MIN(old->num_subgroups, CONFIG_BT_BAP_BASS_MAX_SUBGROUPS);
+	for (uint8_t i = 0; i < num_subgroups; i++) {
+		const struct bt_bap_scan_delegator_subgroup *subgroup = &state->subgroups[i];
+		const struct bt_bap_scan_delegator_subgroup *old_subgroup = &old->subgroups[i];
+		bool new_subgroup = is_new || i >= old->num_subgroups;
 
-			evt_msg = message_alloc_tx_message();
+		if (new_subgroup || subgroup->bis_sync != old_subgroup->bis_sync) {
+			LOG_INF("src_id %u: subgroup %u BIS sync 0x%08x -> 0x%08x", state->src_id,
+				i, old_subgroup->bis_sync, subgroup->bis_sync);
 
-			/* Bluetooth LE Device Address */
-			bt_addr_le = bt_conn_get_dst(conn);
-			net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-			net_buf_add_u8(evt_msg, bt_addr_le_is_identity(bt_addr_le) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-			net_buf_add_u8(evt_msg, bt_addr_le->type);
-			net_buf_add_mem(evt_msg, &bt_addr_le->a, sizeof(bt_addr_t));
+			proto_add_bis_sync(evt_msg, i, subgroup->bis_sync);
+			changed = true;
+		}
+
+		if (new_subgroup || subgroup->metadata_len != old_subgroup->metadata_len ||
+		    memcmp(subgroup->metadata, old_subgroup->metadata, subgroup->metadata_len) != 0) {
+			/* The BIS_SYNC of the following subgroups, of the removed subgroups
+			 * and the ERROR_CODE of a truncated event always fit (BUILD_ASSERT above)
+			 */
+			size_t reserved = (MAX(num_subgroups, old_num_subgroups) - i - 1) *
+					  PROTO_LTV_BIS_SYNC_SIZE + PROTO_LTV_ERROR_CODE_SIZE;
+
+			/* The LTV length byte covers type and subgroup as well */
+			if (subgroup->metadata_len <= UINT8_MAX - 2 &&
+			    net_buf_tailroom(evt_msg) >= 3 + subgroup->metadata_len + reserved) {
+				proto_add_subgroup_metadata(evt_msg, i, subgroup->metadata,
+							    subgroup->metadata_len);
+			} else {
+				truncated = true;
+			}
+			changed = true;
+		}
+	}
+
+	/* Subgroups that are no longer present are reported as not synced */
+	for (uint8_t i = num_subgroups; i < old_num_subgroups; i++) {
+		if (old->subgroups[i].bis_sync != 0) {
+			proto_add_bis_sync(evt_msg, i, 0);
+			changed = true;
+		}
+	}
+
+	if (truncated) {
+		LOG_ERR("src_id %u: metadata does not fit in the receive state event", state->src_id);
+		proto_add_error_code(evt_msg, -EMSGSIZE);
+	}
+
+	return changed;
+}
+
+static void broadcast_assistant_recv_state_cb(struct bt_conn *conn, int err,
+			   const struct bt_bap_scan_delegator_recv_state *state)
+{
+	struct recv_state_entry *entry;
+	const bt_addr_le_t *bt_addr_le;
+	struct net_buf *evt_msg;
+	bool is_new;
+	bool changed;
+
+	LOG_INF("Broadcast assistant recv_state callback (%p, %d)", (void *)conn, err);
+
+	/* Read during discovery or notified, neither is an operation of its own */
+	if (err || state == NULL) {
+		return;
+	}
+
+	/* Read without the lock, the entries are only changed on this thread */
+	entry = recv_state_entry_get(conn, state->src_id, false);
+	is_new = entry == NULL;
+
+	evt_msg = message_alloc_tx_event();
+	if (!evt_msg) {
+		/* Do not store the state so the change is reported on the next update */
+		LOG_ERR("Failed to allocate receive state event");
+		return;
+	}
 
-			/* broadcast id */
-			net_buf_add_u8(evt_msg, 5);
-			net_buf_add_u8(evt_msg, BT_DATA_BROADCAST_ID);
-			net_buf_add_le32(evt_msg, state->broadcast_id);
+	bt_addr_le = bt_conn_get_dst(conn);
+	proto_evt_recv_state_changed(evt_msg, bt_addr_le, state->src_id, state->broadcast_id);
+
+	/* Only append the fields that changed since the last update of this src_id */
+	changed = recv_state_append(evt_msg, state, is_new ? NULL : &entry->state);
 
-			send_net_buf_event(evt_msg_sub_type, evt_msg);
+	/* Store latest receive state of this sink and src_id, a new entry is only taken now so the
+	 * snapshot never sees it without its state
+	 */
+	K_SPINLOCK(&recv_state_lock) {
+		if (is_new) {
+			entry = recv_state_entry_get(conn, state->src_id, true);
 		}
+		if (entry) {
+			memcpy(&entry->state, state, sizeof(entry->state));
+		}
+	}
+
+	if (!entry) {
+		LOG_ERR("No free receive state entry (src_id = %u)", state->src_id);
+		net_buf_unref(evt_msg);
+		return;
+	}
+
+	if (!changed) {
+		LOG_DBG("src_id %u: receive state unchanged", state->src_id);
+		net_buf_unref(evt_msg);
+		return;
 	}
 
-	/* Store latest recv_state */
-	memcpy(&recv_state, state, sizeof(struct bt_bap_scan_delegator_recv_state));
+	send_net_buf_event(MESSAGE_SUBTYPE_RECV_STATE_CHANGED, evt_msg);
 }
 
 static void broadcast_assistant_recv_state_removed_cb(struct bt_conn *conn, int err, uint8_t src_id)
 {
+	struct recv_state_entry *entry;
+	const bt_addr_le_t *bt_addr_le;
+	struct net_buf *evt_msg;
+
 	LOG_INF("Broadcast assistant recv_state_removed callback (%p, %d, %u)", (void *)conn, err, src_id);
-	send_event(MESSAGE_SUBTYPE_SOURCE_REMOVED, err);
+
+	if (!err) {
+		K_SPINLOCK(&recv_state_lock) {
+			entry = recv_state_entry_get(conn, src_id, false);
+			if (entry) {
+				entry->used = false;
+			}
+		}
+	}
+
+	evt_msg = message_alloc_tx_event();
+	if (!evt_msg) {
+		LOG_ERR("Failed to allocate source removed event");
+		return;
+	}
+
+	bt_addr_le = bt_conn_get_dst(conn);
+	proto_evt_source_removed(evt_msg, bt_addr_le, src_id, err);
+
+	send_net_buf_event(MESSAGE_SUBTYPE_SOURCE_REMOVED, evt_msg);
 }
 
 static void broadcast_assistant_add_src_cb(struct bt_conn *conn, int err)
+{
+	LOG_INF("Broadcast assistant add_src callback (%p, %d)", (void *)conn, err);
+	bap_op_queue_complete(conn, BAP_OP_ADD_SRC, err);
+}
+
+static void broadcast_assistant_mod_src_cb(struct bt_conn *conn, int err)
+{
+	LOG_INF("Broadcast assistant mod_src callback (%p, %d)", (void *)conn, err);
+	bap_op_queue_complete(conn, BAP_OP_MOD_SRC, err);
+}
+
+static void broadcast_assistant_rem_src_cb(struct bt_conn *conn, int err)
+{
+	LOG_INF("Broadcast assistant rem_src callback (%p, %d)", (void *)conn, err);
+	bap_op_queue_complete(conn, BAP_OP_REM_SRC, err);
+}
+
+static void source_added(struct bt_conn *conn, uint32_t broadcast_id, int err)
 {
 	const bt_addr_le_t *bt_addr_le;
 	char addr_str[BT_ADDR_LE_STR_LEN];
 	struct net_buf *evt_msg;
 
-	LOG_INF("Broadcast assistant add_src callback (%p, %d)", (void *)conn, err);
+	evt_msg = message_alloc_tx_event();
+	if (!evt_msg) {
+		LOG_ERR("Failed to allocate source added event");
+		return;
+	}
 
-	evt_msg = message_alloc_tx_message();
-	bt_addr_le = bt_conn_get_dst(ba_sink_conn); /* sink addr */
+	bt_addr_le = bt_conn_get_dst(conn); /* sink addr */
 	bt_addr_le_to_str(bt_addr_le, addr_str, sizeof(addr_str));
 	LOG_DBG("Source added for %s", addr_str);
 
-	/* Bluetooth LE Device Address */
-	net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-	net_buf_add_u8(evt_msg, bt_addr_le_is_identity(bt_addr_le) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-	net_buf_add_u8(evt_msg, bt_addr_le->type);
-	net_buf_add_mem(evt_msg, &bt_addr_le->a, sizeof(bt_addr_t));
-
-	/* broadcast id */
-	net_buf_add_u8(evt_msg, 5);
-	net_buf_add_u8(evt_msg, BT_DATA_BROADCAST_ID);
-	net_buf_add_le32(evt_msg, ba_source_broadcast_id);
-	/* error code */
-	net_buf_add_u8(evt_msg, 1 /* len of BT_DATA type */ + sizeof(int32_t));
-	net_buf_add_u8(evt_msg, BT_DATA_ERROR_CODE);
-	net_buf_add_le32(evt_msg, err);
+	proto_evt_source_added(evt_msg, bt_addr_le, broadcast_id, err);
 
 	send_net_buf_event(MESSAGE_SUBTYPE_SOURCE_ADDED, evt_msg);
 }
 
-static void broadcast_assistant_mod_src_cb(struct bt_conn *conn, int err)
+static void bap_op_done(struct bt_conn *conn, const struct bap_op *op, int err)
 {
-	if (err) {
-		LOG_ERR("BASS modify source (err: %d)", err);
+	if (err == -ENOTCONN) {
+		/* Sink is gone, the host is notified by the disconnected event */
 		return;
 	}
 
-	LOG_INF("BASS modify source (bis_sync = 0, pa_sync = false) ok -> Now remove source");
-
-	err = bt_bap_broadcast_assistant_rem_src(conn, ba_source_id);
-	if (err) {
-		LOG_ERR("BASS remove source (err: %d)", err);
+	switch (op->type) {
+	case BAP_OP_DISCOVER:
+		if (err) {
+			LOG_ERR("Broadcast assistant discover (err %d)", err);
+			err = bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+			if (err) {
+				LOG_ERR("Failed to disconnect (err %d)", err);
+			}
+			restart_scanning_if_needed();
+		}
+		break;
+	case BAP_OP_ADD_SRC:
+		source_added(conn, op->add_src.broadcast_id, err);
+		break;
+	case BAP_OP_MOD_SRC:
+		if (err) {
+			LOG_ERR("BASS modify source (src_id %u, err: %d)", op->mod_src.src_id, err);
+		}
+		break;
+	case BAP_OP_REM_SRC:
+		if (err) {
+			LOG_ERR("BASS remove source (src_id %u, err: %d)", op->rem_src.src_id, err);
+		}
+		break;
+	default:
+		break;
 	}
 }
 
-static void broadcast_assistant_rem_src_cb(struct bt_conn *conn, int err)
-{
-	LOG_INF("BASS remove source (err: %d)", err);
-	ba_source_id = 0;
-}
-
 static void connected(struct bt_conn *conn, uint8_t err)
 {
 	LOG_INF("Broadcast assistant connected callback (%p, err:%d)", (void *)conn, err);
@@ -290,26 +478,26 @@ static void connected(struct bt_conn *conn, uint8_t err)
 
 		LOG_ERR("Connected error (err %d)", err);
 
-		evt_msg = message_alloc_tx_message();
-		bt_addr_le = bt_conn_get_dst(conn);
-		/* Bluetooth LE Device Address */
-		net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-		net_buf_add_u8(evt_msg, bt_addr_le_is_identity(bt_addr_le) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-		net_buf_add_u8(evt_msg, bt_addr_le->type);
-		net_buf_add_mem(evt_msg, &bt_addr_le->a, sizeof(bt_addr_t));
-		/* error code */
-		net_buf_add_u8(evt_msg, 1 /* len of BT_DATA type */ + sizeof(int32_t));
-		net_buf_add_u8(evt_msg, BT_DATA_ERROR_CODE);
-		net_buf_add_le32(evt_msg, err);
+		evt_msg = message_alloc_tx_event();
+		if (evt_msg) {
+			bt_addr_le = bt_conn_get_dst(conn);
+			proto_evt_sink_connected(evt_msg, bt_addr_le, err);
+		} else {
+			LOG_ERR("Failed to allocate sink connected event");
+		}
 
 		bt_conn_unref(ba_sink_conn);
 		ba_sink_conn = NULL;
 
-		send_net_buf_event(MESSAGE_SUBTYPE_SINK_CONNECTED, evt_msg);
+		if (evt_msg) {
+			send_net_buf_event(MESSAGE_SUBTYPE_SINK_CONNECTED, evt_msg);
+		}
 		restart_scanning_if_needed();
 		return;
 	}
 
+	link_tune_setup(conn);
+
 	err = bt_conn_set_security(conn, BT_SECURITY_L2 | BT_SECURITY_FORCE_PAIR);
 	if (err) {
 		LOG_ERR("Setting security failed (err %d)", err);
@@ -329,36 +517,41 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 	}
 
 	bt_addr_le = bt_conn_get_dst(conn);
-	evt_msg = message_alloc_tx_message();
-	/* Bluetooth LE Device Address */
-	net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-	net_buf_add_u8(evt_msg, bt_addr_le_is_identity(bt_addr_le) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-	net_buf_add_u8(evt_msg, bt_addr_le->type);
-	net_buf_add_mem(evt_msg, &bt_addr_le->a, sizeof(bt_addr_t));
-	/* error code */
-	net_buf_add_u8(evt_msg, 1 /* len of BT_DATA type */ + sizeof(int32_t));
-	net_buf_add_u8(evt_msg, BT_DATA_ERROR_CODE);
-	net_buf_add_le32(evt_msg, 0 /* OK */);
+	evt_msg = message_alloc_tx_event();
+	if (evt_msg) {
+		proto_evt_sink_disconnected(evt_msg, bt_addr_le, 0 /* OK */);
+	} else {
+		LOG_ERR("Failed to allocate sink disconnected event");
+	}
+
+	bap_op_queue_flush(conn);
+	recv_state_entries_clear(conn);
+	sink_ready[bt_conn_index(conn)] = false;
 
 	bt_conn_unref(ba_sink_conn);
 	ba_sink_conn = NULL;
 
-	send_net_buf_event(MESSAGE_SUBTYPE_SINK_DISCONNECTED, evt_msg);
+	if (evt_msg) {
+		send_net_buf_event(MESSAGE_SUBTYPE_SINK_DISCONNECTED, evt_msg);
+	}
 }
 
 static void security_changed_cb(struct bt_conn *conn, bt_security_t level, enum bt_security_err err)
 {
+	const struct bap_op op = { .type = BAP_OP_DISCOVER };
+	int ret;
+
 	LOG_INF("Broadcast assistant security_changed callback (%p, %d, err:%d)", (void *)conn, level, err);
 
 
 	/* Connected. Do BAP broadcast assistant discover */
 	LOG_INF("Broadcast assistant discover");
-	err = bt_bap_broadcast_assistant_discover(ba_sink_conn);
-	if (err) {
-		LOG_ERR("Broadcast assistant discover (err %d)", err);
-		err = bt_conn_disconnect(ba_sink_conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
-		if (err) {
-			LOG_ERR("Failed to disconnect (err %d)", err);
+	ret = bap_op_queue_submit(conn, &op);
+	if (ret) {
+		LOG_ERR("Broadcast assistant discover (err %d)", ret);
+		ret = bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		if (ret) {
+			LOG_ERR("Failed to disconnect (err %d)", ret);
 		}
 		restart_scanning_if_needed();
 
@@ -379,19 +572,92 @@ static void identity_resolved_cb(struct bt_conn *conn, const bt_addr_le_t *rpa,
 	struct net_buf *evt_msg;
 
 	evt_msg_sub_type = MESSAGE_SUBTYPE_IDENTITY_RESOLVED;
-	evt_msg = message_alloc_tx_message();
+	evt_msg = message_alloc_tx_event();
+	if (!evt_msg) {
+		LOG_ERR("Failed to allocate identity resolved event");
+		return;
+	}
+	proto_evt_identity_resolved(evt_msg, rpa, identity);
 
-	net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-	net_buf_add_u8(evt_msg, BT_DATA_RPA);
-	net_buf_add_u8(evt_msg, rpa->type);
-	net_buf_add_mem(evt_msg, &rpa->a, sizeof(bt_addr_t));
+	send_net_buf_event(evt_msg_sub_type, evt_msg);
+}
 
-	net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-	net_buf_add_u8(evt_msg, BT_DATA_IDENTITY);
-	net_buf_add_u8(evt_msg, identity->type);
-	net_buf_add_mem(evt_msg, &identity->a, sizeof(bt_addr_t));
+static void le_param_updated_cb(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+				uint16_t timeout)
+{
+	LOG_INF("Connection parameters updated (%p, interval: %u, latency: %u, timeout: %u)",
+		(void *)conn, interval, latency, timeout);
+}
 
-	send_net_buf_event(evt_msg_sub_type, evt_msg);
+static void le_phy_updated_cb(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+	LOG_INF("PHY updated (%p, tx: 0x%02x, rx: 0x%02x)", (void *)conn, param->tx_phy,
+		param->rx_phy);
+}
+
+static void le_data_len_updated_cb(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	LOG_INF("Data length updated (%p, tx: %u bytes/%u us, rx: %u bytes/%u us)", (void *)conn,
+		info->tx_max_len, info->tx_max_time, info->rx_max_len, info->rx_max_time);
+}
+
+static void link_tune_setup(struct bt_conn *conn)
+{
+	int err;
+
+	/* The connection is created with the setup interval, so only PHY and data
+	 * length need to be requested here. The controller serializes the procedures.
+	 */
+	if (ba_link_params.phy != BT_GAP_LE_PHY_NONE) {
+		const struct bt_conn_le_phy_param phy_param = {
+			.options = BT_CONN_LE_PHY_OPT_NONE,
+			.pref_tx_phy = ba_link_params.phy,
+			.pref_rx_phy = ba_link_params.phy,
+		};
+
+		err = bt_conn_le_phy_update(conn, &phy_param);
+		if (err) {
+			LOG_ERR("PHY update request failed (err %d)", err);
+		}
+	}
+
+	err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+	if (err) {
+		LOG_ERR("Data length update request failed (err %d)", err);
+	}
+}
+
+static void link_tune_steady(struct bt_conn *conn)
+{
+	int err;
+
+	LOG_INF("Relaxing connection interval to %u-%u", ba_link_params.steady.interval_min,
+		ba_link_params.steady.interval_max);
+
+	err = bt_conn_le_param_update(conn, &ba_link_params.steady);
+	if (err) {
+		LOG_ERR("Connection parameter update request failed (err %d)", err);
+	}
+}
+
+static bool link_conn_param_valid(const struct bt_le_conn_param *param)
+{
+	/* Core Spec v5.4, Vol 6, Part B, Section 4.5.2 */
+	if (param->interval_min < LINK_INTERVAL_MIN || param->interval_max > LINK_INTERVAL_MAX ||
+	    param->interval_min > param->interval_max) {
+		return false;
+	}
+
+	if (param->latency > 499 || param->timeout < 10 || param->timeout > 3200) {
+		return false;
+	}
+
+	/* Supervision timeout must be larger than (1 + latency) * interval_max * 2 */
+	if ((4U * param->timeout) <= ((1U + param->latency) * param->interval_max)) {
+		return false;
+	}
+
+	return true;
 }
 
 static void restart_scanning_if_needed(void)
@@ -416,233 +682,92 @@ static void restart_scanning_if_needed(void)
 	}
 }
 
-static bool device_found(struct bt_data *data, void *user_data)
-{
-	struct scan_recv_data *sr_data = (struct scan_recv_data *)user_data;
-	struct bt_uuid_16 adv_uuid;
-
-	switch (data->type) {
-	case BT_DATA_NAME_SHORTENED:
-	case BT_DATA_NAME_COMPLETE:
-		memcpy(sr_data->bt_name, data->data, MIN(data->data_len, BT_NAME_LEN - 1));
-		sr_data->bt_name_type = data->type == BT_DATA_NAME_SHORTENED
-						? BT_DATA_NAME_SHORTENED
-						: BT_DATA_NAME_COMPLETE;
-		return true;
-	case BT_DATA_BROADCAST_NAME:
-		memcpy(sr_data->broadcast_name, data->data, MIN(data->data_len, BT_NAME_LEN - 1));
-		return true;
-	case BT_DATA_SVC_DATA16:
-		/* TODO: Test code bolow before enable */
-#if 0
-		/* Check for BASS in Service Data */
-		if (data->data_len >= BT_UUID_SIZE_16) {
-			const struct bt_uuid *uuid;
-			uint16_t u16;
-
-			memcpy(&u16, data->data, sizeof(u16));
-			uuid = BT_UUID_DECLARE_16(sys_le16_to_cpu(u16));
-
-			if (bt_uuid_cmp(uuid, BT_UUID_BASS)) {
-				sr_info->has_bass = true;
-				return true;
-			}
-		}
-#endif /* 0 */
-
-		/* Check for Broadcast ID */
-		if (data->data_len < BT_UUID_SIZE_16 + BT_AUDIO_BROADCAST_ID_SIZE) {
-			return true;
-		}
-
-		if (!bt_uuid_create(&adv_uuid.uuid, data->data, BT_UUID_SIZE_16)) {
-			return true;
-		}
-
-		if (bt_uuid_cmp(&adv_uuid.uuid, BT_UUID_BROADCAST_AUDIO) != 0) {
-			return true;
-		}
-
-		sr_data->broadcast_id = sys_get_le24(data->data + BT_UUID_SIZE_16);
-		return true;
-	case BT_DATA_UUID16_SOME:
-	case BT_DATA_UUID16_ALL:
-		/* NOTE: According to the BAP 1.0.1 Spec,
-		 * Section 3.9.2. Additional Broadcast Audio Scan Service requirements,
-		 * If the Scan Delegator implements a Broadcast Sink, it should also
-		 * advertise a Service Data field containing the Broadcast Audio
-		 * Scan Service (BASS) UUID.
-		 *
-		 * However, it seems that this is not the case with the sinks available
-		 * while developing this sample application.  Therefore, we instead,
-		 * search for the existence of BASS and PACS in the list of service UUIDs,
-		 * which does seem to exist in the sinks available.
-		 */
-
-		/* Check for BASS and PACS */
-		if (data->data_len % sizeof(uint16_t) != 0U) {
-			LOG_ERR("UUID16 AD malformed\n");
-			return true;
-		}
-
-		for (size_t i = 0; i < data->data_len; i += sizeof(uint16_t)) {
-			const struct bt_uuid *uuid;
-			uint16_t u16;
-
-			memcpy(&u16, &data->data[i], sizeof(u16));
-			uuid = BT_UUID_DECLARE_16(sys_le16_to_cpu(u16));
-
-			if (bt_uuid_cmp(uuid, BT_UUID_BASS) == 0) {
-				sr_data->has_bass = true;
-				continue;
-			}
+static void scan_recv_cb(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad)
+{
+	uint64_t timestamp = message_timestamp_get();
+	enum message_sub_type evt_msg_sub_type;
+	struct scan_recv_data sr_data;
+	struct rssi_report rssi;
+	struct net_buf *evt_msg;
+	enum ad_class class;
+	uint8_t *p;
 
-			if (bt_uuid_cmp(uuid, BT_UUID_PACS) == 0) {
-				sr_data->has_pacs = true;
-				continue;
-			}
-		}
-		return true;
-	default:
-		return true;
+	/* Cheapest checks first, nothing below allocates until the report has passed all filters */
+	if (ad_candidate(info->adv_props, info->interval, ba_scan_target) == AD_CLASS_NONE) {
+		return;
 	}
-}
 
-static bool scan_for_source(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad,
-			    struct scan_recv_data *sr_data)
-{
-	/* Scan for and select Broadcast Source */
+	if (!scan_filter_check_info(info->rssi, info->addr)) {
+		return;
+	}
 
-	sr_data->broadcast_id = INVALID_BROADCAST_ID;
+	/* Single pass over the AD data, ad is left untouched for the event message */
+	class = ad_classify(info->adv_props, info->interval, ba_scan_target, ad->data, ad->len,
+			    &sr_data);
 
-	/* We are only interested in non-connectable periodic advertisers */
-	if ((info->adv_props & BT_GAP_ADV_PROP_CONNECTABLE) != 0 || info->interval == 0) {
-		return false;
+	if (class == AD_CLASS_NONE || !scan_filter_check_data(class, &sr_data)) {
+		return;
 	}
 
-	bt_data_parse(ad, device_found, (void *)sr_data);
+	/* Repeated reports of a device are held back until its filtered RSSI is due */
+	if (!rssi_report_update(info->addr, info->rssi, &rssi)) {
+		return;
+	}
 
-	if (sr_data->broadcast_id != INVALID_BROADCAST_ID) {
+	switch (class) {
+	case AD_CLASS_SOURCE:
 		LOG_INF("Broadcast Source Found [name, b_name, b_id] = [\"%s\", \"%s\", 0x%06x]",
-			sr_data->bt_name, sr_data->broadcast_name, sr_data->broadcast_id);
+			sr_data.bt_name, sr_data.broadcast_name, sr_data.broadcast_id);
 
 		/* TODO: Add support for syncing to the PA and parsing the BASE
 		 * in order to obtain the right subgroup information to send to
 		 * the sink when adding a broadcast source (see in main function below).
 		 */
-
-		return true;
+		evt_msg_sub_type = MESSAGE_SUBTYPE_SOURCE_FOUND;
+		break;
+	case AD_CLASS_SINK:
+		if (IS_ENABLED(CONFIG_LOG)) {
+			char addr_str[BT_ADDR_LE_STR_LEN];
+
+			bt_addr_le_to_str(info->addr, addr_str, sizeof(addr_str));
+			LOG_INF("Broadcast Sink Found: [\"%s\", %s]", sr_data.bt_name, addr_str);
+		}
+		evt_msg_sub_type = MESSAGE_SUBTYPE_SINK_FOUND;
+		break;
+	default:
+		return;
 	}
 
-	return false;
-}
-
-static bool scan_for_sink(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad,
-			  struct scan_recv_data *sr_data)
-{
-	/* Scan for and connect to Broadcast Sink */
-
-	/* We are only interested in connectable advertisers */
-	if ((info->adv_props & BT_GAP_ADV_PROP_CONNECTABLE) == 0) {
-		return false;
+	/* The next advertisement repeats a lost report, it does not take an event sequence number */
+	evt_msg = message_alloc_tx_message();
+	if (!evt_msg) {
+		LOG_ERR("Failed to allocate scan event");
+		rssi_report_unsent(info->addr, &rssi);
+		return;
 	}
 
-	bt_data_parse(ad, device_found, (void *)sr_data);
-
-	if (sr_data->has_bass) {
-		char addr_str[BT_ADDR_LE_STR_LEN];
+	message_add_timestamp(evt_msg, timestamp);
+	net_buf_add_mem(evt_msg, ad->data, ad->len);
 
-		bt_addr_le_to_str(info->addr, addr_str, sizeof(addr_str));
-		LOG_INF("Broadcast Sink Found: [\"%s\", %s]", sr_data->bt_name, addr_str);
-
-		return true;
+	/* Append data from struct bt_le_scan_recv_info (RSSI, BT addr, ..) */
+	p = net_buf_add(evt_msg, PROTO_LTV_RSSI_SIZE + PROTO_LTV_ADDR_SIZE);
+	p = proto_put_rssi(p, rssi.rssi);
+	proto_put_addr(p, info->addr);
+	if (rssi.count > 0) {
+		proto_add_rssi_stats(evt_msg, rssi.min, rssi.max, rssi.count);
 	}
-
-	return false;
-}
-
-static void scan_recv_cb(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad)
-{
-	struct net_buf_simple ad_clone1, ad_clone2;
-
-	/* Clone needed for the event message because bt_data_parse consumes ad data */
-	net_buf_simple_clone(ad, &ad_clone1);
-	net_buf_simple_clone(ad, &ad_clone2);
-
-	if (ba_scan_target & BROADCAST_ASSISTANT_SCAN_TARGET_SOURCE) {
-		enum message_sub_type evt_msg_sub_type;
-		struct net_buf *evt_msg;
-		struct scan_recv_data sr_data = {0};
-
-		if (scan_for_source(info, &ad_clone1, &sr_data)) {
-			/* broadcast source found */
-			evt_msg_sub_type = MESSAGE_SUBTYPE_SOURCE_FOUND;
-			evt_msg = message_alloc_tx_message();
-
-			net_buf_add_mem(evt_msg, ad->data, ad->len);
-
-			/* Append data from struct bt_le_scan_recv_info (RSSI, BT addr, ..) */
-			/* RSSI */
-			net_buf_add_u8(evt_msg, 2);
-			net_buf_add_u8(evt_msg, BT_DATA_RSSI);
-			net_buf_add_u8(evt_msg, info->rssi);
-			/* Bluetooth LE Device Address */
-			net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-			net_buf_add_u8(evt_msg, bt_addr_le_is_identity(info->addr) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-			net_buf_add_u8(evt_msg, info->addr->type);
-			net_buf_add_mem(evt_msg, &info->addr->a, sizeof(bt_addr_t));
-			/* BT name */
-			net_buf_add_u8(evt_msg, strlen(sr_data.bt_name) + 1);
-			net_buf_add_u8(evt_msg, sr_data.bt_name_type);
-			net_buf_add_mem(evt_msg, &sr_data.bt_name, strlen(sr_data.bt_name));
-
-			/* sid */
-			net_buf_add_u8(evt_msg, 2);
-			net_buf_add_u8(evt_msg, BT_DATA_SID);
-			net_buf_add_u8(evt_msg, info->sid);
-			/* pa interval */
-			net_buf_add_u8(evt_msg, 3);
-			net_buf_add_u8(evt_msg, BT_DATA_PA_INTERVAL);
-			net_buf_add_le16(evt_msg, info->interval);
-			/* broadcast id */
-			net_buf_add_u8(evt_msg, 5);
-			net_buf_add_u8(evt_msg, BT_DATA_BROADCAST_ID);
-			net_buf_add_le32(evt_msg, sr_data.broadcast_id);
-
-			send_net_buf_event(evt_msg_sub_type, evt_msg);
-		}
+	/* BT name */
+	proto_add_ltv(evt_msg, sr_data.bt_name_type, sr_data.bt_name, strlen(sr_data.bt_name));
+
+	if (class == AD_CLASS_SOURCE) {
+		p = net_buf_add(evt_msg, PROTO_LTV_SID_SIZE + PROTO_LTV_PA_INTERVAL_SIZE +
+					 PROTO_LTV_BROADCAST_ID_SIZE);
+		p = proto_put_sid(p, info->sid);
+		p = proto_put_pa_interval(p, info->interval);
+		proto_put_broadcast_id(p, sr_data.broadcast_id);
 	}
 
-	if (ba_scan_target & BROADCAST_ASSISTANT_SCAN_TARGET_SINK) {
-		enum message_sub_type evt_msg_sub_type;
-		struct net_buf *evt_msg;
-		struct scan_recv_data sr_data = {0};
-
-		if (scan_for_sink(info, &ad_clone2, &sr_data)) {
-			/* broadcast sink found */
-			evt_msg_sub_type = MESSAGE_SUBTYPE_SINK_FOUND;
-			evt_msg = message_alloc_tx_message();
-
-			net_buf_add_mem(evt_msg, ad->data, ad->len);
-
-			/* Append data from struct bt_le_scan_recv_info (RSSI, BT addr, ..) */
-			/* RSSI */
-			net_buf_add_u8(evt_msg, 2);
-			net_buf_add_u8(evt_msg, BT_DATA_RSSI);
-			net_buf_add_u8(evt_msg, info->rssi);
-			/* Bluetooth LE Device Address */
-			net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-			net_buf_add_u8(evt_msg, bt_addr_le_is_identity(info->addr) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-			net_buf_add_u8(evt_msg, info->addr->type);
-			net_buf_add_mem(evt_msg, &info->addr->a, sizeof(bt_addr_t));
-			/* BT name */
-			net_buf_add_u8(evt_msg, strlen(sr_data.bt_name) + 1);
-			net_buf_add_u8(evt_msg, sr_data.bt_name_type);
-			net_buf_add_mem(evt_msg, &sr_data.bt_name, strlen(sr_data.bt_name));
-
-			send_net_buf_event(evt_msg_sub_type, evt_msg);
-		}
-	}
+	send_net_buf_event(evt_msg_sub_type, evt_msg);
 }
 
 static void scan_timeout_cb(void)
@@ -735,7 +860,7 @@ int connect_to_sink(bt_addr_le_t *bt_addr_le)
 	int err;
 
 	if (ba_sink_conn) {
-		/* Sink already connected. TODO: Support multiple sinks*/
+		/* Sink already connected or connecting, see ba_sink_conn */
 		return -EAGAIN;
 	}
 
@@ -752,7 +877,7 @@ int connect_to_sink(bt_addr_le_t *bt_addr_le)
 	bt_addr_le_to_str(bt_addr_le, addr_str, sizeof(addr_str));
 	LOG_INF("Connecting to %s...", addr_str);
 
-	err = bt_conn_le_create(bt_addr_le, BT_CONN_LE_CREATE_CONN, BT_LE_CONN_PARAM_DEFAULT,
+	err = bt_conn_le_create(bt_addr_le, BT_CONN_LE_CREATE_CONN, &ba_link_params.setup,
 				&ba_sink_conn);
 	if (err) {
 		LOG_ERR("Failed creating connection (err=%d)", err);
@@ -782,16 +907,12 @@ int disconnect_from_sink(bt_addr_le_t *bt_addr_le)
 			struct net_buf *evt_msg;
 
 			LOG_ERR("Failed to disconnect (err %d)", err);
-			evt_msg = message_alloc_tx_message();
-			/* Bluetooth LE Device Address */
-			net_buf_add_u8(evt_msg, 1 + BT_ADDR_LE_SIZE);
-			net_buf_add_u8(evt_msg, bt_addr_le_is_identity(bt_addr_le) ? BT_DATA_IDENTITY : BT_DATA_RPA);
-			net_buf_add_u8(evt_msg, bt_addr_le->type);
-			net_buf_add_mem(evt_msg, &bt_addr_le->a, sizeof(bt_addr_t));
-			/* error code */
-			net_buf_add_u8(evt_msg, 1 /* len of BT_DATA type */ + sizeof(int32_t));
-			net_buf_add_u8(evt_msg, BT_DATA_ERROR_CODE);
-			net_buf_add_le32(evt_msg, err);
+			evt_msg = message_alloc_tx_event();
+			if (!evt_msg) {
+				LOG_ERR("Failed to allocate sink disconnected event");
+				return 0;
+			}
+			proto_evt_sink_disconnected(evt_msg, bt_addr_le, err);
 
 			send_net_buf_event(MESSAGE_SUBTYPE_SINK_DISCONNECTED, evt_msg);
 		}
@@ -804,33 +925,24 @@ int add_source(uint8_t sid, uint16_t pa_interval, uint32_t broadcast_id, bt_addr
 {
 	LOG_INF("Adding broadcast source...");
 
-	struct bt_bap_scan_delegator_subgroup subgroup = {0};
-	struct bt_bap_broadcast_assistant_add_src_param param = {0};
+	struct bap_op op = { .type = BAP_OP_ADD_SRC };
 	int err = 0;
 
-	subgroup.bis_sync = BT_BAP_BIS_SYNC_NO_PREF; /* We might want to hard code to BIT(1) */
-
-	bt_addr_le_copy(&param.addr, addr);
-	param.adv_sid = sid;
-	param.pa_interval = pa_interval;
-	param.broadcast_id = broadcast_id;
-	param.pa_sync = true;
+	bt_addr_le_copy(&op.add_src.addr, addr);
+	op.add_src.adv_sid = sid;
+	op.add_src.pa_interval = pa_interval;
+	op.add_src.broadcast_id = broadcast_id;
 
-	/* keep broadcast_id as global variable */
-	ba_source_broadcast_id = broadcast_id;
-
-	LOG_INF("adv_sid = %u, pa_interval = %u, broadcast_id = 0x%08x", param.adv_sid,
-		param.pa_interval, param.broadcast_id);
-
-	param.num_subgroups = 1;
-	param.subgroups = &subgroup;
+	LOG_INF("adv_sid = %u, pa_interval = %u, broadcast_id = 0x%08x", op.add_src.adv_sid,
+		op.add_src.pa_interval, op.add_src.broadcast_id);
 
 	if (!ba_sink_conn) {
 		LOG_INF("No sink connected!");
 		return -ENOTCONN;
 	}
 
-	err = bt_bap_broadcast_assistant_add_src(ba_sink_conn, &param);
+	/* The result is reported with the SOURCE_ADDED event */
+	err = bap_op_queue_submit(ba_sink_conn, &op);
 	if (err) {
 		LOG_ERR("Failed to add source (err %d)", err);
 		return err;
@@ -843,34 +955,197 @@ int remove_source(void)
 {
 	LOG_INF("Removing broadcast source...");
 
-	struct bt_bap_scan_delegator_subgroup subgroup = {0}; /* bis_sync = 0 */
-	struct bt_bap_broadcast_assistant_mod_src_param param = { 0 };
-	int err = 0;
-
-	param.src_id = ba_source_id;
-	param.pa_sync = false; /* stop sync to periodic advertisements */
-	param.pa_interval = BT_BAP_PA_INTERVAL_UNKNOWN;
-	param.num_subgroups = 1; /* TODO: Support multiple subgroups */
-	param.subgroups = &subgroup;
+	struct recv_state_entry *entries;
+	int queued = 0;
 
 	if (!ba_sink_conn) {
 		LOG_INF("No sink connected!");
 		return -ENOTCONN;
 	}
 
-	err = bt_bap_broadcast_assistant_mod_src(ba_sink_conn, &param);
-	if (err) {
-		LOG_ERR("Failed to modify source (err %d)", err);
-		return err;
+	/* Stop sync (bis_sync = 0, pa_sync = false) and then remove every source of the sink */
+	entries = recv_states[bt_conn_index(ba_sink_conn)];
+	for (size_t i = 0; i < RECV_STATE_COUNT; i++) {
+		struct bap_op op = { .type = BAP_OP_MOD_SRC };
+		bool used;
+		int err;
+
+		K_SPINLOCK(&recv_state_lock) {
+			used = entries[i].used;
+			op.mod_src.src_id = entries[i].state.src_id;
+			op.mod_src.num_subgroups = entries[i].state.num_subgroups;
+		}
+
+		if (!used) {
+			continue;
+		}
+
+		op.mod_src.pa_sync = false;
+		op.mod_src.bis_sync = 0;
+		op.mod_src.remove_after = true;
+
+		err = bap_op_queue_submit(ba_sink_conn, &op);
+		if (err) {
+			LOG_ERR("Failed to modify source (err %d)", err);
+			return err;
+		}
+
+		queued++;
+	}
+
+	if (queued == 0) {
+		LOG_INF("No source to remove");
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+int set_link_params(const struct broadcast_assistant_link_params *params)
+{
+	if (!link_conn_param_valid(&params->setup) || !link_conn_param_valid(&params->steady)) {
+		LOG_ERR("Invalid connection parameters");
+		return -EINVAL;
 	}
 
+	if (params->phy & ~(BT_GAP_LE_PHY_1M | BT_GAP_LE_PHY_2M | BT_GAP_LE_PHY_CODED)) {
+		LOG_ERR("Invalid PHY 0x%02x", params->phy);
+		return -EINVAL;
+	}
+
+	memcpy(&ba_link_params, params, sizeof(ba_link_params));
+
+	LOG_INF("Link params: setup %u-%u, steady %u-%u, latency %u, timeout %u, phy 0x%02x",
+		ba_link_params.setup.interval_min, ba_link_params.setup.interval_max,
+		ba_link_params.steady.interval_min, ba_link_params.steady.interval_max,
+		ba_link_params.steady.latency, ba_link_params.steady.timeout, ba_link_params.phy);
+
 	return 0;
 }
 
+void get_link_params(struct broadcast_assistant_link_params *params)
+{
+	memcpy(params, &ba_link_params, sizeof(*params));
+}
+
+static void snapshot_sink(struct bt_conn *conn, void *user_data)
+{
+	struct recv_state_entry *entries = recv_states[bt_conn_index(conn)];
+	const bt_addr_le_t *bt_addr_le = bt_conn_get_dst(conn);
+	struct bt_conn_info info;
+	struct net_buf *evt_msg;
+	int *err = user_data;
+	uint8_t conn_state;
+
+	if (bt_conn_get_info(conn, &info) != 0 || info.state == BT_CONN_STATE_DISCONNECTING ||
+	    info.state == BT_CONN_STATE_DISCONNECTED) {
+		/* Reported by the disconnected event */
+		return;
+	}
+
+	if (info.state == BT_CONN_STATE_CONNECTING) {
+		conn_state = SINK_CONN_STATE_CONNECTING;
+	} else if (sink_ready[bt_conn_index(conn)]) {
+		conn_state = SINK_CONN_STATE_READY;
+	} else {
+		conn_state = SINK_CONN_STATE_CONNECTED;
+	}
+
+	evt_msg = message_alloc_tx_event_timeout(SNAPSHOT_ALLOC_TIMEOUT);
+	if (!evt_msg) {
+		*err = -ENOMEM;
+		return;
+	}
+
+	proto_evt_sink_state(evt_msg, bt_addr_le, conn_state, bt_conn_get_security(conn));
+	send_net_buf_event(MESSAGE_SUBTYPE_SINK_STATE, evt_msg);
+
+	for (size_t i = 0; i < RECV_STATE_COUNT; i++) {
+		struct bt_bap_scan_delegator_recv_state state;
+		bool used;
+
+		/* Copied, the Bluetooth callbacks update the entry meanwhile */
+		K_SPINLOCK(&recv_state_lock) {
+			used = entries[i].used;
+			if (used) {
+				memcpy(&state, &entries[i].state, sizeof(state));
+			}
+		}
+
+		if (!used) {
+			continue;
+		}
+
+		evt_msg = message_alloc_tx_event_timeout(SNAPSHOT_ALLOC_TIMEOUT);
+		if (!evt_msg) {
+			*err = -ENOMEM;
+			return;
+		}
+
+		proto_evt_recv_state_changed(evt_msg, bt_addr_le, state.src_id, state.broadcast_id);
+		recv_state_append(evt_msg, &state, NULL);
+		send_net_buf_event(MESSAGE_SUBTYPE_RECV_STATE_CHANGED, evt_msg);
+	}
+}
+
+static void snapshot_work_handler(struct k_work *work)
+{
+	struct net_buf *end_msg;
+	struct net_buf *evt_msg;
+	int err = 0;
+
+	ARG_UNUSED(work);
+
+	LOG_INF("Sending state snapshot");
+
+	/* Taken first so STATE_SNAPSHOT_END, with the error of an incomplete snapshot, always
+	 * makes it. Without it the host only sees gaps, and resyncs again.
+	 */
+	end_msg = message_alloc_tx_message_timeout(SNAPSHOT_ALLOC_TIMEOUT);
+	if (!end_msg) {
+		/* Nothing sent, the host times out waiting for the snapshot */
+		LOG_ERR("Failed to allocate state snapshot");
+		return;
+	}
+
+	evt_msg = message_alloc_tx_event_timeout(SNAPSHOT_ALLOC_TIMEOUT);
+	if (evt_msg) {
+		proto_evt_state_snapshot_begin(evt_msg, ba_scan_target);
+		send_net_buf_event(MESSAGE_SUBTYPE_STATE_SNAPSHOT_BEGIN, evt_msg);
+	} else {
+		err = -ENOMEM;
+	}
+
+	bt_conn_foreach(BT_CONN_TYPE_LE, snapshot_sink, &err);
+
+	if (err) {
+		LOG_ERR("State snapshot incomplete (err %d)", err);
+	}
+
+	message_add_timestamp(end_msg, message_timestamp_get());
+	proto_evt_state_snapshot_end(end_msg, err);
+	send_net_buf_event(MESSAGE_SUBTYPE_STATE_SNAPSHOT_END, end_msg);
+}
+
+void request_state_snapshot(void)
+{
+	/* A request while a snapshot is being sent queues one more */
+	k_work_submit_to_queue(&snapshot_workqueue, &snapshot_work);
+}
+
 int broadcast_assistant_init(void)
 {
 	ba_sink_conn = NULL;
 
+	/* SET_LINK_PARAMS keeps the parameters not in the message, the defaults must be valid */
+	__ASSERT(link_conn_param_valid(&ba_link_params.setup) &&
+		 link_conn_param_valid(&ba_link_params.steady), "Invalid default link parameters");
+
+	k_work_queue_start(&snapshot_workqueue, snapshot_workqueue_stack,
+			   K_THREAD_STACK_SIZEOF(snapshot_workqueue_stack),
+			   SNAPSHOT_WORKQUEUE_PRIORITY, NULL);
+	k_thread_name_set(&snapshot_workqueue.thread, "snapshot");
+
 	int err = bt_enable(NULL);
 	if (err) {
 		LOG_ERR("Bluetooth init failed (err %d)", err);
@@ -881,6 +1156,7 @@ int broadcast_assistant_init(void)
 
 	bt_le_scan_cb_register(&scan_callbacks);
 	bt_bap_broadcast_assistant_register_cb(&broadcast_assistant_callbacks);
+	bap_op_queue_init(bap_op_done);
 	LOG_INF("Bluetooth scan callback registered");
 
 	ba_scan_target = 0;
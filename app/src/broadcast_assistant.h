@@ -14,14 +14,9 @@
 #include <zephyr/types.h>
 #include <zephyr/bluetooth/gap.h>
 #include <zephyr/bluetooth/addr.h>
+#include <zephyr/bluetooth/conn.h>
 
-#define BT_DATA_RSSI         (BT_DATA_MANUFACTURER_DATA - 1)
-#define BT_DATA_SID          (BT_DATA_MANUFACTURER_DATA - 2)
-#define BT_DATA_PA_INTERVAL  (BT_DATA_MANUFACTURER_DATA - 3)
-#define BT_DATA_ERROR_CODE   (BT_DATA_MANUFACTURER_DATA - 4)
-#define BT_DATA_BROADCAST_ID (BT_DATA_MANUFACTURER_DATA - 5)
-#define BT_DATA_RPA          (BT_DATA_MANUFACTURER_DATA - 6)
-#define BT_DATA_IDENTITY     (BT_DATA_MANUFACTURER_DATA - 7)
+#include "protocol.h"
 
 enum {
 	BROADCAST_ASSISTANT_SCAN_TARGET_SOURCE = BIT(0),
@@ -30,12 +25,29 @@ enum {
 		(BROADCAST_ASSISTANT_SCAN_TARGET_SOURCE | BROADCAST_ASSISTANT_SCAN_TARGET_SINK)
 };
 
+/* Link parameters used for connected sinks. The setup parameters are used while
+ * discovering BASS and the steady parameters once the sink is ready.
+ */
+struct broadcast_assistant_link_params {
+	struct bt_le_conn_param setup;
+	struct bt_le_conn_param steady;
+	uint8_t phy; /* BT_GAP_LE_PHY_* bitmask, BT_GAP_LE_PHY_NONE to skip PHY update */
+};
+
 int start_scan(uint8_t target);
 int stop_scanning(void);
+/* One sink at a time, -EAGAIN while a sink is connected or connecting */
 int connect_to_sink(bt_addr_le_t *bt_addr_le);
 int disconnect_from_sink(bt_addr_le_t *bt_addr_le);
 int add_source(uint8_t sid, uint16_t pa_interval, uint32_t broadcast_id, bt_addr_le_t *addr);
+/* Stop sync to and remove all sources of the sink, -ENOENT if it has no receive state */
 int remove_source(void);
+int set_link_params(const struct broadcast_assistant_link_params *params);
+void get_link_params(struct broadcast_assistant_link_params *params);
+/* Send the current state as events, from STATE_SNAPSHOT_BEGIN to STATE_SNAPSHOT_END, from the
+ * snapshot work queue
+ */
+void request_state_snapshot(void);
 int broadcast_assistant_init(void);
 int disconnect_unpair_all(void);
 
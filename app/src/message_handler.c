@@ -14,12 +14,16 @@
 #include <zephyr/sys/byteorder.h>
 #include <zephyr/net/buf.h>
 #include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/audio/audio.h>
 
 #include "webusb.h"
 #include "broadcast_assistant.h"
 #include "message_handler.h"
+#include "scan_filter.h"
+#include "rssi_report.h"
 
-LOG_MODULE_REGISTER(message_handler, LOG_LEVEL_INF);
+#define MESSAGE_HANDLER_LOG_LEVEL LOG_LEVEL_INF
+LOG_MODULE_REGISTER(message_handler, MESSAGE_HANDLER_LOG_LEVEL);
 
 NET_BUF_POOL_DEFINE(command_tx_msg_pool, CONFIG_TX_MSG_MAX_MESSAGES, sizeof(struct webusb_message) + CONFIG_TX_MSG_MAX_PAYLOAD_LEN, 0, NULL);
 
@@ -28,49 +32,103 @@ struct webusb_ltv_data {
 	uint16_t pa_interval;
 	uint32_t broadcast_id;
 	bt_addr_le_t addr;
+	struct bt_le_conn_param conn_param_setup;
+	struct bt_le_conn_param conn_param_steady;
+	uint8_t phy;
+	uint8_t has_conn_param_setup : 1;
+	uint8_t has_conn_param_steady : 1;
+	uint8_t has_phy : 1;
 } __packed;
 
 
 static void heartbeat_timeout_handler(struct k_timer *dummy_p);
 K_TIMER_DEFINE(heartbeat_timer, heartbeat_timeout_handler, NULL);
 
-static void log_ltv(uint8_t *data, uint16_t data_len);
+static void log_ltv(const uint8_t *data, uint16_t data_len);
+
+/* FLOOD sends its events from the system workqueue, the due events every period */
+#define FLOOD_PERIOD_MS 1
+/* Largest FLOOD_DATA payload, the event may carry a TIMESTAMP as well */
+#define FLOOD_SIZE_MAX (CONFIG_TX_MSG_MAX_PAYLOAD_LEN - PROTO_LTV_TIMESTAMP_SIZE)
+#define BENCH_DATA_MAX 254
+
+struct bench_flood {
+	uint16_t size;
+	uint16_t rate;
+	uint16_t duration;
+};
+
+static void flood_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(flood_work, flood_work_handler);
 
 #define LTV_STR_LEN 256
+/* Value bytes logged per entry: "[ L:xx T:xx ", 3 per byte and "... ]" fit LTV_STR_LEN */
+#define LTV_STR_MAX_VALUES ((LTV_STR_LEN - 12 - 6) / 3)
 
-static void log_ltv(uint8_t *data, uint16_t data_len)
+static void log_ltv(const uint8_t *data, uint16_t data_len)
 {
-	char ltv_str[LTV_STR_LEN] = {0};
+	char ltv_str[LTV_STR_LEN];
+
+	/* Payloads are up to CONFIG_TX_MSG_MAX_PAYLOAD_LEN, only format them to log them */
+	if (!IS_ENABLED(CONFIG_LOG) || MESSAGE_HANDLER_LOG_LEVEL < LOG_LEVEL_DBG) {
+		return;
+	}
 
-	/* Log message payload (ltv format) */
-	for (int i = 0; i < data_len;) {
-		uint8_t ltv_len = *data++;
-		char *ch_ptr = &ltv_str[0];
+	/* Log message payload (ltv format), one line per entry */
+	for (uint16_t i = 0; i < data_len;) {
+		uint8_t ltv_len = data[i++];
+		size_t pos;
+
+		if (ltv_len > data_len - i) {
+			LOG_DBG("[ L:%02x beyond the payload ]", ltv_len);
+			return;
+		}
 
 		/* length */
-		sprintf(ch_ptr, "[ L:%02x ", ltv_len);
-		ch_ptr += 7;
+		pos = snprintf(ltv_str, sizeof(ltv_str), "[ L:%02x ", ltv_len);
 		if (ltv_len > 0) {
 			/* type */
-			sprintf(ch_ptr, "T:%02x ", *data++);
-			ch_ptr += 5;
-			if (ltv_len > 1) {
-				/* value */
-				for (int j = 1; j < ltv_len; j++) {
-					sprintf(ch_ptr, "%02x ", *data++);
-					ch_ptr += 3;
-				}
+			pos += snprintf(&ltv_str[pos], sizeof(ltv_str) - pos, "T:%02x ", data[i]);
+			/* value */
+			for (int j = 1; j < MIN(ltv_len, LTV_STR_MAX_VALUES + 1); j++) {
+				pos += snprintf(&ltv_str[pos], sizeof(ltv_str) - pos, "%02x ",
+						data[i + j]);
 			}
 		}
-		sprintf(ch_ptr, "]");
-		ch_ptr += 1;
-		i += (ltv_len + 1);
+		snprintf(&ltv_str[pos], sizeof(ltv_str) - pos,
+			 ltv_len > LTV_STR_MAX_VALUES + 1 ? "... ]" : "]");
+		i += ltv_len;
 
 		LOG_DBG("%s", ltv_str);
 	}
 }
 
 static struct webusb_ltv_data parsed_ltv_data;
+/* SET_LINK_PARAMS with a malformed entry is rejected as a whole */
+static int parsed_link_params_err;
+static struct scan_filter parsed_scan_filter;
+static int parsed_scan_filter_err;
+static struct rssi_report_config parsed_rssi_report;
+static int parsed_rssi_report_err;
+/* Sequence number of the next event, events are sent from several threads */
+static atomic_t event_seq_no;
+/* Held from taking an event sequence number until the event is queued, so events are queued in
+ * sequence number order
+ */
+static struct k_spinlock event_lock;
+/* Events carry a TIMESTAMP once the host synchronized its clock (TIME_SYNC) */
+static atomic_t event_timestamps;
+static struct bench_flood parsed_bench_flood;
+static int parsed_bench_flood_err;
+/* Running FLOOD, only changed while flood_work is not pending */
+static struct {
+	struct bench_flood config;
+	uint32_t start;
+	uint32_t sent;
+	uint32_t dropped;
+} flood;
+/* Payload bytes received with DISCARD since RESET */
+static uint32_t bench_discarded;
 static void heartbeat_timeout_handler(struct k_timer *timer)
 {
 	static uint8_t heartbeat_cnt = 0;
@@ -93,11 +151,11 @@ static void heartbeat_timeout_handler(struct k_timer *timer)
 	}
 }
 
-struct net_buf* message_alloc_tx_message(void)
+struct net_buf *message_alloc_tx_message_timeout(k_timeout_t timeout)
 {
 	struct net_buf *tx_net_buf;
 
-	tx_net_buf = net_buf_alloc(&command_tx_msg_pool, K_NO_WAIT);
+	tx_net_buf = net_buf_alloc(&command_tx_msg_pool, timeout);
 	if (!tx_net_buf) {
 		return NULL;
 	}
@@ -108,6 +166,57 @@ struct net_buf* message_alloc_tx_message(void)
 	return tx_net_buf;
 }
 
+struct net_buf* message_alloc_tx_message(void)
+{
+	return message_alloc_tx_message_timeout(K_NO_WAIT);
+}
+
+struct net_buf *message_alloc_tx_event_timeout(k_timeout_t timeout)
+{
+	struct net_buf *tx_net_buf;
+
+	tx_net_buf = message_alloc_tx_message_timeout(timeout);
+	if (!tx_net_buf) {
+		/* The lost event leaves a gap in the sequence numbers the host can detect */
+		atomic_inc(&event_seq_no);
+		return NULL;
+	}
+
+	/* Taken after the wait, the event is sent when a buffer was free */
+	message_add_timestamp(tx_net_buf, message_timestamp_get());
+
+	return tx_net_buf;
+}
+
+struct net_buf *message_alloc_tx_event(void)
+{
+	uint64_t timestamp = message_timestamp_get();
+	struct net_buf *tx_net_buf;
+
+	tx_net_buf = message_alloc_tx_message();
+	if (!tx_net_buf) {
+		/* The lost event leaves a gap in the sequence numbers the host can detect */
+		atomic_inc(&event_seq_no);
+		return NULL;
+	}
+
+	message_add_timestamp(tx_net_buf, timestamp);
+
+	return tx_net_buf;
+}
+
+uint64_t message_timestamp_get(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+void message_add_timestamp(struct net_buf *tx_net_buf, uint64_t timestamp)
+{
+	if (atomic_get(&event_timestamps)) {
+		proto_add_timestamp(tx_net_buf, timestamp);
+	}
+}
+
 static void send_simple_message(enum message_type mtype, enum message_sub_type stype, uint8_t seq_no, int32_t rc)
 {
 	struct net_buf *tx_net_buf;
@@ -120,12 +229,11 @@ static void send_simple_message(enum message_type mtype, enum message_sub_type s
 	tx_net_buf = message_alloc_tx_message();
 	if (!tx_net_buf) {
 		LOG_ERR("Failed to allocate net_buf");
+		return;
 	}
 
 	/* Append error code payload */
-	net_buf_add_u8(tx_net_buf, 5);
-	net_buf_add_u8(tx_net_buf, BT_DATA_ERROR_CODE);
-	net_buf_add_le32(tx_net_buf, rc);
+	proto_add_error_code(tx_net_buf, rc);
 	msg_payload_length = tx_net_buf->len;
 
 	// Prepend message header
@@ -134,7 +242,8 @@ static void send_simple_message(enum message_type mtype, enum message_sub_type s
 	net_buf_push_u8(tx_net_buf, stype);
 	net_buf_push_u8(tx_net_buf, mtype);
 
-	log_ltv(&tx_net_buf->data[0], tx_net_buf->len);
+	log_ltv(&tx_net_buf->data[sizeof(struct webusb_message)],
+		tx_net_buf->len - sizeof(struct webusb_message));
 
 	ret = webusb_transmit(tx_net_buf);
 	if (ret != 0) {
@@ -150,21 +259,53 @@ void send_response(enum message_sub_type stype, uint8_t seq_no, int32_t rc)
 
 void send_event(enum message_sub_type stype, int32_t rc)
 {
-	send_simple_message(MESSAGE_TYPE_EVT, stype, 0, rc);
+	struct net_buf *tx_net_buf;
+
+	tx_net_buf = message_alloc_tx_event();
+	if (!tx_net_buf) {
+		LOG_ERR("Failed to allocate event");
+		return;
+	}
+
+	proto_add_error_code(tx_net_buf, rc);
+
+	send_net_buf_event(stype, tx_net_buf);
 }
 
 void send_net_buf_event(enum message_sub_type stype, struct net_buf *tx_net_buf)
 {
 	int ret;
 
+	LOG_INF("send_net_buf_event(stype: %d)", stype);
+	log_ltv(tx_net_buf->data, tx_net_buf->len);
+
+	K_SPINLOCK(&event_lock) {
+		// Prepend message header
+		net_buf_push_le16(tx_net_buf, tx_net_buf->len);
+		net_buf_push_u8(tx_net_buf, (uint8_t)atomic_inc(&event_seq_no));
+		net_buf_push_u8(tx_net_buf, stype);
+		net_buf_push_u8(tx_net_buf, MESSAGE_TYPE_EVT);
+
+		ret = webusb_transmit(tx_net_buf);
+	}
+	if (ret != 0) {
+		LOG_ERR("Failed to send message (err=%d)", ret);
+	}
+}
+
+void send_net_buf_response(enum message_sub_type stype, uint8_t seq_no, struct net_buf *tx_net_buf)
+{
+	int ret;
+
 	// Prepend message header
 	net_buf_push_le16(tx_net_buf, tx_net_buf->len);
-	net_buf_push_u8(tx_net_buf, 0);
+	net_buf_push_u8(tx_net_buf, seq_no);
 	net_buf_push_u8(tx_net_buf, stype);
-	net_buf_push_u8(tx_net_buf, MESSAGE_TYPE_EVT);
+	net_buf_push_u8(tx_net_buf, MESSAGE_TYPE_RES);
 
-	LOG_INF("send_net_buf_event(stype: %d)", stype);
-	log_ltv(&tx_net_buf->data[0], tx_net_buf->len);
+	LOG_INF("send_net_buf_response(stype: %d, seq_no: %u)", stype, seq_no);
+	log_ltv(&tx_net_buf->data[sizeof(struct webusb_message)],
+		tx_net_buf->len - sizeof(struct webusb_message));
 
 	ret = webusb_transmit(tx_net_buf);
 	if (ret != 0) {
@@ -172,6 +313,306 @@ void send_net_buf_event(enum message_sub_type stype, struct net_buf *tx_net_buf)
 	}
 }
 
+static void scan_filter_ltv_found(struct bt_data *data)
+{
+	struct scan_filter *filter = &parsed_scan_filter;
+
+	switch (data->type) {
+	case BT_DATA_FILTER_MIN_RSSI:
+		filter->min_rssi = (int8_t)data->data[0];
+		filter->has_min_rssi = true;
+		break;
+	case BT_DATA_FILTER_NAME_PREFIX:
+		if (data->data_len >= sizeof(filter->name_prefix)) {
+			parsed_scan_filter_err = -EINVAL;
+			break;
+		}
+		memcpy(filter->name_prefix, data->data, data->data_len);
+		filter->name_prefix[data->data_len] = '\0';
+		filter->name_prefix_len = data->data_len;
+		break;
+	case BT_DATA_FILTER_BROADCAST_ID_ALLOW:
+	case BT_DATA_FILTER_BROADCAST_ID_DENY:
+		uint32_t *ids;
+		uint8_t *num_ids;
+
+		if (data->type == BT_DATA_FILTER_BROADCAST_ID_ALLOW) {
+			ids = filter->broadcast_id_allow;
+			num_ids = &filter->num_broadcast_id_allow;
+		} else {
+			ids = filter->broadcast_id_deny;
+			num_ids = &filter->num_broadcast_id_deny;
+		}
+
+		/* uint24[n] */
+		for (uint8_t i = 0; i + BT_AUDIO_BROADCAST_ID_SIZE <= data->data_len;
+		     i += BT_AUDIO_BROADCAST_ID_SIZE) {
+			if (*num_ids >= CONFIG_SCAN_FILTER_MAX_BROADCAST_IDS) {
+				parsed_scan_filter_err = -ENOMEM;
+				break;
+			}
+			ids[(*num_ids)++] = sys_get_le24(&data->data[i]);
+		}
+		break;
+	case BT_DATA_FILTER_ADDR_ALLOW:
+		/* (uint8 type + uint8[6] addr)[n] */
+		for (uint8_t i = 0; i + BT_ADDR_LE_SIZE <= data->data_len; i += BT_ADDR_LE_SIZE) {
+			bt_addr_le_t *addr;
+
+			if (filter->num_addr_allow >= CONFIG_SCAN_FILTER_MAX_ADDRS) {
+				parsed_scan_filter_err = -ENOMEM;
+				break;
+			}
+			addr = &filter->addr_allow[filter->num_addr_allow++];
+			addr->type = data->data[i];
+			memcpy(&addr->a, &data->data[i + 1], sizeof(bt_addr_t));
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void rssi_report_ltv_found(struct bt_data *data)
+{
+	struct rssi_report_config *config = &parsed_rssi_report;
+
+	/* uint8 smoothing + uint16 interval + uint8 threshold */
+	if (data->data_len != PROTO_LTV_RSSI_REPORT_SIZE - 2) {
+		parsed_rssi_report_err = -EINVAL;
+		return;
+	}
+
+	config->smoothing = data->data[0];
+	config->interval = sys_get_le16(&data->data[1]);
+	config->threshold = data->data[3];
+
+	/* The EWMA has 8 fractional bits */
+	if (config->smoothing > 8) {
+		parsed_rssi_report_err = -EINVAL;
+	}
+}
+
+static void bench_flood_ltv_found(struct bt_data *data)
+{
+	/* uint16 size + uint16 rate + uint16 duration */
+	if (data->data_len != PROTO_LTV_BENCH_FLOOD_SIZE - 2) {
+		parsed_bench_flood_err = -EINVAL;
+		return;
+	}
+
+	parsed_bench_flood.size = sys_get_le16(&data->data[0]);
+	parsed_bench_flood.rate = sys_get_le16(&data->data[2]);
+	parsed_bench_flood.duration = sys_get_le16(&data->data[4]);
+
+	/* An LTV entry takes two bytes at least */
+	if (parsed_bench_flood.size == 1 || parsed_bench_flood.size > FLOOD_SIZE_MAX) {
+		parsed_bench_flood_err = -EINVAL;
+	}
+}
+
+/* Add size bytes of BENCH_DATA entries */
+static void bench_fill(struct net_buf *tx_net_buf, uint16_t size)
+{
+	while (size >= 2) {
+		uint8_t len = MIN(size - 2, BENCH_DATA_MAX);
+		uint8_t *p;
+
+		/* A single byte left could not be an entry */
+		if (size - 2 - len == 1) {
+			len--;
+		}
+
+		p = net_buf_add(tx_net_buf, 2 + len);
+		p[0] = 1 + len;
+		p[1] = BT_DATA_BENCH_DATA;
+		memset(&p[2], 0, len);
+
+		size -= 2 + len;
+	}
+}
+
+/* Benchmark payloads are used as is, the length in the header must match the bytes received */
+static bool bench_payload_valid(const struct webusb_message *msg_ptr, uint16_t msg_length)
+{
+	return msg_length >= sizeof(struct webusb_message) &&
+	       msg_ptr->length == msg_length - sizeof(struct webusb_message);
+}
+
+static void send_echo(uint8_t seq_no, const struct net_buf_simple *payload)
+{
+	struct net_buf *tx_net_buf;
+
+	if (payload->len > CONFIG_TX_MSG_MAX_PAYLOAD_LEN - PROTO_LTV_ERROR_CODE_SIZE) {
+		send_response(MESSAGE_SUBTYPE_ECHO, seq_no, -EMSGSIZE);
+		return;
+	}
+
+	tx_net_buf = message_alloc_tx_message();
+	if (!tx_net_buf) {
+		LOG_ERR("Failed to allocate net_buf");
+		return;
+	}
+
+	proto_add_error_code(tx_net_buf, 0);
+	net_buf_add_mem(tx_net_buf, payload->data, payload->len);
+
+	send_net_buf_response(MESSAGE_SUBTYPE_ECHO, seq_no, tx_net_buf);
+}
+
+static void send_discard(uint8_t seq_no, const struct net_buf_simple *payload)
+{
+	struct net_buf *tx_net_buf;
+
+	bench_discarded += payload->len;
+
+	tx_net_buf = message_alloc_tx_message();
+	if (!tx_net_buf) {
+		LOG_ERR("Failed to allocate net_buf");
+		return;
+	}
+
+	proto_add_error_code(tx_net_buf, 0);
+	proto_add_bench_bytes(tx_net_buf, bench_discarded);
+
+	send_net_buf_response(MESSAGE_SUBTYPE_DISCARD, seq_no, tx_net_buf);
+}
+
+static void send_flood_end(void)
+{
+	struct net_buf *tx_net_buf;
+
+	/* Not a lost event if there is no buffer yet, it is sent later */
+	tx_net_buf = message_alloc_tx_message();
+	if (!tx_net_buf) {
+		k_work_reschedule(&flood_work, K_MSEC(FLOOD_PERIOD_MS));
+		return;
+	}
+
+	message_add_timestamp(tx_net_buf, message_timestamp_get());
+	proto_evt_flood_end(tx_net_buf, flood.sent, flood.dropped);
+
+	send_net_buf_event(MESSAGE_SUBTYPE_FLOOD_END, tx_net_buf);
+
+	LOG_INF("Flood done: %u sent, %u dropped", flood.sent, flood.dropped);
+}
+
+static void flood_work_handler(struct k_work *work)
+{
+	uint32_t elapsed = k_uptime_get_32() - flood.start;
+	struct net_buf *tx_net_buf;
+	uint32_t due;
+
+	if (elapsed >= flood.config.duration) {
+		send_flood_end();
+		return;
+	}
+
+	/* Without a rate, as many as there are buffers for */
+	due = flood.config.rate ? (uint32_t)((uint64_t)elapsed * flood.config.rate / MSEC_PER_SEC) + 1 :
+				  UINT32_MAX;
+
+	while (flood.sent + flood.dropped < due) {
+		uint64_t timestamp = message_timestamp_get();
+
+		/* Like scan reports, events without a buffer take no sequence number */
+		tx_net_buf = message_alloc_tx_message();
+		if (!tx_net_buf) {
+			if (flood.config.rate) {
+				/* Events not sent on time are not sent later */
+				flood.dropped = due - flood.sent;
+			}
+			break;
+		}
+
+		message_add_timestamp(tx_net_buf, timestamp);
+		bench_fill(tx_net_buf, flood.config.size);
+
+		send_net_buf_event(MESSAGE_SUBTYPE_FLOOD_DATA, tx_net_buf);
+		flood.sent++;
+	}
+
+	k_work_reschedule(&flood_work, K_MSEC(FLOOD_PERIOD_MS));
+}
+
+/* Replaces a running flood (without its FLOOD_END), a duration of 0 stops it */
+static void flood_start(const struct bench_flood *config)
+{
+	struct k_work_sync sync;
+
+	k_work_cancel_delayable_sync(&flood_work, &sync);
+
+	memcpy(&flood.config, config, sizeof(flood.config));
+	flood.start = k_uptime_get_32();
+	flood.sent = 0;
+	flood.dropped = 0;
+
+	if (config->duration > 0) {
+		LOG_INF("Flood: %u bytes, %u events/s, %u ms", config->size, config->rate,
+			config->duration);
+		k_work_reschedule(&flood_work, K_NO_WAIT);
+	}
+}
+
+static void send_time_sync(uint8_t seq_no)
+{
+	struct net_buf *tx_net_buf;
+
+	/* Taken first, the host pairs it with the middle of the round trip */
+	uint64_t timestamp = message_timestamp_get();
+
+	atomic_set(&event_timestamps, 1);
+
+	tx_net_buf = message_alloc_tx_message();
+	if (!tx_net_buf) {
+		LOG_ERR("Failed to allocate net_buf");
+		return;
+	}
+
+	proto_add_error_code(tx_net_buf, 0);
+	proto_add_timestamp(tx_net_buf, timestamp);
+
+	send_net_buf_response(MESSAGE_SUBTYPE_TIME_SYNC, seq_no, tx_net_buf);
+}
+
+static void send_scan_filter_stats(uint8_t seq_no)
+{
+	static const uint8_t filter_ltv_types[SCAN_FILTER_TYPE_COUNT] = {
+		[SCAN_FILTER_MIN_RSSI] = BT_DATA_FILTER_MIN_RSSI,
+		[SCAN_FILTER_ADDR_ALLOW] = BT_DATA_FILTER_ADDR_ALLOW,
+		[SCAN_FILTER_NAME_PREFIX] = BT_DATA_FILTER_NAME_PREFIX,
+		[SCAN_FILTER_BROADCAST_ID_ALLOW] = BT_DATA_FILTER_BROADCAST_ID_ALLOW,
+		[SCAN_FILTER_BROADCAST_ID_DENY] = BT_DATA_FILTER_BROADCAST_ID_DENY,
+	};
+	struct scan_filter_stats stats;
+	struct net_buf *tx_net_buf;
+	uint8_t *p;
+
+	tx_net_buf = message_alloc_tx_message();
+	if (!tx_net_buf) {
+		LOG_ERR("Failed to allocate net_buf");
+		return;
+	}
+
+	scan_filter_stats_get(&stats);
+
+	p = net_buf_add(tx_net_buf, PROTO_LTV_ERROR_CODE_SIZE +
+				    (2 + SCAN_FILTER_TYPE_COUNT) * PROTO_LTV_FILTER_STATS_SIZE);
+	p = proto_put_error_code(p, 0);
+
+	/* Accepted reports are reported with filter type 0 */
+	p = proto_put_filter_stats(p, 0, stats.accepted);
+
+	for (size_t i = 0; i < SCAN_FILTER_TYPE_COUNT; i++) {
+		p = proto_put_filter_stats(p, filter_ltv_types[i], stats.rejected[i]);
+	}
+
+	/* Reports held back by the RSSI aggregation (accepted by the filters) */
+	p = proto_put_filter_stats(p, BT_DATA_RSSI_REPORT, rssi_report_held_get());
+
+	send_net_buf_response(MESSAGE_SUBTYPE_GET_SCAN_FILTER_STATS, seq_no, tx_net_buf);
+}
+
 bool ltv_found(struct bt_data *data, void *user_data)
 {
 	struct webusb_ltv_data *_parsed = (struct webusb_ltv_data *)user_data;
@@ -191,6 +632,60 @@ bool ltv_found(struct bt_data *data, void *user_data)
 		_parsed->broadcast_id = sys_get_le24(data->data);
 		LOG_DBG("BT_DATA_BROADCAST_ID");
 		return true;
+	case BT_DATA_CONN_PARAM_SETUP:
+	case BT_DATA_CONN_PARAM_STEADY:
+		struct bt_le_conn_param param;
+
+		if (data->data_len != 4 * sizeof(uint16_t)) {
+			LOG_ERR("Invalid connection parameter length %u", data->data_len);
+			parsed_link_params_err = -EINVAL;
+			return true;
+		}
+
+		param.interval_min = sys_get_le16(&data->data[0]);
+		param.interval_max = sys_get_le16(&data->data[2]);
+		param.latency = sys_get_le16(&data->data[4]);
+		param.timeout = sys_get_le16(&data->data[6]);
+
+		/* Copy as a whole, the members of the packed struct may be unaligned */
+		if (data->type == BT_DATA_CONN_PARAM_SETUP) {
+			memcpy(&_parsed->conn_param_setup, &param, sizeof(param));
+			_parsed->has_conn_param_setup = 1;
+		} else {
+			memcpy(&_parsed->conn_param_steady, &param, sizeof(param));
+			_parsed->has_conn_param_steady = 1;
+		}
+		LOG_DBG("BT_DATA_CONN_PARAM");
+		return true;
+	case BT_DATA_PHY:
+		if (data->data_len != 1) {
+			LOG_ERR("Invalid PHY length %u", data->data_len);
+			parsed_link_params_err = -EINVAL;
+			return true;
+		}
+		_parsed->phy = data->data[0];
+		_parsed->has_phy = 1;
+		LOG_DBG("BT_DATA_PHY");
+		return true;
+	case BT_DATA_FILTER_MIN_RSSI:
+	case BT_DATA_FILTER_NAME_PREFIX:
+	case BT_DATA_FILTER_BROADCAST_ID_ALLOW:
+	case BT_DATA_FILTER_BROADCAST_ID_DENY:
+	case BT_DATA_FILTER_ADDR_ALLOW:
+		if (data->data_len == 0) {
+			return true;
+		}
+		scan_filter_ltv_found(data);
+		LOG_DBG("BT_DATA_FILTER (type %u)", data->type);
+		return true;
+	case BT_DATA_RSSI_REPORT:
+		rssi_report_ltv_found(data);
+		LOG_DBG("BT_DATA_RSSI_REPORT");
+		return true;
+	case BT_DATA_BENCH_FLOOD:
+		bench_flood_ltv_found(data);
+		LOG_DBG("BT_DATA_BENCH_FLOOD");
+		return true;
 	case BT_DATA_RPA:
 	case BT_DATA_IDENTITY:
 		char addr_str[BT_ADDR_LE_STR_LEN];
@@ -224,7 +719,26 @@ void message_handler(struct webusb_message *msg_ptr, uint16_t msg_length)
 	msg_net_buf.size = CONFIG_TX_MSG_MAX_PAYLOAD_LEN;
 	msg_net_buf.__buf = msg_ptr->payload;
 
-	bt_data_parse(&msg_net_buf, ltv_found, (void *)&parsed_ltv_data);
+	/* Optional fields must not leak from a previous message */
+	parsed_ltv_data.has_conn_param_setup = 0;
+	parsed_ltv_data.has_conn_param_steady = 0;
+	parsed_ltv_data.has_phy = 0;
+	parsed_link_params_err = 0;
+	if (msg_sub_type == MESSAGE_SUBTYPE_SET_SCAN_FILTER) {
+		memset(&parsed_scan_filter, 0, sizeof(parsed_scan_filter));
+		parsed_scan_filter_err = 0;
+	} else if (msg_sub_type == MESSAGE_SUBTYPE_SET_RSSI_REPORT) {
+		memset(&parsed_rssi_report, 0, sizeof(parsed_rssi_report));
+		parsed_rssi_report_err = 0;
+	} else if (msg_sub_type == MESSAGE_SUBTYPE_FLOOD) {
+		memset(&parsed_bench_flood, 0, sizeof(parsed_bench_flood));
+		parsed_bench_flood_err = 0;
+	}
+
+	/* Benchmark payloads are only copied or counted */
+	if (msg_sub_type != MESSAGE_SUBTYPE_ECHO && msg_sub_type != MESSAGE_SUBTYPE_DISCARD) {
+		bt_data_parse(&msg_net_buf, ltv_found, (void *)&parsed_ltv_data);
+	}
 
 	switch (msg_sub_type) {
 	case MESSAGE_SUBTYPE_HEARTBEAT:
@@ -290,11 +804,105 @@ void message_handler(struct webusb_message *msg_ptr, uint16_t msg_length)
 		send_response(MESSAGE_SUBTYPE_REMOVE_SOURCE, msg_seq_no, msg_rc);
 		break;
 
+	case MESSAGE_SUBTYPE_SET_LINK_PARAMS:
+		LOG_DBG("MESSAGE_SUBTYPE_SET_LINK_PARAMS (len %u)", msg_length);
+		struct broadcast_assistant_link_params link_params;
+
+		/* Parameters not included in the message are left unchanged */
+		get_link_params(&link_params);
+		if (parsed_ltv_data.has_conn_param_setup) {
+			link_params.setup = parsed_ltv_data.conn_param_setup;
+		}
+		if (parsed_ltv_data.has_conn_param_steady) {
+			link_params.steady = parsed_ltv_data.conn_param_steady;
+		}
+		if (parsed_ltv_data.has_phy) {
+			link_params.phy = parsed_ltv_data.phy;
+		}
+		msg_rc = parsed_link_params_err;
+		if (msg_rc == 0) {
+			msg_rc = set_link_params(&link_params);
+		}
+		send_response(MESSAGE_SUBTYPE_SET_LINK_PARAMS, msg_seq_no, msg_rc);
+		break;
+
+	case MESSAGE_SUBTYPE_SET_SCAN_FILTER:
+		LOG_DBG("MESSAGE_SUBTYPE_SET_SCAN_FILTER (len %u)", msg_length);
+		/* Filters not included in the message are disabled, an empty message clears all */
+		msg_rc = parsed_scan_filter_err;
+		if (msg_rc == 0) {
+			scan_filter_set(&parsed_scan_filter);
+		}
+		send_response(MESSAGE_SUBTYPE_SET_SCAN_FILTER, msg_seq_no, msg_rc);
+		break;
+
+	case MESSAGE_SUBTYPE_GET_SCAN_FILTER_STATS:
+		LOG_DBG("MESSAGE_SUBTYPE_GET_SCAN_FILTER_STATS");
+		send_scan_filter_stats(msg_seq_no);
+		break;
+
+	case MESSAGE_SUBTYPE_GET_STATE_SNAPSHOT:
+		LOG_DBG("MESSAGE_SUBTYPE_GET_STATE_SNAPSHOT");
+		send_response(MESSAGE_SUBTYPE_GET_STATE_SNAPSHOT, msg_seq_no, 0);
+		request_state_snapshot();
+		break;
+
+	case MESSAGE_SUBTYPE_TIME_SYNC:
+		LOG_DBG("MESSAGE_SUBTYPE_TIME_SYNC");
+		send_time_sync(msg_seq_no);
+		break;
+
+	case MESSAGE_SUBTYPE_ECHO:
+		LOG_DBG("MESSAGE_SUBTYPE_ECHO (len %u)", msg_length);
+		if (!bench_payload_valid(msg_ptr, msg_length)) {
+			send_response(MESSAGE_SUBTYPE_ECHO, msg_seq_no, -EINVAL);
+			break;
+		}
+		send_echo(msg_seq_no, &msg_net_buf);
+		break;
+
+	case MESSAGE_SUBTYPE_DISCARD:
+		LOG_DBG("MESSAGE_SUBTYPE_DISCARD (len %u)", msg_length);
+		if (!bench_payload_valid(msg_ptr, msg_length)) {
+			send_response(MESSAGE_SUBTYPE_DISCARD, msg_seq_no, -EINVAL);
+			break;
+		}
+		send_discard(msg_seq_no, &msg_net_buf);
+		break;
+
+	case MESSAGE_SUBTYPE_FLOOD:
+		LOG_DBG("MESSAGE_SUBTYPE_FLOOD (len %u)", msg_length);
+		msg_rc = parsed_bench_flood_err;
+		if (msg_rc == 0) {
+			flood_start(&parsed_bench_flood);
+		}
+		send_response(MESSAGE_SUBTYPE_FLOOD, msg_seq_no, msg_rc);
+		break;
+
+	case MESSAGE_SUBTYPE_SET_RSSI_REPORT:
+		LOG_DBG("MESSAGE_SUBTYPE_SET_RSSI_REPORT (len %u)", msg_length);
+		/* Without RSSI_REPORT, aggregation is turned off */
+		msg_rc = parsed_rssi_report_err;
+		if (msg_rc == 0) {
+			rssi_report_set(&parsed_rssi_report);
+		}
+		send_response(MESSAGE_SUBTYPE_SET_RSSI_REPORT, msg_seq_no, msg_rc);
+		break;
+
 	case MESSAGE_SUBTYPE_RESET:
 		LOG_DBG("MESSAGE_SUBTYPE_RESET (len %u)", msg_length);
 		msg_rc = stop_scanning();
 		send_response(MESSAGE_SUBTYPE_STOP_SCAN, msg_seq_no, msg_rc);
 		msg_rc = disconnect_unpair_all();
+		/* Filters set by a previous host session must not hide devices */
+		memset(&parsed_scan_filter, 0, sizeof(parsed_scan_filter));
+		scan_filter_set(&parsed_scan_filter);
+		memset(&parsed_rssi_report, 0, sizeof(parsed_rssi_report));
+		rssi_report_set(&parsed_rssi_report);
+		atomic_set(&event_timestamps, 0);
+		memset(&parsed_bench_flood, 0, sizeof(parsed_bench_flood));
+		flood_start(&parsed_bench_flood);
+		bench_discarded = 0;
 		send_response(MESSAGE_SUBTYPE_RESET, msg_seq_no, msg_rc);
 		// Stop heartbeat if active
 		heartbeat_on = false;
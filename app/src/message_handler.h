@@ -12,43 +12,9 @@
 #define __COMMAND_H__
 
 #include <zephyr/types.h>
+#include <zephyr/kernel.h>
 
-enum message_type {
-	MESSAGE_TYPE_CMD = 1,
-	MESSAGE_TYPE_RES,
-	MESSAGE_TYPE_EVT,
-};
-
-enum message_sub_type {
-	/* CMD/RES (bit7 = 0) */
-	MESSAGE_SUBTYPE_START_SINK_SCAN         = 0x01,
-	MESSAGE_SUBTYPE_START_SOURCE_SCAN       = 0x02,
-	MESSAGE_SUBTYPE_START_SCAN_ALL    	= 0x03,
-	MESSAGE_SUBTYPE_STOP_SCAN               = 0x04,
-	MESSAGE_SUBTYPE_CONNECT_SINK            = 0x05,
-	MESSAGE_SUBTYPE_DISCONNECT_SINK         = 0x06,
-	MESSAGE_SUBTYPE_ADD_SOURCE              = 0x07,
-	MESSAGE_SUBTYPE_REMOVE_SOURCE           = 0x08,
-	MESSAGE_SUBTYPE_RESET                   = 0x2A,
-
-	/* EVT (bit7 = 1) */
-	MESSAGE_SUBTYPE_SINK_FOUND              = 0x81,
-	MESSAGE_SUBTYPE_SOURCE_FOUND            = 0x82,
-	MESSAGE_SUBTYPE_SINK_CONNECTED          = 0x83,
-	MESSAGE_SUBTYPE_SINK_DISCONNECTED       = 0x84,
-	MESSAGE_SUBTYPE_SOURCE_ADDED            = 0x85,
-	MESSAGE_SUBTYPE_SOURCE_REMOVED          = 0x86,
-	MESSAGE_SUBTYPE_NEW_PA_STATE_NOT_SYNCED = 0x87,
-	MESSAGE_SUBTYPE_NEW_PA_STATE_INFO_REQ   = 0x88,
-	MESSAGE_SUBTYPE_NEW_PA_STATE_SYNCED     = 0x89,
-	MESSAGE_SUBTYPE_NEW_PA_STATE_FAILED     = 0x8A,
-	MESSAGE_SUBTYPE_NEW_PA_STATE_NO_PAST    = 0x8B,
-	MESSAGE_SUBTYPE_BIS_SYNCED              = 0x8C,
-	MESSAGE_SUBTYPE_BIS_NOT_SYNCED          = 0x8D,
-	MESSAGE_SUBTYPE_IDENTITY_RESOLVED	= 0x8E,
-
-	MESSAGE_SUBTYPE_HEARTBEAT               = 0xFF,
-};
+#include "protocol.h"
 
 struct webusb_message {
 	uint8_t type;
@@ -59,7 +25,18 @@ struct webusb_message {
 } __packed;
 
 struct net_buf* message_alloc_tx_message(void);
+/* Wait up to timeout for a free buffer, not from the webusb workqueue (it frees them) */
+struct net_buf *message_alloc_tx_message_timeout(k_timeout_t timeout);
+/* Allocate an event message, a failed allocation takes an event sequence number */
+struct net_buf *message_alloc_tx_event(void);
+/* As message_alloc_tx_event(), waiting up to timeout for a free buffer */
+struct net_buf *message_alloc_tx_event_timeout(k_timeout_t timeout);
+/* Device time (uptime in us) for event timestamps */
+uint64_t message_timestamp_get(void);
+/* Add a TIMESTAMP to an event, if the host asked for them (TIME_SYNC) */
+void message_add_timestamp(struct net_buf *tx_net_buf, uint64_t timestamp);
 void send_response(enum message_sub_type stype, uint8_t seq_no, int32_t rc);
+void send_net_buf_response(enum message_sub_type stype, uint8_t seq_no, struct net_buf *tx_net_buf);
 void send_event(enum message_sub_type stype, int32_t rc);
 void send_net_buf_event(enum message_sub_type stype, struct net_buf *tx_net_buf);
 void message_handler(struct webusb_message *msg_ptr, uint16_t msg_length);
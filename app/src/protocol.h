@@ -0,0 +1,751 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Protocol definitions and encoders
+ *
+ * Generated by protocol/generate.js from protocol/schema.json, do not edit.
+ *
+ * proto_put_<type>() writes a fixed size LTV entry and returns the position
+ * after it, so several entries can be written into one net_buf_add() of the
+ * summed PROTO_LTV_<TYPE>_SIZE. proto_add_<type>() appends a single entry and
+ * proto_evt_<event>() appends the fixed fields of an event in one go.
+ */
+
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+#include <string.h>
+#include <zephyr/types.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/addr.h>
+
+enum message_type {
+	MESSAGE_TYPE_CMD = 1,
+	MESSAGE_TYPE_RES = 2,
+	MESSAGE_TYPE_EVT = 3,
+};
+
+enum message_sub_type {
+	/* CMD/RES (bit7 = 0) */
+	MESSAGE_SUBTYPE_START_SINK_SCAN         = 0x01,
+	MESSAGE_SUBTYPE_START_SOURCE_SCAN       = 0x02,
+	MESSAGE_SUBTYPE_START_SCAN_ALL          = 0x03,
+	MESSAGE_SUBTYPE_STOP_SCAN               = 0x04,
+	MESSAGE_SUBTYPE_CONNECT_SINK            = 0x05, /* ADDR */
+	MESSAGE_SUBTYPE_DISCONNECT_SINK         = 0x06, /* ADDR */
+	MESSAGE_SUBTYPE_ADD_SOURCE              = 0x07, /* ADDR, SID, PA_INTERVAL, BROADCAST_ID */
+	MESSAGE_SUBTYPE_REMOVE_SOURCE           = 0x08,
+	MESSAGE_SUBTYPE_SET_LINK_PARAMS         = 0x09, /* [CONN_PARAM_SETUP], [CONN_PARAM_STEADY], [PHY] */
+	MESSAGE_SUBTYPE_SET_SCAN_FILTER         = 0x0A, /* [FILTER_MIN_RSSI], [FILTER_NAME_PREFIX], [FILTER_BROADCAST_ID_ALLOW], [FILTER_BROADCAST_ID_DENY], [FILTER_ADDR_ALLOW] */
+	MESSAGE_SUBTYPE_GET_SCAN_FILTER_STATS   = 0x0B, /* -> [FILTER_STATS] */
+	MESSAGE_SUBTYPE_SET_RSSI_REPORT         = 0x0C, /* [RSSI_REPORT] */
+	MESSAGE_SUBTYPE_GET_STATE_SNAPSHOT      = 0x0D,
+	MESSAGE_SUBTYPE_TIME_SYNC               = 0x0E, /* -> [TIMESTAMP] */
+	MESSAGE_SUBTYPE_ECHO                    = 0x0F, /* [BENCH_DATA] -> [BENCH_DATA] */
+	MESSAGE_SUBTYPE_DISCARD                 = 0x10, /* [BENCH_DATA] -> [BENCH_BYTES] */
+	MESSAGE_SUBTYPE_FLOOD                   = 0x11, /* BENCH_FLOOD */
+	MESSAGE_SUBTYPE_RESET                   = 0x2A,
+
+	/* EVT (bit7 = 1) */
+	MESSAGE_SUBTYPE_SINK_FOUND              = 0x81, /* [RSSI], [RSSI_STATS], [ADDR], [NAME_COMPLETE], [NAME_SHORTENED], [UUID16_SOME], [UUID16_ALL] */
+	MESSAGE_SUBTYPE_SOURCE_FOUND            = 0x82, /* [RSSI], [RSSI_STATS], [ADDR], [BROADCAST_NAME], [NAME_COMPLETE], [SID], [PA_INTERVAL], [BROADCAST_ID] */
+	MESSAGE_SUBTYPE_SINK_CONNECTED          = 0x83, /* ADDR, ERROR_CODE */
+	MESSAGE_SUBTYPE_SINK_DISCONNECTED       = 0x84, /* ADDR, ERROR_CODE */
+	MESSAGE_SUBTYPE_SOURCE_ADDED            = 0x85, /* ADDR, BROADCAST_ID, ERROR_CODE */
+	MESSAGE_SUBTYPE_SOURCE_REMOVED          = 0x86, /* ADDR, SOURCE_ID, ERROR_CODE */
+	MESSAGE_SUBTYPE_IDENTITY_RESOLVED       = 0x8E, /* RPA, IDENTITY */
+	MESSAGE_SUBTYPE_RECV_STATE_CHANGED      = 0x8F, /* ADDR, SOURCE_ID, BROADCAST_ID, [PA_SYNC_STATE], [ENC_STATE], [BIS_SYNC], [SUBGROUP_METADATA], [ERROR_CODE] */
+	MESSAGE_SUBTYPE_STATE_SNAPSHOT_BEGIN    = 0x90, /* SCAN_TARGET */
+	MESSAGE_SUBTYPE_SINK_STATE              = 0x91, /* ADDR, CONN_STATE, SECURITY_LEVEL */
+	MESSAGE_SUBTYPE_STATE_SNAPSHOT_END      = 0x92, /* ERROR_CODE */
+	MESSAGE_SUBTYPE_FLOOD_DATA              = 0x93, /* [BENCH_DATA] */
+	MESSAGE_SUBTYPE_FLOOD_END               = 0x94, /* BENCH_FLOOD_STATS */
+	MESSAGE_SUBTYPE_HEARTBEAT               = 0xFF,
+};
+
+/* LTV types created for this app (not standard) */
+#define BT_DATA_RSSI                      (BT_DATA_MANUFACTURER_DATA - 1)
+#define BT_DATA_SID                       (BT_DATA_MANUFACTURER_DATA - 2)
+#define BT_DATA_PA_INTERVAL               (BT_DATA_MANUFACTURER_DATA - 3)
+#define BT_DATA_ERROR_CODE                (BT_DATA_MANUFACTURER_DATA - 4)
+#define BT_DATA_BROADCAST_ID              (BT_DATA_MANUFACTURER_DATA - 5)
+#define BT_DATA_RPA                       (BT_DATA_MANUFACTURER_DATA - 6)
+#define BT_DATA_IDENTITY                  (BT_DATA_MANUFACTURER_DATA - 7)
+#define BT_DATA_CONN_PARAM_SETUP          (BT_DATA_MANUFACTURER_DATA - 8)
+#define BT_DATA_CONN_PARAM_STEADY         (BT_DATA_MANUFACTURER_DATA - 9)
+#define BT_DATA_PHY                       (BT_DATA_MANUFACTURER_DATA - 10)
+#define BT_DATA_SOURCE_ID                 (BT_DATA_MANUFACTURER_DATA - 11)
+#define BT_DATA_PA_SYNC_STATE             (BT_DATA_MANUFACTURER_DATA - 12)
+#define BT_DATA_ENC_STATE                 (BT_DATA_MANUFACTURER_DATA - 13)
+#define BT_DATA_BIS_SYNC                  (BT_DATA_MANUFACTURER_DATA - 14)
+#define BT_DATA_SUBGROUP_METADATA         (BT_DATA_MANUFACTURER_DATA - 15)
+#define BT_DATA_FILTER_MIN_RSSI           (BT_DATA_MANUFACTURER_DATA - 16)
+#define BT_DATA_FILTER_NAME_PREFIX        (BT_DATA_MANUFACTURER_DATA - 17)
+#define BT_DATA_FILTER_BROADCAST_ID_ALLOW (BT_DATA_MANUFACTURER_DATA - 18)
+#define BT_DATA_FILTER_BROADCAST_ID_DENY  (BT_DATA_MANUFACTURER_DATA - 19)
+#define BT_DATA_FILTER_ADDR_ALLOW         (BT_DATA_MANUFACTURER_DATA - 20)
+#define BT_DATA_FILTER_STATS              (BT_DATA_MANUFACTURER_DATA - 21)
+#define BT_DATA_RSSI_REPORT               (BT_DATA_MANUFACTURER_DATA - 22)
+#define BT_DATA_RSSI_STATS                (BT_DATA_MANUFACTURER_DATA - 23)
+#define BT_DATA_SCAN_TARGET               (BT_DATA_MANUFACTURER_DATA - 24)
+#define BT_DATA_CONN_STATE                (BT_DATA_MANUFACTURER_DATA - 25)
+#define BT_DATA_SECURITY_LEVEL            (BT_DATA_MANUFACTURER_DATA - 26)
+#define BT_DATA_TIMESTAMP                 (BT_DATA_MANUFACTURER_DATA - 27)
+#define BT_DATA_BENCH_DATA                (BT_DATA_MANUFACTURER_DATA - 28)
+#define BT_DATA_BENCH_FLOOD               (BT_DATA_MANUFACTURER_DATA - 29)
+#define BT_DATA_BENCH_BYTES               (BT_DATA_MANUFACTURER_DATA - 30)
+#define BT_DATA_BENCH_FLOOD_STATS         (BT_DATA_MANUFACTURER_DATA - 31)
+
+/* Append an LTV entry with a value of len bytes */
+static inline void proto_add_ltv(struct net_buf *buf, uint8_t type, const void *data, uint8_t len)
+{
+	uint8_t *p = net_buf_add(buf, 2 + len);
+
+	p[0] = 1 + len;
+	p[1] = type;
+	memcpy(&p[2], data, len);
+}
+
+/* NAME_SHORTENED: utf8 (variable len) */
+static inline void proto_add_name_shortened(struct net_buf *buf, const char *name_shortened, uint8_t len)
+{
+	uint8_t *p = net_buf_add(buf, 2 + len);
+
+	p[0] = 1 + len;
+	p[1] = BT_DATA_NAME_SHORTENED;
+	memcpy(&p[2], name_shortened, len);
+}
+
+/* NAME_COMPLETE: utf8 (variable len) */
+static inline void proto_add_name_complete(struct net_buf *buf, const char *name_complete, uint8_t len)
+{
+	uint8_t *p = net_buf_add(buf, 2 + len);
+
+	p[0] = 1 + len;
+	p[1] = BT_DATA_NAME_COMPLETE;
+	memcpy(&p[2], name_complete, len);
+}
+
+/* SVC_DATA16: uint8[n] */
+static inline void proto_add_svc_data16(struct net_buf *buf, const uint8_t *svc_data16, uint8_t len)
+{
+	uint8_t *p = net_buf_add(buf, 2 + len);
+
+	p[0] = 1 + len;
+	p[1] = BT_DATA_SVC_DATA16;
+	memcpy(&p[2], svc_data16, len);
+}
+
+/* BROADCAST_NAME: utf8 (variable len) */
+static inline void proto_add_broadcast_name(struct net_buf *buf, const char *broadcast_name, uint8_t len)
+{
+	uint8_t *p = net_buf_add(buf, 2 + len);
+
+	p[0] = 1 + len;
+	p[1] = BT_DATA_BROADCAST_NAME;
+	memcpy(&p[2], broadcast_name, len);
+}
+
+/* RSSI: int8 */
+#define PROTO_LTV_RSSI_SIZE 3
+
+static inline uint8_t *proto_put_rssi(uint8_t *p, int8_t rssi)
+{
+	p[0] = PROTO_LTV_RSSI_SIZE - 1;
+	p[1] = BT_DATA_RSSI;
+	p[2] = (uint8_t)rssi;
+
+	return p + PROTO_LTV_RSSI_SIZE;
+}
+
+static inline void proto_add_rssi(struct net_buf *buf, int8_t rssi)
+{
+	proto_put_rssi(net_buf_add(buf, PROTO_LTV_RSSI_SIZE), rssi);
+}
+
+/* SID: uint8 */
+#define PROTO_LTV_SID_SIZE 3
+
+static inline uint8_t *proto_put_sid(uint8_t *p, uint8_t sid)
+{
+	p[0] = PROTO_LTV_SID_SIZE - 1;
+	p[1] = BT_DATA_SID;
+	p[2] = sid;
+
+	return p + PROTO_LTV_SID_SIZE;
+}
+
+static inline void proto_add_sid(struct net_buf *buf, uint8_t sid)
+{
+	proto_put_sid(net_buf_add(buf, PROTO_LTV_SID_SIZE), sid);
+}
+
+/* PA_INTERVAL: uint16 */
+#define PROTO_LTV_PA_INTERVAL_SIZE 4
+
+static inline uint8_t *proto_put_pa_interval(uint8_t *p, uint16_t pa_interval)
+{
+	p[0] = PROTO_LTV_PA_INTERVAL_SIZE - 1;
+	p[1] = BT_DATA_PA_INTERVAL;
+	sys_put_le16(pa_interval, &p[2]);
+
+	return p + PROTO_LTV_PA_INTERVAL_SIZE;
+}
+
+static inline void proto_add_pa_interval(struct net_buf *buf, uint16_t pa_interval)
+{
+	proto_put_pa_interval(net_buf_add(buf, PROTO_LTV_PA_INTERVAL_SIZE), pa_interval);
+}
+
+/* ERROR_CODE: int32 */
+#define PROTO_LTV_ERROR_CODE_SIZE 6
+
+static inline uint8_t *proto_put_error_code(uint8_t *p, int32_t error_code)
+{
+	p[0] = PROTO_LTV_ERROR_CODE_SIZE - 1;
+	p[1] = BT_DATA_ERROR_CODE;
+	sys_put_le32(error_code, &p[2]);
+
+	return p + PROTO_LTV_ERROR_CODE_SIZE;
+}
+
+static inline void proto_add_error_code(struct net_buf *buf, int32_t error_code)
+{
+	proto_put_error_code(net_buf_add(buf, PROTO_LTV_ERROR_CODE_SIZE), error_code);
+}
+
+/* BROADCAST_ID: uint32 */
+#define PROTO_LTV_BROADCAST_ID_SIZE 6
+
+static inline uint8_t *proto_put_broadcast_id(uint8_t *p, uint32_t broadcast_id)
+{
+	p[0] = PROTO_LTV_BROADCAST_ID_SIZE - 1;
+	p[1] = BT_DATA_BROADCAST_ID;
+	sys_put_le32(broadcast_id, &p[2]);
+
+	return p + PROTO_LTV_BROADCAST_ID_SIZE;
+}
+
+static inline void proto_add_broadcast_id(struct net_buf *buf, uint32_t broadcast_id)
+{
+	proto_put_broadcast_id(net_buf_add(buf, PROTO_LTV_BROADCAST_ID_SIZE), broadcast_id);
+}
+
+/* RPA: uint8 (type) + uint8[6] (addr) */
+#define PROTO_LTV_RPA_SIZE 9
+
+static inline uint8_t *proto_put_rpa(uint8_t *p, const bt_addr_le_t *rpa)
+{
+	p[0] = PROTO_LTV_RPA_SIZE - 1;
+	p[1] = BT_DATA_RPA;
+	p[2] = rpa->type;
+	memcpy(&p[3], &rpa->a, sizeof(bt_addr_t));
+
+	return p + PROTO_LTV_RPA_SIZE;
+}
+
+static inline void proto_add_rpa(struct net_buf *buf, const bt_addr_le_t *rpa)
+{
+	proto_put_rpa(net_buf_add(buf, PROTO_LTV_RPA_SIZE), rpa);
+}
+
+/* IDENTITY: uint8 (type) + uint8[6] (addr) */
+#define PROTO_LTV_IDENTITY_SIZE 9
+
+static inline uint8_t *proto_put_identity(uint8_t *p, const bt_addr_le_t *identity)
+{
+	p[0] = PROTO_LTV_IDENTITY_SIZE - 1;
+	p[1] = BT_DATA_IDENTITY;
+	p[2] = identity->type;
+	memcpy(&p[3], &identity->a, sizeof(bt_addr_t));
+
+	return p + PROTO_LTV_IDENTITY_SIZE;
+}
+
+static inline void proto_add_identity(struct net_buf *buf, const bt_addr_le_t *identity)
+{
+	proto_put_identity(net_buf_add(buf, PROTO_LTV_IDENTITY_SIZE), identity);
+}
+
+/* CONN_PARAM_SETUP: uint16 (interval_min) + uint16 (interval_max) + uint16 (latency) + uint16 (timeout) */
+#define PROTO_LTV_CONN_PARAM_SETUP_SIZE 10
+
+static inline uint8_t *proto_put_conn_param_setup(uint8_t *p, uint16_t interval_min, uint16_t interval_max, uint16_t latency, uint16_t timeout)
+{
+	p[0] = PROTO_LTV_CONN_PARAM_SETUP_SIZE - 1;
+	p[1] = BT_DATA_CONN_PARAM_SETUP;
+	sys_put_le16(interval_min, &p[2]);
+	sys_put_le16(interval_max, &p[4]);
+	sys_put_le16(latency, &p[6]);
+	sys_put_le16(timeout, &p[8]);
+
+	return p + PROTO_LTV_CONN_PARAM_SETUP_SIZE;
+}
+
+static inline void proto_add_conn_param_setup(struct net_buf *buf, uint16_t interval_min, uint16_t interval_max, uint16_t latency, uint16_t timeout)
+{
+	proto_put_conn_param_setup(net_buf_add(buf, PROTO_LTV_CONN_PARAM_SETUP_SIZE), interval_min, interval_max, latency, timeout);
+}
+
+/* CONN_PARAM_STEADY: uint16 (interval_min) + uint16 (interval_max) + uint16 (latency) + uint16 (timeout) */
+#define PROTO_LTV_CONN_PARAM_STEADY_SIZE 10
+
+static inline uint8_t *proto_put_conn_param_steady(uint8_t *p, uint16_t interval_min, uint16_t interval_max, uint16_t latency, uint16_t timeout)
+{
+	p[0] = PROTO_LTV_CONN_PARAM_STEADY_SIZE - 1;
+	p[1] = BT_DATA_CONN_PARAM_STEADY;
+	sys_put_le16(interval_min, &p[2]);
+	sys_put_le16(interval_max, &p[4]);
+	sys_put_le16(latency, &p[6]);
+	sys_put_le16(timeout, &p[8]);
+
+	return p + PROTO_LTV_CONN_PARAM_STEADY_SIZE;
+}
+
+static inline void proto_add_conn_param_steady(struct net_buf *buf, uint16_t interval_min, uint16_t interval_max, uint16_t latency, uint16_t timeout)
+{
+	proto_put_conn_param_steady(net_buf_add(buf, PROTO_LTV_CONN_PARAM_STEADY_SIZE), interval_min, interval_max, latency, timeout);
+}
+
+/* PHY: uint8 (BT_GAP_LE_PHY_* bitmask) */
+#define PROTO_LTV_PHY_SIZE 3
+
+static inline uint8_t *proto_put_phy(uint8_t *p, uint8_t phy)
+{
+	p[0] = PROTO_LTV_PHY_SIZE - 1;
+	p[1] = BT_DATA_PHY;
+	p[2] = phy;
+
+	return p + PROTO_LTV_PHY_SIZE;
+}
+
+static inline void proto_add_phy(struct net_buf *buf, uint8_t phy)
+{
+	proto_put_phy(net_buf_add(buf, PROTO_LTV_PHY_SIZE), phy);
+}
+
+/* SOURCE_ID: uint8 */
+#define PROTO_LTV_SOURCE_ID_SIZE 3
+
+static inline uint8_t *proto_put_source_id(uint8_t *p, uint8_t source_id)
+{
+	p[0] = PROTO_LTV_SOURCE_ID_SIZE - 1;
+	p[1] = BT_DATA_SOURCE_ID;
+	p[2] = source_id;
+
+	return p + PROTO_LTV_SOURCE_ID_SIZE;
+}
+
+static inline void proto_add_source_id(struct net_buf *buf, uint8_t source_id)
+{
+	proto_put_source_id(net_buf_add(buf, PROTO_LTV_SOURCE_ID_SIZE), source_id);
+}
+
+/* PA_SYNC_STATE: uint8 */
+#define PROTO_LTV_PA_SYNC_STATE_SIZE 3
+
+static inline uint8_t *proto_put_pa_sync_state(uint8_t *p, uint8_t pa_sync_state)
+{
+	p[0] = PROTO_LTV_PA_SYNC_STATE_SIZE - 1;
+	p[1] = BT_DATA_PA_SYNC_STATE;
+	p[2] = pa_sync_state;
+
+	return p + PROTO_LTV_PA_SYNC_STATE_SIZE;
+}
+
+static inline void proto_add_pa_sync_state(struct net_buf *buf, uint8_t pa_sync_state)
+{
+	proto_put_pa_sync_state(net_buf_add(buf, PROTO_LTV_PA_SYNC_STATE_SIZE), pa_sync_state);
+}
+
+/* ENC_STATE: uint8 */
+#define PROTO_LTV_ENC_STATE_SIZE 3
+
+static inline uint8_t *proto_put_enc_state(uint8_t *p, uint8_t enc_state)
+{
+	p[0] = PROTO_LTV_ENC_STATE_SIZE - 1;
+	p[1] = BT_DATA_ENC_STATE;
+	p[2] = enc_state;
+
+	return p + PROTO_LTV_ENC_STATE_SIZE;
+}
+
+static inline void proto_add_enc_state(struct net_buf *buf, uint8_t enc_state)
+{
+	proto_put_enc_state(net_buf_add(buf, PROTO_LTV_ENC_STATE_SIZE), enc_state);
+}
+
+/* BIS_SYNC: uint8 (subgroup) + uint32 (bis_sync) (0xFFFFFFFF = failed to sync) */
+#define PROTO_LTV_BIS_SYNC_SIZE 7
+
+static inline uint8_t *proto_put_bis_sync(uint8_t *p, uint8_t subgroup, uint32_t bis_sync)
+{
+	p[0] = PROTO_LTV_BIS_SYNC_SIZE - 1;
+	p[1] = BT_DATA_BIS_SYNC;
+	p[2] = subgroup;
+	sys_put_le32(bis_sync, &p[3]);
+
+	return p + PROTO_LTV_BIS_SYNC_SIZE;
+}
+
+static inline void proto_add_bis_sync(struct net_buf *buf, uint8_t subgroup, uint32_t bis_sync)
+{
+	proto_put_bis_sync(net_buf_add(buf, PROTO_LTV_BIS_SYNC_SIZE), subgroup, bis_sync);
+}
+
+/* SUBGROUP_METADATA: uint8 (subgroup) + uint8[n] (metadata) */
+static inline void proto_add_subgroup_metadata(struct net_buf *buf, uint8_t subgroup, const uint8_t *metadata, uint8_t metadata_len)
+{
+	uint8_t *p = net_buf_add(buf, 3 + metadata_len);
+
+	p[0] = 2 + metadata_len;
+	p[1] = BT_DATA_SUBGROUP_METADATA;
+	p[2] = subgroup;
+	memcpy(&p[3], metadata, metadata_len);
+}
+
+/* FILTER_MIN_RSSI: int8 */
+#define PROTO_LTV_FILTER_MIN_RSSI_SIZE 3
+
+static inline uint8_t *proto_put_filter_min_rssi(uint8_t *p, int8_t filter_min_rssi)
+{
+	p[0] = PROTO_LTV_FILTER_MIN_RSSI_SIZE - 1;
+	p[1] = BT_DATA_FILTER_MIN_RSSI;
+	p[2] = (uint8_t)filter_min_rssi;
+
+	return p + PROTO_LTV_FILTER_MIN_RSSI_SIZE;
+}
+
+static inline void proto_add_filter_min_rssi(struct net_buf *buf, int8_t filter_min_rssi)
+{
+	proto_put_filter_min_rssi(net_buf_add(buf, PROTO_LTV_FILTER_MIN_RSSI_SIZE), filter_min_rssi);
+}
+
+/* FILTER_NAME_PREFIX: utf8 (variable len) */
+static inline void proto_add_filter_name_prefix(struct net_buf *buf, const char *filter_name_prefix, uint8_t len)
+{
+	uint8_t *p = net_buf_add(buf, 2 + len);
+
+	p[0] = 1 + len;
+	p[1] = BT_DATA_FILTER_NAME_PREFIX;
+	memcpy(&p[2], filter_name_prefix, len);
+}
+
+/* FILTER_STATS: uint8 (filter) + uint32 (count) (filter type, 0 = accepted, RSSI_REPORT = held back) */
+#define PROTO_LTV_FILTER_STATS_SIZE 7
+
+static inline uint8_t *proto_put_filter_stats(uint8_t *p, uint8_t filter, uint32_t count)
+{
+	p[0] = PROTO_LTV_FILTER_STATS_SIZE - 1;
+	p[1] = BT_DATA_FILTER_STATS;
+	p[2] = filter;
+	sys_put_le32(count, &p[3]);
+
+	return p + PROTO_LTV_FILTER_STATS_SIZE;
+}
+
+static inline void proto_add_filter_stats(struct net_buf *buf, uint8_t filter, uint32_t count)
+{
+	proto_put_filter_stats(net_buf_add(buf, PROTO_LTV_FILTER_STATS_SIZE), filter, count);
+}
+
+/* RSSI_REPORT: uint8 (smoothing) + uint16 (interval) + uint8 (threshold) (EWMA weight 1/2^smoothing, ms, dB) */
+#define PROTO_LTV_RSSI_REPORT_SIZE 6
+
+static inline uint8_t *proto_put_rssi_report(uint8_t *p, uint8_t smoothing, uint16_t interval, uint8_t threshold)
+{
+	p[0] = PROTO_LTV_RSSI_REPORT_SIZE - 1;
+	p[1] = BT_DATA_RSSI_REPORT;
+	p[2] = smoothing;
+	sys_put_le16(interval, &p[3]);
+	p[5] = threshold;
+
+	return p + PROTO_LTV_RSSI_REPORT_SIZE;
+}
+
+static inline void proto_add_rssi_report(struct net_buf *buf, uint8_t smoothing, uint16_t interval, uint8_t threshold)
+{
+	proto_put_rssi_report(net_buf_add(buf, PROTO_LTV_RSSI_REPORT_SIZE), smoothing, interval, threshold);
+}
+
+/* RSSI_STATS: int8 (min) + int8 (max) + uint16 (count) (raw samples since the previous report) */
+#define PROTO_LTV_RSSI_STATS_SIZE 6
+
+static inline uint8_t *proto_put_rssi_stats(uint8_t *p, int8_t min, int8_t max, uint16_t count)
+{
+	p[0] = PROTO_LTV_RSSI_STATS_SIZE - 1;
+	p[1] = BT_DATA_RSSI_STATS;
+	p[2] = (uint8_t)min;
+	p[3] = (uint8_t)max;
+	sys_put_le16(count, &p[4]);
+
+	return p + PROTO_LTV_RSSI_STATS_SIZE;
+}
+
+static inline void proto_add_rssi_stats(struct net_buf *buf, int8_t min, int8_t max, uint16_t count)
+{
+	proto_put_rssi_stats(net_buf_add(buf, PROTO_LTV_RSSI_STATS_SIZE), min, max, count);
+}
+
+/* SCAN_TARGET: uint8 (bit 0 sources, bit 1 sinks, 0 = not scanning) */
+#define PROTO_LTV_SCAN_TARGET_SIZE 3
+
+static inline uint8_t *proto_put_scan_target(uint8_t *p, uint8_t scan_target)
+{
+	p[0] = PROTO_LTV_SCAN_TARGET_SIZE - 1;
+	p[1] = BT_DATA_SCAN_TARGET;
+	p[2] = scan_target;
+
+	return p + PROTO_LTV_SCAN_TARGET_SIZE;
+}
+
+static inline void proto_add_scan_target(struct net_buf *buf, uint8_t scan_target)
+{
+	proto_put_scan_target(net_buf_add(buf, PROTO_LTV_SCAN_TARGET_SIZE), scan_target);
+}
+
+/* CONN_STATE: uint8 (1 = connecting, 2 = connected, 3 = ready (BASS discovered)) */
+#define PROTO_LTV_CONN_STATE_SIZE 3
+
+static inline uint8_t *proto_put_conn_state(uint8_t *p, uint8_t conn_state)
+{
+	p[0] = PROTO_LTV_CONN_STATE_SIZE - 1;
+	p[1] = BT_DATA_CONN_STATE;
+	p[2] = conn_state;
+
+	return p + PROTO_LTV_CONN_STATE_SIZE;
+}
+
+static inline void proto_add_conn_state(struct net_buf *buf, uint8_t conn_state)
+{
+	proto_put_conn_state(net_buf_add(buf, PROTO_LTV_CONN_STATE_SIZE), conn_state);
+}
+
+/* SECURITY_LEVEL: uint8 (bt_security_t) */
+#define PROTO_LTV_SECURITY_LEVEL_SIZE 3
+
+static inline uint8_t *proto_put_security_level(uint8_t *p, uint8_t security_level)
+{
+	p[0] = PROTO_LTV_SECURITY_LEVEL_SIZE - 1;
+	p[1] = BT_DATA_SECURITY_LEVEL;
+	p[2] = security_level;
+
+	return p + PROTO_LTV_SECURITY_LEVEL_SIZE;
+}
+
+static inline void proto_add_security_level(struct net_buf *buf, uint8_t security_level)
+{
+	proto_put_security_level(net_buf_add(buf, PROTO_LTV_SECURITY_LEVEL_SIZE), security_level);
+}
+
+/* TIMESTAMP: uint64 (device uptime in us) */
+#define PROTO_LTV_TIMESTAMP_SIZE 10
+
+static inline uint8_t *proto_put_timestamp(uint8_t *p, uint64_t timestamp)
+{
+	p[0] = PROTO_LTV_TIMESTAMP_SIZE - 1;
+	p[1] = BT_DATA_TIMESTAMP;
+	sys_put_le64(timestamp, &p[2]);
+
+	return p + PROTO_LTV_TIMESTAMP_SIZE;
+}
+
+static inline void proto_add_timestamp(struct net_buf *buf, uint64_t timestamp)
+{
+	proto_put_timestamp(net_buf_add(buf, PROTO_LTV_TIMESTAMP_SIZE), timestamp);
+}
+
+/* BENCH_DATA: uint8[n] (filler, up to 254 bytes per entry) */
+static inline void proto_add_bench_data(struct net_buf *buf, const uint8_t *bench_data, uint8_t len)
+{
+	uint8_t *p = net_buf_add(buf, 2 + len);
+
+	p[0] = 1 + len;
+	p[1] = BT_DATA_BENCH_DATA;
+	memcpy(&p[2], bench_data, len);
+}
+
+/* BENCH_FLOOD: uint16 (size) + uint16 (rate) + uint16 (duration) (payload bytes per event, events/s (0 = as fast as buffers allow), ms (0 = stop)) */
+#define PROTO_LTV_BENCH_FLOOD_SIZE 8
+
+static inline uint8_t *proto_put_bench_flood(uint8_t *p, uint16_t size, uint16_t rate, uint16_t duration)
+{
+	p[0] = PROTO_LTV_BENCH_FLOOD_SIZE - 1;
+	p[1] = BT_DATA_BENCH_FLOOD;
+	sys_put_le16(size, &p[2]);
+	sys_put_le16(rate, &p[4]);
+	sys_put_le16(duration, &p[6]);
+
+	return p + PROTO_LTV_BENCH_FLOOD_SIZE;
+}
+
+static inline void proto_add_bench_flood(struct net_buf *buf, uint16_t size, uint16_t rate, uint16_t duration)
+{
+	proto_put_bench_flood(net_buf_add(buf, PROTO_LTV_BENCH_FLOOD_SIZE), size, rate, duration);
+}
+
+/* BENCH_BYTES: uint32 (bytes discarded since RESET) */
+#define PROTO_LTV_BENCH_BYTES_SIZE 6
+
+static inline uint8_t *proto_put_bench_bytes(uint8_t *p, uint32_t bench_bytes)
+{
+	p[0] = PROTO_LTV_BENCH_BYTES_SIZE - 1;
+	p[1] = BT_DATA_BENCH_BYTES;
+	sys_put_le32(bench_bytes, &p[2]);
+
+	return p + PROTO_LTV_BENCH_BYTES_SIZE;
+}
+
+static inline void proto_add_bench_bytes(struct net_buf *buf, uint32_t bench_bytes)
+{
+	proto_put_bench_bytes(net_buf_add(buf, PROTO_LTV_BENCH_BYTES_SIZE), bench_bytes);
+}
+
+/* BENCH_FLOOD_STATS: uint32 (sent) + uint32 (dropped) (events sent, events not sent (no buffer)) */
+#define PROTO_LTV_BENCH_FLOOD_STATS_SIZE 10
+
+static inline uint8_t *proto_put_bench_flood_stats(uint8_t *p, uint32_t sent, uint32_t dropped)
+{
+	p[0] = PROTO_LTV_BENCH_FLOOD_STATS_SIZE - 1;
+	p[1] = BT_DATA_BENCH_FLOOD_STATS;
+	sys_put_le32(sent, &p[2]);
+	sys_put_le32(dropped, &p[6]);
+
+	return p + PROTO_LTV_BENCH_FLOOD_STATS_SIZE;
+}
+
+static inline void proto_add_bench_flood_stats(struct net_buf *buf, uint32_t sent, uint32_t dropped)
+{
+	proto_put_bench_flood_stats(net_buf_add(buf, PROTO_LTV_BENCH_FLOOD_STATS_SIZE), sent, dropped);
+}
+
+/* ADDR: RPA or IDENTITY, depending on the address */
+#define PROTO_LTV_ADDR_SIZE PROTO_LTV_RPA_SIZE
+
+static inline uint8_t *proto_put_addr(uint8_t *p, const bt_addr_le_t *addr)
+{
+	return bt_addr_le_is_identity(addr) ? proto_put_identity(p, addr) : proto_put_rpa(p, addr);
+}
+
+static inline void proto_add_addr(struct net_buf *buf, const bt_addr_le_t *addr)
+{
+	proto_put_addr(net_buf_add(buf, PROTO_LTV_ADDR_SIZE), addr);
+}
+
+/* SINK_CONNECTED: ADDR, ERROR_CODE */
+#define PROTO_EVT_SINK_CONNECTED_SIZE (PROTO_LTV_ADDR_SIZE + PROTO_LTV_ERROR_CODE_SIZE)
+
+static inline void proto_evt_sink_connected(struct net_buf *buf, const bt_addr_le_t *addr, int32_t error_code)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_SINK_CONNECTED_SIZE);
+
+	p = proto_put_addr(p, addr);
+	proto_put_error_code(p, error_code);
+}
+
+/* SINK_DISCONNECTED: ADDR, ERROR_CODE */
+#define PROTO_EVT_SINK_DISCONNECTED_SIZE (PROTO_LTV_ADDR_SIZE + PROTO_LTV_ERROR_CODE_SIZE)
+
+static inline void proto_evt_sink_disconnected(struct net_buf *buf, const bt_addr_le_t *addr, int32_t error_code)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_SINK_DISCONNECTED_SIZE);
+
+	p = proto_put_addr(p, addr);
+	proto_put_error_code(p, error_code);
+}
+
+/* SOURCE_ADDED: ADDR, BROADCAST_ID, ERROR_CODE */
+#define PROTO_EVT_SOURCE_ADDED_SIZE (PROTO_LTV_ADDR_SIZE + PROTO_LTV_BROADCAST_ID_SIZE + PROTO_LTV_ERROR_CODE_SIZE)
+
+static inline void proto_evt_source_added(struct net_buf *buf, const bt_addr_le_t *addr, uint32_t broadcast_id, int32_t error_code)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_SOURCE_ADDED_SIZE);
+
+	p = proto_put_addr(p, addr);
+	p = proto_put_broadcast_id(p, broadcast_id);
+	proto_put_error_code(p, error_code);
+}
+
+/* SOURCE_REMOVED: ADDR, SOURCE_ID, ERROR_CODE */
+#define PROTO_EVT_SOURCE_REMOVED_SIZE (PROTO_LTV_ADDR_SIZE + PROTO_LTV_SOURCE_ID_SIZE + PROTO_LTV_ERROR_CODE_SIZE)
+
+static inline void proto_evt_source_removed(struct net_buf *buf, const bt_addr_le_t *addr, uint8_t source_id, int32_t error_code)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_SOURCE_REMOVED_SIZE);
+
+	p = proto_put_addr(p, addr);
+	p = proto_put_source_id(p, source_id);
+	proto_put_error_code(p, error_code);
+}
+
+/* IDENTITY_RESOLVED: RPA, IDENTITY */
+#define PROTO_EVT_IDENTITY_RESOLVED_SIZE (PROTO_LTV_RPA_SIZE + PROTO_LTV_IDENTITY_SIZE)
+
+static inline void proto_evt_identity_resolved(struct net_buf *buf, const bt_addr_le_t *rpa, const bt_addr_le_t *identity)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_IDENTITY_RESOLVED_SIZE);
+
+	p = proto_put_rpa(p, rpa);
+	proto_put_identity(p, identity);
+}
+
+/* RECV_STATE_CHANGED: ADDR, SOURCE_ID, BROADCAST_ID (optional fields are added after these) */
+#define PROTO_EVT_RECV_STATE_CHANGED_SIZE (PROTO_LTV_ADDR_SIZE + PROTO_LTV_SOURCE_ID_SIZE + PROTO_LTV_BROADCAST_ID_SIZE)
+
+static inline void proto_evt_recv_state_changed(struct net_buf *buf, const bt_addr_le_t *addr, uint8_t source_id, uint32_t broadcast_id)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_RECV_STATE_CHANGED_SIZE);
+
+	p = proto_put_addr(p, addr);
+	p = proto_put_source_id(p, source_id);
+	proto_put_broadcast_id(p, broadcast_id);
+}
+
+/* STATE_SNAPSHOT_BEGIN: SCAN_TARGET */
+#define PROTO_EVT_STATE_SNAPSHOT_BEGIN_SIZE (PROTO_LTV_SCAN_TARGET_SIZE)
+
+static inline void proto_evt_state_snapshot_begin(struct net_buf *buf, uint8_t scan_target)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_STATE_SNAPSHOT_BEGIN_SIZE);
+
+	proto_put_scan_target(p, scan_target);
+}
+
+/* SINK_STATE: ADDR, CONN_STATE, SECURITY_LEVEL */
+#define PROTO_EVT_SINK_STATE_SIZE (PROTO_LTV_ADDR_SIZE + PROTO_LTV_CONN_STATE_SIZE + PROTO_LTV_SECURITY_LEVEL_SIZE)
+
+static inline void proto_evt_sink_state(struct net_buf *buf, const bt_addr_le_t *addr, uint8_t conn_state, uint8_t security_level)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_SINK_STATE_SIZE);
+
+	p = proto_put_addr(p, addr);
+	p = proto_put_conn_state(p, conn_state);
+	proto_put_security_level(p, security_level);
+}
+
+/* STATE_SNAPSHOT_END: ERROR_CODE */
+#define PROTO_EVT_STATE_SNAPSHOT_END_SIZE (PROTO_LTV_ERROR_CODE_SIZE)
+
+static inline void proto_evt_state_snapshot_end(struct net_buf *buf, int32_t error_code)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_STATE_SNAPSHOT_END_SIZE);
+
+	proto_put_error_code(p, error_code);
+}
+
+/* FLOOD_END: BENCH_FLOOD_STATS */
+#define PROTO_EVT_FLOOD_END_SIZE (PROTO_LTV_BENCH_FLOOD_STATS_SIZE)
+
+static inline void proto_evt_flood_end(struct net_buf *buf, uint32_t sent, uint32_t dropped)
+{
+	uint8_t *p = net_buf_add(buf, PROTO_EVT_FLOOD_END_SIZE);
+
+	proto_put_bench_flood_stats(p, sent, dropped);
+}
+
+#endif /* __PROTOCOL_H__ */
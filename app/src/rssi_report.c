@@ -0,0 +1,214 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Per device RSSI aggregation for scan reports
+ *
+ * The configuration is set from the message handler and the devices are
+ * updated on the Bluetooth RX thread, a spinlock protects both. Devices are
+ * kept in a small table searched linearly, when it is full the device not
+ * heard for the longest time is replaced (and reported again when heard).
+ */
+
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include "rssi_report.h"
+
+LOG_MODULE_REGISTER(rssi_report, LOG_LEVEL_INF);
+
+/* The EWMA is kept in 1/256 dB */
+#define EWMA_SHIFT 8
+#define EWMA_ONE   (1 << EWMA_SHIFT)
+
+struct rssi_device {
+	bt_addr_le_t addr;
+	bool used;
+	int32_t ewma;
+	int8_t min;
+	int8_t max;
+	uint16_t count;
+	int8_t reported;
+	/* The last report was not sent, report on the next sample */
+	bool unsent;
+	uint32_t reported_at;
+	uint32_t seen_at;
+};
+
+static struct k_spinlock report_lock;
+static struct rssi_report_config active_config;
+static struct rssi_device devices[CONFIG_RSSI_REPORT_MAX_DEVICES];
+static uint32_t held;
+
+static int8_t ewma_to_rssi(int32_t ewma)
+{
+	return (int8_t)((ewma + EWMA_ONE / 2) >> EWMA_SHIFT);
+}
+
+static struct rssi_device *device_find(const bt_addr_le_t *addr)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(devices); i++) {
+		if (devices[i].used && bt_addr_le_cmp(&devices[i].addr, addr) == 0) {
+			return &devices[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct rssi_device *device_get(const bt_addr_le_t *addr, uint32_t now, bool *is_new)
+{
+	struct rssi_device *oldest = &devices[0];
+
+	for (size_t i = 0; i < ARRAY_SIZE(devices); i++) {
+		struct rssi_device *device = &devices[i];
+
+		if (!device->used) {
+			oldest = device;
+			continue;
+		}
+
+		if (bt_addr_le_cmp(&device->addr, addr) == 0) {
+			*is_new = false;
+			return device;
+		}
+
+		if (oldest->used && now - device->seen_at > now - oldest->seen_at) {
+			oldest = device;
+		}
+	}
+
+	memset(oldest, 0, sizeof(*oldest));
+	bt_addr_le_copy(&oldest->addr, addr);
+	oldest->used = true;
+	*is_new = true;
+
+	return oldest;
+}
+
+static bool device_due(const struct rssi_device *device, int8_t rssi, uint32_t now)
+{
+	if (device->unsent || (active_config.interval == 0 && active_config.threshold == 0)) {
+		return true;
+	}
+
+	if (active_config.interval > 0 && now - device->reported_at >= active_config.interval) {
+		return true;
+	}
+
+	return active_config.threshold > 0 &&
+	       abs(rssi - device->reported) >= active_config.threshold;
+}
+
+void rssi_report_set(const struct rssi_report_config *config)
+{
+	K_SPINLOCK(&report_lock) {
+		memcpy(&active_config, config, sizeof(active_config));
+		memset(devices, 0, sizeof(devices));
+		held = 0;
+	}
+
+	LOG_INF("RSSI report: smoothing 1/%u, interval %u ms, threshold %u dB",
+		1U << config->smoothing, config->interval, config->threshold);
+}
+
+bool rssi_report_update(const bt_addr_le_t *addr, int8_t rssi, struct rssi_report *report)
+{
+	uint32_t now = k_uptime_get_32();
+	bool send = true;
+
+	K_SPINLOCK(&report_lock) {
+		struct rssi_device *device;
+		bool is_new;
+
+		if (active_config.smoothing == 0 && active_config.interval == 0 &&
+		    active_config.threshold == 0) {
+			report->rssi = rssi;
+			report->min = rssi;
+			report->max = rssi;
+			report->count = 0;
+			K_SPINLOCK_BREAK;
+		}
+
+		device = device_get(addr, now, &is_new);
+		device->seen_at = now;
+
+		if (is_new || device->count == 0) {
+			device->min = rssi;
+			device->max = rssi;
+		} else {
+			device->min = MIN(device->min, rssi);
+			device->max = MAX(device->max, rssi);
+		}
+
+		if (device->count < UINT16_MAX) {
+			device->count++;
+		}
+
+		if (is_new) {
+			device->ewma = rssi * EWMA_ONE;
+		} else {
+			/* Shifts of negative values are arithmetic (gcc) */
+			device->ewma += (rssi * EWMA_ONE - device->ewma) >>
+					active_config.smoothing;
+		}
+
+		report->rssi = ewma_to_rssi(device->ewma);
+
+		if (!is_new && !device_due(device, report->rssi, now)) {
+			held++;
+			send = false;
+			K_SPINLOCK_BREAK;
+		}
+
+		report->min = device->min;
+		report->max = device->max;
+		report->count = device->count;
+
+		device->reported = report->rssi;
+		device->reported_at = now;
+		device->unsent = false;
+		device->count = 0;
+	}
+
+	return send;
+}
+
+void rssi_report_unsent(const bt_addr_le_t *addr, const struct rssi_report *report)
+{
+	K_SPINLOCK(&report_lock) {
+		struct rssi_device *device = device_find(addr);
+
+		/* Aggregation off or the device was replaced, its next sample is reported anyway */
+		if (!device || report->count == 0) {
+			K_SPINLOCK_BREAK;
+		}
+
+		/* Samples added since the report was taken are merged with the ones it carried */
+		if (device->count == 0) {
+			device->min = report->min;
+			device->max = report->max;
+		} else {
+			device->min = MIN(device->min, report->min);
+			device->max = MAX(device->max, report->max);
+		}
+		device->count = MIN((uint32_t)device->count + report->count, UINT16_MAX);
+		device->unsent = true;
+	}
+}
+
+uint32_t rssi_report_held_get(void)
+{
+	uint32_t count;
+
+	K_SPINLOCK(&report_lock) {
+		count = held;
+	}
+
+	return count;
+}
@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Per device RSSI aggregation for scan reports
+ *
+ * Scan reports of a device carry a filtered RSSI (EWMA) instead of the raw
+ * sample, and repeated reports are held back until the device is due: at a
+ * fixed interval or when the filtered RSSI changed significantly. The
+ * samples in between are summarized as min/max/count.
+ */
+
+#ifndef __RSSI_REPORT_H__
+#define __RSSI_REPORT_H__
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/addr.h>
+
+struct rssi_report_config {
+	/* Weight of a new sample is 1/2^smoothing, 0 = raw samples */
+	uint8_t smoothing;
+	/* Report a device at least every interval ms, 0 = on change only */
+	uint16_t interval;
+	/* Report a device early when the filtered RSSI moved threshold dB, 0 = never */
+	uint8_t threshold;
+};
+
+struct rssi_report {
+	/* Filtered RSSI */
+	int8_t rssi;
+	/* Raw samples since the previous report of the device */
+	int8_t min;
+	int8_t max;
+	/* 0 if aggregation is off (rssi is the raw sample) */
+	uint16_t count;
+};
+
+/**
+ * @brief Replace the configuration, forget all devices and reset the counter
+ *
+ * An all zero configuration turns aggregation off, every report is sent
+ * with its raw RSSI.
+ */
+void rssi_report_set(const struct rssi_report_config *config);
+
+/**
+ * @brief Add an RSSI sample of a device
+ *
+ * @param report	Filled in when the report is to be sent
+ *
+ * @return true if the scan report should be sent
+ */
+bool rssi_report_update(const bt_addr_le_t *addr, int8_t rssi, struct rssi_report *report);
+
+/**
+ * @brief Undo a report that rssi_report_update() let through but was not sent
+ *
+ * The samples it carried are kept and the device is reported on its next
+ * sample, as if it was due.
+ *
+ * @param report	The report filled in by rssi_report_update()
+ */
+void rssi_report_unsent(const bt_addr_le_t *addr, const struct rssi_report *report);
+
+/**
+ * @brief Get the number of reports held back since the configuration was set
+ */
+uint32_t rssi_report_held_get(void);
+
+#endif /* __RSSI_REPORT_H__ */
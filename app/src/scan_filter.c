@@ -0,0 +1,131 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Host configurable filters for scan reports
+ *
+ * The filters are set from the message handler and evaluated on the Bluetooth
+ * RX thread, a spinlock keeps them consistent. The checks are cheap (short
+ * lists), so the lock is held for the whole evaluation.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include "scan_filter.h"
+
+LOG_MODULE_REGISTER(scan_filter, LOG_LEVEL_INF);
+
+static struct k_spinlock filter_lock;
+static struct scan_filter active_filter;
+static struct scan_filter_stats filter_stats;
+
+static bool broadcast_id_in_list(uint32_t broadcast_id, const uint32_t *list, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++) {
+		if (list[i] == broadcast_id) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool name_has_prefix(const char *name, const char *prefix, uint8_t prefix_len)
+{
+	return strncmp(name, prefix, prefix_len) == 0;
+}
+
+void scan_filter_set(const struct scan_filter *filter)
+{
+	K_SPINLOCK(&filter_lock) {
+		memcpy(&active_filter, filter, sizeof(active_filter));
+		memset(&filter_stats, 0, sizeof(filter_stats));
+	}
+
+	LOG_INF("Scan filter: rssi %s%d, name prefix \"%.*s\", %u allowed / %u denied broadcast IDs, "
+		"%u allowed addresses",
+		filter->has_min_rssi ? ">= " : "off ", filter->min_rssi, filter->name_prefix_len,
+		filter->name_prefix, filter->num_broadcast_id_allow, filter->num_broadcast_id_deny,
+		filter->num_addr_allow);
+}
+
+bool scan_filter_check_info(int8_t rssi, const bt_addr_le_t *addr)
+{
+	bool pass = true;
+
+	K_SPINLOCK(&filter_lock) {
+		if (active_filter.has_min_rssi && rssi < active_filter.min_rssi) {
+			filter_stats.rejected[SCAN_FILTER_MIN_RSSI]++;
+			pass = false;
+			K_SPINLOCK_BREAK;
+		}
+
+		if (active_filter.num_addr_allow > 0) {
+			bool found = false;
+
+			for (uint8_t i = 0; i < active_filter.num_addr_allow; i++) {
+				if (bt_addr_le_cmp(addr, &active_filter.addr_allow[i]) == 0) {
+					found = true;
+					break;
+				}
+			}
+
+			if (!found) {
+				filter_stats.rejected[SCAN_FILTER_ADDR_ALLOW]++;
+				pass = false;
+			}
+		}
+	}
+
+	return pass;
+}
+
+bool scan_filter_check_data(enum ad_class class, const struct scan_recv_data *sr_data)
+{
+	bool pass = true;
+
+	K_SPINLOCK(&filter_lock) {
+		if (active_filter.name_prefix_len > 0 &&
+		    !name_has_prefix(sr_data->bt_name, active_filter.name_prefix,
+				     active_filter.name_prefix_len) &&
+		    !name_has_prefix(sr_data->broadcast_name, active_filter.name_prefix,
+				     active_filter.name_prefix_len)) {
+			filter_stats.rejected[SCAN_FILTER_NAME_PREFIX]++;
+			pass = false;
+			K_SPINLOCK_BREAK;
+		}
+
+		if (class == AD_CLASS_SOURCE) {
+			if (active_filter.num_broadcast_id_allow > 0 &&
+			    !broadcast_id_in_list(sr_data->broadcast_id,
+						  active_filter.broadcast_id_allow,
+						  active_filter.num_broadcast_id_allow)) {
+				filter_stats.rejected[SCAN_FILTER_BROADCAST_ID_ALLOW]++;
+				pass = false;
+				K_SPINLOCK_BREAK;
+			}
+
+			if (broadcast_id_in_list(sr_data->broadcast_id, active_filter.broadcast_id_deny,
+						 active_filter.num_broadcast_id_deny)) {
+				filter_stats.rejected[SCAN_FILTER_BROADCAST_ID_DENY]++;
+				pass = false;
+				K_SPINLOCK_BREAK;
+			}
+		}
+
+		filter_stats.accepted++;
+	}
+
+	return pass;
+}
+
+void scan_filter_stats_get(struct scan_filter_stats *stats)
+{
+	K_SPINLOCK(&filter_lock) {
+		memcpy(stats, &filter_stats, sizeof(*stats));
+	}
+}
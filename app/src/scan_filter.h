@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Host configurable filters for scan reports
+ *
+ * Reports rejected by a filter are dropped before any event message is
+ * allocated. Each filter counts the reports it rejected.
+ */
+
+#ifndef __SCAN_FILTER_H__
+#define __SCAN_FILTER_H__
+
+#include <zephyr/types.h>
+#include <zephyr/bluetooth/addr.h>
+
+#include "ad_classifier.h"
+
+enum scan_filter_type {
+	SCAN_FILTER_MIN_RSSI,
+	SCAN_FILTER_ADDR_ALLOW,
+	SCAN_FILTER_NAME_PREFIX,
+	SCAN_FILTER_BROADCAST_ID_ALLOW,
+	SCAN_FILTER_BROADCAST_ID_DENY,
+	SCAN_FILTER_TYPE_COUNT,
+};
+
+struct scan_filter {
+	bool has_min_rssi;
+	int8_t min_rssi;
+	/* Matched against both the device name and the broadcast name */
+	uint8_t name_prefix_len;
+	char name_prefix[BT_NAME_LEN];
+	/* Broadcast ID lists only apply to sources */
+	uint8_t num_broadcast_id_allow;
+	uint32_t broadcast_id_allow[CONFIG_SCAN_FILTER_MAX_BROADCAST_IDS];
+	uint8_t num_broadcast_id_deny;
+	uint32_t broadcast_id_deny[CONFIG_SCAN_FILTER_MAX_BROADCAST_IDS];
+	uint8_t num_addr_allow;
+	bt_addr_le_t addr_allow[CONFIG_SCAN_FILTER_MAX_ADDRS];
+};
+
+struct scan_filter_stats {
+	uint32_t accepted;
+	uint32_t rejected[SCAN_FILTER_TYPE_COUNT];
+};
+
+/**
+ * @brief Replace the active filters and reset the counters
+ *
+ * An empty filter (all zero) disables filtering.
+ */
+void scan_filter_set(const struct scan_filter *filter);
+
+/**
+ * @brief Filter on the report header (RSSI and address), before the AD data is parsed
+ *
+ * @return true if the report should be processed further
+ */
+bool scan_filter_check_info(int8_t rssi, const bt_addr_le_t *addr);
+
+/**
+ * @brief Filter on the data extracted from a classified report
+ *
+ * @return true if the report should be forwarded to the host
+ */
+bool scan_filter_check_data(enum ad_class class, const struct scan_recv_data *sr_data);
+
+/**
+ * @brief Get the rejection counters since the filters were last set
+ */
+void scan_filter_stats_get(struct scan_filter_stats *stats);
+
+#endif /* __SCAN_FILTER_H__ */
@@ -105,8 +105,13 @@ static void webusb_tx_work_handler(struct k_work *work_p);
 K_WORK_DEFINE(webusb_tx_work, webusb_tx_work_handler);
 K_MSGQ_DEFINE(webusb_tx_msg_queue, sizeof(struct net_buf*), CONFIG_TX_MSG_MAX_MESSAGES, 4);
 
-uint8_t cobs_decoded_stream[MAX_COBS_MESSAGE_SIZE];
-uint16_t cobs_decoded_length;
+/* Decoded messages wait here for the message handler, the read is re-armed meanwhile. A message
+ * received with all buffers taken is dropped, the host has at most CONFIG_RX_MSG_MAX_MESSAGES
+ * commands in flight.
+ */
+NET_BUF_POOL_DEFINE(webusb_rx_msg_pool, CONFIG_RX_MSG_MAX_MESSAGES, MAX_COBS_MESSAGE_SIZE, 0, NULL);
+K_MSGQ_DEFINE(webusb_rx_msg_queue, sizeof(struct net_buf*), CONFIG_RX_MSG_MAX_MESSAGES, 4);
+
 uint8_t cobs_encoded_stream[MAX_COBS_MESSAGE_SIZE];
 
 /*#define WEBUSB_DEBUG*/
@@ -166,8 +171,14 @@ static void webusb_rx_work_handler(struct k_work *work_p)
 {
 	ARG_UNUSED(work_p);
 
-	if (webusb_msg_handler) {
-		webusb_msg_handler((struct webusb_message *)&cobs_decoded_stream, cobs_decoded_length);
+	struct net_buf *rx_net_buf = NULL;
+
+	while (k_msgq_get(&webusb_rx_msg_queue, &rx_net_buf, K_NO_WAIT) == 0) {
+		if (webusb_msg_handler) {
+			webusb_msg_handler((struct webusb_message *)rx_net_buf->data, rx_net_buf->len);
+		}
+
+		net_buf_unref(rx_net_buf);
 	}
 }
 
@@ -213,6 +224,7 @@ void webusb_register_message_handler(void (*cb)(struct webusb_message *msg_ptr,
 static void webusb_read_cb(uint8_t ep, int size, void *priv)
 {
 	struct usb_cfg_data *cfg = priv;
+	struct net_buf *rx_net_buf;
 	cobs_decode_result result;
 
 	LOG_DBG("cfg %p ep %x size %u", cfg, ep, size);
@@ -222,16 +234,25 @@ static void webusb_read_cb(uint8_t ep, int size, void *priv)
 		goto done;
 	}
 
-	result = cobs_decode(&cobs_decoded_stream, sizeof(cobs_decoded_stream), rx_buf, strlen(rx_buf));
+	rx_net_buf = net_buf_alloc(&webusb_rx_msg_pool, K_NO_WAIT);
+	if (!rx_net_buf) {
+		LOG_ERR("No buffer for the received message, dropped");
+		goto done;
+	}
+
+	result = cobs_decode(rx_net_buf->data, rx_net_buf->size, rx_buf, strlen(rx_buf));
 	if (result.status == COBS_DECODE_OK) {
-		cobs_decoded_length = result.out_len;
+		net_buf_add(rx_net_buf, result.out_len);
 		LOG_DBG("Decoded COBS to Message, len=%d", result.out_len);
 #ifdef WEBUSB_DEBUG
-		print_hex(cobs_decoded_stream, result.out_len);
+		print_hex(rx_net_buf->data, rx_net_buf->len);
 #endif /* WEBUSB_DEBUG */
+		/* The queue holds every buffer of the pool */
+		k_msgq_put(&webusb_rx_msg_queue, &rx_net_buf, K_NO_WAIT);
 		k_work_submit_to_queue(&webusb_workqueue, &webusb_rx_work);
 	} else {
 		LOG_ERR("Could not decode received COBS encoded data! - err: %d", result.status);
+		net_buf_unref(rx_net_buf);
 	}
 
 done:
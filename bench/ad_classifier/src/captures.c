@@ -0,0 +1,135 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Advertising reports used by the classifier benchmark
+ *
+ * The reports are modelled on what is seen when scanning in an office with a
+ * few LE Audio sources and sinks around: most reports are unrelated devices
+ * (phones, beacons, HID devices, trackers), a few are broadcast sources and
+ * sinks. The advertising data is written out by hand, addresses and IDs are
+ * made up.
+ */
+
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/gap.h>
+
+#include "captures.h"
+
+#define PROP_CONN     BT_GAP_ADV_PROP_CONNECTABLE
+#define PROP_CONN_EXT (BT_GAP_ADV_PROP_CONNECTABLE | BT_GAP_ADV_PROP_EXT_ADV)
+#define PROP_EXT      BT_GAP_ADV_PROP_EXT_ADV
+
+/* Broadcast source, Broadcast Audio Announcement + Broadcast Name */
+static const uint8_t src_broadcast_name[] = {
+	0x06, 0x16, 0x52, 0x18, 0x3a, 0x9c, 0x01,
+	0x11, 0x30, 'Z', 'e', 'p', 'h', 'y', 'r', ' ', 'B', 'r', 'o', 'a', 'd', 'c', 'a', 's',
+	't',
+};
+
+/* Broadcast source, Public Broadcast Announcement, Broadcast Audio Announcement,
+ * Broadcast Name and Complete Local Name
+ */
+static const uint8_t src_public_broadcast[] = {
+	0x09, 0x16, 0x56, 0x18, 0x04, 0x04, 0x03, 0x02, 0x04, 0x00,
+	0x06, 0x16, 0x52, 0x18, 0x10, 0x22, 0x33,
+	0x0f, 0x30, 'L', 'e', 'c', 't', 'u', 'r', 'e', ' ', 'H', 'a', 'l', 'l', ' ', 'A',
+	0x08, 0x09, 'T', 'V', ' ', 'R', 'o', 'o', 'm',
+	0x03, 0x19, 0x40, 0x08,
+};
+
+/* Sink, hearing aid with BASS/PACS/ASCS in the UUID list and ASCS service data */
+static const uint8_t sink_hearing_aid[] = {
+	0x02, 0x01, 0x06,
+	0x09, 0x03, 0x4e, 0x18, 0x4f, 0x18, 0x50, 0x18, 0x44, 0x18,
+	0x09, 0x16, 0x4e, 0x18, 0x00, 0xff, 0x0f, 0x03, 0x00, 0x00,
+	0x03, 0x19, 0x41, 0x0a,
+	0x0e, 0x09, 'H', 'e', 'a', 'r', 'i', 'n', 'g', ' ', 'A', 'i', 'd', ' ', 'L',
+};
+
+/* Sink, earbuds with an incomplete UUID list and a shortened name */
+static const uint8_t sink_earbuds[] = {
+	0x02, 0x01, 0x1a,
+	0x05, 0x02, 0x50, 0x18, 0x4f, 0x18,
+	0x0a, 0xff, 0x59, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x07, 0x08, 'B', 'u', 'd', 's', ' ', '2',
+};
+
+/* Connectable LE Audio device without BASS (unicast only headset) */
+static const uint8_t unicast_headset[] = {
+	0x02, 0x01, 0x06,
+	0x05, 0x03, 0x4e, 0x18, 0x50, 0x18,
+	0x08, 0x09, 'H', 'e', 'a', 'd', 's', 'e', 't',
+};
+
+/* Phone, connectable with manufacturer data */
+static const uint8_t phone[] = {
+	0x02, 0x01, 0x1a,
+	0x0a, 0xff, 0x4c, 0x00, 0x10, 0x05, 0x01, 0x18, 0x41, 0x2b, 0x4d,
+	0x02, 0x0a, 0x0c,
+};
+
+/* HID keyboard */
+static const uint8_t keyboard[] = {
+	0x02, 0x01, 0x05,
+	0x03, 0x19, 0xc1, 0x03,
+	0x05, 0x02, 0x12, 0x18, 0x0f, 0x18,
+	0x0e, 0x09, 'K', 'e', 'y', 'b', 'o', 'a', 'r', 'd', ' ', 'K', '3', '8', '0',
+};
+
+/* Eddystone beacon, non-connectable and not periodic */
+static const uint8_t beacon[] = {
+	0x02, 0x01, 0x06,
+	0x03, 0x03, 0xaa, 0xfe,
+	0x12, 0x16, 0xaa, 0xfe, 0x10, 0xf4, 0x03, 'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c',
+	'o', 'm', 0x00,
+};
+
+/* Tracker, non-connectable with manufacturer data */
+static const uint8_t tracker[] = {
+	0x1c, 0xff, 0x4c, 0x00, 0x12, 0x19, 0x10, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+	0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x01,
+	0x00,
+};
+
+/* Periodic advertiser that is not a broadcast source */
+static const uint8_t periodic_other[] = {
+	0x05, 0x16, 0x2c, 0xfe, 0x00, 0x01,
+	0x08, 0x09, 'S', 'e', 'n', 's', 'o', 'r', '1',
+};
+
+/* Truncated report, the last structure claims more data than present */
+static const uint8_t truncated[] = {
+	0x02, 0x01, 0x06,
+	0x09, 0x03, 0x4f, 0x18, 0x50,
+};
+
+#define CAPTURE(_desc, _props, _interval, _expected, _data)                                       \
+	{                                                                                          \
+		.desc = _desc, .adv_props = _props, .interval = _interval,                          \
+		.expected = _expected, .len = sizeof(_data), .data = _data,                          \
+	}
+
+const struct capture captures[] = {
+	CAPTURE("source (broadcast name)", PROP_EXT, 0x0050, AD_CLASS_SOURCE, src_broadcast_name),
+	CAPTURE("source (public broadcast)", PROP_EXT, 0x00a0, AD_CLASS_SOURCE,
+		src_public_broadcast),
+	CAPTURE("sink (hearing aid)", PROP_CONN_EXT, 0, AD_CLASS_SINK, sink_hearing_aid),
+	CAPTURE("sink (earbuds)", PROP_CONN, 0, AD_CLASS_SINK, sink_earbuds),
+	CAPTURE("unicast headset", PROP_CONN, 0, AD_CLASS_NONE, unicast_headset),
+	CAPTURE("phone", PROP_CONN, 0, AD_CLASS_NONE, phone),
+	CAPTURE("phone", PROP_CONN, 0, AD_CLASS_NONE, phone),
+	CAPTURE("phone", PROP_CONN, 0, AD_CLASS_NONE, phone),
+	CAPTURE("keyboard", PROP_CONN, 0, AD_CLASS_NONE, keyboard),
+	CAPTURE("beacon", 0, 0, AD_CLASS_NONE, beacon),
+	CAPTURE("beacon", 0, 0, AD_CLASS_NONE, beacon),
+	CAPTURE("tracker", 0, 0, AD_CLASS_NONE, tracker),
+	CAPTURE("tracker", 0, 0, AD_CLASS_NONE, tracker),
+	CAPTURE("tracker", 0, 0, AD_CLASS_NONE, tracker),
+	CAPTURE("periodic, not audio", PROP_EXT, 0x0320, AD_CLASS_NONE, periodic_other),
+	CAPTURE("truncated", PROP_CONN, 0, AD_CLASS_NONE, truncated),
+};
+
+const size_t captures_count = ARRAY_SIZE(captures);
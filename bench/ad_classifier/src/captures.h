@@ -0,0 +1,29 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Advertising reports used by the classifier benchmark
+ */
+
+#ifndef __CAPTURES_H__
+#define __CAPTURES_H__
+
+#include <zephyr/types.h>
+
+#include "ad_classifier.h"
+
+struct capture {
+	const char *desc;
+	uint16_t adv_props;
+	uint16_t interval;
+	enum ad_class expected;
+	uint8_t len;
+	const uint8_t *data;
+};
+
+extern const struct capture captures[];
+extern const size_t captures_count;
+
+#endif /* __CAPTURES_H__ */
@@ -0,0 +1,139 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Previous two pass scan classification, kept as the benchmark baseline
+ *
+ * Same logic as scan_recv_cb() used before ad_classify(): the AD buffer is
+ * cloned per scan target and parsed with bt_data_parse(), UUIDs are compared
+ * with bt_uuid_cmp().
+ */
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/audio/audio.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "broadcast_assistant.h"
+#include "legacy.h"
+
+static bool device_found(struct bt_data *data, void *user_data)
+{
+	struct scan_recv_data *sr_data = (struct scan_recv_data *)user_data;
+	struct bt_uuid_16 adv_uuid;
+
+	switch (data->type) {
+	case BT_DATA_NAME_SHORTENED:
+	case BT_DATA_NAME_COMPLETE:
+		memcpy(sr_data->bt_name, data->data, MIN(data->data_len, BT_NAME_LEN - 1));
+		sr_data->bt_name_type = data->type == BT_DATA_NAME_SHORTENED
+						? BT_DATA_NAME_SHORTENED
+						: BT_DATA_NAME_COMPLETE;
+		return true;
+	case BT_DATA_BROADCAST_NAME:
+		memcpy(sr_data->broadcast_name, data->data, MIN(data->data_len, BT_NAME_LEN - 1));
+		return true;
+	case BT_DATA_SVC_DATA16:
+		/* Check for Broadcast ID */
+		if (data->data_len < BT_UUID_SIZE_16 + BT_AUDIO_BROADCAST_ID_SIZE) {
+			return true;
+		}
+
+		if (!bt_uuid_create(&adv_uuid.uuid, data->data, BT_UUID_SIZE_16)) {
+			return true;
+		}
+
+		if (bt_uuid_cmp(&adv_uuid.uuid, BT_UUID_BROADCAST_AUDIO) != 0) {
+			return true;
+		}
+
+		sr_data->broadcast_id = sys_get_le24(data->data + BT_UUID_SIZE_16);
+		return true;
+	case BT_DATA_UUID16_SOME:
+	case BT_DATA_UUID16_ALL:
+		/* Check for BASS and PACS */
+		if (data->data_len % sizeof(uint16_t) != 0U) {
+			return true;
+		}
+
+		for (size_t i = 0; i < data->data_len; i += sizeof(uint16_t)) {
+			const struct bt_uuid *uuid;
+			uint16_t u16;
+
+			memcpy(&u16, &data->data[i], sizeof(u16));
+			uuid = BT_UUID_DECLARE_16(sys_le16_to_cpu(u16));
+
+			if (bt_uuid_cmp(uuid, BT_UUID_BASS) == 0) {
+				sr_data->has_bass = true;
+				continue;
+			}
+
+			if (bt_uuid_cmp(uuid, BT_UUID_PACS) == 0) {
+				sr_data->has_pacs = true;
+				continue;
+			}
+		}
+		return true;
+	default:
+		return true;
+	}
+}
+
+static bool scan_for_source(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad,
+			    struct scan_recv_data *sr_data)
+{
+	sr_data->broadcast_id = INVALID_BROADCAST_ID;
+
+	/* We are only interested in non-connectable periodic advertisers */
+	if ((info->adv_props & BT_GAP_ADV_PROP_CONNECTABLE) != 0 || info->interval == 0) {
+		return false;
+	}
+
+	bt_data_parse(ad, device_found, (void *)sr_data);
+
+	return sr_data->broadcast_id != INVALID_BROADCAST_ID;
+}
+
+static bool scan_for_sink(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad,
+			  struct scan_recv_data *sr_data)
+{
+	/* We are only interested in connectable advertisers */
+	if ((info->adv_props & BT_GAP_ADV_PROP_CONNECTABLE) == 0) {
+		return false;
+	}
+
+	bt_data_parse(ad, device_found, (void *)sr_data);
+
+	return sr_data->has_bass;
+}
+
+enum ad_class legacy_classify(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad,
+			      uint8_t targets, struct scan_recv_data *sr_data)
+{
+	struct net_buf_simple ad_clone1, ad_clone2;
+	enum ad_class class = AD_CLASS_NONE;
+
+	net_buf_simple_clone(ad, &ad_clone1);
+	net_buf_simple_clone(ad, &ad_clone2);
+
+	if (targets & BROADCAST_ASSISTANT_SCAN_TARGET_SOURCE) {
+		memset(sr_data, 0, sizeof(*sr_data));
+
+		if (scan_for_source(info, &ad_clone1, sr_data)) {
+			class = AD_CLASS_SOURCE;
+		}
+	}
+
+	if (targets & BROADCAST_ASSISTANT_SCAN_TARGET_SINK) {
+		struct scan_recv_data sink_data = {0};
+
+		if (scan_for_sink(info, &ad_clone2, &sink_data)) {
+			memcpy(sr_data, &sink_data, sizeof(sink_data));
+			class = AD_CLASS_SINK;
+		}
+	}
+
+	return class;
+}
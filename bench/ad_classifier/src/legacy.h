@@ -0,0 +1,20 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Previous two pass scan classification, kept as the benchmark baseline
+ */
+
+#ifndef __LEGACY_H__
+#define __LEGACY_H__
+
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include "ad_classifier.h"
+
+enum ad_class legacy_classify(const struct bt_le_scan_recv_info *info, struct net_buf_simple *ad,
+			      uint8_t targets, struct scan_recv_data *sr_data);
+
+#endif /* __LEGACY_H__ */
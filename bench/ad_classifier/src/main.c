@@ -0,0 +1,202 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Microbenchmark of the advertising report classifier
+ *
+ * Runs the single pass ad_classify() and the previous two pass classification
+ * over the same set of advertising reports, checks that they agree and prints
+ * the average time per report.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include "broadcast_assistant.h"
+#include "ad_classifier.h"
+#include "captures.h"
+#include "legacy.h"
+
+#define ITERATIONS 2000
+#define CAPTURES_MAX 32
+
+/* Scan callback arguments for the legacy path, set up once outside of the timing */
+static struct bt_le_scan_recv_info infos[CAPTURES_MAX];
+static struct net_buf_simple ads[CAPTURES_MAX];
+
+static const char *class_str(enum ad_class class)
+{
+	switch (class) {
+	case AD_CLASS_SOURCE:
+		return "source";
+	case AD_CLASS_SINK:
+		return "sink";
+	default:
+		return "none";
+	}
+}
+
+static enum ad_class expected_class(const struct capture *cap, uint8_t targets)
+{
+	if (cap->expected == AD_CLASS_SOURCE &&
+	    (targets & BROADCAST_ASSISTANT_SCAN_TARGET_SOURCE) == 0) {
+		return AD_CLASS_NONE;
+	}
+
+	if (cap->expected == AD_CLASS_SINK && (targets & BROADCAST_ASSISTANT_SCAN_TARGET_SINK) == 0) {
+		return AD_CLASS_NONE;
+	}
+
+	return cap->expected;
+}
+
+static bool same_data(enum ad_class class, const struct scan_recv_data *a,
+		      const struct scan_recv_data *b)
+{
+	if (strcmp(a->bt_name, b->bt_name) != 0 ||
+	    strcmp(a->broadcast_name, b->broadcast_name) != 0) {
+		return false;
+	}
+
+	/* Only the fields used for the class are compared */
+	if (class == AD_CLASS_SOURCE) {
+		return a->broadcast_id == b->broadcast_id;
+	}
+
+	return a->has_bass == b->has_bass && a->has_pacs == b->has_pacs;
+}
+
+static void capture_info(const struct capture *cap, struct bt_le_scan_recv_info *info,
+			 struct net_buf_simple *ad)
+{
+	static const bt_addr_le_t addr = {0};
+
+	memset(info, 0, sizeof(*info));
+	info->addr = &addr;
+	info->adv_props = cap->adv_props;
+	info->interval = cap->interval;
+
+	net_buf_simple_init_with_data(ad, (void *)cap->data, cap->len);
+}
+
+static int verify(uint8_t targets)
+{
+	int failures = 0;
+
+	for (size_t i = 0; i < captures_count; i++) {
+		const struct capture *cap = &captures[i];
+		struct scan_recv_data new_data, old_data;
+		struct bt_le_scan_recv_info info;
+		struct net_buf_simple ad;
+		enum ad_class new_class, old_class, expected;
+
+		capture_info(cap, &info, &ad);
+		expected = expected_class(cap, targets);
+
+		new_class = ad_classify(cap->adv_props, cap->interval, targets, cap->data, cap->len,
+					&new_data);
+		old_class = legacy_classify(&info, &ad, targets, &old_data);
+
+		if (new_class != old_class || new_class != expected) {
+			printk("MISMATCH %s: new %s, legacy %s, expected %s\n", cap->desc,
+			       class_str(new_class), class_str(old_class), class_str(expected));
+			failures++;
+			continue;
+		}
+
+		if (new_class != AD_CLASS_NONE && !same_data(new_class, &new_data, &old_data)) {
+			printk("MISMATCH %s: extracted data differs\n", cap->desc);
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+static uint64_t bench_new(uint8_t targets, volatile uint32_t *sink)
+{
+	struct scan_recv_data sr_data;
+	timing_t start, end;
+
+	start = timing_counter_get();
+
+	for (int n = 0; n < ITERATIONS; n++) {
+		for (size_t i = 0; i < captures_count; i++) {
+			const struct capture *cap = &captures[i];
+
+			*sink += ad_classify(cap->adv_props, cap->interval, targets, cap->data,
+					     cap->len, &sr_data);
+		}
+	}
+
+	end = timing_counter_get();
+
+	return timing_cycles_to_ns(timing_cycles_get(&start, &end));
+}
+
+static uint64_t bench_legacy(uint8_t targets, volatile uint32_t *sink)
+{
+	struct scan_recv_data sr_data;
+	timing_t start, end;
+
+	start = timing_counter_get();
+
+	for (int n = 0; n < ITERATIONS; n++) {
+		for (size_t i = 0; i < captures_count; i++) {
+			/* The AD buffer is cloned, so it can be reused */
+			*sink += legacy_classify(&infos[i], &ads[i], targets, &sr_data);
+		}
+	}
+
+	end = timing_counter_get();
+
+	return timing_cycles_to_ns(timing_cycles_get(&start, &end));
+}
+
+static void run(const char *name, uint8_t targets)
+{
+	const uint32_t reports = ITERATIONS * captures_count;
+	volatile uint32_t sink = 0;
+	uint64_t new_ns, legacy_ns;
+
+	if (verify(targets) != 0) {
+		printk("%s: classification mismatch, skipping timing\n", name);
+		return;
+	}
+
+	legacy_ns = bench_legacy(targets, &sink);
+	new_ns = bench_new(targets, &sink);
+
+	printk("%-8s legacy %6llu ns/report, single pass %6llu ns/report (%llu.%02llux)\n", name,
+	       legacy_ns / reports, new_ns / reports, legacy_ns / MAX(new_ns, 1),
+	       (legacy_ns * 100 / MAX(new_ns, 1)) % 100);
+}
+
+int main(void)
+{
+	if (captures_count > CAPTURES_MAX) {
+		printk("Too many captures\n");
+		return 0;
+	}
+
+	for (size_t i = 0; i < captures_count; i++) {
+		capture_info(&captures[i], &infos[i], &ads[i]);
+	}
+
+	timing_init();
+	timing_start();
+
+	printk("Advertising classifier benchmark: %u reports x %u iterations\n",
+	       (unsigned int)captures_count, ITERATIONS);
+
+	run("source", BROADCAST_ASSISTANT_SCAN_TARGET_SOURCE);
+	run("sink", BROADCAST_ASSISTANT_SCAN_TARGET_SINK);
+	run("all", BROADCAST_ASSISTANT_SCAN_TARGET_ALL);
+
+	timing_stop();
+
+	return 0;
+}
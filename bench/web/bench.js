@@ -0,0 +1,300 @@
+// @ts-check
+
+import { readFileSync, writeFileSync, existsSync } from 'node:fs';
+import { parseArgs } from 'node:util';
+
+import {
+	arrayToMsg,
+	messageLtv,
+	msgToArray,
+	tvArrayToLtv,
+	MessageType,
+	MessageSubType,
+	BT_DataType
+} from '../../web/lib/message.js';
+import { cobsEncodeInto, cobsDecodeInto } from '../../web/lib/cobs.js';
+import { CommandEncoder } from '../../web/lib/command-encoder.js';
+import { StreamDeframer } from '../../web/lib/stream-deframer.js';
+import { CommandManager } from '../../web/lib/command-manager.js';
+import { readCapture, CaptureFlags, CAPTURE_MAGIC } from '../../web/lib/capture.js';
+import { AssistantModel } from '../../web/models/assistant-model.js';
+
+import { measure, compare, formatResults } from './harness.js';
+import { scanStream, toChunks, prng } from './streams.js';
+
+/**
+* Web protocol stack benchmarks
+*
+* Runs the COBS codec, message decoding, the command manager and the
+* AssistantModel over synthetic scan streams (and optionally a recorded
+* stream) and compares the results with baseline.json.
+*
+*	node --expose-gc bench.js [options]
+*
+*	--filter <text>		Only run benchmarks with <text> in their name
+*	--recording <file>	Also run on a recorded USB stream (a capture, see
+*				capture.js, or raw COBS bytes)
+*	--threshold <r>		Allowed relative throughput drop (default 0.25)
+*	--p99-threshold <r>	Allowed relative p99 growth (default 0, p99 not
+*				compared)
+*	--heap-slack <bytes>	Allowed heap growth beyond baseline (default 1 MiB)
+*	--update-baseline	Write the results to baseline.json
+*
+* Exits with 1 when a benchmark regressed. Baselines are machine specific,
+* update them on the machine that runs the comparison.
+*/
+
+const baselineFile = new URL('./baseline.json', import.meta.url);
+
+const { values: args } = parseArgs({
+	options: {
+		'filter': { type: 'string', default: '' },
+		'recording': { type: 'string' },
+		'threshold': { type: 'string', default: '0.25' },
+		'p99-threshold': { type: 'string', default: '0' },
+		'heap-slack': { type: 'string', default: String(1024 * 1024) },
+		'update-baseline': { type: 'boolean', default: false }
+	}
+});
+
+const ADDR_TYPES = [BT_DataType.BT_DATA_IDENTITY, BT_DataType.BT_DATA_RPA];
+
+// The model logs every message, which would dominate the measurements
+const quiet = () => {
+	const log = console.log;
+	console.log = () => {};
+	return () => { console.log = log; };
+}
+
+// Minimal device service: the model only listens for events and sends commands
+class BenchService extends EventTarget {
+	sendCMD(message) {
+		return Promise.resolve({ ...message, type: MessageType.RES });
+	}
+}
+
+const deframe = chunks => {
+	const frames = [];
+	const deframer = new StreamDeframer();
+
+	for (const chunk of chunks) {
+		deframer.push(chunk, frame => {
+			try {
+				const decoded = cobsDecodeInto(frame, false).slice();
+				arrayToMsg(decoded);
+				frames.push(decoded);
+			} catch {
+				// Skip invalid frames, as the transport does
+			}
+		});
+	}
+
+	return frames;
+}
+
+// Received data of a capture (transfers as captured) or a raw stream (in 64 byte chunks)
+const readRecording = file => {
+	const data = new Uint8Array(readFileSync(file));
+
+	if (String.fromCharCode(...data.subarray(0, 4)) === CAPTURE_MAGIC) {
+		return readCapture(data).records
+			.filter(record => !(record.flags & CaptureFlags.OUT))
+			.map(record => record.flags & CaptureFlags.RAW ? record.data : cobsEncodeInto(record.data, true).slice());
+	}
+
+	const chunks = [];
+	for (let i = 0; i < data.length; i += 64) {
+		chunks.push(data.subarray(i, i + 64));
+	}
+
+	return chunks;
+}
+
+const commands = () => {
+	const random = prng(2);
+	const subTypes = [
+		MessageSubType.ADD_SOURCE,
+		MessageSubType.CONNECT_SINK,
+		MessageSubType.REMOVE_SOURCE,
+		MessageSubType.START_SOURCE_SCAN
+	];
+
+	return Array.from({length: 256}, (_, i) => {
+		const payload = Uint8Array.from({length: i % 4 === 3 ? 0 : 8 + (i % 40)}, () => Math.floor(random() * 256));
+
+		return { type: MessageType.CMD, subType: subTypes[i % 4], seqNo: i & 0xff, payload };
+	});
+}
+
+// Commands as the model builds them (Type Value Arrays)
+const commandItems = () => {
+	const random = prng(4);
+	const addr = () => ({ type: Math.floor(random() * 2), addr: Uint8Array.from({length: 6}, () => Math.floor(random() * 256)) });
+
+	return Array.from({length: 256}, (_, i) => {
+		switch (i % 4) {
+		case 0:
+			return { type: MessageType.CMD, subType: MessageSubType.ADD_SOURCE, seqNo: i & 0xff, items: [
+				{ type: BT_DataType.BT_DATA_RPA, value: addr() },
+				{ type: BT_DataType.BT_DATA_SID, value: i & 0x0f },
+				{ type: BT_DataType.BT_DATA_PA_INTERVAL, value: 0x0c80 },
+				{ type: BT_DataType.BT_DATA_BROADCAST_ID, value: Math.floor(random() * 0x1000000) }
+			]};
+		case 1:
+			return { type: MessageType.CMD, subType: MessageSubType.CONNECT_SINK, seqNo: i & 0xff, items: [
+				{ type: BT_DataType.BT_DATA_IDENTITY, value: addr() }
+			]};
+		case 2:
+			return { type: MessageType.CMD, subType: MessageSubType.SET_SCAN_FILTER, seqNo: i & 0xff, items: [
+				{ type: BT_DataType.BT_DATA_FILTER_MIN_RSSI, value: -70 },
+				{ type: BT_DataType.BT_DATA_FILTER_NAME_PREFIX, value: `Broadcast ${i}` },
+				{ type: BT_DataType.BT_DATA_FILTER_BROADCAST_ID_ALLOW, value: [1, 2, 3, 4] }
+			]};
+		default:
+			return { type: MessageType.CMD, subType: MessageSubType.START_SOURCE_SCAN, seqNo: i & 0xff };
+		}
+	});
+}
+
+const modelBench = (name, frames) => ({
+	name,
+	count: frames.length,
+	setup: () => {
+		const service = new BenchService();
+		return { service, model: new AssistantModel(service), restore: quiet() };
+	},
+	op: (ctx, i) => {
+		const message = arrayToMsg(frames[i]);
+		ctx.service.dispatchEvent(new CustomEvent('message', {detail: { message }}));
+	},
+	teardown: ctx => ctx.restore()
+});
+
+const decodeStreamBench = (name, chunks) => ({
+	name,
+	count: chunks.length,
+	setup: () => ({ deframer: new StreamDeframer(), out: new Uint8Array(8192), frames: 0 }),
+	op: (ctx, i) => {
+		ctx.deframer.push(chunks[i], frame => {
+			arrayToMsg(cobsDecodeInto(frame, false, ctx.out));
+			ctx.frames++;
+		});
+	}
+});
+
+const benchmarks = () => {
+	const scan1000 = scanStream({ sources: 1000, sinks: 20, reports: 20000 });
+	const scan5000 = scanStream({ sources: 5000, sinks: 50, reports: 20000, seed: 3 });
+	const chunks = toChunks(scan1000, 64);
+	const cmds = commands();
+	const cmdItems = commandItems();
+
+	const list = [
+		{
+			name: 'cobs.encode-command',
+			count: cmds.length,
+			op: (ctx, i) => { cobsEncodeInto(msgToArray(cmds[i]), true); }
+		},
+		{
+			name: 'command.encode',
+			count: cmds.length,
+			setup: () => ({ encoder: new CommandEncoder() }),
+			op: (ctx, i) => { ctx.encoder.encode(cmds[i]); }
+		},
+		// LTV fields, header and COBS framing from the model's Type Value Arrays
+		{
+			name: 'command.encode-items',
+			count: cmdItems.length,
+			setup: () => ({ encoder: new CommandEncoder() }),
+			op: (ctx, i) => { ctx.encoder.encode(cmdItems[i]); }
+		},
+		{
+			name: 'command.encode-items-legacy',
+			count: cmdItems.length,
+			op: (ctx, i) => {
+				const { items, ...message } = cmdItems[i];
+				cobsEncodeInto(msgToArray({ ...message, payload: items && tvArrayToLtv(items) }), true);
+			}
+		},
+		// An op is one 64 byte USB chunk, not a message
+		decodeStreamBench('cobs.decode-stream-64B-chunks', chunks),
+		{
+			name: 'message.decode',
+			count: scan1000.length,
+			op: (ctx, i) => {
+				const message = arrayToMsg(scan1000[i]);
+				const entries = messageLtv(message);
+				entries.find(ADDR_TYPES);
+				entries.find([BT_DataType.BT_DATA_RSSI]);
+			}
+		},
+		modelBench('model.scan-1000-sources', scan1000),
+		modelBench('model.scan-5000-sources', scan5000),
+		{
+			name: 'command-manager.roundtrip',
+			count: 1000,
+			setup: () => {
+				const ctx = { sent: undefined, manager: undefined };
+				ctx.manager = new CommandManager(message => {
+					ctx.sent = message;
+					return Promise.resolve();
+				});
+				return ctx;
+			},
+			op: ctx => {
+				ctx.manager.submit(cmds[0]);
+				const { subType, seqNo } = ctx.sent;
+				ctx.manager.handleResponse({ type: MessageType.RES, subType, seqNo });
+			}
+		}
+	];
+
+	if (args.recording) {
+		const recordedChunks = readRecording(args.recording);
+
+		list.push(
+			decodeStreamBench('recording.decode-stream', recordedChunks),
+			modelBench('recording.model', deframe(recordedChunks))
+		);
+	}
+
+	return list.filter(bench => bench.name.includes(args.filter) && bench.count > 0);
+}
+
+const baseline = existsSync(baselineFile) ? JSON.parse(readFileSync(baselineFile, 'utf8')) : { results: {} };
+
+if (!globalThis.gc) {
+	console.warn('Run with node --expose-gc to measure heap growth');
+}
+
+const results = {};
+for (const bench of benchmarks()) {
+	results[bench.name] = await measure(bench);
+}
+
+console.log(formatResults(results, baseline.results));
+
+if (args['update-baseline']) {
+	const updated = {
+		node: process.version,
+		date: new Date().toISOString().slice(0, 10),
+		results: { ...baseline.results, ...results }
+	};
+	writeFileSync(baselineFile, JSON.stringify(updated, null, '\t') + '\n');
+	console.log(`Baseline written to ${baselineFile.pathname}`);
+	process.exit(0);
+}
+
+const regressions = compare(results, baseline.results, {
+	threshold: Number(args.threshold),
+	p99Threshold: Number(args['p99-threshold']),
+	heapSlack: Number(args['heap-slack'])
+});
+
+if (regressions.length) {
+	console.log('\nRegressions:');
+	regressions.forEach(regression => console.log(`  ${regression}`));
+	process.exit(1);
+}
+
+console.log('\nNo regressions');
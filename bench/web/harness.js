@@ -0,0 +1,156 @@
+// @ts-check
+
+/**
+* Benchmark harness
+*
+* A benchmark is { name, count, setup(), op(ctx, i) } where op() handles
+* message i (0 <= i < count) of a pass. Each benchmark is measured with:
+*
+* - throughput: whole passes, timed as one block, until MIN_TIME_MS passed
+* - latency: LATENCY_PASSES passes timed in batches of LATENCY_BATCH ops,
+*   p50/p99 of the mean time per op of the batches (a single op is too short
+*   to time on its own, and one pass too short for a stable p99)
+* - heap growth: heap used after HEAP_PASSES passes vs before, both after a
+*   full GC (needs node --expose-gc, otherwise not reported)
+*
+* Between passes the event loop gets a turn, so promises created by op()
+* settle outside of the timed code.
+*/
+
+const WARMUP_PASSES = 2;
+const MIN_TIME_MS = 500;
+const HEAP_PASSES = 3;
+const LATENCY_PASSES = 5;
+const LATENCY_BATCH = 32;
+
+const tick = () => new Promise(resolve => setImmediate(resolve));
+
+const gc = globalThis.gc;
+
+const heapUsed = async () => {
+	await tick();
+	gc?.();
+	return process.memoryUsage().heapUsed;
+}
+
+const percentile = (sorted, p) => sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+
+const runPass = (bench, ctx) => {
+	for (let i = 0; i < bench.count; i++) {
+		bench.op(ctx, i);
+	}
+}
+
+/**
+* @returns {Promise<{ opsPerSec: number, p50: number, p99: number, heapGrowth?: number }>}
+*	Latencies in µs, heap growth in bytes
+*/
+export const measure = async bench => {
+	const ctx = await bench.setup?.();
+
+	for (let i = 0; i < WARMUP_PASSES; i++) {
+		runPass(bench, ctx);
+		await tick();
+	}
+
+	let ops = 0;
+	let time = 0;
+	while (time < MIN_TIME_MS) {
+		const start = performance.now();
+		runPass(bench, ctx);
+		time += performance.now() - start;
+		ops += bench.count;
+		await tick();
+	}
+
+	const batches = Math.ceil(bench.count / LATENCY_BATCH);
+	const samples = new Float64Array(LATENCY_PASSES * batches);
+	for (let pass = 0; pass < LATENCY_PASSES; pass++) {
+		for (let batch = 0; batch < batches; batch++) {
+			const first = batch * LATENCY_BATCH;
+			const end = Math.min(first + LATENCY_BATCH, bench.count);
+			const start = performance.now();
+			for (let i = first; i < end; i++) {
+				bench.op(ctx, i);
+			}
+			samples[pass * batches + batch] = (performance.now() - start) / (end - first);
+		}
+		await tick();
+	}
+	samples.sort();
+
+	const before = await heapUsed();
+	for (let i = 0; i < HEAP_PASSES; i++) {
+		runPass(bench, ctx);
+		await tick();
+	}
+	const after = await heapUsed();
+
+	await bench.teardown?.(ctx);
+
+	return {
+		opsPerSec: Math.round(ops / (time / 1000)),
+		p50: Math.round(percentile(samples, 0.5) * 1e5) / 100,
+		p99: Math.round(percentile(samples, 0.99) * 1e5) / 100,
+		heapGrowth: gc ? Math.max(0, after - before) : undefined
+	};
+}
+
+/**
+* Compare results with a baseline
+*
+* A benchmark regresses when its throughput drops by more than `threshold`
+* (relative) or its heap grows more than `heapSlack` bytes beyond the
+* baseline growth. p99 is only compared when `p99Threshold` is set (> 0): GC
+* pauses landing in a batch or not move it by more than 2x between runs of
+* unchanged code.
+*
+* @returns {string[]}	Regressions, empty if none
+*/
+export const compare = (results, baseline, { threshold, p99Threshold, heapSlack }) => {
+	const regressions = [];
+
+	for (const [name, result] of Object.entries(results)) {
+		const base = baseline[name];
+		if (!base) {
+			continue;
+		}
+
+		if (result.opsPerSec < base.opsPerSec * (1 - threshold)) {
+			regressions.push(`${name}: ${result.opsPerSec} ops/s < baseline ${base.opsPerSec} ops/s`);
+		}
+
+		if (p99Threshold > 0 && result.p99 > base.p99 * (1 + p99Threshold)) {
+			regressions.push(`${name}: p99 ${result.p99.toFixed(2)} µs > baseline ${base.p99.toFixed(2)} µs`);
+		}
+
+		if (result.heapGrowth !== undefined && base.heapGrowth !== undefined &&
+		    result.heapGrowth > base.heapGrowth + heapSlack) {
+			regressions.push(`${name}: heap grew ${result.heapGrowth} bytes > baseline ${base.heapGrowth} bytes`);
+		}
+	}
+
+	return regressions;
+}
+
+export const formatResults = (results, baseline = {}) => {
+	const rows = Object.entries(results).map(([name, r]) => {
+		const base = baseline[name];
+		const change = base ? `${((r.opsPerSec / base.opsPerSec - 1) * 100).toFixed(1)}%` : '';
+
+		return [
+			name,
+			r.opsPerSec.toLocaleString('en'),
+			change,
+			r.p50.toFixed(2),
+			r.p99.toFixed(2),
+			r.heapGrowth === undefined ? '-' : (r.heapGrowth / 1024).toFixed(1)
+		];
+	});
+
+	const header = ['benchmark', 'ops/s', 'vs base', 'p50 µs', 'p99 µs', 'heap KiB'];
+	const widths = header.map((h, i) => Math.max(h.length, ...rows.map(row => row[i].length)));
+	const line = row => row.map((cell, i) => i === 0 ? cell.padEnd(widths[i]) : cell.padStart(widths[i])).join('  ');
+
+	return [line(header), ...rows.map(line)].join('\n');
+}
@@ -0,0 +1,108 @@
+// @ts-check
+
+import {
+	msgToArray,
+	MessageType,
+	MessageSubType,
+	BT_DataType
+} from '../../web/lib/message.js';
+import { cobsEncodeInto } from '../../web/lib/cobs.js';
+import { prng } from '../../web/lib/helpers.js';
+
+/**
+* Synthetic event streams
+*
+* Scan reports in the layout sent by the firmware (see scan_recv_cb()),
+* generated from a seeded PRNG so runs are comparable. Streams are returned
+* both as decoded frames and as the raw COBS byte stream split into USB
+* sized chunks.
+*/
+
+const BT_UUID_BASS = 0x184f;
+const BT_UUID_PACS = 0x1850;
+const BT_UUID_BROADCAST_AUDIO = 0x1852;
+
+const utf8encoder = new TextEncoder();
+
+export { prng };
+
+const le = (value, size) => Array.from({length: size}, (_, i) => (value >>> (8 * i)) & 0xff);
+
+const ltv = (type, bytes) => [bytes.length + 1, type, ...bytes];
+
+const encodeEvent = (subType, payload) =>
+	msgToArray({ type: MessageType.EVT, subType, seqNo: 0, payload: new Uint8Array(payload) });
+
+const makeDevices = (random, count, isSource) => Array.from({length: count}, (_, i) => {
+	const addr = Array.from({length: 6}, () => Math.floor(random() * 256));
+	// Static random for sources, RPA for sinks
+	addr[5] = (addr[5] & 0x3f) | (isSource ? 0xc0 : 0x40);
+
+	return {
+		isSource,
+		addr,
+		name: [...utf8encoder.encode(`${isSource ? 'Source' : 'Sink'} ${i}`)],
+		broadcast_id: Math.floor(random() * 0x1000000),
+		rssi: -40 - Math.floor(random() * 50)
+	};
+});
+
+const sourceFound = (device, rssi) => encodeEvent(MessageSubType.SOURCE_FOUND, [
+	...ltv(BT_DataType.BT_DATA_SVC_DATA16, [...le(BT_UUID_BROADCAST_AUDIO, 2), ...le(device.broadcast_id, 3)]),
+	...ltv(BT_DataType.BT_DATA_BROADCAST_NAME, device.name),
+	...ltv(BT_DataType.BT_DATA_NAME_COMPLETE, device.name),
+	...ltv(BT_DataType.BT_DATA_RSSI, [rssi & 0xff]),
+	...ltv(BT_DataType.BT_DATA_IDENTITY, [1, ...device.addr]),
+	...ltv(BT_DataType.BT_DATA_NAME_COMPLETE, device.name),
+	...ltv(BT_DataType.BT_DATA_SID, [0]),
+	...ltv(BT_DataType.BT_DATA_PA_INTERVAL, le(0x0050, 2)),
+	...ltv(BT_DataType.BT_DATA_BROADCAST_ID, le(device.broadcast_id, 4)),
+]);
+
+const sinkFound = (device, rssi) => encodeEvent(MessageSubType.SINK_FOUND, [
+	...ltv(BT_DataType.BT_DATA_UUID16_ALL, [...le(BT_UUID_BASS, 2), ...le(BT_UUID_PACS, 2)]),
+	...ltv(BT_DataType.BT_DATA_SVC_DATA16, le(BT_UUID_BASS, 2)),
+	...ltv(BT_DataType.BT_DATA_NAME_COMPLETE, device.name),
+	...ltv(BT_DataType.BT_DATA_RSSI, [rssi & 0xff]),
+	...ltv(BT_DataType.BT_DATA_RPA, [1, ...device.addr]),
+	...ltv(BT_DataType.BT_DATA_NAME_COMPLETE, device.name),
+]);
+
+/**
+* Scan reports from a fixed set of advertisers, picked at random
+*
+* @returns {Uint8Array[]}	Decoded frames (message bytes)
+*/
+export const scanStream = ({ sources = 1000, sinks = 20, reports = 20000, seed = 1 } = {}) => {
+	const random = prng(seed);
+	const devices = [...makeDevices(random, sources, true), ...makeDevices(random, sinks, false)];
+
+	return Array.from({length: reports}, () => {
+		const device = devices[Math.floor(random() * devices.length)];
+		const rssi = device.rssi + Math.floor(random() * 13) - 6;
+
+		return device.isSource ? sourceFound(device, rssi) : sinkFound(device, rssi);
+	});
+}
+
+/**
+* COBS encode frames into a byte stream and split it into chunks
+*/
+export const toChunks = (frames, chunkSize = 64) => {
+	const length = frames.reduce((sum, frame) => sum + cobsEncodeInto(frame, true).length, 0);
+	const stream = new Uint8Array(length);
+
+	let ptr = 0;
+	for (const frame of frames) {
+		const encoded = cobsEncodeInto(frame, true);
+		stream.set(encoded, ptr);
+		ptr += encoded.length;
+	}
+
+	const chunks = [];
+	for (let i = 0; i < stream.length; i += chunkSize) {
+		chunks.push(stream.subarray(i, i + chunkSize));
+	}
+
+	return chunks;
+}
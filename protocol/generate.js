@@ -0,0 +1,743 @@
+// @ts-check
+
+/**
+* Protocol code generator
+*
+* Reads schema.json and writes the protocol definitions for both sides:
+*
+*	app/src/protocol.h	message enums, BT_DATA_* types, LTV and event encoders
+*	web/lib/protocol.js	MessageType, MessageSubType, BT_DataType, LTV value
+*				decoder, length and writer
+*
+* The encoders are specialised per type: the C helpers write fixed size
+* entries with one net_buf_add() of a compile time size, the JS decoder
+* checks the length once per entry and reads the fields at fixed offsets.
+*
+* Usage:
+*	node generate.js		write the files
+*	node generate.js --check	fail if the files are not up to date
+*/
+
+import { readFileSync, writeFileSync } from 'node:fs';
+import { fileURLToPath } from 'node:url';
+import { join, dirname, relative } from 'node:path';
+
+const ROOT = join(dirname(fileURLToPath(import.meta.url)), '..');
+const SCHEMA = join(ROOT, 'protocol', 'schema.json');
+const C_OUT = join(ROOT, 'app', 'src', 'protocol.h');
+const JS_OUT = join(ROOT, 'web', 'lib', 'protocol.js');
+
+const SCALARS = {
+	u8:	{ size: 1, c: 'uint8_t', doc: 'uint8' },
+	i8:	{ size: 1, c: 'int8_t', doc: 'int8' },
+	u16:	{ size: 2, c: 'uint16_t', doc: 'uint16' },
+	u24:	{ size: 3, c: 'uint32_t', doc: 'uint24' },
+	u32:	{ size: 4, c: 'uint32_t', doc: 'uint32' },
+	i32:	{ size: 4, c: 'int32_t', doc: 'int32' },
+	u64:	{ size: 8, c: 'uint64_t', doc: 'uint64' },
+	addr:	{ size: 6, doc: 'uint8[6]' },
+	utf8:	{ size: undefined, doc: 'utf8 (variable len)' },
+	bytes:	{ size: undefined, doc: 'uint8[n]' },
+};
+
+// Address and type, written from a bt_addr_le_t on the C side
+const ADDR = 'ADDR';
+
+const hex = value => `0x${value.toString(16).padStart(2, '0')}`;
+
+const sizeOf = spec => {
+	if (typeof spec === 'string') {
+		return SCALARS[spec].size;
+	}
+	if (spec.struct) {
+		const sizes = spec.struct.map(([, member]) => sizeOf(member));
+		return sizes.includes(undefined) ? undefined : sizes.reduce((sum, size) => sum + size, 0);
+	}
+
+	return undefined;
+}
+
+const isAddrLe = spec => spec.struct?.length === 2 &&
+	spec.struct[0][0] === 'type' && spec.struct[0][1] === 'u8' &&
+	spec.struct[1][0] === 'addr' && spec.struct[1][1] === 'addr';
+
+const docOf = spec => {
+	if (typeof spec === 'string') {
+		return SCALARS[spec].doc;
+	}
+	if (spec.struct) {
+		return spec.struct.map(([name, member]) => `${docOf(member)} (${name})`).join(' + ');
+	}
+
+	const item = docOf(spec.array);
+	return spec.array.struct ? `(${item})[n]` : `${item}[n]`;
+}
+
+const validateSpec = (spec, where) => {
+	if (typeof spec === 'string') {
+		if (!SCALARS[spec]) {
+			throw new Error(`${where}: unknown value type ${spec}`);
+		}
+		return;
+	}
+	if (spec.struct) {
+		spec.struct.forEach(([name, member], i) => {
+			validateSpec(member, `${where}.${name}`);
+			if (sizeOf(member) === undefined && i !== spec.struct.length - 1) {
+				throw new Error(`${where}.${name}: only the last member may be variable`);
+			}
+			if (typeof member !== 'string') {
+				throw new Error(`${where}.${name}: nested values are not supported`);
+			}
+		});
+		return;
+	}
+	if (spec.array) {
+		validateSpec(spec.array, `${where}[]`);
+		if (sizeOf(spec.array) === undefined) {
+			throw new Error(`${where}: array elements must have a fixed size`);
+		}
+		return;
+	}
+
+	throw new Error(`${where}: invalid value ${JSON.stringify(spec)}`);
+}
+
+const loadSchema = () => {
+	const schema = JSON.parse(readFileSync(SCHEMA, 'utf8'));
+
+	const ltv = schema.ltv.map(entry => ({
+		...entry,
+		type: entry.standard ? Number(entry.type) : 0xff - entry.offset,
+		deviceValue: entry.deviceValue ?? entry.value
+	}));
+	const ltvNames = new Set(ltv.map(entry => entry.name));
+
+	const types = new Set();
+	for (const entry of ltv) {
+		validateSpec(entry.value, entry.name);
+		validateSpec(entry.deviceValue, entry.name);
+		if (types.has(entry.type)) {
+			throw new Error(`${entry.name}: type ${hex(entry.type)} used twice`);
+		}
+		types.add(entry.type);
+	}
+
+	const subTypes = [...schema.commands, ...schema.events].map(entry => ({
+		...entry,
+		value: Number(entry.value),
+		js: entry.js ?? entry.name
+	}));
+	for (const entry of subTypes) {
+		for (const field of [...entry.fields ?? [], ...entry.optional ?? [], ...entry.response ?? []]) {
+			if (field !== ADDR && !ltvNames.has(field)) {
+				throw new Error(`${entry.name}: unknown field ${field}`);
+			}
+		}
+	}
+
+	return {
+		messageTypes: Object.entries(schema.messageTypes),
+		commands: subTypes.filter(entry => entry.value < 0x80),
+		events: subTypes.filter(entry => entry.value >= 0x80),
+		ltv,
+		ltvByName: new Map(ltv.map(entry => [entry.name, entry]))
+	};
+}
+
+/*
+ * C
+ */
+
+const cName = name => name.toLowerCase();
+
+// Parameter list and value writer for one LTV type, undefined if the
+// type is not encoded by the device (arrays)
+const cEncoder = entry => {
+	const spec = entry.deviceValue;
+	const name = cName(entry.name);
+
+	if (spec.array) {
+		return;
+	}
+
+	if (isAddrLe(spec)) {
+		return {
+			params: [`const bt_addr_le_t *${name}`],
+			args: [name],
+			fixed: 2 + 1 + SCALARS.addr.size,
+			write: [
+				`p[2] = ${name}->type;`,
+				`memcpy(&p[3], &${name}->a, sizeof(bt_addr_t));`
+			]
+		};
+	}
+
+	const members = typeof spec === 'string' ? [[name, spec]] : spec.struct;
+	const params = [];
+	const args = [];
+	const write = [];
+	let offset = 2;
+	let length;
+
+	for (const [member, type] of members) {
+		const at = `&p[${offset}]`;
+
+		switch (type) {
+		case 'u8':
+		case 'i8':
+			params.push(`${SCALARS[type].c} ${member}`);
+			write.push(`p[${offset}] = ${type === 'i8' ? `(uint8_t)${member}` : member};`);
+			break;
+		case 'u16':
+			params.push(`uint16_t ${member}`);
+			write.push(`sys_put_le16(${member}, ${at});`);
+			break;
+		case 'u24':
+			params.push(`uint32_t ${member}`);
+			write.push(`sys_put_le24(${member}, ${at});`);
+			break;
+		case 'u32':
+		case 'i32':
+			params.push(`${SCALARS[type].c} ${member}`);
+			write.push(`sys_put_le32(${member}, ${at});`);
+			break;
+		case 'u64':
+			params.push(`uint64_t ${member}`);
+			write.push(`sys_put_le64(${member}, ${at});`);
+			break;
+		case 'addr':
+			params.push(`const bt_addr_t *${member}`);
+			write.push(`memcpy(${at}, ${member}, sizeof(bt_addr_t));`);
+			break;
+		case 'utf8':
+		case 'bytes':
+			length = `${member === name ? '' : `${member}_`}len`;
+			params.push(`const ${type === 'utf8' ? 'char' : 'uint8_t'} *${member}`, `uint8_t ${length}`);
+			write.push(`memcpy(${at}, ${member}, ${length});`);
+			break;
+		}
+		args.push(member);
+		offset += SCALARS[type].size ?? 0;
+	}
+
+	return { params, args, write, fixed: offset, length };
+}
+
+const generateC = schema => {
+	const out = [];
+	const line = (text = '') => out.push(text);
+
+	line(`/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief Protocol definitions and encoders
+ *
+ * Generated by protocol/generate.js from protocol/schema.json, do not edit.
+ *
+ * proto_put_<type>() writes a fixed size LTV entry and returns the position
+ * after it, so several entries can be written into one net_buf_add() of the
+ * summed PROTO_LTV_<TYPE>_SIZE. proto_add_<type>() appends a single entry and
+ * proto_evt_<event>() appends the fixed fields of an event in one go.
+ */
+
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+#include <string.h>
+#include <zephyr/types.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/bluetooth/gap.h>
+#include <zephyr/bluetooth/addr.h>
+
+enum message_type {`);
+	schema.messageTypes.forEach(([name, value]) => line(`\tMESSAGE_TYPE_${name} = ${value},`));
+	line('};');
+	line();
+
+	const subTypeLine = entry => {
+		const fields = [...entry.fields ?? [], ...(entry.optional ?? []).map(field => `[${field}]`)];
+		const response = entry.response ? ` -> ${entry.response.map(field => `[${field}]`).join(', ')}` : '';
+		const comment = fields.length || response ? ` /* ${fields.join(', ')}${response} */`.replace('/*  ->', '/* ->') : '';
+		line(`\tMESSAGE_SUBTYPE_${entry.name.padEnd(23)} = 0x${entry.value.toString(16).toUpperCase().padStart(2, '0')},${comment}`);
+	}
+
+	line('enum message_sub_type {');
+	line('\t/* CMD/RES (bit7 = 0) */');
+	schema.commands.forEach(subTypeLine);
+	line();
+	line('\t/* EVT (bit7 = 1) */');
+	schema.events.forEach(subTypeLine);
+	line('};');
+	line();
+
+	line('/* LTV types created for this app (not standard) */');
+	for (const entry of schema.ltv.filter(entry => !entry.standard)) {
+		line(`#define BT_DATA_${entry.name.padEnd(25)} (BT_DATA_MANUFACTURER_DATA - ${entry.offset})`);
+	}
+	line();
+
+	line(`/* Append an LTV entry with a value of len bytes */
+static inline void proto_add_ltv(struct net_buf *buf, uint8_t type, const void *data, uint8_t len)
+{
+	uint8_t *p = net_buf_add(buf, 2 + len);
+
+	p[0] = 1 + len;
+	p[1] = type;
+	memcpy(&p[2], data, len);
+}`);
+
+	for (const entry of schema.ltv) {
+		const encoder = cEncoder(entry);
+		if (!encoder) {
+			continue;
+		}
+
+		const name = cName(entry.name);
+		const size = `PROTO_LTV_${entry.name}_SIZE`;
+		const comment = entry.comment ? ` (${entry.comment})` : '';
+
+		line();
+		line(`/* ${entry.name}: ${docOf(entry.deviceValue)}${comment} */`);
+
+		if (encoder.length) {
+			line(`static inline void proto_add_${name}(struct net_buf *buf, ${encoder.params.join(', ')})`);
+			line('{');
+			line(`\tuint8_t *p = net_buf_add(buf, ${encoder.fixed} + ${encoder.length});`);
+			line();
+			line(`\tp[0] = ${encoder.fixed - 1} + ${encoder.length};`);
+			line(`\tp[1] = BT_DATA_${entry.name};`);
+			encoder.write.forEach(text => line(`\t${text}`));
+			line('}');
+			continue;
+		}
+
+		line(`#define ${size} ${encoder.fixed}`);
+		line();
+		line(`static inline uint8_t *proto_put_${name}(uint8_t *p, ${encoder.params.join(', ')})`);
+		line('{');
+		line(`\tp[0] = ${size} - 1;`);
+		line(`\tp[1] = BT_DATA_${entry.name};`);
+		encoder.write.forEach(text => line(`\t${text}`));
+		line();
+		line(`\treturn p + ${size};`);
+		line('}');
+		line();
+		line(`static inline void proto_add_${name}(struct net_buf *buf, ${encoder.params.join(', ')})`);
+		line('{');
+		line(`\tproto_put_${name}(net_buf_add(buf, ${size}), ${encoder.args.join(', ')});`);
+		line('}');
+	}
+
+	line(`
+/* ${ADDR}: RPA or IDENTITY, depending on the address */
+#define PROTO_LTV_${ADDR}_SIZE PROTO_LTV_RPA_SIZE
+
+static inline uint8_t *proto_put_addr(uint8_t *p, const bt_addr_le_t *addr)
+{
+	return bt_addr_le_is_identity(addr) ? proto_put_identity(p, addr) : proto_put_rpa(p, addr);
+}
+
+static inline void proto_add_addr(struct net_buf *buf, const bt_addr_le_t *addr)
+{
+	proto_put_addr(net_buf_add(buf, PROTO_LTV_${ADDR}_SIZE), addr);
+}`);
+
+	for (const event of schema.events.filter(event => event.fields)) {
+		const name = cName(event.name);
+		const size = `PROTO_EVT_${event.name}_SIZE`;
+		const fields = event.fields.map(field => field === ADDR ?
+			{ name: ADDR, size: `PROTO_LTV_${ADDR}_SIZE`, params: ['const bt_addr_le_t *addr'], args: ['addr'] } :
+			{ name: field, size: `PROTO_LTV_${field}_SIZE`, ...cEncoder(schema.ltvByName.get(field)) });
+
+		line();
+		line(`/* ${event.name}: ${event.fields.join(', ')}${event.optional ? ' (optional fields are added after these)' : ''} */`);
+		line(`#define ${size} (${fields.map(field => field.size).join(' + ')})`);
+		line();
+		line(`static inline void proto_evt_${name}(struct net_buf *buf, ${fields.flatMap(field => field.params).join(', ')})`);
+		line('{');
+		line(`\tuint8_t *p = net_buf_add(buf, ${size});`);
+		line();
+		fields.forEach((field, i) => {
+			const call = `proto_put_${cName(field.name)}(p, ${field.args.join(', ')});`;
+			line(`\t${i < fields.length - 1 ? `p = ${call}` : call}`);
+		});
+		line('}');
+	}
+
+	line();
+	line('#endif /* __PROTOCOL_H__ */');
+
+	return out.join('\n') + '\n';
+}
+
+/*
+ * JS
+ */
+
+const jsRead = (type, at) => {
+	switch (type) {
+	case 'u8':
+		return `${at(0)}`;
+	case 'i8':
+		return `${at(0)} << 24 >> 24`;
+	case 'u16':
+		return `(${at(0)} | ${at(1)} << 8)`;
+	case 'u24':
+		return `(${at(0)} | ${at(1)} << 8 | ${at(2)} << 16)`;
+	case 'u32':
+		return `(${at(0)} | ${at(1)} << 8 | ${at(2)} << 16 | ${at(3)} << 24) >>> 0`;
+	case 'i32':
+		return `(${at(0)} | ${at(1)} << 8 | ${at(2)} << 16 | ${at(3)} << 24)`;
+	case 'u64':
+		// Exact up to 2^53
+		return `((${at(0)} | ${at(1)} << 8 | ${at(2)} << 16 | ${at(3)} << 24) >>> 0) + ` +
+			`((${at(4)} | ${at(5)} << 8 | ${at(6)} << 16 | ${at(7)} << 24) >>> 0) * 0x100000000`;
+	case 'addr':
+		return `value.slice(${at.offset(0)}, ${at.offset(6)})`;
+	case 'utf8':
+		return at.offset(0) === '0' ? 'utf8decoder.decode(value)' : `utf8decoder.decode(value.subarray(${at.offset(0)}))`;
+	case 'bytes':
+		return at.offset(0) === '0' ? 'value.slice()' : `value.slice(${at.offset(0)})`;
+	}
+}
+
+// Writer calls for one value, see writeLtvValue
+const jsWrite = (type, source) => {
+	switch (type) {
+	case 'u8':
+	case 'i8':
+		return [`w.u8(${source});`];
+	case 'u16':
+		return [`w.u8(${source});`, `w.u8(${source} >> 8);`];
+	case 'u24':
+		return [`w.u8(${source});`, `w.u8(${source} >> 8);`, `w.u8(${source} >> 16);`];
+	case 'u32':
+	case 'i32':
+		return [`w.u8(${source});`, `w.u8(${source} >> 8);`, `w.u8(${source} >> 16);`, `w.u8(${source} >> 24);`];
+	case 'u64':
+		// The writer keeps the low byte of the (truncated) 32 bit value
+		return [
+			`w.u8(${source});`, `w.u8(${source} >> 8);`, `w.u8(${source} >> 16);`, `w.u8(${source} >> 24);`,
+			`w.u8(${source} / 0x100000000);`, `w.u8(${source} / 0x100000000 >> 8);`,
+			`w.u8(${source} / 0x100000000 >> 16);`, `w.u8(${source} / 0x100000000 >> 24);`
+		];
+	case 'addr':
+		return [`w.bytes(${source}, 6);`];
+	case 'bytes':
+		return [`w.bytes(${source}, ${source}.length);`];
+	case 'utf8':
+		return [`writeUtf8(w, ${source});`];
+	}
+}
+
+// Element accessors at a fixed (number) or variable (string) base offset
+const accessor = (array, base) => {
+	const offset = k => typeof base === 'number' ? `${base + k}` : k ? `${base} + ${k}` : base;
+	const at = k => `${array}[${offset(k)}]`;
+	at.offset = offset;
+
+	return at;
+}
+
+const jsDecodeValue = (spec, base) => {
+	if (typeof spec === 'string') {
+		return jsRead(spec, accessor('value', base));
+	}
+
+	let offset = 0;
+	const members = spec.struct.map(([name, member]) => {
+		const read = jsRead(member, accessor('value', typeof base === 'number' ? base + offset : offset ? `${base} + ${offset}` : base));
+		offset += SCALARS[member].size ?? 0;
+		return `${name}: ${read}`;
+	});
+
+	return `{ ${members.join(', ')} }`;
+}
+
+const jsDecoder = spec => {
+	const size = sizeOf(spec);
+
+	if (spec.array) {
+		const itemSize = sizeOf(spec.array);
+		return [
+			`if (value.length % ${itemSize} !== 0) {`,
+			'\treturn;',
+			'}',
+			'const items = [];',
+			`for (let i = 0; i < value.length; i += ${itemSize}) {`,
+			`\titems.push(${jsDecodeValue(spec.array, 'i')});`,
+			'}',
+			'return items;'
+		];
+	}
+
+	if (size === undefined) {
+		const fixed = typeof spec === 'string' ? 0 : sizeOf({ struct: spec.struct.slice(0, -1) });
+		return [
+			...fixed ? [`if (value.length < ${fixed}) {`, '\treturn;', '}'] : [],
+			`return ${jsDecodeValue(spec, 0)};`
+		];
+	}
+
+	return [
+		`if (value.length !== ${size}) {`,
+		'\treturn;',
+		'}',
+		`return ${jsDecodeValue(spec, 0)};`
+	];
+}
+
+const jsLength = spec => {
+	if (spec.array) {
+		return [`return value.length * ${sizeOf(spec.array)};`];
+	}
+
+	const members = typeof spec === 'string' ? [['', spec]] : spec.struct;
+	const [name, last] = members[members.length - 1];
+	const fixed = sizeOf({ struct: members.slice(0, -1) }) ?? 0;
+	const source = name ? `value.${name}` : 'value';
+
+	switch (last) {
+	case 'utf8':
+		return [`return ${fixed ? `${fixed} + ` : ''}utf8Length(${source});`];
+	case 'bytes':
+		return [`return ${fixed ? `${fixed} + ` : ''}${source}.length;`];
+	default:
+		return [`return ${sizeOf(spec)};`];
+	}
+}
+
+const jsWriter = spec => {
+	if (spec.array) {
+		const members = typeof spec.array === 'string' ? [['', spec.array]] : spec.array.struct;
+		return [
+			`for (let i = 0; i < value.length; i++) {`,
+			`\tconst item = value[i];`,
+			...members.flatMap(([name, member]) => jsWrite(member, name ? `item.${name}` : 'item')).map(text => `\t${text}`),
+			'}',
+			'return;'
+		];
+	}
+
+	const members = typeof spec === 'string' ? [['', spec]] : spec.struct;
+	return [
+		...members.flatMap(([name, member]) => jsWrite(member, name ? `value.${name}` : 'value')),
+		'return;'
+	];
+}
+
+// Group types with identical code into one case list
+const jsSwitch = (ltv, codeOf) => {
+	const groups = new Map();
+	for (const entry of ltv) {
+		const lines = codeOf(entry);
+		const key = lines.join('\n');
+		if (!groups.has(key)) {
+			groups.set(key, { names: [], lines });
+		}
+		groups.get(key).names.push(entry.name);
+	}
+
+	const out = [];
+	for (const { names, lines } of groups.values()) {
+		names.forEach(name => out.push(`\tcase BT_DataType.BT_DATA_${name}:`));
+		out.push('\t{');
+		lines.forEach(text => out.push(`\t\t${text}`));
+		out.push('\t}');
+	}
+
+	return out;
+}
+
+const generateJs = schema => {
+	const out = [];
+	const line = (text = '') => out.push(text);
+
+	const ltvComment = entry => `// ${docOf(entry.value)}${entry.comment ? ` (${entry.comment})` : ''}`;
+
+	line(`// @ts-check
+
+/**
+* Protocol definitions, LTV value decoder and encoder
+*
+* Generated by protocol/generate.js from protocol/schema.json, do not edit.
+*/
+
+const utf8decoder = new TextDecoder();
+
+export const MessageType = Object.freeze({`);
+	schema.messageTypes.forEach(([name, value], i) =>
+		line(`\t${name}: ${hex(value)}${i < schema.messageTypes.length - 1 ? ',' : ''}`));
+	line('});');
+	line();
+
+	const subTypeLine = entry => line(`\t${`${entry.js}:`.padEnd(27)}${hex(entry.value).toUpperCase().replace('0X', '0x')},`);
+
+	line('export const MessageSubType = Object.freeze({');
+	line('\t// CMD/RES (MSB = 0)');
+	schema.commands.forEach(subTypeLine);
+	line();
+	line('\t// EVT (MSB = 1)');
+	schema.events.forEach(subTypeLine);
+	line('});');
+	line();
+
+	line('export const BT_DataType = Object.freeze({');
+	for (const entry of schema.ltv.filter(entry => entry.standard)) {
+		line(`\t${`BT_DATA_${entry.name}:`.padEnd(35)}${hex(entry.type)},\t${ltvComment(entry)}`);
+	}
+	line();
+	line('\t// The following types are created for this app (not standard)');
+	for (const entry of schema.ltv.filter(entry => !entry.standard).reverse()) {
+		line(`\t${`BT_DATA_${entry.name}:`.padEnd(35)}${hex(entry.type)},\t${ltvComment(entry)}`);
+	}
+	line('});');
+	line();
+
+	line(`// Value of types without a decoder
+export const UNHANDLED = 'UNHANDLED';
+
+/**
+* decodeLtvValue
+*
+* @param {number} type		LTV type (BT_DataType)
+* @param {Uint8Array} value	LTV value (without length and type)
+* @returns {any}		Decoded value, UNHANDLED for unknown types or
+*				undefined if the length is not valid for the type
+*/
+export const decodeLtvValue = (type, value) => {
+	switch (type) {`);
+	out.push(...jsSwitch(schema.ltv, entry => {
+		if (entry.deviceValue === entry.value) {
+			return jsDecoder(entry.value);
+		}
+
+		// Accept both encodings, fixed sizes only
+		return [
+			`if (value.length === ${sizeOf(entry.value)}) {`,
+			`\treturn ${jsDecodeValue(entry.value, 0)};`,
+			'}',
+			`if (value.length === ${sizeOf(entry.deviceValue)}) {`,
+			`\treturn ${jsDecodeValue(entry.deviceValue, 0)};`,
+			'}',
+			'return;'
+		];
+	}));
+	line(`\tdefault:
+		return UNHANDLED;
+	}
+}
+
+// UTF-8 length of a string, as encoded by TextEncoder (lone surrogates
+// become U+FFFD)
+export const utf8Length = str => {
+	let length = 0;
+
+	for (let i = 0; i < str.length; i++) {
+		const c = str.charCodeAt(i);
+		if (c < 0x80) {
+			length += 1;
+		} else if (c < 0x800) {
+			length += 2;
+		} else if (c >= 0xd800 && c < 0xdc00 && (str.charCodeAt(i + 1) & 0xfc00) === 0xdc00) {
+			length += 4;
+			i++;
+		} else {
+			length += 3;
+		}
+	}
+
+	return length;
+}
+
+export const writeUtf8 = (w, str) => {
+	for (let i = 0; i < str.length; i++) {
+		let c = str.charCodeAt(i);
+		if (c < 0x80) {
+			w.u8(c);
+		} else if (c < 0x800) {
+			w.u8(0xc0 | c >> 6);
+			w.u8(0x80 | c & 0x3f);
+		} else if (c >= 0xd800 && c < 0xdc00 && (str.charCodeAt(i + 1) & 0xfc00) === 0xdc00) {
+			c = 0x10000 + ((c & 0x3ff) << 10) + (str.charCodeAt(++i) & 0x3ff);
+			w.u8(0xf0 | c >> 18);
+			w.u8(0x80 | c >> 12 & 0x3f);
+			w.u8(0x80 | c >> 6 & 0x3f);
+			w.u8(0x80 | c & 0x3f);
+		} else {
+			if (c >= 0xd800 && c < 0xe000) {
+				c = 0xfffd;
+			}
+			w.u8(0xe0 | c >> 12);
+			w.u8(0x80 | c >> 6 & 0x3f);
+			w.u8(0x80 | c & 0x3f);
+		}
+	}
+}
+
+/**
+* ltvValueLength
+*
+* @param {number} type		LTV type (BT_DataType)
+* @param {any} value		Value in the form returned by decodeLtvValue
+* @returns {number}		Encoded length of the value, -1 for unknown types
+*/
+export const ltvValueLength = (type, value) => {
+	switch (type) {`);
+	out.push(...jsSwitch(schema.ltv, entry => jsLength(entry.value)));
+	line(`\tdefault:
+		return -1;
+	}
+}
+
+/**
+* writeLtvValue
+*
+* Writes the value (ltvValueLength bytes) through a writer with
+* u8(byte) and bytes(data, length) methods, so values can be written
+* straight into their destination (e.g. a COBS frame) without copies.
+*
+* @param {number} type		LTV type (BT_DataType)
+* @param {any} value		Value in the form returned by decodeLtvValue
+* @param {{ u8: (byte: number) => void, bytes: (data: ArrayLike<number>, length: number) => void }} w
+*/
+export const writeLtvValue = (type, value, w) => {
+	switch (type) {`);
+	out.push(...jsSwitch(schema.ltv, entry => jsWriter(entry.value)));
+	line(`\tdefault:
+		return;
+	}
+}`);
+
+	return out.join('\n') + '\n';
+}
+
+const schema = loadSchema();
+const outputs = [[C_OUT, generateC(schema)], [JS_OUT, generateJs(schema)]];
+
+if (process.argv.includes('--check')) {
+	let stale = false;
+	for (const [file, content] of outputs) {
+		let current;
+		try {
+			current = readFileSync(file, 'utf8');
+		} catch {
+			current = undefined;
+		}
+		if (current !== content) {
+			console.error(`${relative(ROOT, file)} is not up to date, run: node protocol/generate.js`);
+			stale = true;
+		}
+	}
+	process.exit(stale ? 1 : 0);
+}
+
+for (const [file, content] of outputs) {
+	writeFileSync(file, content);
+	console.log(`Wrote ${relative(ROOT, file)}`);
+}
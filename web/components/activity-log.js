@@ -0,0 +1,151 @@
+// @ts-check
+
+import { downloadData, fileTimestamp } from '../lib/helpers.js';
+import { Metrics } from '../lib/metrics.js';
+
+/**
+* Activity Log Component
+*
+* Shows an ActivityLog, newest entry first. Only the visible rows exist as
+* elements and they are only formatted when shown. Updates are rendered once
+* per animation frame.
+*
+* The host element is the scroll container, size it from the outside.
+*/
+
+const template = document.createElement('template');
+template.innerHTML = `
+<style>
+:host {
+	display: block;
+	position: relative;
+	overflow-y: auto;
+}
+
+#content {
+	position: relative;
+}
+
+.row {
+	position: absolute;
+	left: 0;
+	right: 0;
+	top: 0;
+	height: 16px;
+	line-height: 16px;
+	white-space: nowrap;
+	overflow: hidden;
+	text-overflow: ellipsis;
+}
+
+#export {
+	position: sticky;
+	float: right;
+	top: 0;
+	z-index: 1;
+	font: inherit;
+	cursor: pointer;
+}
+</style>
+<button id="export" title="Export as binary capture">Export</button>
+<div id="content"></div>
+`;
+
+// Must match the .row height
+const ROW_HEIGHT = 16;
+
+const OVERSCAN_ROWS = 4;
+
+export class ActivityLogView extends HTMLElement {
+	#log
+	#content
+	#rows
+	#frame
+
+	constructor() {
+		super();
+
+		const shadowRoot = this.attachShadow({mode: 'open'});
+		shadowRoot.appendChild(template.content.cloneNode(true));
+
+		this.#content = shadowRoot.querySelector('#content');
+		this.#rows = [];
+
+		this.addEventListener('scroll', () => this.changed(), { passive: true });
+		// The log is expanded on hover/click
+		new ResizeObserver(() => this.changed()).observe(this);
+
+		shadowRoot.querySelector('#export')?.addEventListener('click', evt => {
+			// Don't let the click expand/collapse the log
+			evt.stopPropagation();
+			this.#export();
+		});
+	}
+
+	/**
+	* @param {import('../lib/activity-log.js').ActivityLog} log
+	*/
+	set log(log) {
+		this.#log = log;
+		this.changed();
+	}
+
+	get log() {
+		return this.#log;
+	}
+
+	/**
+	* Call when entries were added, renders on the next frame
+	*/
+	changed() {
+		this.#frame ??= requestAnimationFrame(() => this.#render());
+	}
+
+	#export() {
+		if (!this.#log) {
+			return;
+		}
+
+		downloadData(this.#log.toCapture(), `activity-${fileTimestamp()}.wbac`);
+	}
+
+	#render() {
+		const start = Metrics.enabled ? performance.now() : 0;
+		this.#frame = undefined;
+
+		const length = this.#log?.length ?? 0;
+		const { scrollTop, clientHeight } = this;
+
+		this.#content.style.height = `${length * ROW_HEIGHT}px`;
+
+		const first = Math.max(0, Math.floor(scrollTop / ROW_HEIGHT) - OVERSCAN_ROWS);
+		const last = Math.min(length, Math.ceil((scrollTop + clientHeight) / ROW_HEIGHT) + OVERSCAN_ROWS);
+
+		while (this.#rows.length < last - first) {
+			const row = document.createElement('div');
+			row.className = 'row';
+			this.#content.appendChild(row);
+			this.#rows.push(row);
+		}
+
+		this.#rows.forEach((row, i) => {
+			const r = first + i;
+			row.hidden = r >= last;
+			if (row.hidden) {
+				return;
+			}
+
+			// Row 0 is the newest entry
+			const text = this.#log.format(length - 1 - r);
+			if (row.textContent !== text) {
+				row.textContent = text;
+			}
+			row.style.transform = `translateY(${r * ROW_HEIGHT}px)`;
+		});
+
+		if (Metrics.enabled) {
+			Metrics.add('render', performance.now() - start);
+		}
+	}
+}
+customElements.define('activity-log', ActivityLogView);
@@ -0,0 +1,115 @@
+// @ts-check
+
+/**
+* Dongle Status Component
+*
+* Lists the connected assistant dongles with their load, updated once per
+* second: connected (and connecting) sinks against the capacity, scan
+* reports received and forwarded (the rest were heard better by another
+* dongle) and commands sent.
+*
+* The add button selects another dongle (service.scan()).
+*
+* Set the service property to a service with getDongleStats() (see
+* MultiDeviceService).
+*/
+
+const template = document.createElement('template');
+template.innerHTML = `
+<style>
+:host {
+	display: block;
+	font-family: monospace;
+	font-size: smaller;
+}
+
+.row {
+	display: flex;
+	flex-direction: row;
+	gap: 10px;
+	align-items: center;
+}
+
+pre {
+	margin: 0;
+}
+
+button {
+	margin-left: auto;
+	border: 1px solid darkgray;
+	border-radius: 5px;
+	background: transparent;
+	font: inherit;
+	cursor: pointer;
+}
+</style>
+<div class="row">
+	<pre id="text"></pre>
+	<button id="add">Add dongle</button>
+</div>
+`;
+
+const UPDATE_MS = 1000;
+
+const rate = (count, previous, dt) => previous === undefined ? '-' : ((count - previous) / dt).toFixed(0);
+
+export class DongleStatus extends HTMLElement {
+	#text
+	#service
+	#timer
+	#previous
+	#lastUpdate
+
+	constructor() {
+		super();
+
+		const shadowRoot = this.attachShadow({mode: 'open'});
+		shadowRoot.appendChild(template.content.cloneNode(true));
+
+		this.#text = shadowRoot.querySelector('#text');
+		this.#previous = new Map();
+
+		shadowRoot.querySelector('#add')?.addEventListener('click', () => this.#service?.scan());
+
+		this.update = this.update.bind(this);
+	}
+
+	set service(service) {
+		this.#service?.removeEventListener('dongles-changed', this.update);
+		this.#service = service;
+		this.#service.addEventListener('dongles-changed', this.update);
+		this.update();
+	}
+
+	connectedCallback() {
+		this.#lastUpdate = performance.now();
+		this.#timer = setInterval(this.update, UPDATE_MS);
+	}
+
+	disconnectedCallback() {
+		clearInterval(this.#timer);
+	}
+
+	update() {
+		const now = performance.now();
+		const dt = (now - this.#lastUpdate) / 1000;
+		this.#lastUpdate = now;
+
+		const dongles = this.#service?.getDongleStats() ?? [];
+
+		const lines = dongles.map(stats => {
+			const previous = this.#previous.get(stats.id);
+			const name = stats.device?.serialNumber ?? stats.id ?? '-';
+
+			return `${name.padEnd(16)} sinks ${stats.sinks}/${stats.capacity}` +
+				`${stats.connecting ? ` (+${stats.connecting})` : ''}` +
+				`  reports ${rate(stats.reports, previous?.reports, dt)}/s` +
+				` (${rate(stats.forwarded, previous?.forwarded, dt)}/s used)` +
+				`  commands ${stats.commands}`;
+		});
+
+		this.#previous = new Map(dongles.map(stats => [stats.id, stats]));
+		this.#text.textContent = lines.length ? lines.join('\n') : 'No dongles';
+	}
+}
+customElements.define('dongle-status', DongleStatus);
@@ -0,0 +1,249 @@
+// @ts-check
+
+import * as AssistantModel from '../models/assistant-model.js';
+
+import { Metrics } from '../lib/metrics.js';
+import { RTT_BUCKETS } from '../lib/command-manager.js';
+import { MessageSubType } from '../lib/message.js';
+
+/**
+* Performance Overlay Component
+*
+* Shows the pipeline metrics (see metrics.js) once per second: USB
+* throughput, decode, model and render times, coalesced, merged (scan
+* reports heard by several dongles) and dropped updates, lost events (gaps
+* in the event numbering) and command round trip times. Metrics are only collected while the overlay is connected.
+*
+* The device side scan filter counters are polled (GET_SCAN_FILTER_STATS)
+* and shown next to the host numbers, held are reports of known devices the
+* RSSI aggregation did not send.
+*
+* While connected, the model synchronizes with the device clock
+* (startTimeSync()), the clock offset and drift per device are shown with the
+* latency of the events from their device timestamp to the model.
+*
+* Set the service property to the device service in use.
+*/
+
+const template = document.createElement('template');
+template.innerHTML = `
+<style>
+:host {
+	position: fixed;
+	top: 10px;
+	right: 10px;
+	z-index: 900;
+
+	padding: 0.5em 0.8em;
+	border: 1px solid darkgray;
+	background: rgba(255, 255, 255, 0.9);
+	box-shadow: 3px 3px 6px 3px lightgray;
+
+	font-family: monospace;
+	font-size: smaller;
+	pointer-events: none;
+}
+
+pre {
+	margin: 0;
+}
+</style>
+<pre id="text"></pre>
+`;
+
+const UPDATE_MS = 1000;
+const DEVICE_POLL_MS = 2000;
+
+const HISTOGRAM_WIDTH = 20;
+
+const subTypeName = subType => Object.entries(MessageSubType).find(([, value]) => value === subType)?.[0] ??
+	`0x${subType.toString(16)}`;
+
+const fmt = (value, digits = 0) => value === undefined || Number.isNaN(value) ? '-' : value.toFixed(digits);
+
+export class PerfOverlay extends HTMLElement {
+	#text
+	#service
+	#model
+	#timer
+	#pollTimer
+	#frame
+	#frames
+	#lastUpdate
+	#dropped
+	#lost
+	#device
+
+	constructor() {
+		super();
+
+		const shadowRoot = this.attachShadow({mode: 'open'});
+		shadowRoot.appendChild(template.content.cloneNode(true));
+
+		this.#text = shadowRoot.querySelector('#text');
+		this.#dropped = 0;
+		this.#lost = 0;
+
+		this.scanFilterStats = this.scanFilterStats.bind(this);
+	}
+
+	set service(service) {
+		this.#service = service;
+		this.#service.enableMetrics(this.isConnected);
+	}
+
+	connectedCallback() {
+		this.#model = AssistantModel.getInstance();
+		this.#model.addEventListener('scan-filter-stats', this.scanFilterStats);
+
+		Metrics.enabled = true;
+		Metrics.take();
+		this.#service?.enableMetrics(true);
+
+		this.#frames = 0;
+		this.#lastUpdate = performance.now();
+
+		const countFrame = () => {
+			this.#frames++;
+			this.#frame = requestAnimationFrame(countFrame);
+		}
+		this.#frame = requestAnimationFrame(countFrame);
+
+		this.#timer = setInterval(() => this.#update(), UPDATE_MS);
+		this.#pollTimer = setInterval(() => this.#pollDevice(), DEVICE_POLL_MS);
+
+		this.#model.startTimeSync();
+	}
+
+	disconnectedCallback() {
+		this.#model?.removeEventListener('scan-filter-stats', this.scanFilterStats);
+		this.#model?.stopTimeSync();
+
+		Metrics.enabled = false;
+		this.#service?.enableMetrics(false);
+
+		cancelAnimationFrame(this.#frame);
+		clearInterval(this.#timer);
+		clearInterval(this.#pollTimer);
+	}
+
+	#pollDevice() {
+		if (!this.#model.serviceIsConnected) {
+			return;
+		}
+
+		// Failures are logged by the model
+		this.#model.getScanFilterStats().catch(() => {});
+	}
+
+	scanFilterStats(evt) {
+		const { stats } = evt.detail;
+		const now = performance.now();
+
+		const rejected = Object.values(stats.rejected).reduce((sum, count) => sum + count, 0);
+		const previous = this.#device;
+
+		this.#device = { time: now, accepted: stats.accepted, held: stats.held, rejected };
+
+		// Counters restart when the filters (held: the RSSI report) are set
+		if (previous && stats.accepted >= previous.accepted && rejected >= previous.rejected) {
+			const dt = (now - previous.time) / 1000;
+			const heldRate = stats.held >= previous.held ? (stats.held - previous.held) / dt : 0;
+			this.#device.heldRate = heldRate;
+			this.#device.sentRate = Math.max(0, (stats.accepted - previous.accepted) / dt - heldRate);
+			this.#device.rejectedRate = (rejected - previous.rejected) / dt;
+		}
+	}
+
+	#update() {
+		const now = performance.now();
+		const dt = (now - this.#lastUpdate) / 1000;
+		this.#lastUpdate = now;
+
+		const frames = this.#frames;
+		this.#frames = 0;
+
+		const metrics = Metrics.take();
+		const total = name => metrics.get(name)?.total ?? 0;
+		const rate = name => total(name) / dt;
+		const avg = name => {
+			const metric = metrics.get(name);
+			return metric?.count ? metric.total / metric.count : undefined;
+		}
+		const max = name => metrics.get(name)?.max;
+
+		this.#dropped += total('dropped');
+		this.#lost += total('events.lost');
+
+		const device = this.#device;
+
+		const lines = [
+			`USB       ${fmt(rate('usb.frames'))} frames/s  ${fmt(rate('usb.bytes') / 1024, 1)} KiB/s`,
+			`device    ${fmt(device?.sentRate)} reports/s sent  ${fmt(device?.rejectedRate)} filtered/s  ${fmt(device?.heldRate)} held/s`,
+			`decode    ${fmt(avg('decode') * 1000, 1)} µs/frame (max ${fmt(max('decode') * 1000, 1)})`,
+			`model     ${fmt(avg('model') * 1000, 1)} µs/msg (max ${fmt(max('model') * 1000, 1)})`,
+			`render    ${fmt(frames ? total('render') / frames : undefined, 2)} ms/frame (max ${fmt(max('render'), 2)})  ${fmt(frames / dt)} fps`,
+			`coalesced ${fmt(rate('coalesced'))}/s transport  ${fmt(rate('list.coalesced'))}/s lists  ${fmt(rate('merged'))}/s dongles`,
+			`dropped   ${this.#dropped} frames  ${this.#lost} events lost`,
+			`latency   ${fmt(avg('latency'), 1)} ms/event device to model (max ${fmt(max('latency'), 1)})`,
+			...this.#clockLines(),
+			...this.#commandLines(),
+			...this.#latencyLines()
+		];
+
+		this.#text.textContent = lines.join('\n');
+	}
+
+	#clockLines() {
+		const lines = [];
+
+		for (const [dongle, timeSync] of this.#model.getTimeSyncs()) {
+			if (timeSync.synced) {
+				lines.push(`clock${dongle ? ` ${dongle}` : ''}  offset ${fmt(timeSync.offset, 1)} ms  drift ${fmt(timeSync.drift, 1)} ppm  rtt ${fmt(timeSync.rtt, 1)} ms`);
+			}
+		}
+
+		return lines;
+	}
+
+	#latencyLines() {
+		const stats = this.#model.getEventLatencyStats();
+		if (!stats.size) {
+			return [];
+		}
+
+		const lines = ['', 'event                n   p50   p95  (ms)'];
+
+		for (const [subType, s] of stats) {
+			lines.push(`${subTypeName(subType).padEnd(18)} ${String(s.count).padStart(3)} ${fmt(s.p50, 1).padStart(5)} ${fmt(s.p95, 1).padStart(5)}`);
+		}
+
+		return lines;
+	}
+
+	#commandLines() {
+		const stats = this.#service?.getCommandStats();
+		if (!stats?.size) {
+			return [];
+		}
+
+		const lines = ['', 'command              n   p50   p95  t/o  (ms)'];
+		const histogram = new Array(RTT_BUCKETS.length + 1).fill(0);
+
+		for (const [subType, s] of stats) {
+			lines.push(`${subTypeName(subType).padEnd(18)} ${String(s.count).padStart(3)} ${fmt(s.p50, 1).padStart(5)} ${fmt(s.p95, 1).padStart(5)} ${String(s.timeouts).padStart(4)}`);
+			s.histogram.forEach((count, i) => { histogram[i] += count; });
+		}
+
+		const peak = Math.max(...histogram);
+		lines.push('', 'RTT (ms, last samples)');
+		histogram.forEach((count, i) => {
+			const label = i < RTT_BUCKETS.length ? `<= ${RTT_BUCKETS[i]}` : `> ${RTT_BUCKETS[RTT_BUCKETS.length - 1]}`;
+			const bar = '#'.repeat(peak ? Math.round(count / peak * HISTOGRAM_WIDTH) : 0);
+			lines.push(`${label.padStart(7)} ${bar} ${count || ''}`);
+		});
+
+		return lines;
+	}
+}
+customElements.define('perf-overlay', PerfOverlay);
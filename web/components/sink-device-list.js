@@ -3,6 +3,8 @@
 import * as AssistantModel from '../models/assistant-model.js';
 
 import { SinkItem } from './sink-item.js';
+import { VirtualList } from '../lib/virtual-list.js';
+import { bufToAddressString } from '../lib/message.js';
 
 /*
 * Sink Device List Component
@@ -23,8 +25,7 @@ template.innerHTML = `
 }
 
 #list {
-	display: flex;
-	flex-direction: column;
+	max-height: 70vh;
 }
 
 input {
@@ -43,8 +44,17 @@ input {
 </div>
 `;
 
+// Height of a sink-item, including margins
+const ROW_HEIGHT = 84;
+
+const matchesSink = (sink, token) => {
+	return (sink.addr && bufToAddressString(sink.addr.value.addr).toLowerCase().includes(token)) ||
+		sink.name?.toLowerCase().includes(token);
+}
+
 export class SinkDeviceList extends HTMLElement {
 	#list
+	#virtualList
 	#model
 	#filterTokens
 
@@ -69,6 +79,15 @@ export class SinkDeviceList extends HTMLElement {
 		this.shadowRoot?.appendChild(template.content.cloneNode(true));
 		// Add listeners, etc.
 		this.#list = this.shadowRoot?.querySelector('#list');
+		this.#virtualList = new VirtualList(this.#list, {
+			rowHeight: ROW_HEIGHT,
+			createItem: () => {
+				const el = new SinkItem();
+				el.addEventListener('click', this.sinkClicked);
+				return el;
+			},
+			matches: matchesSink
+		});
 		this.shadowRoot?.querySelector('#filter')?.addEventListener('input', evt => { this.setFilter(evt?.target.value) } );
 
 		this.#model = AssistantModel.getInstance();
@@ -76,7 +95,7 @@ export class SinkDeviceList extends HTMLElement {
 		this.#model.addEventListener('sink-found', this.sinkFound)
 		this.#model.addEventListener('sink-updated', this.sinkUpdated)
 		this.#model.addEventListener('sink-disconnected', this.sinkDisconnected)
-		this.#model.addEventListener('reset', () => { this.#list.replaceChildren()})
+		this.#model.addEventListener('reset', () => { this.#virtualList.clear() });
 	}
 
 	disconnectedCallback() {
@@ -116,38 +135,12 @@ export class SinkDeviceList extends HTMLElement {
 	}
 
 	applyFilter() {
-		const elements = Array.from(this.#list.querySelectorAll('sink-item'));
-
-		if (this.#filterTokens.length === 0) {
-			// Remove 'hidden' class from all items
-			elements.forEach( i => { i.classList.remove('hidden') } );
-			return;
-		}
-
-		let found = elements;
-
-		for (const t of this.#filterTokens) {
-			found = found.filter(i => i.getModel().addr?.value.toLowerCase().includes(t) ||
-				i.getModel().name?.toLowerCase().includes(t));
-		}
-
-		elements.forEach( i => {
-			if (found.includes(i)) {
-				i.classList.remove('hidden');
-			} else {
-				i.classList.add('hidden');
-			}
-		});
+		this.#virtualList.setFilter(this.#filterTokens);
 	}
 
 	// TODO: This is not called for now but can be used if we want to sort by RSSI
 	orderByRssi() {
-		const elements = this.#list.querySelectorAll('sink-item');
-
-		let order = 0;
-		[...elements]
-			.sort((a, b) => b.getModel().rssi - a.getModel().rssi)
-			.forEach(node => { node.style.order=order++ });
+		this.#virtualList.sort((a, b) => b.rssi - a.rssi);
 	}
 
 	sinkFound(evt) {
@@ -158,15 +151,9 @@ export class SinkDeviceList extends HTMLElement {
 		// not be a big issue.
 		const { sink } = evt.detail;
 
-		const el = new SinkItem();
-		this.#list.appendChild(el);
-		el.setModel(sink);
-
-		if (this.#filterTokens.length !== 0) this.applyFilter();
+		this.#virtualList.add(sink);
 
 		// this.orderByRssi();
-
-		el.addEventListener('click', this.sinkClicked);
 	}
 
 	sinkDisconnected(evt) {
@@ -174,24 +161,15 @@ export class SinkDeviceList extends HTMLElement {
 		// Just remove from the list
 		const { sink } = evt.detail;
 
-		const elements = Array.from(this.#list.querySelectorAll('sink-item'));
-
-		elements.find(e => e.getModel() === sink)?.remove();
+		this.#virtualList.remove(sink);
 	}
 
 	sinkUpdated(evt) {
 		const { sink } = evt.detail;
 
-		const items = Array.from(this.#list.querySelectorAll('sink-item'));
-
-		const el = items.find(i => i.getModel() === sink);
-
-		if (el) {
-			el.refresh();
-			// this.orderByRssi();
-		} else {
-			console.warn('sink not found!', sink);
-		}
+		// Applied on the next frame, only if the sink is in view
+		this.#virtualList.update(sink);
+		// this.orderByRssi();
 	}
 }
 customElements.define('sink-device-list', SinkDeviceList);
@@ -81,6 +81,10 @@ div {
 	box-shadow: 3px 3px 6px 3px gray;
 }
 
+
+#card[stale] {
+	opacity: 0.5;
+}
 </style>
 <div id="card">
 <span id="name"></span>
@@ -144,6 +148,8 @@ export class SinkItem extends HTMLElement {
 		// this.#uuid16sEl.textContent = `UUID16s: [${this.#sink.uuid16s?.map(a => {return '0x'+a.toString(16)})} ]`;
 
 		this.#cardEl.setAttribute('state', this.#sink.state);
+		// Known from an earlier session, not seen yet
+		this.#cardEl.toggleAttribute('stale', Boolean(this.#sink.stale));
 
 		const source = this.#sink.source_added;
 
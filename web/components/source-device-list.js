@@ -3,6 +3,8 @@
 import * as AssistantModel from '../models/assistant-model.js';
 
 import { SourceItem } from './source-item.js';
+import { VirtualList } from '../lib/virtual-list.js';
+import { bufToAddressString } from '../lib/message.js';
 
 /**
 Source Device List Component
@@ -23,8 +25,7 @@ template.innerHTML = `
 }
 
 #list {
-	display: flex;
-	flex-direction: column;
+	max-height: 70vh;
 }
 
 input {
@@ -43,8 +44,18 @@ input {
 </div>
 `;
 
+// Height of a source-item, including margins
+const ROW_HEIGHT = 84;
+
+const matchesSource = (source, token) => {
+	return (source.addr && bufToAddressString(source.addr.value.addr).toLowerCase().includes(token)) ||
+		source.name?.toLowerCase().includes(token) ||
+		source.broadcast_name?.toLowerCase().includes(token);
+}
+
 export class SourceDeviceList extends HTMLElement {
 	#list
+	#virtualList
 	#model
 	#filterTokens
 
@@ -69,13 +80,22 @@ export class SourceDeviceList extends HTMLElement {
 		this.shadowRoot?.appendChild(template.content.cloneNode(true));
 		// Add listeners, etc.
 		this.#list = this.shadowRoot?.querySelector('#list');
+		this.#virtualList = new VirtualList(this.#list, {
+			rowHeight: ROW_HEIGHT,
+			createItem: () => {
+				const el = new SourceItem();
+				el.addEventListener('click', this.sourceClicked);
+				return el;
+			},
+			matches: matchesSource
+		});
 		this.shadowRoot?.querySelector('#filter')?.addEventListener('input', evt => { this.setFilter(evt?.target.value) } );
 
 		this.#model = AssistantModel.getInstance();
 
 		this.#model.addEventListener('source-found', this.sourceFound);
 		this.#model.addEventListener('source-updated', this.sourceUpdated);
-		this.#model.addEventListener('reset', () => { this.#list.replaceChildren()})
+		this.#model.addEventListener('reset', () => { this.#virtualList.clear() });
 	}
 
 	disconnectedCallback() {
@@ -116,29 +136,7 @@ export class SourceDeviceList extends HTMLElement {
 	}
 
 	applyFilter() {
-		const elements = Array.from(this.#list.querySelectorAll('source-item'));
-
-		if (this.#filterTokens.length === 0) {
-			// Remove 'hidden' class from all items
-			elements.forEach( i => { i.classList.remove('hidden') } );
-			return;
-		}
-
-		let found = elements;
-
-		for (const t of this.#filterTokens) {
-			found = found.filter(i => i.getModel().addr?.value.toLowerCase().includes(t) ||
-				i.getModel().name?.toLowerCase().includes(t) ||
-				i.getModel().broadcast_name?.toLowerCase().includes(t));
-		}
-
-		elements.forEach( i => {
-			if (found.includes(i)) {
-				i.classList.remove('hidden');
-			} else {
-				i.classList.add('hidden');
-			}
-		});
+		this.#virtualList.setFilter(this.#filterTokens);
 	}
 
 	sourceFound(evt) {
@@ -149,25 +147,14 @@ export class SourceDeviceList extends HTMLElement {
 		// not be a big issue.
 		const { source } = evt.detail;
 
-		const el = new SourceItem();
-		this.#list.appendChild(el);
-		el.setModel(source);
-
-		el.addEventListener('click', this.sourceClicked);
+		this.#virtualList.add(source);
 	}
 
 	sourceUpdated(evt) {
 		const { source } = evt.detail;
 
-		const items = Array.from(this.#list.querySelectorAll('source-item'));
-
-		const el = items.find(i => i.getModel() === source);
-
-		if (el) {
-			el.refresh();
-		} else {
-			console.warn('source not found!', source);
-		}
+		// Applied on the next frame, only if the source is in view
+		this.#virtualList.update(source);
 	}
 }
 
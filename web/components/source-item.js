@@ -68,6 +68,10 @@ div {
 	background-color: lightgreen;
 	box-shadow: 1px 1px 2px 2px gray;
 }
+
+#card[stale] {
+	opacity: 0.5;
+}
 </style>
 <div id="card">
 <span id="name"></span>
@@ -132,6 +136,8 @@ export class SourceItem extends HTMLElement {
 			this.#source.broadcast_id?.toString(16).padStart(6, '0').toUpperCase()}`;
 
 		this.#cardEl.setAttribute('state', this.#source.state);
+		// Known from an earlier session, not seen yet
+		this.#cardEl.toggleAttribute('stale', Boolean(this.#source.stale));
 	}
 
 	setModel(source) {
@@ -0,0 +1,118 @@
+// @ts-check
+
+import { arrayToMsg, msgToArray, logString } from './message.js';
+import { CaptureWriter, CaptureFlags } from './capture.js';
+
+/**
+* Activity Log
+*
+* Fixed capacity ring buffer of sent and received messages. When full, the
+* oldest entries are overwritten. Entries keep a copy of the message bytes
+* and are only formatted when asked for (e.g. when they become visible).
+*
+* The log can be exported as a binary capture (see capture.js).
+*/
+
+const DEFAULT_CAPACITY = 10000;
+
+export class ActivityLog {
+	#capacity
+	#times
+	#flags
+	#data
+	#extraInfo
+	#start
+	#length
+
+	constructor(capacity = DEFAULT_CAPACITY) {
+		this.#capacity = Math.max(1, Math.floor(capacity) || DEFAULT_CAPACITY);
+		this.#times = new Float64Array(this.#capacity);
+		this.#flags = new Uint8Array(this.#capacity);
+		this.#data = new Array(this.#capacity);
+		this.#extraInfo = new Array(this.#capacity);
+		this.#start = 0;
+		this.#length = 0;
+	}
+
+	get length() {
+		return this.#length;
+	}
+
+	get capacity() {
+		return this.#capacity;
+	}
+
+	/**
+	* @param message	Message to log, copied (received messages are views)
+	* @param {object} [options]
+	* @param {boolean} [options.outgoing]	Sent to the device
+	* @param {string} [options.extraInfo]	Appended to the formatted entry
+	*/
+	push(message, { outgoing = false, extraInfo = undefined } = {}) {
+		let index;
+		if (this.#length < this.#capacity) {
+			index = (this.#start + this.#length++) % this.#capacity;
+		} else {
+			index = this.#start;
+			this.#start = (this.#start + 1) % this.#capacity;
+		}
+
+		this.#times[index] = Date.now();
+		this.#flags[index] = outgoing ? CaptureFlags.OUT : 0;
+		this.#data[index] = msgToArray(message);
+		this.#extraInfo[index] = extraInfo;
+	}
+
+	clear() {
+		this.#data.fill(undefined);
+		this.#extraInfo.fill(undefined);
+		this.#start = 0;
+		this.#length = 0;
+	}
+
+	#index(i) {
+		if (i < 0 || i >= this.#length) {
+			throw new RangeError(`Log index out of range (${i})`);
+		}
+
+		return (this.#start + i) % this.#capacity;
+	}
+
+	/**
+	* @param {number} i	0 is the oldest entry
+	*/
+	at(i) {
+		const index = this.#index(i);
+
+		return {
+			time: this.#times[index],
+			outgoing: this.#flags[index] === CaptureFlags.OUT,
+			message: arrayToMsg(this.#data[index]),
+			extraInfo: this.#extraInfo[index]
+		};
+	}
+
+	/**
+	* @param {number} i	0 is the oldest entry
+	* @returns {string}
+	*/
+	format(i) {
+		const { time, message, extraInfo } = this.at(i);
+
+		return logString(message, extraInfo, time);
+	}
+
+	/**
+	* @returns {Uint8Array}	Binary capture of all entries, oldest first
+	*/
+	toCapture() {
+		const writer = new CaptureWriter(this.#length ? this.#times[this.#start] : Date.now());
+
+		for (let i = 0; i < this.#length; i++) {
+			const index = this.#index(i);
+			writer.add(this.#times[index], this.#flags[index], this.#data[index]);
+		}
+
+		return writer.toArray();
+	}
+}
@@ -0,0 +1,130 @@
+// @ts-check
+
+/**
+* Binary capture format
+*
+* A capture is a sequence of timestamped records:
+*
+*	header:	"WBAC" | version (u8) | 3 reserved bytes | start time (f64, ms since epoch)
+*	record:	time delta (u32, µs since the previous record) | flags (u8) |
+*		length (u16) | data
+*
+* All values are little endian. Time deltas saturate at ~71 minutes.
+*/
+
+export const CAPTURE_MAGIC = 'WBAC';
+export const CAPTURE_VERSION = 1;
+
+const HEADER_SIZE = 16;
+const RECORD_HEADER_SIZE = 7;
+
+export const CaptureFlags = Object.freeze({
+	OUT:	0x01,	// Host -> device (otherwise device -> host)
+	RAW:	0x02,	// Transferred (COBS encoded) bytes, otherwise a message
+});
+
+export class CaptureWriter {
+	#buffer
+	#view
+	#length
+	#startTime
+	#lastTime
+
+	/**
+	* @param {number} startTime	ms since epoch
+	*/
+	constructor(startTime = Date.now()) {
+		this.#buffer = new Uint8Array(4096);
+		this.#view = new DataView(this.#buffer.buffer);
+		this.#startTime = startTime;
+		this.#lastTime = startTime;
+
+		for (let i = 0; i < CAPTURE_MAGIC.length; i++) {
+			this.#buffer[i] = CAPTURE_MAGIC.charCodeAt(i);
+		}
+		this.#buffer[4] = CAPTURE_VERSION;
+		this.#view.setFloat64(8, startTime, true);
+		this.#length = HEADER_SIZE;
+	}
+
+	get length() {
+		return this.#length;
+	}
+
+	/**
+	* @param {number} time		ms since epoch, not before the previous record
+	* @param {number} flags		CaptureFlags
+	* @param {Uint8Array} data	At most 65535 bytes
+	*/
+	add(time, flags, data) {
+		if (data.length > 0xffff) {
+			throw new Error(`Capture record too long (${data.length})`);
+		}
+
+		const size = RECORD_HEADER_SIZE + data.length;
+		if (this.#length + size > this.#buffer.length) {
+			const buffer = new Uint8Array(Math.max(this.#buffer.length * 2, this.#length + size));
+			buffer.set(this.#buffer.subarray(0, this.#length));
+			this.#buffer = buffer;
+			this.#view = new DataView(buffer.buffer);
+		}
+
+		const delta = Math.round((time - this.#lastTime) * 1000);
+		this.#lastTime = time;
+
+		this.#view.setUint32(this.#length, Math.min(Math.max(delta, 0), 0xffffffff), true);
+		this.#view.setUint8(this.#length + 4, flags);
+		this.#view.setUint16(this.#length + 5, data.length, true);
+		this.#buffer.set(data, this.#length + RECORD_HEADER_SIZE);
+		this.#length += size;
+	}
+
+	/**
+	* @returns {Uint8Array}	The capture so far (copy)
+	*/
+	toArray() {
+		return this.#buffer.slice(0, this.#length);
+	}
+}
+
+/**
+* @param {Uint8Array} data	Capture file content
+* @returns {{ startTime: number, records: { time: number, flags: number, data: Uint8Array }[] }}
+*	Record times in ms since epoch, record data are views of data
+*/
+export const readCapture = data => {
+	const view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+
+	const magic = String.fromCharCode(...data.subarray(0, 4));
+	if (data.length < HEADER_SIZE || magic !== CAPTURE_MAGIC) {
+		throw new Error("Not a capture file");
+	}
+
+	if (data[4] !== CAPTURE_VERSION) {
+		throw new Error(`Unsupported capture version (${data[4]})`);
+	}
+
+	const startTime = view.getFloat64(8, true);
+	const records = [];
+
+	let time = startTime;
+	let ptr = HEADER_SIZE;
+	while (ptr + RECORD_HEADER_SIZE <= data.length) {
+		const length = view.getUint16(ptr + 5, true);
+		if (ptr + RECORD_HEADER_SIZE + length > data.length) {
+			// Truncated record, e.g. capture cut short
+			break;
+		}
+
+		time += view.getUint32(ptr, true) / 1000;
+		records.push({
+			time,
+			flags: data[ptr + 4],
+			data: data.subarray(ptr + RECORD_HEADER_SIZE, ptr + RECORD_HEADER_SIZE + length)
+		});
+
+		ptr += RECORD_HEADER_SIZE + length;
+	}
+
+	return { startTime, records };
+}
@@ -62,3 +62,210 @@ export const cobsDecode = (data, zeropad) => {
 
 	return new Uint8Array(res);
 }
+
+/**
+* Preallocated COBS codec
+*
+* cobsEncodeInto/cobsDecodeInto write into a caller supplied Uint8Array or,
+* if none is given, into a pooled buffer owned by this module, and return a
+* subarray view of the result. Views of the pooled buffers are only valid
+* until the next call of the same function, copy them if they must be kept.
+*/
+
+let encodePool = new Uint8Array(1024);
+let decodePool = new Uint8Array(1024);
+
+const growPool = (pool, size) => {
+	let length = pool.length;
+	while (length < size) {
+		length *= 2;
+	}
+
+	return length === pool.length ? pool : new Uint8Array(length);
+}
+
+/**
+* Worst case encoded length, same formula as COBS_ENCODE_DST_BUF_LEN_MAX in cobs.h
+* (empty input still encodes to one code byte). Add one for the zero delimiter.
+*/
+export const cobsEncodedLengthMax = length => Math.max(1, length + Math.floor((length + 253) / 254));
+
+/**
+* Worst case decoded length, same formula as COBS_DECODE_DST_BUF_LEN_MAX in cobs.h
+*/
+export const cobsDecodedLengthMax = length => length === 0 ? 0 : length - 1;
+
+export const cobsEncodeInto = (data, zeropad, out) => {
+	if (!(data instanceof Uint8Array)) {
+		throw new Error("Input data must be a Uint8Array");
+	}
+
+	const maxLength = cobsEncodedLengthMax(data.length) + (zeropad ? 1 : 0);
+
+	if (out === undefined) {
+		encodePool = growPool(encodePool, maxLength);
+		out = encodePool;
+	} else if (out.length < maxLength) {
+		throw new Error(`Output buffer too small (${out.length} < ${maxLength})`);
+	}
+
+	const length = data.length;
+	let codePtr = 0;
+	let outPtr = 1;
+	let code = 1;
+
+	for (let i = 0; i < length; i++) {
+		const byte = data[i];
+
+		if (byte === 0) {
+			out[codePtr] = code;
+			codePtr = outPtr++;
+			code = 1;
+		} else {
+			out[outPtr++] = byte;
+			code++;
+			// As in cobs.c, no new block is started after a full block at the end
+			if (code === 0xFF && i + 1 < length) {
+				out[codePtr] = code;
+				codePtr = outPtr++;
+				code = 1;
+			}
+		}
+	}
+	out[codePtr] = code;
+
+	if (zeropad) {
+		out[outPtr++] = 0;
+	}
+
+	return out.subarray(0, outPtr);
+}
+
+export const cobsDecodeInto = (data, zeropad, out) => {
+	if (!(data instanceof Uint8Array)) {
+		throw new Error("Input data must be a Uint8Array");
+	}
+
+	const end = zeropad ? data.length - 1 : data.length;
+	const maxLength = cobsDecodedLengthMax(Math.max(end, 0));
+
+	if (out === undefined) {
+		decodePool = growPool(decodePool, maxLength);
+		out = decodePool;
+	} else if (out.length < maxLength) {
+		throw new Error(`Output buffer too small (${out.length} < ${maxLength})`);
+	}
+
+	let outPtr = 0;
+	let ptr = 0;
+	let code = 0xFF;
+
+	while (ptr < end) {
+		// Blocks shorter than 0xFF are followed by a zero
+		if (code !== 0xFF) {
+			out[outPtr++] = 0;
+		}
+
+		code = data[ptr++];
+		if (code === 0) {
+			break;
+		}
+
+		const blockEnd = Math.min(ptr + code - 1, end);
+		while (ptr < blockEnd) {
+			out[outPtr++] = data[ptr++];
+		}
+	}
+
+	return out.subarray(0, outPtr);
+}
+
+/**
+* CobsWriter
+*
+* Incremental COBS encoder: bytes are encoded as they are written, so a
+* frame can be built straight from its parts without an unencoded copy.
+* The output is the same as from cobsEncodeInto.
+*
+* The buffer is owned by the writer and reused, the view returned by
+* finish() is only valid until the next start(). Views are cached per
+* length, so encoding does not allocate once the buffer has its size.
+*/
+export class CobsWriter {
+	#out
+	#views
+	#outPtr
+	#codePtr
+	#code
+
+	constructor(size = 1024) {
+		this.#out = new Uint8Array(size);
+		this.#views = [];
+		this.#outPtr = 1;
+		this.#codePtr = 0;
+		this.#code = 1;
+	}
+
+	/**
+	* @param {number} length	Number of (unencoded) bytes that will be written
+	*/
+	start(length) {
+		const out = growPool(this.#out, cobsEncodedLengthMax(length) + 1);
+		if (out !== this.#out) {
+			this.#out = out;
+			this.#views = [];
+		}
+
+		this.#outPtr = 1;
+		this.#codePtr = 0;
+		this.#code = 1;
+	}
+
+	/**
+	* @param {number} byte	Written as byte & 0xff
+	*/
+	u8(byte) {
+		const out = this.#out;
+
+		// As in cobs.c, no new block is started after a full block at the end
+		if (this.#code === 0xFF) {
+			out[this.#codePtr] = 0xFF;
+			this.#codePtr = this.#outPtr++;
+			this.#code = 1;
+		}
+
+		byte &= 0xff;
+		if (byte === 0) {
+			out[this.#codePtr] = this.#code;
+			this.#codePtr = this.#outPtr++;
+			this.#code = 1;
+		} else {
+			out[this.#outPtr++] = byte;
+			this.#code++;
+		}
+	}
+
+	/**
+	* @param {ArrayLike<number>} data
+	* @param {number} length
+	*/
+	bytes(data, length) {
+		for (let i = 0; i < length; i++) {
+			this.u8(data[i]);
+		}
+	}
+
+	/**
+	* @param {boolean} zeropad	Append the zero delimiter
+	* @returns {Uint8Array}	View of the encoded frame
+	*/
+	finish(zeropad) {
+		this.#out[this.#codePtr] = this.#code;
+
+		if (zeropad) {
+			this.#out[this.#outPtr++] = 0;
+		}
+
+		return this.#views[this.#outPtr] ??= this.#out.subarray(0, this.#outPtr);
+	}
+}
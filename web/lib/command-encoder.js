@@ -0,0 +1,82 @@
+// @ts-check
+
+import { CobsWriter } from './cobs.js';
+import { validMessageType, validMessageSubType, ltvLength, writeLtv } from './message.js';
+
+/**
+* Command Encoder
+*
+* Encodes a message straight into a COBS frame (with the zero delimiter):
+* header, LTV fields and framing are written in one pass into a buffer
+* owned by the encoder, so sending a burst of commands does not allocate.
+* The output is the same as cobsEncodeInto(msgToArray(message), true).
+*
+* The message either has a payload (Uint8Array) or items, a Type Value
+* Array [{type, value}, ...] that is written as LTV fields (as
+* tvArrayToLtv would).
+*
+* The returned frame is a view of the encoder buffer and only valid until
+* the next encode(), copy it if it must be kept.
+*/
+
+const HEADER_SIZE = 5;
+
+export class CommandEncoder {
+	#writer
+
+	constructor() {
+		this.#writer = new CobsWriter();
+	}
+
+	/**
+	* @param {{ type: number, subType: number, seqNo?: number, payload?: Uint8Array, items?: any[] }} message
+	* @returns {Uint8Array}	COBS frame, valid until the next encode()
+	*/
+	encode(message) {
+		const { type, subType, payload, items } = message;
+
+		if (!validMessageType[type]) {
+			throw new Error(`Message type invalid (${type})`);
+		}
+
+		if (!validMessageSubType[subType]) {
+			throw new Error(`Message subType invalid (${subType})`);
+		}
+
+		// Same default as msgToArray
+		let seqNo = message.seqNo;
+		if (!Number.isInteger(seqNo) || seqNo < 0 || seqNo > 255) {
+			seqNo = 0;
+		}
+
+		let payloadSize = 0;
+		if (items) {
+			payloadSize = ltvLength(items);
+		} else if (payload instanceof Uint8Array) {
+			payloadSize = payload.length;
+		} else if (payload !== undefined) {
+			throw new Error("If set, payload must be a Uint8Array");
+		}
+
+		if (payloadSize > 0xffff) {
+			throw new Error(`Payload too long (${payloadSize})`);
+		}
+
+		const w = this.#writer;
+		w.start(HEADER_SIZE + payloadSize);
+
+		w.u8(type);
+		w.u8(subType);
+		w.u8(seqNo);
+		w.u8(payloadSize);
+		w.u8(payloadSize >> 8);
+
+		if (items) {
+			writeLtv(items, w);
+		} else if (payload) {
+			w.bytes(payload, payloadSize);
+		}
+
+		return w.finish(true);
+	}
+}
@@ -0,0 +1,225 @@
+// @ts-check
+
+/**
+* Command Manager
+*
+* Allocates sequence numbers for commands and matches responses to them on
+* seqNo and subType. Each command gets a promise that resolves with the RES
+* message, or rejects on send errors and timeouts.
+*
+* Up to `window` commands are in flight at a time; further commands are
+* queued and sent, in order, as responses come in. The device queues up to
+* CONFIG_RX_MSG_MAX_MESSAGES (app/Kconfig) received commands and drops
+* the ones beyond, a larger window makes commands time out.
+*
+* Round trip times are collected per command subType (see getStats()).
+*/
+
+// At most CONFIG_RX_MSG_MAX_MESSAGES of the firmware (default 4)
+const DEFAULT_WINDOW = 4;
+const DEFAULT_TIMEOUT_MS = 2000;
+
+// Samples kept per subType for the percentiles
+const RTT_SAMPLES = 100;
+
+// Upper bounds (ms) of the RTT histogram buckets, the last bucket is open
+export const RTT_BUCKETS = [1, 2, 5, 10, 20, 50, 100, 200, 500, 1000];
+
+export class CommandManager {
+	#send
+	#window
+	#timeout
+	#nextSeqNo
+	#inFlight
+	#queue
+	#stats
+
+	/**
+	* @param {(message: any) => Promise<void>} send	Sends an encoded command, rejects on failure
+	* @param {object} [options]
+	* @param {number} [options.window]		Max commands in flight, not more than
+	*						the device queues (DEFAULT_WINDOW)
+	* @param {number} [options.timeout]		Response timeout in ms
+	*/
+	constructor(send, { window = DEFAULT_WINDOW, timeout = DEFAULT_TIMEOUT_MS } = {}) {
+		this.#send = send;
+		this.#window = window;
+		this.#timeout = timeout;
+		this.#nextSeqNo = 1;
+		this.#inFlight = new Map();
+		this.#queue = [];
+		this.#stats = new Map();
+	}
+
+	setWindow(window) {
+		this.#window = Math.max(1, Math.floor(window) || DEFAULT_WINDOW);
+		this.#pump();
+	}
+
+	setTimeout(timeout) {
+		this.#timeout = timeout;
+	}
+
+	get inFlight() {
+		return this.#inFlight.size;
+	}
+
+	get queued() {
+		return this.#queue.length;
+	}
+
+	/**
+	* Queue a command, seqNo is assigned when it is sent
+	*
+	* @returns {Promise<any>}	Resolves with the matching RES message
+	*/
+	submit(message) {
+		return new Promise((resolve, reject) => {
+			this.#queue.push({ message, resolve, reject });
+			this.#pump();
+		});
+	}
+
+	/**
+	* Match a response with the command it belongs to
+	*
+	* @returns {boolean}	true if the response matched a command in flight
+	*/
+	handleResponse(message) {
+		const command = this.#inFlight.get(message.seqNo);
+
+		if (!command || command.message.subType !== message.subType) {
+			return false;
+		}
+
+		this.#complete(command);
+		this.#record(message.subType, performance.now() - command.sentAt);
+		command.resolve(message);
+
+		return true;
+	}
+
+	/**
+	* Reject all commands, in flight and queued (e.g. on disconnect)
+	*/
+	abort(reason = 'Aborted') {
+		const commands = [...this.#inFlight.values(), ...this.#queue];
+
+		for (const command of this.#inFlight.values()) {
+			clearTimeout(command.timer);
+		}
+
+		this.#inFlight.clear();
+		this.#queue = [];
+
+		commands.forEach(command => command.reject(new Error(reason)));
+	}
+
+	/**
+	* @returns	Map of subType -> { count, timeouts, errors, last, min, max, mean, p50, p95, histogram }
+	*		(times in ms, histogram: sample counts per RTT_BUCKETS bucket)
+	*/
+	getStats() {
+		const result = new Map();
+
+		for (const [subType, stats] of this.#stats) {
+			const sorted = stats.samples.slice().sort((a, b) => a - b);
+			const percentile = p => sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+
+			const histogram = new Array(RTT_BUCKETS.length + 1).fill(0);
+			for (const rtt of sorted) {
+				const bucket = RTT_BUCKETS.findIndex(bound => rtt <= bound);
+				histogram[bucket === -1 ? RTT_BUCKETS.length : bucket]++;
+			}
+
+			result.set(subType, {
+				count: stats.count,
+				timeouts: stats.timeouts,
+				errors: stats.errors,
+				last: stats.last,
+				min: stats.count ? stats.min : undefined,
+				max: stats.count ? stats.max : undefined,
+				mean: stats.count ? stats.total / stats.count : undefined,
+				p50: percentile(0.5),
+				p95: percentile(0.95),
+				histogram
+			});
+		}
+
+		return result;
+	}
+
+	resetStats() {
+		this.#stats.clear();
+	}
+
+	#statsFor(subType) {
+		let stats = this.#stats.get(subType);
+		if (!stats) {
+			stats = { count: 0, timeouts: 0, errors: 0, total: 0, min: Infinity, max: 0, last: undefined, samples: [] };
+			this.#stats.set(subType, stats);
+		}
+
+		return stats;
+	}
+
+	#record(subType, rtt) {
+		const stats = this.#statsFor(subType);
+
+		stats.count++;
+		stats.total += rtt;
+		stats.last = rtt;
+		stats.min = Math.min(stats.min, rtt);
+		stats.max = Math.max(stats.max, rtt);
+
+		if (stats.samples.length === RTT_SAMPLES) {
+			stats.samples.shift();
+		}
+		stats.samples.push(rtt);
+	}
+
+	#allocateSeqNo() {
+		// 1..255, skipping numbers still in flight (0 is left for unmanaged messages)
+		while (this.#inFlight.has(this.#nextSeqNo)) {
+			this.#nextSeqNo = this.#nextSeqNo % 255 + 1;
+		}
+
+		const seqNo = this.#nextSeqNo;
+		this.#nextSeqNo = this.#nextSeqNo % 255 + 1;
+
+		return seqNo;
+	}
+
+	#complete(command) {
+		clearTimeout(command.timer);
+		this.#inFlight.delete(command.message.seqNo);
+		this.#pump();
+	}
+
+	#pump() {
+		while (this.#queue.length && this.#inFlight.size < Math.min(this.#window, 255)) {
+			const command = this.#queue.shift();
+
+			command.message = { ...command.message, seqNo: this.#allocateSeqNo() };
+			command.sentAt = performance.now();
+			command.timer = setTimeout(() => {
+				this.#statsFor(command.message.subType).timeouts++;
+				this.#complete(command);
+				command.reject(new Error(`Timeout waiting for response (subType 0x${
+					command.message.subType.toString(16)}, seqNo ${command.message.seqNo})`));
+			}, this.#timeout);
+
+			this.#inFlight.set(command.message.seqNo, command);
+
+			this.#send(command.message).catch(error => {
+				if (this.#inFlight.get(command.message.seqNo) !== command) {
+					return;
+				}
+
+				this.#statsFor(command.message.subType).errors++;
+				this.#complete(command);
+				command.reject(error);
+			});
+		}
+	}
+}
@@ -0,0 +1,168 @@
+// @ts-check
+
+/**
+* Device Store
+*
+* Persists known sources and sinks in IndexedDB, so the lists can be shown
+* right away on the next page load.
+*
+* put() only remembers the (live) device object, records are serialized and
+* written once per FLUSH_MS in a single transaction. Repeated updates of a
+* device between flushes cost one write.
+*
+* Records not seen for MAX_AGE_MS are dropped when loading (sinks advertising
+* with an RPA are never seen under the same address again).
+*
+* Without IndexedDB (e.g. in Node) the store keeps nothing.
+*/
+
+const DB_NAME = 'web-broadcast-assistant';
+const DB_VERSION = 1;
+
+export const DeviceKind = Object.freeze({
+	SOURCE:	'sources',
+	SINK:	'sinks',
+});
+
+const FLUSH_MS = 1000;
+const MAX_AGE_MS = 7 * 24 * 60 * 60 * 1000;
+
+const promisify = request => new Promise((resolve, reject) => {
+	request.onsuccess = () => resolve(request.result);
+	request.onerror = () => reject(request.error);
+});
+
+export class DeviceStore {
+	#db
+	#serialize
+	#pending
+	#deleted
+	#timer
+
+	/**
+	* @param {(kind: string, device: any) => object} serialize	Device -> record (structured clonable)
+	*/
+	constructor(serialize) {
+		this.#serialize = serialize;
+		this.#pending = new Map(Object.values(DeviceKind).map(kind => [kind, new Map()]));
+		this.#deleted = new Map(Object.values(DeviceKind).map(kind => [kind, new Set()]));
+	}
+
+	/**
+	* @returns {Promise<boolean>}	false if IndexedDB is not available
+	*/
+	async open() {
+		if (typeof indexedDB === 'undefined') {
+			return false;
+		}
+
+		const request = indexedDB.open(DB_NAME, DB_VERSION);
+		request.onupgradeneeded = () => {
+			for (const kind of Object.values(DeviceKind)) {
+				request.result.createObjectStore(kind, { keyPath: 'key' });
+			}
+		};
+
+		this.#db = await promisify(request);
+
+		return true;
+	}
+
+	/**
+	* @returns {Promise<{ sources: object[], sinks: object[] }>}	Records seen within MAX_AGE_MS
+	*/
+	async load() {
+		if (!this.#db) {
+			return { sources: [], sinks: [] };
+		}
+
+		const tx = this.#db.transaction(Object.values(DeviceKind), 'readwrite');
+		const oldest = Date.now() - MAX_AGE_MS;
+
+		const loadKind = async kind => {
+			const store = tx.objectStore(kind);
+			const records = await promisify(store.getAll());
+
+			return records.filter(record => {
+				if (record.last_seen >= oldest) {
+					return true;
+				}
+				store.delete(record.key);
+				return false;
+			});
+		};
+
+		const [sources, sinks] = await Promise.all([loadKind(DeviceKind.SOURCE), loadKind(DeviceKind.SINK)]);
+
+		return { sources, sinks };
+	}
+
+	/**
+	* Schedule a write of the device (serialized when written)
+	*/
+	put(kind, key, device) {
+		if (!this.#db) {
+			return;
+		}
+
+		this.#deleted.get(kind)?.delete(key);
+		this.#pending.get(kind)?.set(key, device);
+		this.#schedule();
+	}
+
+	delete(kind, key) {
+		if (!this.#db) {
+			return;
+		}
+
+		this.#pending.get(kind)?.delete(key);
+		this.#deleted.get(kind)?.add(key);
+		this.#schedule();
+	}
+
+	async clear() {
+		this.#pending.forEach(pending => pending.clear());
+		this.#deleted.forEach(deleted => deleted.clear());
+
+		if (!this.#db) {
+			return;
+		}
+
+		const tx = this.#db.transaction(Object.values(DeviceKind), 'readwrite');
+		Object.values(DeviceKind).forEach(kind => tx.objectStore(kind).clear());
+	}
+
+	#schedule() {
+		this.#timer ??= setTimeout(() => this.flush(), FLUSH_MS);
+	}
+
+	/**
+	* Write the pending changes now
+	*/
+	flush() {
+		clearTimeout(this.#timer);
+		this.#timer = undefined;
+
+		if (!this.#db) {
+			return;
+		}
+
+		const tx = this.#db.transaction(Object.values(DeviceKind), 'readwrite');
+
+		for (const kind of Object.values(DeviceKind)) {
+			const store = tx.objectStore(kind);
+
+			for (const [key, device] of this.#pending.get(kind) ?? []) {
+				store.put({ ...this.#serialize(kind, device), key });
+			}
+			for (const key of this.#deleted.get(kind) ?? []) {
+				store.delete(key);
+			}
+		}
+
+		this.#pending.forEach(pending => pending.clear());
+		this.#deleted.forEach(deleted => deleted.clear());
+
+		tx.onerror = () => console.warn('Storing devices failed', tx.error);
+	}
+}
@@ -0,0 +1,298 @@
+// @ts-check
+
+/**
+* Dongle Router
+*
+* Bookkeeping for several assistant dongles covering the same room:
+*
+* Scan reports: every dongle reports the devices it hears. A device is
+* forwarded from one dongle at a time, the one that heard it best. Another
+* dongle takes over when it hears the device HYSTERESIS_DB better, or when
+* the current one has not reported it for STALE_MS. Reports from the other
+* dongles are duplicates, they only update the RSSI per dongle.
+*
+* Sinks: a sink is connected through the dongle with spare capacity that
+* heard it best (recently), so connections spread over the dongles by
+* position. Connection attempts count against the capacity until
+* SINK_CONNECTED or CONNECT_TIMEOUT_MS.
+*
+* Devices are identified by their packed address (bufToAddressKey).
+*/
+
+const HYSTERESIS_DB = 3;
+const STALE_MS = 2000;
+
+// RSSI older than this is not used to pick a dongle for a sink
+const RSSI_MAX_AGE_MS = 10000;
+
+const CONNECT_TIMEOUT_MS = 30000;
+
+// Devices not heard for this long are forgotten (checked every PRUNE_MS)
+const SEEN_MAX_AGE_MS = 60000;
+const PRUNE_MS = 10000;
+
+const NO_RSSI = -128;
+
+export class DongleRouter {
+	#dongles
+	#seen
+	#owner
+	#lastPrune
+
+	constructor() {
+		this.#dongles = new Map();
+		this.#seen = new Map();
+		this.#owner = new Map();
+		this.#lastPrune = 0;
+	}
+
+	/**
+	* @param {string} id
+	* @param {number} capacity	Max connected sinks (CONFIG_BT_MAX_CONN)
+	*/
+	addDongle(id, capacity) {
+		this.#dongles.set(id, {
+			id,
+			capacity,
+			sinks: new Set(),
+			connecting: new Map(),
+			reports: 0,
+			forwarded: 0,
+			commands: 0
+		});
+	}
+
+	/**
+	* Forget a dongle, e.g. when unplugged. Its connections are gone.
+	*/
+	removeDongle(id) {
+		const dongle = this.#dongles.get(id);
+		if (!dongle) {
+			return;
+		}
+
+		for (const key of dongle.sinks) {
+			this.#owner.delete(key);
+		}
+		this.#dongles.delete(id);
+
+		for (const entry of this.#seen.values()) {
+			entry.rssiBy.delete(id);
+			if (entry.best === id) {
+				entry.best = undefined;
+			}
+		}
+	}
+
+	setCapacity(id, capacity) {
+		const dongle = this.#dongles.get(id);
+		if (dongle) {
+			dongle.capacity = capacity;
+		}
+	}
+
+	get dongles() {
+		return [...this.#dongles.keys()];
+	}
+
+	/**
+	* @param {string} id		Reporting dongle
+	* @param {number} key		Device address key
+	* @param {number | undefined} rssi
+	* @param {number} now		ms
+	* @returns {boolean}		true if the report is to be forwarded
+	*/
+	scanReport(id, key, rssi = NO_RSSI, now = performance.now()) {
+		const dongle = this.#dongles.get(id);
+		if (!dongle) {
+			return false;
+		}
+
+		dongle.reports++;
+
+		if (now - this.#lastPrune > PRUNE_MS) {
+			this.#prune(now);
+		}
+
+		let entry = this.#seen.get(key);
+		if (!entry) {
+			entry = { best: undefined, rssi: NO_RSSI, time: 0, rssiBy: new Map() };
+			this.#seen.set(key, entry);
+		}
+
+		let heard = entry.rssiBy.get(id);
+		if (!heard) {
+			heard = { rssi, time: now };
+			entry.rssiBy.set(id, heard);
+		}
+		heard.rssi = rssi;
+		heard.time = now;
+
+		if (entry.best !== id && entry.best !== undefined &&
+		    now - entry.time < STALE_MS && rssi < entry.rssi + HYSTERESIS_DB) {
+			return false;
+		}
+
+		entry.best = id;
+		entry.rssi = rssi;
+		entry.time = now;
+		dongle.forwarded++;
+
+		return true;
+	}
+
+	/**
+	* Pick the dongle to connect a sink through
+	*
+	* @returns {string | undefined}	undefined if no dongle has spare capacity
+	*/
+	pickDongle(key, now = performance.now()) {
+		const heardBy = this.#seen.get(key)?.rssiBy;
+
+		let best;
+		let bestRssi = -Infinity;
+		let bestLoad = Infinity;
+
+		for (const dongle of this.#dongles.values()) {
+			const load = this.#load(dongle, now);
+			if (load >= dongle.capacity) {
+				continue;
+			}
+
+			const heard = heardBy?.get(dongle.id);
+			const rssi = heard && now - heard.time < RSSI_MAX_AGE_MS ? heard.rssi : -Infinity;
+
+			if (rssi > bestRssi || (rssi === bestRssi && load < bestLoad)) {
+				best = dongle.id;
+				bestRssi = rssi;
+				bestLoad = load;
+			}
+		}
+
+		return best;
+	}
+
+	/**
+	* A CONNECT_SINK has been sent through the dongle
+	*/
+	connecting(id, key, now = performance.now()) {
+		this.#dongles.get(id)?.connecting.set(key, now);
+	}
+
+	/**
+	* SINK_CONNECTED from the dongle (or a failed CONNECT_SINK, ok = false)
+	*/
+	connected(id, key, ok) {
+		const dongle = this.#dongles.get(id);
+		if (!dongle) {
+			return;
+		}
+
+		dongle.connecting.delete(key);
+
+		if (ok) {
+			dongle.sinks.add(key);
+			this.#owner.set(key, id);
+		}
+	}
+
+	disconnected(id, key) {
+		const dongle = this.#dongles.get(id);
+		if (!dongle) {
+			return;
+		}
+
+		dongle.connecting.delete(key);
+		dongle.sinks.delete(key);
+		if (this.#owner.get(key) === id) {
+			this.#owner.delete(key);
+		}
+	}
+
+	/**
+	* The dongle resolved the identity of a sink, later events may use
+	* either address
+	*/
+	identityResolved(id, rpaKey, identityKey) {
+		const dongle = this.#dongles.get(id);
+		if (!dongle) {
+			return;
+		}
+
+		if (dongle.connecting.has(rpaKey)) {
+			dongle.connecting.set(identityKey, dongle.connecting.get(rpaKey));
+			dongle.connecting.delete(rpaKey);
+		}
+		if (dongle.sinks.delete(rpaKey)) {
+			dongle.sinks.add(identityKey);
+		}
+		if (this.#owner.get(rpaKey) === id) {
+			this.#owner.delete(rpaKey);
+			this.#owner.set(identityKey, id);
+		}
+	}
+
+	/**
+	* @returns {string | undefined}	Dongle the sink is connected through
+	*/
+	ownerOf(key) {
+		return this.#owner.get(key);
+	}
+
+	/**
+	* @returns {number[]}	Sinks connected through the dongle
+	*/
+	sinksOf(id) {
+		return [...(this.#dongles.get(id)?.sinks ?? [])];
+	}
+
+	/**
+	* @returns {string[]}	Dongles with connected sinks
+	*/
+	withSinks() {
+		return [...this.#dongles.values()].filter(dongle => dongle.sinks.size).map(dongle => dongle.id);
+	}
+
+	commandSent(id) {
+		const dongle = this.#dongles.get(id);
+		if (dongle) {
+			dongle.commands++;
+		}
+	}
+
+	/**
+	* @returns	Per dongle: { id, capacity, sinks, connecting, reports, forwarded,
+	*		commands }, counters since the dongle was added
+	*/
+	getStats(now = performance.now()) {
+		return [...this.#dongles.values()].map(dongle => ({
+			id: dongle.id,
+			capacity: dongle.capacity,
+			sinks: dongle.sinks.size,
+			connecting: this.#load(dongle, now) - dongle.sinks.size,
+			reports: dongle.reports,
+			forwarded: dongle.forwarded,
+			commands: dongle.commands
+		}));
+	}
+
+	#load(dongle, now) {
+		for (const [key, time] of dongle.connecting) {
+			if (now - time > CONNECT_TIMEOUT_MS) {
+				dongle.connecting.delete(key);
+			}
+		}
+
+		return dongle.sinks.size + dongle.connecting.size;
+	}
+
+	#prune(now) {
+		this.#lastPrune = now;
+
+		for (const [key, entry] of this.#seen) {
+			if (now - entry.time > SEEN_MAX_AGE_MS) {
+				this.#seen.delete(key);
+			}
+		}
+	}
+}
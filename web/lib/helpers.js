@@ -15,3 +15,23 @@ export const compareTypedArray = (arr1, arr2) => {
 export const arrayToHex = arr => {
         return Array.from(arr).map((b) => b.toString(16).padStart(2, "0")).join(', ');
 }
+
+export const downloadData = (data, filename) => {
+        const a = document.createElement('a');
+        a.href = URL.createObjectURL(new Blob([data], { type: 'application/octet-stream' }));
+        a.download = filename;
+        a.click();
+        URL.revokeObjectURL(a.href);
+}
+
+// e.g. "2024-05-01T12-30-00-000Z", usable in file names
+export const fileTimestamp = () => new Date().toISOString().replace(/[:.]/g, '-');
+
+// Seeded PRNG (mulberry32), returns numbers in [0, 1) like Math.random
+export const prng = seed => () => {
+	seed = (seed + 0x6d2b79f5) | 0;
+	let t = seed;
+	t = Math.imul(t ^ (t >>> 15), t | 1);
+	t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+	return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+}
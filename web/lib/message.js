@@ -2,6 +2,7 @@
 
 import { cobsEncode, cobsDecode } from './cobs.js';
 import { arrayToHex } from './helpers.js';
+import { MessageType, MessageSubType, BT_DataType, decodeLtvValue, ltvValueLength, writeLtvValue } from './protocol.js';
 
 /**
 * This module contains enums and functions related to messages
@@ -16,78 +17,31 @@ import { arrayToHex } from './helpers.js';
 *
 */
 
-export const MessageType = Object.freeze({
-	CMD: 0x01,
-	RES: 0x02,
-	EVT: 0x03
-});
+// Generated from protocol/schema.json
+export { MessageType, MessageSubType, BT_DataType } from './protocol.js';
 
-export const MessageSubType = Object.freeze({
-	// CMD/RES (MSB = 0)
-	START_SINK_SCAN:		0x01,
-	START_SOURCE_SCAN:		0x02,
-	START_SCAN_ALL:			0x03,
-	STOP_SCAN:			0x04,
-	CONNECT_SINK:			0x05,
-	DISCONNECT_SINK:		0x06,
-	ADD_SOURCE:			0x07,
-	REMOVE_SOURCE:			0x08,
-
-	RESET:				0x2A,
-
-	// EVT (MSB = 1)
-	SINK_FOUND:			0x81,
-	SOURCE_FOUND:			0x82,
-	SINK_CONNECTED:			0x83,
-	SINK_DISCONNECTED:		0x84,
-	SOURCE_ADDED:			0x85,
-	SOURCE_REMOVED:			0x86,
-	NEW_PA_STATE_NOT_SYNCED:	0x87,
-	NEW_PA_STATE_INFO_REQ:		0x88,
-	NEW_PA_STATE_SYNCED:		0x89,
-	NEW_PA_STATE_FAILED:		0x8A,
-	NEW_PA_STATE_NO_PAST:		0x8B,
-	BIS_SYNCED:			0x8C,
-	BIS_UNSYNCED:			0x8D,
-	IDENTITY_RESOLVED:		0x8E,
-
-	HEARTBEAT:			0xFF,
+export const BT_UUID = Object.freeze({
+	BT_UUID_BROADCAST_AUDIO:	0x1852,
 });
 
-export const BT_DataType = Object.freeze({
-	BT_DATA_UUID16_SOME:		0x02,	// uint16[n]
-	BT_DATA_UUID16_ALL:		0x03,	// uint16[n]
-	BT_DATA_UUID32_SOME:		0x04,	// uint32[n]
-	BT_DATA_UUID32_ALL:		0x05,	// uint32[n]
-
-	BT_DATA_NAME_SHORTENED:		0x08,	// utf8 (variable len)
-	BT_DATA_NAME_COMPLETE:		0x09,	// utf8 (variable len)
-
-	BT_DATA_SVC_DATA16:		0x16,
+// Lookup tables for validation, non zero for known values
+const lookupTable = values => {
+	const table = new Uint8Array(256);
+	values.forEach(value => { table[value] = 1; });
 
-	BT_DATA_BROADCAST_NAME:		0x30,	// utf8 (variable len)
-
-	// The following types are created for this app (not standard)
-	BT_DATA_IDENTITY:		0xf8,   // uint8 (type) + uint8[6] (addr)
-	BT_DATA_RPA:			0xf9,   // uint8 (type) + uint8[6] (addr)
-	BT_DATA_BROADCAST_ID:		0xfa,	// uint24
-	BT_DATA_ERROR_CODE:		0xfb,	// int32
-	BT_DATA_PA_INTERVAL:		0xfc,	// uint16
-	BT_DATA_SID:			0xfd,	// uint8
-	BT_DATA_RSSI:			0xfe,	// int8
-});
+	return table;
+}
 
-export const BT_UUID = Object.freeze({
-	BT_UUID_BROADCAST_AUDIO:	0x1852,
-});
+export const validMessageType = lookupTable(Object.values(MessageType));
+export const validMessageSubType = lookupTable(Object.values(MessageSubType));
 
 export const msgToArray = msg => {
 	// Simple validation
-	if (!Object.values(MessageType).includes(msg?.type)) {
+	if (!validMessageType[msg?.type]) {
 		throw new Error(`Message type invalid (${msg?.type})`);
 	}
 
-	if (!Object.values(MessageSubType).includes(msg?.subType)) {
+	if (!validMessageSubType[msg?.subType]) {
 		throw new Error(`Message subType invalid (${msg?.subType})`);
 	}
 	// TBD: Maybe check subType MSB against message type
@@ -152,93 +106,22 @@ export const arrayToMsg = data => {
 	}
 
 	// TODO: Full validation
-	console.log('Validation complete...');
 
+	// The payload is a view of data (no copy), data must not be reused while
+	// the message is in use
 	return {
 		type: data[0],
 		subType: data[1],
 		seqNo: data[2],
 		payloadSize,
-		payload: data.slice(5)
+		payload: data.subarray(5)
 	}
 }
 
-const utf8decoder = new TextDecoder();
-
 const addressStringToArray = (str) => {
 	return str.split(':').reverse().map(v => Number.parseInt(v, 16));
 }
 
-const uintToArray = (num, length) => {
-	if (length < 1 || length > 4) {
-		throw new Error("Can only handle uint8, 16, 24, 32");
-	}
-
-	let outArr = [];
-
-	for (var i = 0; i < length; i++) {
-		outArr.push((num >> (8*i)) & 0xff)
-	}
-
-	return outArr;
-}
-
-const bufToInt = (data, signed) => {
-	if (!(data instanceof Uint8Array)) {
-		throw new Error("Input data must be a Uint8Array");
-	}
-
-	if (data.length < 1 || data.length > 4) {
-		throw new Error("Can only handle int8, 16, 24, 32");
-	}
-	const width = data.length * 8;
-
-	let item = 0;
-	let count = 0;
-	while(count < data.length) {
-		item += data[count] << (8*count);
-		count++;
-	}
-
-	if (signed) {
-		const neg = item & (1 << (width - 1));
-		const tmp = (1 << width);
-		const min = -tmp;
-		return neg ? min + (item & (tmp - 1)) : item;
-	}
-
-	return item;
-}
-
-const bufToValueArray = (data, itemsize) => {
-	// Used to extract uint8, 16, 24 or 32 values
-	if (!(data instanceof Uint8Array)) {
-		throw new Error("Input data must be a Uint8Array");
-	}
-
-	if (itemsize < 1 || itemsize > 4) {
-		return [];
-	}
-
-	if (data.length % itemsize !== 0) {
-		return [];
-	}
-
-	const res = [];
-	let ptr = 0;
-	while (ptr < data.length) {
-		let item = 0;
-		let count = 0;
-		while(count < itemsize) {
-			item += data[ptr++] << (8*count);
-			count++;
-		}
-		res.push(item);
-	}
-
-	return res;
-}
-
 const parseLTVItem = (type, len, value) => {
 	// type: uint8 (AD type)
 	// len: utin8
@@ -248,46 +131,14 @@ const parseLTVItem = (type, len, value) => {
 		return;
 	}
 
-	const item = { type };
-	// For now, just parse the ones we know
-	switch (type) {
-		case BT_DataType.BT_DATA_NAME_SHORTENED:
-		case BT_DataType.BT_DATA_NAME_COMPLETE:
-		case BT_DataType.BT_DATA_BROADCAST_NAME:
-		item.value = utf8decoder.decode(value);
-		break;
-		case BT_DataType.BT_DATA_UUID16_SOME:
-		case BT_DataType.BT_DATA_UUID16_ALL:
-		item.value = bufToValueArray(value, 2);
-		break;
-		case BT_DataType.BT_DATA_UUID32_SOME:
-		case BT_DataType.BT_DATA_UUID32_ALL:
-		item.value = bufToValueArray(value, 4);
-		break;
-		case BT_DataType.BT_DATA_RSSI:
-		case BT_DataType.BT_DATA_ERROR_CODE:
-		item.value = bufToInt(value, true);
-		break;
-		case BT_DataType.BT_DATA_BROADCAST_ID:
-		case BT_DataType.BT_DATA_PA_INTERVAL:
-		case BT_DataType.BT_DATA_SID:
-		item.value = bufToInt(value, false);
-		break;
-		case BT_DataType.BT_DATA_RPA:
-		case BT_DataType.BT_DATA_IDENTITY:
-		item.value = {
-			type: value[0],
-			addr: value.slice(1)
-		}
-		const subTypeName = keyName(MessageSubType, type);
-		console.log(subTypeName, item.value, bufToAddressString(item.value.addr));
-		break;
-		default:
-		item.value = "UNHANDLED";
-		break;
+	// Types without a decoder get the value UNHANDLED, values with an invalid
+	// length are skipped
+	const decoded = decodeLtvValue(type, value);
+	if (decoded === undefined) {
+		return;
 	}
 
-	return item;
+	return { type, value: decoded };
 }
 
 export const bufToAddressString = (data) => {
@@ -298,6 +149,18 @@ export const bufToAddressString = (data) => {
 	return Array.from(data, b => b.toString(16).padStart(2, '0')).reverse().join(':').toUpperCase();
 }
 
+/**
+* bufToAddressKey
+*
+* @param data		Uint8Array with a 6 byte address
+* @returns		Address packed into an integer (48 bits, exact as a Number),
+*			for use as Map key
+*/
+export const bufToAddressKey = data => {
+	return (data[0] | data[1] << 8 | data[2] << 16) +
+		(data[3] | data[4] << 8 | data[5] << 16) * 0x1000000;
+}
+
 /**
 * ltvToPayloadArray
 *
@@ -334,51 +197,215 @@ export const ltvToTvArray = payload => {
 }
 
 /**
-* tvArrayToLtv
+* LtvView
+*
+* Lazy alternative to ltvToTvArray. The constructor only walks the LTV
+* structure once to index the entry offsets, values are decoded (and cached)
+* when an entry is looked up. Decoded items have the same {type, value} form
+* as the ones from ltvToTvArray.
+*
+* The view refers to the payload, so the payload must not be modified while
+* the view is in use.
+*/
+export class LtvView {
+	#payload
+	#offsets
+	#count
+	#items
+
+	/**
+	* @param {Uint8Array | undefined} payload	Uint8Array containing LTV fields
+	*/
+	constructor(payload) {
+		this.#payload = payload ?? new Uint8Array(0);
+		// Every entry takes at least two bytes (length and type)
+		this.#offsets = new Uint16Array(this.#payload.length >> 1);
+		this.#count = 0;
+
+		const data = this.#payload;
+		let ptr = 0;
+		while (ptr + 1 < data.length) {
+			const next = ptr + 1 + data[ptr];
+			if (data[ptr] === 0 || next > data.length) {
+				console.warn("Error in LTV structure");
+				break;
+			}
+			this.#offsets[this.#count++] = ptr;
+			ptr = next;
+		}
+	}
+
+	get length() {
+		return this.#count;
+	}
+
+	#item(index) {
+		this.#items ??= new Array(this.#count);
+
+		let item = this.#items[index];
+		if (item === undefined) {
+			const offset = this.#offsets[index];
+			const len = this.#payload[offset] - 1;
+			const value = this.#payload.subarray(offset + 2, offset + 2 + len);
+			// Entries that cannot be decoded are cached as null
+			item = parseLTVItem(this.#payload[offset + 1], len, value) ?? null;
+			this.#items[index] = item;
+		}
+
+		return item;
+	}
+
+	/**
+	* Same as tvArrayFindItem, only the matching entry is decoded
+	*
+	* @param types		Array with Types to search for
+	* @returns		First element found with type in types
+	*/
+	find(types) {
+		for (let i = 0; i < this.#count; i++) {
+			if (types.includes(this.#payload[this.#offsets[i] + 1])) {
+				const item = this.#item(i);
+				if (item) {
+					return item;
+				}
+			}
+		}
+	}
+
+	*[Symbol.iterator]() {
+		for (let i = 0; i < this.#count; i++) {
+			const item = this.#item(i);
+			if (item) {
+				yield item;
+			}
+		}
+	}
+}
+
+/**
+* messageLtv
+*
+* @param message	Message from arrayToMsg
+* @returns		LtvView of the message payload, shared by all users of the message
+*/
+export const messageLtv = message => {
+	message.ltv ??= new LtvView(message.payload);
+
+	return message.ltv;
+}
+
+/**
+* eventLatency
+*
+* @param message	Event message from arrayToMsg
+* @param timeSync	TimeSync of the device the message came from
+* @param {number} received	Host time the message was received (performance.now())
+* @returns {number | undefined}	ms from the device timestamp (taken where the
+*				event was created) to received, undefined if the
+*				event has no TIMESTAMP or the clocks are not synced
+*/
+export const eventLatency = (message, timeSync, received) => {
+	if (!timeSync?.synced) {
+		return;
+	}
+
+	const timestamp = messageLtv(message).find([BT_DataType.BT_DATA_TIMESTAMP])?.value;
+	if (timestamp === undefined) {
+		return;
+	}
+
+	return received - timeSync.toHostTime(timestamp);
+}
+
+/**
+* ltvLength
 *
 * @param arr		Type Value Array containing decoded fields [{type, value}, ...]
-* @returns 		Uint8Array containing LTV fields
+* @returns 		Byte length of the LTV fields tvArrayToLtv (or CommandEncoder) writes
 */
-export const tvArrayToLtv = arr => {
-	const result = [];
+export const ltvLength = arr => {
+	let length = 0;
+
+	for (let i = 0; i < arr.length; i++) {
+		const { type, value } = arr[i];
+
+		if (type === undefined || value === undefined) {
+			continue;
+		}
+
+		const valueLength = ltvValueLength(type, value);
+		if (valueLength < 0) {
+			continue;
+		}
+		if (valueLength > 254) {
+			throw new Error(`LTV value too long (type ${type}, ${valueLength} bytes)`);
+		}
 
-	for (const item of arr) {
-		const { type, value } = item;
-		let outArr;
+		length += valueLength + 2;
+	}
+
+	return length;
+}
+
+/**
+* writeLtv
+*
+* Writes the LTV fields through a writer (see writeLtvValue), ltvLength(arr)
+* bytes in total
+*
+* @param arr		Type Value Array containing decoded fields [{type, value}, ...]
+* @param w		Writer with u8(byte) and bytes(data, length)
+*/
+export const writeLtv = (arr, w) => {
+	for (let i = 0; i < arr.length; i++) {
+		const { type, value } = arr[i];
 
 		if (type === undefined || value === undefined) {
 			// TBD: Throw error?
 			continue;
 		}
 
-		// TODO: Add handlers for types needed for commands.
-		switch (type) {
-			case BT_DataType.BT_DATA_RPA:
-			case BT_DataType.BT_DATA_IDENTITY:
-			outArr = [value.type, ...Array.from(value.addr)];
-			break;
-			case BT_DataType.BT_DATA_BROADCAST_ID:
-			outArr = uintToArray(value, 3);	//uint24
-			break;
-			case BT_DataType.BT_DATA_PA_INTERVAL:
-			outArr = uintToArray(value, 2); //uint16
-			break;
-			case BT_DataType.BT_DATA_SID:
-			outArr = uintToArray(value, 1);	//uint8
-			break;
-			default:
-			// Don't add fields we don't handle yet
+		const valueLength = ltvValueLength(type, value);
+		if (valueLength < 0) {
+			// Don't add fields we don't handle
 			continue;
 		}
 
-		const len = outArr.length + 1;
+		w.u8(valueLength + 1);
+		w.u8(type);
+		writeLtvValue(type, value, w);
+	}
+}
+
+// Writer into a Uint8Array of the right size
+class ArrayWriter {
+	constructor(out) {
+		this.out = out;
+		this.ptr = 0;
+	}
 
-		result.push(len);
-		result.push(type);
-		result.push(...outArr);
+	u8(byte) {
+		this.out[this.ptr++] = byte;
 	}
 
-	return new Uint8Array(result);
+	bytes(data, length) {
+		for (let i = 0; i < length; i++) {
+			this.out[this.ptr++] = data[i];
+		}
+	}
+}
+
+/**
+* tvArrayToLtv
+*
+* @param arr		Type Value Array containing decoded fields [{type, value}, ...]
+* @returns 		Uint8Array containing LTV fields
+*/
+export const tvArrayToLtv = arr => {
+	const w = new ArrayWriter(new Uint8Array(ltvLength(arr)));
+	writeLtv(arr, w);
+
+	return w.out;
 }
 
 /**
@@ -398,15 +425,18 @@ const keyName = (obj, val) => {
 	return Object.entries(obj).find(i => i[1] === val)?.[0];
 }
 
-export const logString = (message, extraInfo) => {
-	const ts = (new Date()).toISOString().substring(11,23); // "HH:mm:ss.sss"
+/**
+* @param time	ms since epoch, defaults to now
+*/
+export const logString = (message, extraInfo, time = Date.now()) => {
+	const ts = (new Date(time)).toISOString().substring(11,23); // "HH:mm:ss.sss"
 
 	const typeName = keyName(MessageType, message.type);
 	const subTypeName = keyName(MessageSubType, message.subType);
 
-	const entries = ltvToTvArray(message.payload);
+	const entries = messageLtv(message);
 
-	const addr = tvArrayFindItem(entries, [
+	const addr = entries.find([
 		BT_DataType.BT_DATA_RPA,
 		BT_DataType.BT_DATA_IDENTITY
 	])?.value;
@@ -417,7 +447,7 @@ export const logString = (message, extraInfo) => {
 		addrStr = bufToAddressString(addr.addr);
 	}
 
-	const err = tvArrayFindItem(entries, [
+	const err = entries.find([
 		BT_DataType.BT_DATA_ERROR_CODE
 	])?.value;
 
@@ -0,0 +1,56 @@
+// @ts-check
+
+/**
+* Metrics
+*
+* Pipeline counters and timings for the performance overlay. Each metric
+* accumulates a total, a sample count and the largest sample until the next
+* take(). Instrumented code checks Metrics.enabled first, so the metrics
+* cost nothing (no timestamps taken) while the overlay is off.
+*
+* Names in use:
+*	usb.frames, usb.bytes	received frames/bytes (total)
+*	decode			decode time in ms (count: frames)
+*	model			model update time per message in ms
+*	render			list render time in ms (count: renders)
+*	coalesced		scan reports coalesced in the transport
+*	dropped			invalid or oversized frames
+*	list.coalesced		list updates merged into an already pending render
+*	latency			ms from the device timestamp of an event to the model
+*	events.lost		events missing in the event numbering
+*	merged			scan reports dropped, heard better by another dongle
+*/
+
+export const Metrics = new class {
+	enabled = false
+	#metrics = new Map()
+
+	/**
+	* @param {string} name
+	* @param {number} total	Value (e.g. duration in ms) or sum of values
+	* @param {number} count	Number of samples in total
+	*/
+	add(name, total = 1, count = 1) {
+		let metric = this.#metrics.get(name);
+		if (!metric) {
+			metric = { total: 0, count: 0, max: 0 };
+			this.#metrics.set(name, metric);
+		}
+
+		metric.total += total;
+		metric.count += count;
+		metric.max = Math.max(metric.max, count ? total / count : 0);
+	}
+
+	/**
+	* Get the metrics collected since the previous call, and start over
+	*
+	* @returns {Map<string, { total: number, count: number, max: number }>}
+	*/
+	take() {
+		const metrics = this.#metrics;
+		this.#metrics = new Map();
+
+		return metrics;
+	}
+}
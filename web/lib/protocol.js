@@ -0,0 +1,648 @@
+// @ts-check
+
+/**
+* Protocol definitions, LTV value decoder and encoder
+*
+* Generated by protocol/generate.js from protocol/schema.json, do not edit.
+*/
+
+const utf8decoder = new TextDecoder();
+
+export const MessageType = Object.freeze({
+	CMD: 0x01,
+	RES: 0x02,
+	EVT: 0x03
+});
+
+export const MessageSubType = Object.freeze({
+	// CMD/RES (MSB = 0)
+	START_SINK_SCAN:           0x01,
+	START_SOURCE_SCAN:         0x02,
+	START_SCAN_ALL:            0x03,
+	STOP_SCAN:                 0x04,
+	CONNECT_SINK:              0x05,
+	DISCONNECT_SINK:           0x06,
+	ADD_SOURCE:                0x07,
+	REMOVE_SOURCE:             0x08,
+	SET_LINK_PARAMS:           0x09,
+	SET_SCAN_FILTER:           0x0A,
+	GET_SCAN_FILTER_STATS:     0x0B,
+	SET_RSSI_REPORT:           0x0C,
+	GET_STATE_SNAPSHOT:        0x0D,
+	TIME_SYNC:                 0x0E,
+	ECHO:                      0x0F,
+	DISCARD:                   0x10,
+	FLOOD:                     0x11,
+	RESET:                     0x2A,
+
+	// EVT (MSB = 1)
+	SINK_FOUND:                0x81,
+	SOURCE_FOUND:              0x82,
+	SINK_CONNECTED:            0x83,
+	SINK_DISCONNECTED:         0x84,
+	SOURCE_ADDED:              0x85,
+	SOURCE_REMOVED:            0x86,
+	IDENTITY_RESOLVED:         0x8E,
+	RECV_STATE_CHANGED:        0x8F,
+	STATE_SNAPSHOT_BEGIN:      0x90,
+	SINK_STATE:                0x91,
+	STATE_SNAPSHOT_END:        0x92,
+	FLOOD_DATA:                0x93,
+	FLOOD_END:                 0x94,
+	HEARTBEAT:                 0xFF,
+});
+
+export const BT_DataType = Object.freeze({
+	BT_DATA_UUID16_SOME:               0x02,	// uint16[n]
+	BT_DATA_UUID16_ALL:                0x03,	// uint16[n]
+	BT_DATA_UUID32_SOME:               0x04,	// uint32[n]
+	BT_DATA_UUID32_ALL:                0x05,	// uint32[n]
+	BT_DATA_NAME_SHORTENED:            0x08,	// utf8 (variable len)
+	BT_DATA_NAME_COMPLETE:             0x09,	// utf8 (variable len)
+	BT_DATA_SVC_DATA16:                0x16,	// uint8[n]
+	BT_DATA_BROADCAST_NAME:            0x30,	// utf8 (variable len)
+
+	// The following types are created for this app (not standard)
+	BT_DATA_BENCH_FLOOD_STATS:         0xe0,	// uint32 (sent) + uint32 (dropped) (events sent, events not sent (no buffer))
+	BT_DATA_BENCH_BYTES:               0xe1,	// uint32 (bytes discarded since RESET)
+	BT_DATA_BENCH_FLOOD:               0xe2,	// uint16 (size) + uint16 (rate) + uint16 (duration) (payload bytes per event, events/s (0 = as fast as buffers allow), ms (0 = stop))
+	BT_DATA_BENCH_DATA:                0xe3,	// uint8[n] (filler, up to 254 bytes per entry)
+	BT_DATA_TIMESTAMP:                 0xe4,	// uint64 (device uptime in us)
+	BT_DATA_SECURITY_LEVEL:            0xe5,	// uint8 (bt_security_t)
+	BT_DATA_CONN_STATE:                0xe6,	// uint8 (1 = connecting, 2 = connected, 3 = ready (BASS discovered))
+	BT_DATA_SCAN_TARGET:               0xe7,	// uint8 (bit 0 sources, bit 1 sinks, 0 = not scanning)
+	BT_DATA_RSSI_STATS:                0xe8,	// int8 (min) + int8 (max) + uint16 (count) (raw samples since the previous report)
+	BT_DATA_RSSI_REPORT:               0xe9,	// uint8 (smoothing) + uint16 (interval) + uint8 (threshold) (EWMA weight 1/2^smoothing, ms, dB)
+	BT_DATA_FILTER_STATS:              0xea,	// uint8 (filter) + uint32 (count) (filter type, 0 = accepted, RSSI_REPORT = held back)
+	BT_DATA_FILTER_ADDR_ALLOW:         0xeb,	// (uint8 (type) + uint8[6] (addr))[n]
+	BT_DATA_FILTER_BROADCAST_ID_DENY:  0xec,	// uint24[n]
+	BT_DATA_FILTER_BROADCAST_ID_ALLOW: 0xed,	// uint24[n]
+	BT_DATA_FILTER_NAME_PREFIX:        0xee,	// utf8 (variable len)
+	BT_DATA_FILTER_MIN_RSSI:           0xef,	// int8
+	BT_DATA_SUBGROUP_METADATA:         0xf0,	// uint8 (subgroup) + uint8[n] (metadata)
+	BT_DATA_BIS_SYNC:                  0xf1,	// uint8 (subgroup) + uint32 (bis_sync) (0xFFFFFFFF = failed to sync)
+	BT_DATA_ENC_STATE:                 0xf2,	// uint8
+	BT_DATA_PA_SYNC_STATE:             0xf3,	// uint8
+	BT_DATA_SOURCE_ID:                 0xf4,	// uint8
+	BT_DATA_PHY:                       0xf5,	// uint8 (BT_GAP_LE_PHY_* bitmask)
+	BT_DATA_CONN_PARAM_STEADY:         0xf6,	// uint16 (interval_min) + uint16 (interval_max) + uint16 (latency) + uint16 (timeout)
+	BT_DATA_CONN_PARAM_SETUP:          0xf7,	// uint16 (interval_min) + uint16 (interval_max) + uint16 (latency) + uint16 (timeout)
+	BT_DATA_IDENTITY:                  0xf8,	// uint8 (type) + uint8[6] (addr)
+	BT_DATA_RPA:                       0xf9,	// uint8 (type) + uint8[6] (addr)
+	BT_DATA_BROADCAST_ID:              0xfa,	// uint24
+	BT_DATA_ERROR_CODE:                0xfb,	// int32
+	BT_DATA_PA_INTERVAL:               0xfc,	// uint16
+	BT_DATA_SID:                       0xfd,	// uint8
+	BT_DATA_RSSI:                      0xfe,	// int8
+});
+
+// Value of types without a decoder
+export const UNHANDLED = 'UNHANDLED';
+
+/**
+* decodeLtvValue
+*
+* @param {number} type		LTV type (BT_DataType)
+* @param {Uint8Array} value	LTV value (without length and type)
+* @returns {any}		Decoded value, UNHANDLED for unknown types or
+*				undefined if the length is not valid for the type
+*/
+export const decodeLtvValue = (type, value) => {
+	switch (type) {
+	case BT_DataType.BT_DATA_UUID16_SOME:
+	case BT_DataType.BT_DATA_UUID16_ALL:
+	{
+		if (value.length % 2 !== 0) {
+			return;
+		}
+		const items = [];
+		for (let i = 0; i < value.length; i += 2) {
+			items.push((value[i] | value[i + 1] << 8));
+		}
+		return items;
+	}
+	case BT_DataType.BT_DATA_UUID32_SOME:
+	case BT_DataType.BT_DATA_UUID32_ALL:
+	{
+		if (value.length % 4 !== 0) {
+			return;
+		}
+		const items = [];
+		for (let i = 0; i < value.length; i += 4) {
+			items.push((value[i] | value[i + 1] << 8 | value[i + 2] << 16 | value[i + 3] << 24) >>> 0);
+		}
+		return items;
+	}
+	case BT_DataType.BT_DATA_NAME_SHORTENED:
+	case BT_DataType.BT_DATA_NAME_COMPLETE:
+	case BT_DataType.BT_DATA_BROADCAST_NAME:
+	case BT_DataType.BT_DATA_FILTER_NAME_PREFIX:
+	{
+		return utf8decoder.decode(value);
+	}
+	case BT_DataType.BT_DATA_SVC_DATA16:
+	case BT_DataType.BT_DATA_BENCH_DATA:
+	{
+		return value.slice();
+	}
+	case BT_DataType.BT_DATA_RSSI:
+	case BT_DataType.BT_DATA_FILTER_MIN_RSSI:
+	{
+		if (value.length !== 1) {
+			return;
+		}
+		return value[0] << 24 >> 24;
+	}
+	case BT_DataType.BT_DATA_SID:
+	case BT_DataType.BT_DATA_PHY:
+	case BT_DataType.BT_DATA_SOURCE_ID:
+	case BT_DataType.BT_DATA_PA_SYNC_STATE:
+	case BT_DataType.BT_DATA_ENC_STATE:
+	case BT_DataType.BT_DATA_SCAN_TARGET:
+	case BT_DataType.BT_DATA_CONN_STATE:
+	case BT_DataType.BT_DATA_SECURITY_LEVEL:
+	{
+		if (value.length !== 1) {
+			return;
+		}
+		return value[0];
+	}
+	case BT_DataType.BT_DATA_PA_INTERVAL:
+	{
+		if (value.length !== 2) {
+			return;
+		}
+		return (value[0] | value[1] << 8);
+	}
+	case BT_DataType.BT_DATA_ERROR_CODE:
+	{
+		if (value.length !== 4) {
+			return;
+		}
+		return (value[0] | value[1] << 8 | value[2] << 16 | value[3] << 24);
+	}
+	case BT_DataType.BT_DATA_BROADCAST_ID:
+	{
+		if (value.length === 3) {
+			return (value[0] | value[1] << 8 | value[2] << 16);
+		}
+		if (value.length === 4) {
+			return (value[0] | value[1] << 8 | value[2] << 16 | value[3] << 24) >>> 0;
+		}
+		return;
+	}
+	case BT_DataType.BT_DATA_RPA:
+	case BT_DataType.BT_DATA_IDENTITY:
+	{
+		if (value.length !== 7) {
+			return;
+		}
+		return { type: value[0], addr: value.slice(1, 7) };
+	}
+	case BT_DataType.BT_DATA_CONN_PARAM_SETUP:
+	case BT_DataType.BT_DATA_CONN_PARAM_STEADY:
+	{
+		if (value.length !== 8) {
+			return;
+		}
+		return { interval_min: (value[0] | value[1] << 8), interval_max: (value[2] | value[3] << 8), latency: (value[4] | value[5] << 8), timeout: (value[6] | value[7] << 8) };
+	}
+	case BT_DataType.BT_DATA_BIS_SYNC:
+	{
+		if (value.length !== 5) {
+			return;
+		}
+		return { subgroup: value[0], bis_sync: (value[1] | value[2] << 8 | value[3] << 16 | value[4] << 24) >>> 0 };
+	}
+	case BT_DataType.BT_DATA_SUBGROUP_METADATA:
+	{
+		if (value.length < 1) {
+			return;
+		}
+		return { subgroup: value[0], metadata: value.slice(1) };
+	}
+	case BT_DataType.BT_DATA_FILTER_BROADCAST_ID_ALLOW:
+	case BT_DataType.BT_DATA_FILTER_BROADCAST_ID_DENY:
+	{
+		if (value.length % 3 !== 0) {
+			return;
+		}
+		const items = [];
+		for (let i = 0; i < value.length; i += 3) {
+			items.push((value[i] | value[i + 1] << 8 | value[i + 2] << 16));
+		}
+		return items;
+	}
+	case BT_DataType.BT_DATA_FILTER_ADDR_ALLOW:
+	{
+		if (value.length % 7 !== 0) {
+			return;
+		}
+		const items = [];
+		for (let i = 0; i < value.length; i += 7) {
+			items.push({ type: value[i], addr: value.slice(i + 1, i + 1 + 6) });
+		}
+		return items;
+	}
+	case BT_DataType.BT_DATA_FILTER_STATS:
+	{
+		if (value.length !== 5) {
+			return;
+		}
+		return { filter: value[0], count: (value[1] | value[2] << 8 | value[3] << 16 | value[4] << 24) >>> 0 };
+	}
+	case BT_DataType.BT_DATA_RSSI_REPORT:
+	{
+		if (value.length !== 4) {
+			return;
+		}
+		return { smoothing: value[0], interval: (value[1] | value[2] << 8), threshold: value[3] };
+	}
+	case BT_DataType.BT_DATA_RSSI_STATS:
+	{
+		if (value.length !== 4) {
+			return;
+		}
+		return { min: value[0] << 24 >> 24, max: value[1] << 24 >> 24, count: (value[2] | value[3] << 8) };
+	}
+	case BT_DataType.BT_DATA_TIMESTAMP:
+	{
+		if (value.length !== 8) {
+			return;
+		}
+		return ((value[0] | value[1] << 8 | value[2] << 16 | value[3] << 24) >>> 0) + ((value[4] | value[5] << 8 | value[6] << 16 | value[7] << 24) >>> 0) * 0x100000000;
+	}
+	case BT_DataType.BT_DATA_BENCH_FLOOD:
+	{
+		if (value.length !== 6) {
+			return;
+		}
+		return { size: (value[0] | value[1] << 8), rate: (value[2] | value[3] << 8), duration: (value[4] | value[5] << 8) };
+	}
+	case BT_DataType.BT_DATA_BENCH_BYTES:
+	{
+		if (value.length !== 4) {
+			return;
+		}
+		return (value[0] | value[1] << 8 | value[2] << 16 | value[3] << 24) >>> 0;
+	}
+	case BT_DataType.BT_DATA_BENCH_FLOOD_STATS:
+	{
+		if (value.length !== 8) {
+			return;
+		}
+		return { sent: (value[0] | value[1] << 8 | value[2] << 16 | value[3] << 24) >>> 0, dropped: (value[4] | value[5] << 8 | value[6] << 16 | value[7] << 24) >>> 0 };
+	}
+	default:
+		return UNHANDLED;
+	}
+}
+
+// UTF-8 length of a string, as encoded by TextEncoder (lone surrogates
+// become U+FFFD)
+export const utf8Length = str => {
+	let length = 0;
+
+	for (let i = 0; i < str.length; i++) {
+		const c = str.charCodeAt(i);
+		if (c < 0x80) {
+			length += 1;
+		} else if (c < 0x800) {
+			length += 2;
+		} else if (c >= 0xd800 && c < 0xdc00 && (str.charCodeAt(i + 1) & 0xfc00) === 0xdc00) {
+			length += 4;
+			i++;
+		} else {
+			length += 3;
+		}
+	}
+
+	return length;
+}
+
+export const writeUtf8 = (w, str) => {
+	for (let i = 0; i < str.length; i++) {
+		let c = str.charCodeAt(i);
+		if (c < 0x80) {
+			w.u8(c);
+		} else if (c < 0x800) {
+			w.u8(0xc0 | c >> 6);
+			w.u8(0x80 | c & 0x3f);
+		} else if (c >= 0xd800 && c < 0xdc00 && (str.charCodeAt(i + 1) & 0xfc00) === 0xdc00) {
+			c = 0x10000 + ((c & 0x3ff) << 10) + (str.charCodeAt(++i) & 0x3ff);
+			w.u8(0xf0 | c >> 18);
+			w.u8(0x80 | c >> 12 & 0x3f);
+			w.u8(0x80 | c >> 6 & 0x3f);
+			w.u8(0x80 | c & 0x3f);
+		} else {
+			if (c >= 0xd800 && c < 0xe000) {
+				c = 0xfffd;
+			}
+			w.u8(0xe0 | c >> 12);
+			w.u8(0x80 | c >> 6 & 0x3f);
+			w.u8(0x80 | c & 0x3f);
+		}
+	}
+}
+
+/**
+* ltvValueLength
+*
+* @param {number} type		LTV type (BT_DataType)
+* @param {any} value		Value in the form returned by decodeLtvValue
+* @returns {number}		Encoded length of the value, -1 for unknown types
+*/
+export const ltvValueLength = (type, value) => {
+	switch (type) {
+	case BT_DataType.BT_DATA_UUID16_SOME:
+	case BT_DataType.BT_DATA_UUID16_ALL:
+	{
+		return value.length * 2;
+	}
+	case BT_DataType.BT_DATA_UUID32_SOME:
+	case BT_DataType.BT_DATA_UUID32_ALL:
+	{
+		return value.length * 4;
+	}
+	case BT_DataType.BT_DATA_NAME_SHORTENED:
+	case BT_DataType.BT_DATA_NAME_COMPLETE:
+	case BT_DataType.BT_DATA_BROADCAST_NAME:
+	case BT_DataType.BT_DATA_FILTER_NAME_PREFIX:
+	{
+		return utf8Length(value);
+	}
+	case BT_DataType.BT_DATA_SVC_DATA16:
+	case BT_DataType.BT_DATA_BENCH_DATA:
+	{
+		return value.length;
+	}
+	case BT_DataType.BT_DATA_RSSI:
+	case BT_DataType.BT_DATA_SID:
+	case BT_DataType.BT_DATA_PHY:
+	case BT_DataType.BT_DATA_SOURCE_ID:
+	case BT_DataType.BT_DATA_PA_SYNC_STATE:
+	case BT_DataType.BT_DATA_ENC_STATE:
+	case BT_DataType.BT_DATA_FILTER_MIN_RSSI:
+	case BT_DataType.BT_DATA_SCAN_TARGET:
+	case BT_DataType.BT_DATA_CONN_STATE:
+	case BT_DataType.BT_DATA_SECURITY_LEVEL:
+	{
+		return 1;
+	}
+	case BT_DataType.BT_DATA_PA_INTERVAL:
+	{
+		return 2;
+	}
+	case BT_DataType.BT_DATA_ERROR_CODE:
+	case BT_DataType.BT_DATA_RSSI_REPORT:
+	case BT_DataType.BT_DATA_RSSI_STATS:
+	case BT_DataType.BT_DATA_BENCH_BYTES:
+	{
+		return 4;
+	}
+	case BT_DataType.BT_DATA_BROADCAST_ID:
+	{
+		return 3;
+	}
+	case BT_DataType.BT_DATA_RPA:
+	case BT_DataType.BT_DATA_IDENTITY:
+	{
+		return 7;
+	}
+	case BT_DataType.BT_DATA_CONN_PARAM_SETUP:
+	case BT_DataType.BT_DATA_CONN_PARAM_STEADY:
+	case BT_DataType.BT_DATA_TIMESTAMP:
+	case BT_DataType.BT_DATA_BENCH_FLOOD_STATS:
+	{
+		return 8;
+	}
+	case BT_DataType.BT_DATA_BIS_SYNC:
+	case BT_DataType.BT_DATA_FILTER_STATS:
+	{
+		return 5;
+	}
+	case BT_DataType.BT_DATA_SUBGROUP_METADATA:
+	{
+		return 1 + value.metadata.length;
+	}
+	case BT_DataType.BT_DATA_FILTER_BROADCAST_ID_ALLOW:
+	case BT_DataType.BT_DATA_FILTER_BROADCAST_ID_DENY:
+	{
+		return value.length * 3;
+	}
+	case BT_DataType.BT_DATA_FILTER_ADDR_ALLOW:
+	{
+		return value.length * 7;
+	}
+	case BT_DataType.BT_DATA_BENCH_FLOOD:
+	{
+		return 6;
+	}
+	default:
+		return -1;
+	}
+}
+
+/**
+* writeLtvValue
+*
+* Writes the value (ltvValueLength bytes) through a writer with
+* u8(byte) and bytes(data, length) methods, so values can be written
+* straight into their destination (e.g. a COBS frame) without copies.
+*
+* @param {number} type		LTV type (BT_DataType)
+* @param {any} value		Value in the form returned by decodeLtvValue
+* @param {{ u8: (byte: number) => void, bytes: (data: ArrayLike<number>, length: number) => void }} w
+*/
+export const writeLtvValue = (type, value, w) => {
+	switch (type) {
+	case BT_DataType.BT_DATA_UUID16_SOME:
+	case BT_DataType.BT_DATA_UUID16_ALL:
+	{
+		for (let i = 0; i < value.length; i++) {
+			const item = value[i];
+			w.u8(item);
+			w.u8(item >> 8);
+		}
+		return;
+	}
+	case BT_DataType.BT_DATA_UUID32_SOME:
+	case BT_DataType.BT_DATA_UUID32_ALL:
+	{
+		for (let i = 0; i < value.length; i++) {
+			const item = value[i];
+			w.u8(item);
+			w.u8(item >> 8);
+			w.u8(item >> 16);
+			w.u8(item >> 24);
+		}
+		return;
+	}
+	case BT_DataType.BT_DATA_NAME_SHORTENED:
+	case BT_DataType.BT_DATA_NAME_COMPLETE:
+	case BT_DataType.BT_DATA_BROADCAST_NAME:
+	case BT_DataType.BT_DATA_FILTER_NAME_PREFIX:
+	{
+		writeUtf8(w, value);
+		return;
+	}
+	case BT_DataType.BT_DATA_SVC_DATA16:
+	case BT_DataType.BT_DATA_BENCH_DATA:
+	{
+		w.bytes(value, value.length);
+		return;
+	}
+	case BT_DataType.BT_DATA_RSSI:
+	case BT_DataType.BT_DATA_SID:
+	case BT_DataType.BT_DATA_PHY:
+	case BT_DataType.BT_DATA_SOURCE_ID:
+	case BT_DataType.BT_DATA_PA_SYNC_STATE:
+	case BT_DataType.BT_DATA_ENC_STATE:
+	case BT_DataType.BT_DATA_FILTER_MIN_RSSI:
+	case BT_DataType.BT_DATA_SCAN_TARGET:
+	case BT_DataType.BT_DATA_CONN_STATE:
+	case BT_DataType.BT_DATA_SECURITY_LEVEL:
+	{
+		w.u8(value);
+		return;
+	}
+	case BT_DataType.BT_DATA_PA_INTERVAL:
+	{
+		w.u8(value);
+		w.u8(value >> 8);
+		return;
+	}
+	case BT_DataType.BT_DATA_ERROR_CODE:
+	case BT_DataType.BT_DATA_BENCH_BYTES:
+	{
+		w.u8(value);
+		w.u8(value >> 8);
+		w.u8(value >> 16);
+		w.u8(value >> 24);
+		return;
+	}
+	case BT_DataType.BT_DATA_BROADCAST_ID:
+	{
+		w.u8(value);
+		w.u8(value >> 8);
+		w.u8(value >> 16);
+		return;
+	}
+	case BT_DataType.BT_DATA_RPA:
+	case BT_DataType.BT_DATA_IDENTITY:
+	{
+		w.u8(value.type);
+		w.bytes(value.addr, 6);
+		return;
+	}
+	case BT_DataType.BT_DATA_CONN_PARAM_SETUP:
+	case BT_DataType.BT_DATA_CONN_PARAM_STEADY:
+	{
+		w.u8(value.interval_min);
+		w.u8(value.interval_min >> 8);
+		w.u8(value.interval_max);
+		w.u8(value.interval_max >> 8);
+		w.u8(value.latency);
+		w.u8(value.latency >> 8);
+		w.u8(value.timeout);
+		w.u8(value.timeout >> 8);
+		return;
+	}
+	case BT_DataType.BT_DATA_BIS_SYNC:
+	{
+		w.u8(value.subgroup);
+		w.u8(value.bis_sync);
+		w.u8(value.bis_sync >> 8);
+		w.u8(value.bis_sync >> 16);
+		w.u8(value.bis_sync >> 24);
+		return;
+	}
+	case BT_DataType.BT_DATA_SUBGROUP_METADATA:
+	{
+		w.u8(value.subgroup);
+		w.bytes(value.metadata, value.metadata.length);
+		return;
+	}
+	case BT_DataType.BT_DATA_FILTER_BROADCAST_ID_ALLOW:
+	case BT_DataType.BT_DATA_FILTER_BROADCAST_ID_DENY:
+	{
+		for (let i = 0; i < value.length; i++) {
+			const item = value[i];
+			w.u8(item);
+			w.u8(item >> 8);
+			w.u8(item >> 16);
+		}
+		return;
+	}
+	case BT_DataType.BT_DATA_FILTER_ADDR_ALLOW:
+	{
+		for (let i = 0; i < value.length; i++) {
+			const item = value[i];
+			w.u8(item.type);
+			w.bytes(item.addr, 6);
+		}
+		return;
+	}
+	case BT_DataType.BT_DATA_FILTER_STATS:
+	{
+		w.u8(value.filter);
+		w.u8(value.count);
+		w.u8(value.count >> 8);
+		w.u8(value.count >> 16);
+		w.u8(value.count >> 24);
+		return;
+	}
+	case BT_DataType.BT_DATA_RSSI_REPORT:
+	{
+		w.u8(value.smoothing);
+		w.u8(value.interval);
+		w.u8(value.interval >> 8);
+		w.u8(value.threshold);
+		return;
+	}
+	case BT_DataType.BT_DATA_RSSI_STATS:
+	{
+		w.u8(value.min);
+		w.u8(value.max);
+		w.u8(value.count);
+		w.u8(value.count >> 8);
+		return;
+	}
+	case BT_DataType.BT_DATA_TIMESTAMP:
+	{
+		w.u8(value);
+		w.u8(value >> 8);
+		w.u8(value >> 16);
+		w.u8(value >> 24);
+		w.u8(value / 0x100000000);
+		w.u8(value / 0x100000000 >> 8);
+		w.u8(value / 0x100000000 >> 16);
+		w.u8(value / 0x100000000 >> 24);
+		return;
+	}
+	case BT_DataType.BT_DATA_BENCH_FLOOD:
+	{
+		w.u8(value.size);
+		w.u8(value.size >> 8);
+		w.u8(value.rate);
+		w.u8(value.rate >> 8);
+		w.u8(value.duration);
+		w.u8(value.duration >> 8);
+		return;
+	}
+	case BT_DataType.BT_DATA_BENCH_FLOOD_STATS:
+	{
+		w.u8(value.sent);
+		w.u8(value.sent >> 8);
+		w.u8(value.sent >> 16);
+		w.u8(value.sent >> 24);
+		w.u8(value.dropped);
+		w.u8(value.dropped >> 8);
+		w.u8(value.dropped >> 16);
+		w.u8(value.dropped >> 24);
+		return;
+	}
+	default:
+		return;
+	}
+}
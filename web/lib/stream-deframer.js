@@ -0,0 +1,114 @@
+// @ts-check
+
+/**
+* Stream deframer for zero delimited (COBS) frames
+*
+* USB transfers do not line up with frames: one transfer can hold several
+* frames and a frame can be split over several transfers. push() splits each
+* chunk on zero bytes and calls onFrame for every complete frame, in order.
+* Frames are passed without their delimiter.
+*
+* Frames that are fully contained in a chunk are passed as subarray views of
+* that chunk (no copy). Frames that span chunks are assembled in an internal
+* carry buffer. In both cases the frame is only valid during the callback.
+*
+* A partial frame growing beyond maxFrameSize is dropped and the deframer
+* resyncs on the next zero delimiter.
+*/
+
+const DEFAULT_MAX_FRAME_SIZE = 8192;
+
+export class StreamDeframer {
+	#carry
+	#carryLength
+	#dropping
+	#dropped
+	#maxFrameSize
+
+	constructor(maxFrameSize = DEFAULT_MAX_FRAME_SIZE) {
+		this.#maxFrameSize = maxFrameSize;
+		this.#carry = new Uint8Array(256);
+		this.#carryLength = 0;
+		this.#dropping = false;
+		this.#dropped = 0;
+	}
+
+	/**
+	* Number of oversized frames dropped so far
+	*/
+	get dropped() {
+		return this.#dropped;
+	}
+
+	/**
+	* Forget any partial frame (e.g. after reopening the device)
+	*/
+	reset() {
+		this.#carryLength = 0;
+		this.#dropping = false;
+	}
+
+	/**
+	* @param {Uint8Array} chunk
+	* @param {(frame: Uint8Array) => void} onFrame
+	*/
+	push(chunk, onFrame) {
+		let start = 0;
+
+		while (start < chunk.length) {
+			const end = chunk.indexOf(0, start);
+
+			if (end === -1) {
+				this.#append(chunk.subarray(start));
+				return;
+			}
+
+			if (this.#dropping) {
+				// End of an oversized frame, resync
+				this.#dropping = false;
+			} else if (this.#carryLength) {
+				this.#append(chunk.subarray(start, end));
+				if (!this.#dropping) {
+					onFrame(this.#carry.subarray(0, this.#carryLength));
+				}
+				this.#carryLength = 0;
+				this.#dropping = false;
+			} else if (end > start) {
+				// Empty frames (back to back delimiters) are skipped
+				onFrame(chunk.subarray(start, end));
+			}
+
+			start = end + 1;
+		}
+	}
+
+	#append(data) {
+		if (this.#dropping) {
+			return;
+		}
+
+		const length = this.#carryLength + data.length;
+
+		if (length > this.#maxFrameSize) {
+			console.warn(`Frame exceeds ${this.#maxFrameSize} bytes, dropping`);
+			this.#carryLength = 0;
+			this.#dropping = true;
+			this.#dropped++;
+			return;
+		}
+
+		if (length > this.#carry.length) {
+			let size = this.#carry.length;
+			while (size < length) {
+				size *= 2;
+			}
+
+			const carry = new Uint8Array(size);
+			carry.set(this.#carry.subarray(0, this.#carryLength));
+			this.#carry = carry;
+		}
+
+		this.#carry.set(data, this.#carryLength);
+		this.#carryLength = length;
+	}
+}
@@ -0,0 +1,214 @@
+// @ts-check
+
+/**
+* Time Sync
+*
+* Maps the device clock (uptime in µs, see the TIMESTAMP LTV) to the host
+* clock (performance.now() in ms), from TIME_SYNC round trips.
+*
+* A sample is the device time in the TIME_SYNC response, with the host times
+* the command was sent and the response received. The device time is
+* assumed to be taken in the middle of the round trip, so the error of a
+* sample is at most half its round trip time. Samples with a short round
+* trip are the precise ones: the offset is fitted through the samples close
+* to the shortest round trip, the drift (ppm) is the slope of that fit.
+*
+* LatencyStats collects the event latencies (see eventLatency() in
+* message.js) per event subType, in the same form as the command round trip
+* times of the CommandManager.
+*/
+
+import { RTT_BUCKETS } from './command-manager.js';
+
+// Samples kept for the fit, one TIME_SYNC every few seconds covers minutes
+const SYNC_SAMPLES = 32;
+
+// Samples used for the fit: round trip at most this much above the shortest
+const RTT_SLACK_MS = 1;
+
+// Latencies kept per event subType for the percentiles
+const LATENCY_SAMPLES = 200;
+
+export class TimeSync {
+	#samples
+	#offset
+	#drift
+	#origin
+
+	constructor() {
+		this.#samples = [];
+		this.reset();
+	}
+
+	/**
+	* Forget the samples (e.g. the device restarted)
+	*/
+	reset() {
+		this.#samples = [];
+		this.#offset = undefined;
+		this.#drift = 0;
+		this.#origin = 0;
+	}
+
+	get synced() {
+		return this.#offset !== undefined;
+	}
+
+	/**
+	* Device minus host time in ms, at the latest sample
+	*/
+	get offset() {
+		return this.synced ? this.#offsetAt(this.#samples[this.#samples.length - 1].host) : undefined;
+	}
+
+	/**
+	* Device clock rate relative to the host clock, in ppm
+	*/
+	get drift() {
+		return this.#drift * 1e6;
+	}
+
+	/**
+	* Shortest round trip of the samples in ms, the offset is within half of it
+	*/
+	get rtt() {
+		return this.#samples.length ? Math.min(...this.#samples.map(sample => sample.rtt)) : undefined;
+	}
+
+	/**
+	* @param {number} sent		Host time the TIME_SYNC command was sent (ms)
+	* @param {number} timestamp	Device time in the response (µs)
+	* @param {number} received	Host time the response was received (ms)
+	*/
+	addSample(sent, timestamp, received) {
+		const rtt = received - sent;
+		const host = sent + rtt / 2;
+		const last = this.#samples[this.#samples.length - 1];
+
+		// The device restarted (or a stale response)
+		if (last && timestamp / 1000 < last.device) {
+			this.reset();
+		}
+
+		if (this.#samples.length === SYNC_SAMPLES) {
+			this.#samples.shift();
+		}
+		this.#samples.push({ host, device: timestamp / 1000, rtt });
+
+		this.#fit();
+	}
+
+	#offsetAt(host) {
+		return /** @type {number} */ (this.#offset) + this.#drift * (host - this.#origin);
+	}
+
+	// Least squares fit of offset = device - host over the precise samples
+	#fit() {
+		const best = /** @type {number} */ (this.rtt);
+		const samples = this.#samples.filter(sample => sample.rtt <= best + RTT_SLACK_MS);
+
+		const origin = samples[0].host;
+		let sumX = 0;
+		let sumY = 0;
+		for (const { host, device } of samples) {
+			sumX += host - origin;
+			sumY += device - host;
+		}
+
+		const meanX = sumX / samples.length;
+		const meanY = sumY / samples.length;
+
+		let sxx = 0;
+		let sxy = 0;
+		for (const { host, device } of samples) {
+			const x = host - origin - meanX;
+			sxx += x * x;
+			sxy += x * (device - host - meanY);
+		}
+
+		// A single sample (or all at once) gives no drift
+		this.#drift = sxx > 0 ? sxy / sxx : 0;
+		this.#origin = origin + meanX;
+		this.#offset = meanY;
+	}
+
+	/**
+	* @param {number} timestamp	Device time (µs)
+	* @returns {number | undefined}	Host time (ms), undefined until synced
+	*/
+	toHostTime(timestamp) {
+		if (!this.synced) {
+			return;
+		}
+
+		// device = host + offset + drift * (host - origin), solved for host
+		const device = timestamp / 1000;
+
+		return (device - /** @type {number} */ (this.#offset) + this.#drift * this.#origin) / (1 + this.#drift);
+	}
+}
+
+export class LatencyStats {
+	#latencies
+
+	constructor() {
+		this.#latencies = new Map();
+	}
+
+	/**
+	* @param {number} subType	Event subType
+	* @param {number} latency	ms from the device timestamp to the host
+	*/
+	add(subType, latency) {
+		let stats = this.#latencies.get(subType);
+		if (!stats) {
+			stats = { count: 0, total: 0, min: Infinity, max: -Infinity, samples: [] };
+			this.#latencies.set(subType, stats);
+		}
+
+		stats.count++;
+		stats.total += latency;
+		stats.min = Math.min(stats.min, latency);
+		stats.max = Math.max(stats.max, latency);
+
+		if (stats.samples.length === LATENCY_SAMPLES) {
+			stats.samples.shift();
+		}
+		stats.samples.push(latency);
+	}
+
+	/**
+	* @returns	Map of subType -> { count, min, max, mean, p50, p95, histogram }
+	*		(times in ms, histogram: sample counts per RTT_BUCKETS bucket)
+	*/
+	getStats() {
+		const result = new Map();
+
+		for (const [subType, stats] of this.#latencies) {
+			const sorted = stats.samples.slice().sort((a, b) => a - b);
+			const percentile = p => sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+
+			const histogram = new Array(RTT_BUCKETS.length + 1).fill(0);
+			for (const latency of sorted) {
+				const bucket = RTT_BUCKETS.findIndex(bound => latency <= bound);
+				histogram[bucket === -1 ? RTT_BUCKETS.length : bucket]++;
+			}
+
+			result.set(subType, {
+				count: stats.count,
+				min: stats.min,
+				max: stats.max,
+				mean: stats.total / stats.count,
+				p50: percentile(0.5),
+				p95: percentile(0.95),
+				histogram
+			});
+		}
+
+		return result;
+	}
+
+	reset() {
+		this.#latencies.clear();
+	}
+}
@@ -0,0 +1,174 @@
+// @ts-check
+
+import { MessageType, MessageSubType, BT_DataType, messageLtv, tvArrayToLtv } from './message.js';
+
+/**
+* USB Benchmark
+*
+* Measures the USB link to the device on its own, without the Bluetooth side,
+* with the benchmark commands of the firmware:
+*
+* - echo: ECHO commands one at a time, round trip times per payload size
+* - discard: DISCARD commands with the command window full, host to device
+*   throughput
+* - flood: FLOOD_DATA events sent by the device at a rate (0: as fast as its
+*   buffers allow), device to host throughput and events lost on the way
+*
+* Bytes are counted as messages (header and payload), before COBS framing.
+* Works with any device service (sendCMD() and 'message' events).
+*/
+
+const HEADER_SIZE = 5;
+
+// Value bytes per BENCH_DATA entry
+const BENCH_DATA_MAX = 254;
+
+// Time for FLOOD_END to arrive after the flood duration
+const FLOOD_END_TIMEOUT_MS = 2000;
+
+/**
+* @param {number} size	Payload bytes, as BENCH_DATA entries (split as bench_fill()
+*			in the firmware does)
+* @returns {Uint8Array}
+*/
+export const benchPayload = size => {
+	const items = [];
+
+	while (size >= 2) {
+		let len = Math.min(size - 2, BENCH_DATA_MAX);
+		// A single byte left could not be an entry
+		if (size - 2 - len === 1) {
+			len--;
+		}
+		items.push({ type: BT_DataType.BT_DATA_BENCH_DATA, value: new Uint8Array(len) });
+		size -= 2 + len;
+	}
+
+	return tvArrayToLtv(items);
+}
+
+const errorCode = message => messageLtv(message).find([BT_DataType.BT_DATA_ERROR_CODE])?.value;
+
+const percentiles = samples => {
+	const sorted = samples.slice().sort((a, b) => a - b);
+	const percentile = p => sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+
+	return { p50: percentile(0.5), p95: percentile(0.95), p99: percentile(0.99) };
+}
+
+export class UsbBench {
+	#service
+
+	constructor(service) {
+		this.#service = service;
+	}
+
+	async #command(subType, payload) {
+		const response = await this.#service.sendCMD({ type: MessageType.CMD, subType, payload });
+
+		const err = errorCode(response);
+		if (err !== 0) {
+			throw new Error(`Command 0x${subType.toString(16)} failed (err ${err})`);
+		}
+
+		return response;
+	}
+
+	/**
+	* @param {number} size	Payload bytes
+	* @param {number} count	Commands
+	*/
+	async echo(size, count) {
+		const payload = benchPayload(size);
+		const rtts = [];
+
+		const start = performance.now();
+		for (let i = 0; i < count; i++) {
+			const sent = performance.now();
+			const response = await this.#command(MessageSubType.ECHO, payload);
+			rtts.push(performance.now() - sent);
+
+			// ERROR_CODE, then the command payload
+			if (response.payload.length !== payload.length + 6) {
+				throw new Error(`ECHO returned ${response.payload.length - 6} of ${payload.length} bytes`);
+			}
+		}
+		const seconds = (performance.now() - start) / 1000;
+
+		// Both directions
+		const frames = 2 * count;
+		const bytes = count * (2 * (HEADER_SIZE + payload.length) + 6);
+
+		return { test: 'echo', size: payload.length, frames, framesPerSec: frames / seconds, mbPerSec: bytes / seconds / 1e6, ...percentiles(rtts) };
+	}
+
+	/**
+	* @param {number} size	Payload bytes
+	* @param {number} count	Commands
+	*/
+	async discard(size, count) {
+		const payload = benchPayload(size);
+
+		const start = performance.now();
+		// The command manager keeps its window of commands in flight
+		await Promise.all(Array.from({ length: count }, () => this.#command(MessageSubType.DISCARD, payload)));
+		const seconds = (performance.now() - start) / 1000;
+
+		return { test: 'discard', size: payload.length, frames: count, framesPerSec: count / seconds, mbPerSec: count * (HEADER_SIZE + payload.length) / seconds / 1e6 };
+	}
+
+	/**
+	* @param {number} size		Payload bytes per event
+	* @param {number} rate		Events/s, 0 = as fast as the device can
+	* @param {number} duration	ms
+	*/
+	async flood(size, rate, duration) {
+		let frames = 0;
+		let bytes = 0;
+		let first = 0;
+		let last = 0;
+		let onEnd;
+		const ended = new Promise(resolve => { onEnd = resolve; });
+
+		const onMessage = evt => {
+			const { message } = evt.detail;
+			if (message.type !== MessageType.EVT) {
+				return;
+			}
+
+			if (message.subType === MessageSubType.FLOOD_DATA) {
+				last = performance.now();
+				first ||= last;
+				frames++;
+				bytes += HEADER_SIZE + message.payload.length;
+			} else if (message.subType === MessageSubType.FLOOD_END) {
+				onEnd(messageLtv(message).find([BT_DataType.BT_DATA_BENCH_FLOOD_STATS])?.value);
+			}
+		}
+
+		this.#service.addEventListener('message', onMessage);
+
+		let stats;
+		try {
+			const config = tvArrayToLtv([{ type: BT_DataType.BT_DATA_BENCH_FLOOD, value: { size, rate, duration } }]);
+			await this.#command(MessageSubType.FLOOD, config);
+
+			let timer;
+			const timeout = new Promise(resolve => { timer = setTimeout(resolve, duration + FLOOD_END_TIMEOUT_MS); });
+			stats = await Promise.race([ended, timeout]);
+			clearTimeout(timer);
+		} finally {
+			this.#service.removeEventListener('message', onMessage);
+		}
+
+		// From the first to the last event, the time to the first one is latency
+		const seconds = frames > 1 ? (last - first) / 1000 : duration / 1000;
+
+		return {
+			test: 'flood', size, frames,
+			framesPerSec: frames / seconds, mbPerSec: bytes / seconds / 1e6,
+			sent: stats?.sent, dropped: stats?.dropped,
+			lost: stats ? stats.sent - frames : undefined
+		};
+	}
+}
@@ -0,0 +1,207 @@
+// @ts-check
+
+import { Metrics } from './metrics.js';
+
+/**
+* Virtual List
+*
+* Renders a list of models as fixed height rows inside a scroll container.
+* Only the rows in (or close to) the visible part of the container exist as
+* elements, and elements are reused for other models when scrolling.
+*
+* Changes (add, update, remove, filter, scroll) are collected and applied
+* once per animation frame, so a burst of model events costs a single render.
+* Rendered elements are found through a Map keyed by the model.
+*
+* Item elements must implement setModel(model), getModel() and refresh().
+*/
+
+// Rows rendered above and below the visible part of the container
+const OVERSCAN_ROWS = 4;
+
+export class VirtualList {
+	#viewport
+	#content
+	#rowHeight
+	#createItem
+	#matches
+	#models
+	#filtered
+	#tokens
+	#dirty
+	#elements
+	#free
+	#frame
+
+	/**
+	* @param {HTMLElement} viewport		Scroll container (should have a limited height)
+	* @param {object} options
+	* @param {number} options.rowHeight	Height of a row in pixels
+	* @param {() => HTMLElement} options.createItem	Creates an item element
+	* @param {(model: any, token: string) => boolean} options.matches	Filter predicate
+	*/
+	constructor(viewport, { rowHeight, createItem, matches }) {
+		this.#viewport = viewport;
+		this.#rowHeight = rowHeight;
+		this.#createItem = createItem;
+		this.#matches = matches;
+
+		this.#models = [];
+		this.#tokens = [];
+		this.#dirty = new Set();
+		this.#elements = new Map();
+		this.#free = [];
+
+		this.#content = document.createElement('div');
+		this.#content.style.position = 'relative';
+		this.#viewport.style.overflowY = 'auto';
+		this.#viewport.appendChild(this.#content);
+
+		this.#viewport.addEventListener('scroll', () => this.#schedule(), { passive: true });
+		window.addEventListener('resize', () => this.#schedule());
+	}
+
+	get length() {
+		return (this.#filtered ?? this.#models).length;
+	}
+
+	add(model) {
+		this.#models.push(model);
+
+		if (this.#filtered && this.#matchesFilter(model)) {
+			this.#filtered.push(model);
+		}
+
+		this.#schedule();
+	}
+
+	update(model) {
+		if (Metrics.enabled && this.#frame !== undefined) {
+			Metrics.add('list.coalesced');
+		}
+
+		this.#dirty.add(model);
+
+		if (this.#filtered) {
+			// The update may change whether the model passes the filter
+			this.#filtered = undefined;
+		}
+
+		this.#schedule();
+	}
+
+	remove(model) {
+		const index = this.#models.indexOf(model);
+		if (index === -1) {
+			return;
+		}
+
+		this.#models.splice(index, 1);
+
+		if (this.#filtered) {
+			this.#filtered = undefined;
+		}
+
+		this.#schedule();
+	}
+
+	clear() {
+		this.#models = [];
+		this.#filtered = undefined;
+		this.#dirty.clear();
+		this.#schedule();
+	}
+
+	/**
+	* @param {string[]} tokens	Models must match all tokens, empty to show all
+	*/
+	setFilter(tokens) {
+		this.#tokens = tokens;
+		this.#filtered = undefined;
+		this.#schedule();
+	}
+
+	sort(compare) {
+		this.#models.sort(compare);
+		this.#filtered = undefined;
+		this.#schedule();
+	}
+
+	#matchesFilter(model) {
+		return this.#tokens.every(t => this.#matches(model, t));
+	}
+
+	#schedule() {
+		this.#frame ??= requestAnimationFrame(() => this.#render());
+	}
+
+	#newElement() {
+		const el = this.#createItem();
+		el.style.position = 'absolute';
+		el.style.left = '0';
+		el.style.right = '0';
+		el.style.top = '0';
+
+		// Must be connected before setModel(), items look up their parts
+		// in connectedCallback
+		this.#content.appendChild(el);
+
+		return el;
+	}
+
+	#render() {
+		const start = Metrics.enabled ? performance.now() : 0;
+		this.#frame = undefined;
+
+		if (this.#filtered === undefined && this.#tokens.length) {
+			this.#filtered = this.#models.filter(m => this.#matchesFilter(m));
+		}
+
+		const rows = this.#filtered ?? this.#models;
+		const rowHeight = this.#rowHeight;
+		const { scrollTop, clientHeight } = this.#viewport;
+
+		this.#content.style.height = `${rows.length * rowHeight}px`;
+
+		const first = Math.max(0, Math.floor(scrollTop / rowHeight) - OVERSCAN_ROWS);
+		const last = Math.min(rows.length, Math.ceil((scrollTop + clientHeight) / rowHeight) + OVERSCAN_ROWS);
+
+		// Rows that are no longer visible are kept for reuse
+		const inView = new Set(rows.slice(first, last));
+		for (const [model, el] of this.#elements) {
+			if (!inView.has(model)) {
+				el.hidden = true;
+				this.#free.push(el);
+				this.#elements.delete(model);
+			}
+		}
+
+		const elements = new Map();
+
+		for (let i = first; i < last; i++) {
+			const model = rows[i];
+
+			let el = this.#elements.get(model);
+			if (el) {
+				this.#elements.delete(model);
+				if (this.#dirty.has(model)) {
+					el.refresh();
+				}
+			} else {
+				el = this.#free.pop() ?? this.#newElement();
+				el.hidden = false;
+				el.setModel(model);
+			}
+
+			el.style.transform = `translateY(${i * rowHeight}px)`;
+			elements.set(model, el);
+		}
+
+		this.#elements = elements;
+		this.#dirty.clear();
+
+		if (Metrics.enabled) {
+			Metrics.add('render', performance.now() - start);
+		}
+	}
+}
@@ -3,11 +3,19 @@
 import './components/sink-device-list.js';
 import './components/source-device-list.js';
 import './components/heart-beat.js';
+import { DongleStatus } from './components/dongle-status.js';
+import { ActivityLogView } from './components/activity-log.js';
+import { PerfOverlay } from './components/perf-overlay.js';
 
 import * as AssistantModel from './models/assistant-model.js';
 import { WebUSBDeviceService } from './services/webusb-device-service.js';
+import { MockDevice, MockDeviceService } from './services/mock-device-service.js';
+import { MultiDeviceService } from './services/multi-device-service.js';
+import { ReplayDeviceService } from './services/replay-device-service.js';
+import { downloadData, fileTimestamp } from './lib/helpers.js';
+import { DeviceStore } from './lib/device-store.js';
+import { ActivityLog } from './lib/activity-log.js';
 import {
-	logString,
 	MessageType,
 	MessageSubType,
 } from './lib/message.js';
@@ -170,8 +178,11 @@ button:disabled {
 			<button id="sink_scan">Discover<br>Sinks</button>
 			<button id='stop_scan'>Stop<br>Scanning</button>
 			<button id="source_scan">Discover<br>Sources</button>
+			<button id="save_capture">Save<br>Capture</button>
 			</div>
 
+			<dongle-status></dongle-status>
+
 			<!-- broadcast sink components... -->
 			<sink-device-list></sink-device-list>
 
@@ -184,11 +195,13 @@ button:disabled {
 <div class="activity-container">
 	<div class="content">
 		<div class="col">
-			<div id="activity" class="textbox"></div>
+			<activity-log id="activity" class="textbox"></activity-log>
 		</div>
 	</div>
 </div>
 
+<perf-overlay></perf-overlay>
+
 <div id="splashbox">
 	<div class="splashcontent">
 		<div class="col">
@@ -205,6 +218,7 @@ export class MainApp extends HTMLElement {
 	#scanSourceButton
 	#stopScanButton
 	#model
+	#service
 	#pageState
 
 	constructor() {
@@ -234,14 +248,76 @@ export class MainApp extends HTMLElement {
 	initializeModels() {
 		console.log("Initialize Models...");
 
-		this.#model = AssistantModel.initializeAssistantModel(WebUSBDeviceService);
+		if (this.#pageState.get('mock') === 'y') {
+			// Synthetic device, e.g. ?mock=y&sources=500&sinks=20&adv_rate=5
+			const options = {};
+			for (const [param, option] of [
+				['sources', 'sources'],
+				['sinks', 'sinks'],
+				['adv_rate', 'advRate'],
+				['rpa_rotation', 'rpaRotation'],
+				['latency', 'latency'],
+				['connect_fail_rate', 'connectFailRate'],
+				['event_loss_rate', 'eventLossRate'],
+			]) {
+				if (this.#pageState.has(param)) {
+					options[option] = Number(this.#pageState.get(param));
+				}
+			}
+
+			// Several dongles in the same room, e.g. ?mock=y&dongles=3&dongle_capacity=2
+			const dongles = Number(this.#pageState.get('dongles') ?? 1);
+			if (dongles > 1) {
+				const service = new MultiDeviceService();
+				for (let i = 1; i <= dongles; i++) {
+					const mock = new MockDevice();
+					mock.configure({ ...options, seed: 1, placement: i });
+					service.addDongle(`mock-${i}`, mock);
+				}
+				this.#service = service;
+			} else {
+				MockDeviceService.configure(options);
+				this.#service = MockDeviceService;
+			}
+		} else if (this.#pageState.has('replay')) {
+			// Capture playback, e.g. ?replay=captures/venue.wbac&replay_speed=1
+			ReplayDeviceService.setSpeed(Number(this.#pageState.get('replay_speed') ?? 0));
+			this.#service = ReplayDeviceService;
+		} else {
+			this.#service = WebUSBDeviceService;
+		}
+
+		if (this.#pageState.has('reads')) {
+			this.#service.setReadsInFlight(Number(this.#pageState.get('reads')));
+		}
+
+		if (this.#pageState.has('dongle_capacity') && this.#service instanceof MultiDeviceService) {
+			this.#service.setDongleCapacity(Number(this.#pageState.get('dongle_capacity')));
+		}
+
+		// Known devices are kept between sessions for the real device (or ?store=y)
+		let store;
+		if (this.#service === WebUSBDeviceService || this.#pageState.get('store') === 'y') {
+			store = new DeviceStore(AssistantModel.serializeDevice);
+			window.addEventListener('pagehide', () => store.flush());
+		}
+
+		this.#model = AssistantModel.initializeAssistantModel(this.#service, store);
+
+		store?.open()
+		.then(() => this.#model.hydrate())
+		.catch(error => { console.log('Device store not available', error); });
 	}
 
 	initializeLogging(el) {
-		if (!(el instanceof HTMLElement)) {
+		if (!(el instanceof ActivityLogView)) {
 			return;
 		}
 
+		// Entries kept, e.g. ?log=y&log_size=50000
+		const log = new ActivityLog(Number(this.#pageState.get('log_size')));
+		el.log = log;
+
 		let lastLogMsg;
 
 		const filterLog = message => {
@@ -277,34 +353,56 @@ export class MainApp extends HTMLElement {
 				extraInfo = " (silencing similar...)";
 			}
 
-			const logStr = logString(message, extraInfo);
-
-			// TBD: Change the crude prepend if performing bad on large content
-			el.textContent = logStr + '\n' + el.textContent;
-			console.log(logStr);
+			log.push(message, { outgoing: evt.type === 'command-sent', extraInfo });
+			el.changed();
 		}
 
-		WebUSBDeviceService.addEventListener('message', addToLog);
-		WebUSBDeviceService.addEventListener('command-sent', addToLog);
+		this.#service.addEventListener('message', addToLog);
+		this.#service.addEventListener('command-sent', addToLog);
 
 		el.addEventListener('click', () => {
 			el.classList.toggle('expanded');
 		});
 	}
 
+	initializeCapture(button) {
+		// Capture all transfers from connect, saving starts a new capture
+		this.#service.addEventListener('connected', () => this.#service.startCapture());
+
+		button?.addEventListener('click', async () => {
+			const capture = await this.#service.stopCapture();
+			this.#service.startCapture();
+
+			downloadData(capture, `capture-${fileTimestamp()}.wbac`);
+		});
+	}
+
+	async startReplay(url) {
+		try {
+			const response = await fetch(url);
+			ReplayDeviceService.load(new Uint8Array(await response.arrayBuffer()));
+
+			const result = await ReplayDeviceService.replay();
+			console.log(`Replayed ${result.records} records (${result.duration.toFixed(0)} ms captured)` +
+				` in ${result.elapsed.toFixed(0)} ms`);
+		} catch (error) {
+			console.log('Replay failed', error);
+		}
+	}
+
 	connectedCallback() {
 		console.log("connectedCallback - MainApp");
 
 		this.shadowRoot?.appendChild(template.content.cloneNode(true));
 
 		const button = this.shadowRoot?.querySelector('#connect');
-		button?.addEventListener('click', WebUSBDeviceService.scan);
+		button?.addEventListener('click', this.#service.scan);
 
 		const splashbox = this.shadowRoot?.querySelector('#splashbox');
-		WebUSBDeviceService.addEventListener('connected', () => { splashbox?.classList.add('hidden') });
-		WebUSBDeviceService.addEventListener('disconnected', () => { splashbox?.classList.remove('hidden') });
+		this.#service.addEventListener('connected', () => { splashbox?.classList.add('hidden') });
+		this.#service.addEventListener('disconnected', () => { splashbox?.classList.remove('hidden') });
 
-		WebUSBDeviceService.addEventListener('connected', this.sendReset);
+		this.#service.addEventListener('connected', this.sendReset);
 
 		this.#stopScanButton = this.shadowRoot?.querySelector('#stop_scan');
 		this.#stopScanButton.addEventListener('click', this.sendStopScan);
@@ -335,12 +433,44 @@ export class MainApp extends HTMLElement {
 			heartbeat?.remove();
 		}
 
+		// Pipeline metrics, e.g. ?perf=y
+		const perfOverlay = this.shadowRoot?.querySelector('perf-overlay');
+		if (this.#pageState.get('perf') === 'y' && perfOverlay instanceof PerfOverlay) {
+			perfOverlay.service = this.#service;
+		} else {
+			perfOverlay?.remove();
+		}
+
+		// Per dongle load, with more than one dongle possible
+		const dongleStatus = this.shadowRoot?.querySelector('dongle-status');
+		if (this.#service instanceof MultiDeviceService && dongleStatus instanceof DongleStatus) {
+			dongleStatus.service = this.#service;
+		} else {
+			dongleStatus?.remove();
+		}
+
+		const saveCapture = this.shadowRoot?.querySelector('#save_capture');
+		if (this.#pageState.get('capture') === 'y') {
+			this.initializeCapture(saveCapture);
+		} else {
+			saveCapture?.remove();
+		}
+
+		if (this.#pageState.has('replay')) {
+			this.startReplay(this.#pageState.get('replay'));
+		}
 
-		WebUSBDeviceService.reconnectPairedDevices();
+		this.#service.reconnectPairedDevices();
 	}
 
 	sendReset() {
 		this.#model.resetBA();
+
+		// Device side RSSI aggregation, e.g. ?rssi_report=3,1000,4 (smoothing, interval ms, threshold dB)
+		if (this.#pageState.has('rssi_report')) {
+			const [smoothing, interval, threshold] = this.#pageState.get('rssi_report').split(',').map(Number);
+			this.#model.setRssiReport({ smoothing, interval, threshold }).catch(() => {});
+		}
 	}
 
 	scanStopped() {
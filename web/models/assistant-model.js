@@ -4,11 +4,14 @@ import {
 	MessageType,
 	MessageSubType,
 	BT_DataType,
-	ltvToTvArray,
+	messageLtv,
 	tvArrayToLtv,
-	tvArrayFindItem
+	bufToAddressKey,
+	eventLatency
 } from '../lib/message.js';
-import { compareTypedArray } from '../lib/helpers.js';
+import { Metrics } from '../lib/metrics.js';
+import { TimeSync, LatencyStats } from '../lib/time-sync.js';
+import { DeviceKind } from '../lib/device-store.js';
 
 /**
 * Assistant Model
@@ -26,6 +29,8 @@ import { compareTypedArray } from '../lib/helpers.js';
 * 	broadcast_name: string | undefined
 * 	broadcast_id: uint24, (UNIQUE IDENTIFIER)
 * 	rssi: int8
+* 	last_seen: ms since epoch
+* 	stale: true until seen in this session (loaded from the device store)
 *
 *
 * Sink device structure
@@ -37,21 +42,110 @@ import { compareTypedArray } from '../lib/helpers.js';
 * 	security_level: uint8,
 * 	bass_state: idle | configured | streaming,
 * 	broadcast_id: uint24,
+* 	recv_states: Map(src_id -> { broadcast_id, pa_sync_state, encrypt_state,
+* 		     bis_sync: uint32[], metadata: Uint8Array[] }),
 * 	rssi: int8
+* 	last_seen: ms since epoch
+* 	stale: true until seen in this session (loaded from the device store)
 *
 */
 
+// BIS sync value 0xFFFFFFFF means that the sink failed to sync
+const isBISSynced = bis_sync => bis_sync !== undefined && bis_sync !== 0 && bis_sync !== 0xFFFFFFFF;
+
+// CONN_STATE of SINK_STATE
+const SINK_CONN_STATE_READY = 3;
+
+// SCAN_TARGET bits
+const SCAN_TARGET_SOURCE = 0x01;
+const SCAN_TARGET_SINK = 0x02;
+
+// Lost events trigger a state snapshot, at most one per RESYNC_MIN_MS
+const RESYNC_MIN_MS = 5000;
+
+// A requested snapshot that did not begin, or did not end, within
+// SNAPSHOT_TIMEOUT_MS is dropped and requested again
+const SNAPSHOT_TIMEOUT_MS = 5000;
+
+// Default time between TIME_SYNC commands, see startTimeSync()
+const TIME_SYNC_INTERVAL_MS = 5000;
+
+/**
+* Sources and sinks are kept in Maps keyed by their packed address
+* (bufToAddressKey), sources are also indexed by broadcast ID. Sinks that
+* had their identity resolved are stored under the identity address and
+* found from their RPA through #identityByRPA.
+*
+* With a device store, known devices are persisted and loaded (as stale) by
+* hydrate(). A RESET keeps the known devices, marked stale.
+*
+* Events are numbered per device (seqNo, heartbeats excluded). When events
+* were lost, e.g. the device ran out of buffers, the model requests a state
+* snapshot (GET_STATE_SNAPSHOT) instead of a RESET: connected sinks and
+* their receive states are updated, and sinks (or receive states) missing
+* from the snapshot were lost with the events and are removed. A snapshot
+* that does not arrive in time is requested again.
+*
+* startTimeSync() synchronizes with the device clock (TIME_SYNC, per dongle)
+* and makes the device timestamp its events, the latency from the device
+* timestamp to the model is collected per event type (getEventLatencyStats()).
+*/
+// Persisted part of sources and sinks
+export const serializeDevice = (kind, device) => kind === DeviceKind.SOURCE ? {
+	addr: device.addr,
+	rssi: device.rssi,
+	name: device.name,
+	broadcast_name: device.broadcast_name,
+	broadcast_id: device.broadcast_id,
+	pa_interval: device.pa_interval,
+	sid: device.sid,
+	last_seen: device.last_seen
+} : {
+	addr: device.addr,
+	rssi: device.rssi,
+	name: device.name,
+	uuid16s: device.uuid16s,
+	last_seen: device.last_seen
+};
+
 export class AssistantModel extends EventTarget {
 	#service
 	#sinks
 	#sources
-
-	constructor(service) {
+	#sourcesByBroadcastId
+	#identityByRPA
+	#selectedSource
+	#store
+	#eventSeqNo
+	#snapshots
+	#snapshotTimers
+	#snapshotRequestTimer
+	#resyncTimer
+	#lastResync
+	#timeSyncs
+	#timeSyncSent
+	#timeSyncTimer
+	#latency
+
+	/**
+	* @param service	Device service
+	* @param {import('../lib/device-store.js').DeviceStore} [store]	Persists known devices
+	*/
+	constructor(service, store) {
 		super();
 
 		this.#service = service;
-		this.#sinks = [];
-		this.#sources = [];
+		this.#store = store;
+		this.#sinks = new Map();
+		this.#sources = new Map();
+		this.#sourcesByBroadcastId = new Map();
+		this.#identityByRPA = new Map();
+		this.#eventSeqNo = new Map();
+		this.#snapshots = new Map();
+		this.#snapshotTimers = new Map();
+		this.#lastResync = -Infinity;
+		this.#timeSyncs = new Map();
+		this.#latency = new LatencyStats();
 
 		this.serviceMessageHandler = this.serviceMessageHandler.bind(this);
 
@@ -62,6 +156,8 @@ export class AssistantModel extends EventTarget {
 		this.#service.addEventListener('connected', evt => {
 			console.log('AssistantModel registered Service as connected');
 			this.serviceIsConnected = true;
+			this.#eventSeqNo.clear();
+			this.#timeSyncs.clear();
 		});
 		this.#service.addEventListener('disconnected', evt => {
 			console.log('AssistantModel registered Service as disconnected');
@@ -70,10 +166,25 @@ export class AssistantModel extends EventTarget {
 		this.#service.addEventListener('message', this.serviceMessageHandler);
 	}
 
+	/**
+	* Send a command, resolves with the response message. Failures are
+	* logged here, callers only need to handle them if they care.
+	*/
+	#sendCMD(message) {
+		const pending = this.#service.sendCMD(message);
+		pending.catch(error => console.warn(`Command 0x${message.subType.toString(16)} failed:`, error.message));
+
+		return pending;
+	}
+
+	#findSink(addr) {
+		const key = bufToAddressKey(addr.value.addr);
+
+		return this.#sinks.get(key) ?? this.#sinks.get(this.#identityByRPA.get(key));
+	}
+
 	handleHeartbeat(message) {
 		console.log(`Handle Heartbeat`);
-		const payloadArray = ltvToTvArray(message.payload);
-		console.log('Payload', payloadArray);
 
 		const heartbeat_cnt = message.seqNo;
 
@@ -83,10 +194,10 @@ export class AssistantModel extends EventTarget {
 	handleSourceFound(message) {
 		console.log(`Handle found Source`);
 
-		const payloadArray = ltvToTvArray(message.payload);
-		// console.log('Payload', payloadArray);
+		const entries = messageLtv(message);
+		// console.log('Payload', [...entries]);
 
-		const addr = tvArrayFindItem(payloadArray, [
+		const addr = entries.find([
 			BT_DataType.BT_DATA_IDENTITY,
 			BT_DataType.BT_DATA_RPA
 		]);
@@ -96,98 +207,190 @@ export class AssistantModel extends EventTarget {
 			return;
 		}
 
-		const rssi = tvArrayFindItem(payloadArray, [
+		const rssi = entries.find([
 			BT_DataType.BT_DATA_RSSI
 		])?.value;
 
+		// Samples since the previous report, when the device aggregates RSSI
+		const rssi_stats = entries.find([
+			BT_DataType.BT_DATA_RSSI_STATS
+		])?.value;
+
 		// TODO: Handle Broadcast ID parsing in message.js and attach to 'source'
 
 		// If device already exists, just update RSSI, otherwise add to list
-		let source = this.#sources.find(i => compareTypedArray(i.addr.value.addr, addr.value.addr));
+		const key = bufToAddressKey(addr.value.addr);
+		let source = this.#sources.get(key);
 		if (!source) {
 			source = {
 				addr,
 				rssi,
-				name: tvArrayFindItem(payloadArray, [
+				rssi_stats,
+				name: entries.find([
 					BT_DataType.BT_DATA_NAME_SHORTENED,
 					BT_DataType.BT_DATA_NAME_COMPLETE
 				])?.value,
-				broadcast_name: tvArrayFindItem(payloadArray, [
+				broadcast_name: entries.find([
 					BT_DataType.BT_DATA_BROADCAST_NAME
 				])?.value,
-				broadcast_id: tvArrayFindItem(payloadArray, [
+				broadcast_id: entries.find([
 					BT_DataType.BT_DATA_BROADCAST_ID
 				])?.value,
-				pa_interval: tvArrayFindItem(payloadArray, [
+				pa_interval: entries.find([
 					BT_DataType.BT_DATA_PA_INTERVAL
 				])?.value,
-				sid: tvArrayFindItem(payloadArray, [
+				sid: entries.find([
 					BT_DataType.BT_DATA_SID
-				])?.value
+				])?.value,
+				last_seen: Date.now()
 			}
 
-			this.#sources.push(source)
+			this.#addSource(key, source);
 			this.dispatchEvent(new CustomEvent('source-found', {detail: { source }}));
 		} else {
 			source.rssi = rssi;
+			source.rssi_stats = rssi_stats;
+			source.last_seen = Date.now();
+			source.stale = undefined;
 			this.dispatchEvent(new CustomEvent('source-updated', {detail: { source }}));
 		}
+
+		this.#store?.put(DeviceKind.SOURCE, key, source);
 	}
 
-	handleBISSync(message, isSynced) {
-		console.log(`Handle BIS Sync`);
+	#addSource(key, source) {
+		this.#sources.set(key, source);
+		if (source.broadcast_id !== undefined) {
+			this.#sourcesByBroadcastId.set(source.broadcast_id, source);
+		}
+	}
+
+	updateSinkSource(sink, broadcast_id, isSynced) {
+		let source = this.#sourcesByBroadcastId.get(broadcast_id);
+		if (!source) {
+			console.warn("Unknown source with broadcast ID:", broadcast_id?.toString(16).padStart(6, '0'));
+			return;
+		}
+
+		// Only the selected source has a state, so only the previous
+		// and the new selection need updating
+		const previous = this.#selectedSource;
+		if (previous && previous !== source) {
+			previous.state = undefined;
+			this.dispatchEvent(new CustomEvent('source-updated', {detail: { source: previous }}));
+		}
 
-		const payloadArray = ltvToTvArray(message.payload);
+		source.state = isSynced ? "selected" : undefined;
+		this.#selectedSource = isSynced ? source : undefined;
+		this.dispatchEvent(new CustomEvent('source-updated', {detail: { source }}));
+
+		sink.source_added = source;
+		this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+	}
 
-		const sink_addr = tvArrayFindItem(payloadArray, [
+	handleRecvStateChanged(message) {
+		console.log(`Handle Receive State Changed`);
+
+		const entries = messageLtv(message);
+
+		const sink_addr = entries.find([
 			BT_DataType.BT_DATA_IDENTITY,
 			BT_DataType.BT_DATA_RPA
 		]);
 
 		if (!sink_addr) {
-			// TBD: Throw exception?
 			return;
 		}
 
-		const err = tvArrayFindItem(payloadArray, [
-			BT_DataType.BT_DATA_ERROR_CODE
-		])?.value;
-
-		const broadcast_id = tvArrayFindItem(payloadArray, [
-			BT_DataType.BT_DATA_BROADCAST_ID
-		])?.value
-
-		// If device already exists, just update RSSI, otherwise add to list
-		let sink = this.#sinks.find(i => compareTypedArray(i.addr.value.addr, sink_addr.value.addr));
+		let sink = this.#findSink(sink_addr);
 		if (!sink) {
-			console.warn("BIS Sync w/ unknown sink addr:", sink_addr);
+			console.warn("Receive state w/ unknown sink addr:", sink_addr);
 			return;
 		}
 
-		let source = this.#sources.find(i => i.broadcast_id === broadcast_id);
-		if (!source) {
-			console.warn("Unknown source with broadcast ID:", broadcast_id?.toString(16).padStart(6, '0'));
+		const src_id = entries.find([BT_DataType.BT_DATA_SOURCE_ID])?.value;
+		if (src_id === undefined) {
 			return;
 		}
 
-		let syncState = isSynced ? "selected" : undefined;
+		this.#snapshots.get(message.dongle)?.get(sink)?.add(src_id);
 
-		this.#sources.forEach( s => {
-			s.state = source === s ? syncState : undefined;
-			this.dispatchEvent(new CustomEvent('source-updated', {detail: { source: s }}));
-		});
+		// The event only carries the fields that changed, merge into the stored state
+		sink.recv_states ??= new Map();
+		let recvState = sink.recv_states.get(src_id);
+		if (!recvState) {
+			recvState = { src_id, bis_sync: [], metadata: [] };
+			sink.recv_states.set(src_id, recvState);
+		}
 
-		sink.source_added = source;
-		this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+		const wasSynced = recvState.bis_sync.some(isBISSynced);
+
+		for (const item of entries) {
+			switch (item.type) {
+				case BT_DataType.BT_DATA_BROADCAST_ID:
+				recvState.broadcast_id = item.value;
+				break;
+				case BT_DataType.BT_DATA_PA_SYNC_STATE:
+				recvState.pa_sync_state = item.value;
+				break;
+				case BT_DataType.BT_DATA_ENC_STATE:
+				recvState.encrypt_state = item.value;
+				break;
+				case BT_DataType.BT_DATA_BIS_SYNC:
+				recvState.bis_sync[item.value.subgroup] = item.value.bis_sync;
+				break;
+				case BT_DataType.BT_DATA_SUBGROUP_METADATA:
+				recvState.metadata[item.value.subgroup] = item.value.metadata;
+				break;
+				case BT_DataType.BT_DATA_ERROR_CODE:
+				// Metadata that did not fit in the event is missing
+				console.warn(`Receive state ${src_id} incomplete (err ${item.value}) w/ sink addr:`, sink_addr);
+				break;
+			}
+		}
+
+		const isSynced = recvState.bis_sync.some(isBISSynced);
+
+		if (isSynced !== wasSynced) {
+			this.updateSinkSource(sink, recvState.broadcast_id, isSynced);
+		} else {
+			this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+		}
+	}
+
+	handleSourceRemoved(message) {
+		console.log(`Handle Source Removed`);
+
+		const entries = messageLtv(message);
+
+		const sink_addr = entries.find([
+			BT_DataType.BT_DATA_IDENTITY,
+			BT_DataType.BT_DATA_RPA
+		]);
+		const src_id = entries.find([BT_DataType.BT_DATA_SOURCE_ID])?.value;
+
+		const sink = sink_addr && this.#findSink(sink_addr);
+		if (sink && src_id !== undefined) {
+			const recvState = sink.recv_states?.get(src_id);
+			sink.recv_states?.delete(src_id);
+
+			if (recvState && sink.source_added?.broadcast_id === recvState.broadcast_id) {
+				this.updateSinkSource(sink, recvState.broadcast_id, false);
+				sink.source_added = undefined;
+				this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+			}
+		}
+
+		this.dispatchEvent(new CustomEvent('source-removed'));
 	}
 
 	handleSinkFound(message) {
 		console.log(`Handle found Sink`);
 
-		const payloadArray = ltvToTvArray(message.payload);
-		// console.log('Payload', payloadArray);
+		const entries = messageLtv(message);
+		// console.log('Payload', [...entries]);
 
-		const addr = tvArrayFindItem(payloadArray, [
+		const addr = entries.find([
 			BT_DataType.BT_DATA_IDENTITY,
 			BT_DataType.BT_DATA_RPA
 		]);
@@ -197,39 +400,51 @@ export class AssistantModel extends EventTarget {
 			return;
 		}
 
-		const rssi = tvArrayFindItem(payloadArray, [
+		const rssi = entries.find([
 			BT_DataType.BT_DATA_RSSI
 		])?.value;
 
+		// Samples since the previous report, when the device aggregates RSSI
+		const rssi_stats = entries.find([
+			BT_DataType.BT_DATA_RSSI_STATS
+		])?.value;
+
 		// If device already exists, just update RSSI, otherwise add to list
-		let sink = this.#sinks.find(i => compareTypedArray(i.addr.value.addr, addr.value.addr));
+		let sink = this.#findSink(addr);
 		if (!sink) {
 			sink = {
 				addr,
 				rssi,
-				name: tvArrayFindItem(payloadArray, [
+				rssi_stats,
+				name: entries.find([
 					BT_DataType.BT_DATA_NAME_SHORTENED,
 					BT_DataType.BT_DATA_NAME_COMPLETE
 				])?.value,
-				uuid16s: tvArrayFindItem(payloadArray, [
+				uuid16s: entries.find([
 					BT_DataType.BT_DATA_UUID16_ALL,
 					BT_DataType.BT_DATA_UUID16_SOME,
-				])?.value || []
+				])?.value || [],
+				last_seen: Date.now()
 			}
 
-			this.#sinks.push(sink)
+			this.#sinks.set(bufToAddressKey(addr.value.addr), sink);
 			this.dispatchEvent(new CustomEvent('sink-found', {detail: { sink }}));
 		} else {
 			sink.rssi = rssi;
+			sink.rssi_stats = rssi_stats;
+			sink.last_seen = Date.now();
+			sink.stale = undefined;
 			this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
 		}
+
+		this.#store?.put(DeviceKind.SINK, bufToAddressKey(sink.addr.value.addr), sink);
 	}
 
 	handleSinkConnectivityEvt(message) {
 		console.log(`Handle connected/disconnected Sink`);
 
-		const payloadArray = ltvToTvArray(message.payload);
-		const addr = tvArrayFindItem(payloadArray, [
+		const entries = messageLtv(message);
+		const addr = entries.find([
 			BT_DataType.BT_DATA_IDENTITY,
 			BT_DataType.BT_DATA_RPA
 		]);
@@ -238,12 +453,12 @@ export class AssistantModel extends EventTarget {
 			return;
 		}
 
-		const err = tvArrayFindItem(payloadArray, [
+		const err = entries.find([
 			BT_DataType.BT_DATA_ERROR_CODE
 		])?.value;
 
 		// If device already exists, just update RSSI, otherwise add to list
-		let sink = this.#sinks.find(i => compareTypedArray(i.addr.value.addr, addr.value.addr));
+		let sink = this.#findSink(addr);
 		if (!sink) {
 			console.warn("Unknown sink connected with addr:", addr.value.addr);
 		} else {
@@ -253,23 +468,31 @@ export class AssistantModel extends EventTarget {
 			} else {
 				if (message.subType === MessageSubType.SINK_CONNECTED) {
 					sink.state = "connected";
+					// Only set with several dongles
+					sink.dongle = message.dongle;
 					this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
 				} else {
-					this.#sinks.splice(this.#sinks.indexOf(sink, 1));
-					this.dispatchEvent(new CustomEvent('sink-disconnected', {detail: { sink }}));
+					this.#sinkDisconnected(sink);
 				}
 			}
 		}
 	}
 
+	#sinkDisconnected(sink) {
+		const key = bufToAddressKey(sink.addr.value.addr);
+		this.#sinks.delete(key);
+		// Rediscovered under a new RPA
+		this.#store?.delete(DeviceKind.SINK, key);
+		this.dispatchEvent(new CustomEvent('sink-disconnected', {detail: { sink }}));
+	}
+
 	handleIdentityResolved(message) {
 		console.log("Handle Identity Resolved");
 		console.log(message);
 
-		const payloadArray = ltvToTvArray(message.payload);
-		console.log(payloadArray);
+		const entries = messageLtv(message);
 
-		const addrIdentity = tvArrayFindItem(payloadArray, [
+		const addrIdentity = entries.find([
 			BT_DataType.BT_DATA_IDENTITY
 		]);
 		console.log(addrIdentity)
@@ -278,7 +501,7 @@ export class AssistantModel extends EventTarget {
 			return;
 		}
 
-		const addrRPA = tvArrayFindItem(payloadArray, [
+		const addrRPA = entries.find([
 			BT_DataType.BT_DATA_RPA
 		]);
 
@@ -287,15 +510,216 @@ export class AssistantModel extends EventTarget {
 			return;
 		}
 
-		let sink = this.#sinks.find(i => compareTypedArray(i.addr.value.addr, addrRPA.value.addr));
+		const rpaKey = bufToAddressKey(addrRPA.value.addr);
+		let sink = this.#sinks.get(rpaKey);
 		if (!sink) {
 			console.warn("Unknown sink had its identity resolved:", addrRPA.value.addr);
 		} else {
+			// Re-key the sink, later events may use either address
+			const identityKey = bufToAddressKey(addrIdentity.value.addr);
+
+			// A stale entry for the same device (from an earlier session) is replaced
+			const known = this.#sinks.get(identityKey);
+			if (known && known !== sink) {
+				this.dispatchEvent(new CustomEvent('sink-disconnected', {detail: { sink: known }}));
+			}
+
+			this.#sinks.delete(rpaKey);
+			this.#sinks.set(identityKey, sink);
+			this.#identityByRPA.set(rpaKey, identityKey);
+
 			sink.addr = addrIdentity;
+			this.#store?.delete(DeviceKind.SINK, rpaKey);
+			this.#store?.put(DeviceKind.SINK, identityKey, sink);
 			this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
 		}
 	}
 
+	// Events (but heartbeats) are numbered per device, a gap means events were lost
+	#checkEventSeqNo(message) {
+		if (message.subType === MessageSubType.HEARTBEAT) {
+			return;
+		}
+
+		const expected = this.#eventSeqNo.get(message.dongle);
+		this.#eventSeqNo.set(message.dongle, (message.seqNo + 1) & 0xff);
+
+		// Firmware without event numbering sends 0 every time
+		if (expected === undefined || (expected === 1 && message.seqNo === 0)) {
+			return;
+		}
+
+		// Events dropped by the multi dongle service are not lost
+		const lost = (message.seqNo - expected - (message.skipped ?? 0)) & 0xff;
+		if (lost === 0) {
+			return;
+		}
+
+		console.warn(`${lost} events lost${message.dongle ? ` (dongle ${message.dongle})` : ''}, resyncing`);
+
+		if (Metrics.enabled) {
+			Metrics.add('events.lost', lost);
+		}
+
+		this.dispatchEvent(new CustomEvent('events-lost', {detail: { lost, dongle: message.dongle }}));
+		this.resync();
+	}
+
+	#addEventLatency(message, received) {
+		const latency = eventLatency(message, this.#timeSyncs.get(message.dongle), received);
+		if (latency === undefined) {
+			return;
+		}
+
+		this.#latency.add(message.subType, latency);
+
+		if (Metrics.enabled) {
+			Metrics.add('latency', latency);
+		}
+	}
+
+	handleTimeSync(message) {
+		const timestamp = messageLtv(message).find([BT_DataType.BT_DATA_TIMESTAMP])?.value;
+		if (timestamp === undefined || this.#timeSyncSent === undefined) {
+			return;
+		}
+
+		let timeSync = this.#timeSyncs.get(message.dongle);
+		if (!timeSync) {
+			timeSync = new TimeSync();
+			this.#timeSyncs.set(message.dongle, timeSync);
+		}
+
+		timeSync.addSample(this.#timeSyncSent, timestamp, performance.now());
+	}
+
+	handleStateSnapshotBegin(message) {
+		// Sinks in the snapshot, with the src_ids of their receive states
+		this.#snapshots.set(message.dongle, new Map());
+
+		clearTimeout(this.#snapshotRequestTimer);
+		this.#snapshotRequestTimer = undefined;
+
+		clearTimeout(this.#snapshotTimers.get(message.dongle));
+		this.#snapshotTimers.set(message.dongle, setTimeout(() => {
+			this.#snapshotTimers.delete(message.dongle);
+			this.#snapshots.delete(message.dongle);
+			console.warn('State snapshot did not end');
+			this.resync();
+		}, SNAPSHOT_TIMEOUT_MS));
+
+		const scanTarget = messageLtv(message).find([BT_DataType.BT_DATA_SCAN_TARGET])?.value ?? 0;
+
+		if (scanTarget === 0) {
+			this.dispatchEvent(new CustomEvent('scan-stopped'));
+		}
+		if (scanTarget & SCAN_TARGET_SINK) {
+			this.dispatchEvent(new CustomEvent('sink-scan-started'));
+		}
+		if (scanTarget & SCAN_TARGET_SOURCE) {
+			this.dispatchEvent(new CustomEvent('source-scan-started'));
+		}
+	}
+
+	handleSinkState(message) {
+		const entries = messageLtv(message);
+
+		const addr = entries.find([
+			BT_DataType.BT_DATA_IDENTITY,
+			BT_DataType.BT_DATA_RPA
+		]);
+
+		if (!addr) {
+			return;
+		}
+
+		// Connected sinks are known, unless their events were lost
+		let sink = this.#findSink(addr);
+		if (!sink) {
+			sink = { addr, uuid16s: [], last_seen: Date.now() };
+			this.#sinks.set(bufToAddressKey(addr.value.addr), sink);
+			this.dispatchEvent(new CustomEvent('sink-found', {detail: { sink }}));
+		}
+
+		const connState = entries.find([BT_DataType.BT_DATA_CONN_STATE])?.value;
+
+		sink.state = connState === SINK_CONN_STATE_READY ? "connected" : "connecting";
+		sink.security_level = entries.find([BT_DataType.BT_DATA_SECURITY_LEVEL])?.value;
+		sink.dongle = message.dongle;
+		sink.stale = undefined;
+
+		this.#snapshots.get(message.dongle)?.set(sink, new Set());
+
+		this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+	}
+
+	handleStateSnapshotEnd(message) {
+		const snapshot = this.#snapshots.get(message.dongle);
+		this.#snapshots.delete(message.dongle);
+
+		clearTimeout(this.#snapshotTimers.get(message.dongle));
+		this.#snapshotTimers.delete(message.dongle);
+
+		const err = messageLtv(message).find([BT_DataType.BT_DATA_ERROR_CODE])?.value;
+
+		if (!snapshot || err !== 0) {
+			// Incomplete, try again later
+			console.warn(`State snapshot incomplete (err ${err})`);
+			this.resync();
+			return;
+		}
+
+		for (const sink of [...this.#sinks.values()]) {
+			const srcIds = snapshot.get(sink);
+
+			if (!srcIds) {
+				// Connecting sinks may not have reached the device yet
+				if (sink.state === "connected" && sink.dongle === message.dongle) {
+					this.#sinkDisconnected(sink);
+				}
+				continue;
+			}
+
+			for (const [src_id, recvState] of sink.recv_states ?? []) {
+				if (srcIds.has(src_id)) {
+					continue;
+				}
+
+				sink.recv_states.delete(src_id);
+
+				if (sink.source_added?.broadcast_id === recvState.broadcast_id) {
+					this.updateSinkSource(sink, recvState.broadcast_id, false);
+					sink.source_added = undefined;
+					this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+				}
+			}
+		}
+
+		this.dispatchEvent(new CustomEvent('state-resynced', {detail: { dongle: message.dongle }}));
+	}
+
+	handleScanFilterStats(message) {
+		const entries = messageLtv(message);
+
+		// Accepted reports have filter type 0, rejections are keyed by filter LTV type.
+		// Accepted reports held back by the RSSI aggregation have type RSSI_REPORT.
+		const stats = { accepted: 0, held: 0, rejected: {} };
+		for (const item of entries) {
+			if (item.type !== BT_DataType.BT_DATA_FILTER_STATS) {
+				continue;
+			}
+			if (item.value.filter === 0) {
+				stats.accepted = item.value.count;
+			} else if (item.value.filter === BT_DataType.BT_DATA_RSSI_REPORT) {
+				stats.held = item.value.count;
+			} else {
+				stats.rejected[item.value.filter] = item.value.count;
+			}
+		}
+
+		this.dispatchEvent(new CustomEvent('scan-filter-stats', {detail: { stats }}));
+	}
+
 	handleRES(message) {
 		console.log(`Response message with subType 0x${message.subType.toString(16)}`);
 
@@ -315,6 +739,24 @@ export class AssistantModel extends EventTarget {
 			case MessageSubType.CONNECT_SINK:
 			console.log('CONNECT_SINK response received');
 			break;
+			case MessageSubType.SET_LINK_PARAMS:
+			console.log('SET_LINK_PARAMS response received');
+			break;
+			case MessageSubType.SET_SCAN_FILTER:
+			console.log('SET_SCAN_FILTER response received');
+			break;
+			case MessageSubType.GET_SCAN_FILTER_STATS:
+			this.handleScanFilterStats(message);
+			break;
+			case MessageSubType.SET_RSSI_REPORT:
+			console.log('SET_RSSI_REPORT response received');
+			break;
+			case MessageSubType.GET_STATE_SNAPSHOT:
+			console.log('GET_STATE_SNAPSHOT response received');
+			break;
+			case MessageSubType.TIME_SYNC:
+			this.handleTimeSync(message);
+			break;
 			case MessageSubType.ADD_SOURCE:
 			console.log('ADD_SOURCE response received');
 			// NOOP/TODO
@@ -358,25 +800,22 @@ export class AssistantModel extends EventTarget {
 			this.dispatchEvent(new CustomEvent('source-added'));
 			break;
 			case MessageSubType.SOURCE_REMOVED:
-			console.log('SOURCE_REMOVED response received');
-			this.dispatchEvent(new CustomEvent('source-removed'));
+			this.handleSourceRemoved(message);
 			break;
-			case MessageSubType.NEW_PA_STATE_NOT_SYNCED:
-			// TODO: Add secondary visual feedback that we are PA un-synced
-			case MessageSubType.NEW_PA_STATE_SYNCED:
-			// TODO: Add secondary visual feedback that we are PA synced
-			case MessageSubType.NEW_PA_STATE_INFO_REQ:
-			case MessageSubType.NEW_PA_STATE_FAILED:
-			case MessageSubType.NEW_PA_STATE_NO_PAST:
+			case MessageSubType.IDENTITY_RESOLVED:
+			this.handleIdentityResolved(message);
 			break;
-			case MessageSubType.BIS_SYNCED:
-			this.handleBISSync(message, true);
+			case MessageSubType.RECV_STATE_CHANGED:
+			this.handleRecvStateChanged(message);
 			break;
-			case MessageSubType.BIS_UNSYNCED:
-			this.handleBISSync(message, false);
+			case MessageSubType.STATE_SNAPSHOT_BEGIN:
+			this.handleStateSnapshotBegin(message);
 			break;
-			case MessageSubType.IDENTITY_RESOLVED:
-			this.handleIdentityResolved(message);
+			case MessageSubType.SINK_STATE:
+			this.handleSinkState(message);
+			break;
+			case MessageSubType.STATE_SNAPSHOT_END:
+			this.handleStateSnapshotEnd(message);
 			break;
 			default:
 			console.log(`Missing handler for EVT subType 0x${message.subType.toString(16)}`);
@@ -396,16 +835,24 @@ export class AssistantModel extends EventTarget {
 			return;
 		}
 
+		const start = Metrics.enabled || this.#timeSyncs.size ? performance.now() : 0;
+
 		switch (message.type) {
 			case MessageType.RES:
 			this.handleRES(message);
 			break;
 			case MessageType.EVT:
+			this.#checkEventSeqNo(message);
+			this.#addEventLatency(message, start);
 			this.handleEVT(message);
 			break;
 			default:
 			console.log(`Could not interpret message with type ${message.type}`);
 		}
+
+		if (Metrics.enabled) {
+			Metrics.add('model', performance.now() - start);
+		}
 	}
 
 	resetBA() {
@@ -414,16 +861,75 @@ export class AssistantModel extends EventTarget {
 		const message = {
 			type: Number(MessageType.CMD),
 			subType: MessageSubType.RESET,
-			seqNo: 123,
 			payload: new Uint8Array([])
 		};
 
-		this.#service.sendCMD(message)
+		const pending = this.#sendCMD(message);
+
+		// Known devices stay listed as stale, the device has no state left
+		this.#identityByRPA.clear();
+		this.#selectedSource = undefined;
+
+		for (const source of this.#sources.values()) {
+			source.stale = true;
+			source.state = undefined;
+			this.dispatchEvent(new CustomEvent('source-updated', {detail: { source }}));
+		}
+
+		for (const sink of this.#sinks.values()) {
+			sink.stale = true;
+			sink.state = undefined;
+			sink.source_added = undefined;
+			sink.recv_states = undefined;
+			this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+		}
+
+		return pending;
+	}
+
+	/**
+	* Load the devices known from earlier sessions, marked stale until seen
+	*/
+	async hydrate() {
+		if (!this.#store) {
+			return;
+		}
 
-		// Also reset the UI
+		const { sources, sinks } = await this.#store.load();
+
+		for (const record of sources) {
+			if (this.#sources.has(record.key)) {
+				continue;
+			}
+			const { key, ...source } = record;
+			source.stale = true;
+			this.#addSource(key, source);
+			this.dispatchEvent(new CustomEvent('source-found', {detail: { source }}));
+		}
+
+		for (const record of sinks) {
+			if (this.#sinks.has(record.key)) {
+				continue;
+			}
+			const { key, ...sink } = record;
+			sink.stale = true;
+			this.#sinks.set(key, sink);
+			this.dispatchEvent(new CustomEvent('sink-found', {detail: { sink }}));
+		}
+	}
+
+	/**
+	* Forget all known devices, also the stored ones
+	*/
+	forgetDevices() {
 		this.dispatchEvent(new Event('reset'));
-		this.#sinks = [];
-		this.#sources = [];
+		this.#sinks.clear();
+		this.#sources.clear();
+		this.#sourcesByBroadcastId.clear();
+		this.#identityByRPA.clear();
+		this.#selectedSource = undefined;
+
+		return this.#store?.clear();
 	}
 
 	startHeartbeat() {
@@ -432,11 +938,10 @@ export class AssistantModel extends EventTarget {
 		const message = {
 			type: Number(MessageType.CMD),
 			subType: MessageSubType.HEARTBEAT,
-			seqNo: 123,
 			payload: new Uint8Array([])
 		};
 
-		this.#service.sendCMD(message)
+		return this.#sendCMD(message);
 	}
 	startSinkScan() {
 		console.log("Sending Start Sink Scan CMD")
@@ -444,11 +949,10 @@ export class AssistantModel extends EventTarget {
 		const message = {
 			type: Number(MessageType.CMD),
 			subType: MessageSubType.START_SINK_SCAN,
-			seqNo: 123,
 			payload: new Uint8Array([])
 		};
 
-		this.#service.sendCMD(message)
+		return this.#sendCMD(message);
 	}
 
 	startSourceScan() {
@@ -457,11 +961,10 @@ export class AssistantModel extends EventTarget {
 		const message = {
 			type: Number(MessageType.CMD),
 			subType: MessageSubType.START_SOURCE_SCAN,
-			seqNo: 123,
 			payload: new Uint8Array([])
 		};
 
-		this.#service.sendCMD(message)
+		return this.#sendCMD(message);
 	}
 
 	stopScan() {
@@ -470,11 +973,10 @@ export class AssistantModel extends EventTarget {
 		const message = {
 			type: Number(MessageType.CMD),
 			subType: MessageSubType.STOP_SCAN,
-			seqNo: 123,
 			payload: new Uint8Array([])
 		};
 
-		this.#service.sendCMD(message)
+		return this.#sendCMD(message);
 	}
 
 	addSource(source) {
@@ -509,11 +1011,10 @@ export class AssistantModel extends EventTarget {
 		const message = {
 			type: Number(MessageType.CMD),
 			subType: MessageSubType.ADD_SOURCE,
-			seqNo: 123,
 			payload
 		};
 
-		this.#service.sendCMD(message);
+		return this.#sendCMD(message);
 	}
 
 	removeSource() {
@@ -523,11 +1024,213 @@ export class AssistantModel extends EventTarget {
 
 		const message = {
 			type: Number(MessageType.CMD),
-			subType: MessageSubType.REMOVE_SOURCE,
-			seqNo: 123
+			subType: MessageSubType.REMOVE_SOURCE
+		};
+
+		return this.#sendCMD(message);
+	}
+
+	/**
+	* setLinkParams
+	*
+	* @param params	{ setup, steady, phy } - all optional. setup/steady are
+	*		{ interval_min, interval_max, latency, timeout } in BT units
+	*		(1.25 ms for intervals, 10 ms for timeout), phy is a bitmask
+	*		(1 = 1M, 2 = 2M, 4 = Coded, 0 = no PHY update)
+	*/
+	setLinkParams(params) {
+		console.log("Sending Set Link Params CMD");
+
+		const tvArr = [];
+
+		if (params.setup) {
+			tvArr.push({ type: BT_DataType.BT_DATA_CONN_PARAM_SETUP, value: params.setup });
+		}
+		if (params.steady) {
+			tvArr.push({ type: BT_DataType.BT_DATA_CONN_PARAM_STEADY, value: params.steady });
+		}
+		if (params.phy !== undefined) {
+			tvArr.push({ type: BT_DataType.BT_DATA_PHY, value: params.phy });
+		}
+
+		const payload = tvArrayToLtv(tvArr);
+
+		const message = {
+			type: Number(MessageType.CMD),
+			subType: MessageSubType.SET_LINK_PARAMS,
+			payload
+		};
+
+		return this.#sendCMD(message);
+	}
+
+	/**
+	* setScanFilter
+	*
+	* @param filter	{ min_rssi, name_prefix, broadcast_id_allow, broadcast_id_deny,
+	*		addr_allow } - all optional, filters left out are disabled.
+	*		broadcast_id_* are arrays of uint24, addr_allow is an array
+	*		of addresses ({ type, addr }, as in source/sink .addr.value)
+	*/
+	setScanFilter(filter = {}) {
+		console.log("Sending Set Scan Filter CMD");
+
+		const tvArr = [];
+
+		if (filter.min_rssi !== undefined) {
+			tvArr.push({ type: BT_DataType.BT_DATA_FILTER_MIN_RSSI, value: filter.min_rssi });
+		}
+		if (filter.name_prefix) {
+			tvArr.push({ type: BT_DataType.BT_DATA_FILTER_NAME_PREFIX, value: filter.name_prefix });
+		}
+		if (filter.broadcast_id_allow?.length) {
+			tvArr.push({ type: BT_DataType.BT_DATA_FILTER_BROADCAST_ID_ALLOW, value: filter.broadcast_id_allow });
+		}
+		if (filter.broadcast_id_deny?.length) {
+			tvArr.push({ type: BT_DataType.BT_DATA_FILTER_BROADCAST_ID_DENY, value: filter.broadcast_id_deny });
+		}
+		if (filter.addr_allow?.length) {
+			tvArr.push({ type: BT_DataType.BT_DATA_FILTER_ADDR_ALLOW, value: filter.addr_allow });
+		}
+
+		const message = {
+			type: Number(MessageType.CMD),
+			subType: MessageSubType.SET_SCAN_FILTER,
+			payload: tvArrayToLtv(tvArr)
+		};
+
+		return this.#sendCMD(message);
+	}
+
+	/**
+	* setRssiReport
+	*
+	* @param config	{ smoothing, interval, threshold } - the device reports a
+	*		filtered RSSI (EWMA, new samples weigh 1/2^smoothing) per device,
+	*		every interval ms or when it moved threshold dB. Leave out
+	*		(or all 0) to get every report with its raw RSSI.
+	*/
+	setRssiReport(config) {
+		console.log("Sending Set RSSI Report CMD");
+
+		const tvArr = [];
+
+		if (config && (config.smoothing || config.interval || config.threshold)) {
+			tvArr.push({ type: BT_DataType.BT_DATA_RSSI_REPORT, value: {
+				smoothing: config.smoothing ?? 0,
+				interval: config.interval ?? 0,
+				threshold: config.threshold ?? 0
+			}});
+		}
+
+		const message = {
+			type: Number(MessageType.CMD),
+			subType: MessageSubType.SET_RSSI_REPORT,
+			payload: tvArrayToLtv(tvArr)
+		};
+
+		return this.#sendCMD(message);
+	}
+
+	getStateSnapshot() {
+		console.log("Sending Get State Snapshot CMD");
+
+		const message = {
+			type: Number(MessageType.CMD),
+			subType: MessageSubType.GET_STATE_SNAPSHOT,
+			payload: new Uint8Array([])
 		};
 
-		this.#service.sendCMD(message);
+		return this.#sendCMD(message);
+	}
+
+	/**
+	* Request a state snapshot, at most one per RESYNC_MIN_MS. Called when
+	* events were lost.
+	*/
+	resync() {
+		if (this.#resyncTimer) {
+			return;
+		}
+
+		const wait = Math.max(0, this.#lastResync + RESYNC_MIN_MS - performance.now());
+
+		this.#resyncTimer = setTimeout(() => {
+			this.#resyncTimer = undefined;
+			this.#lastResync = performance.now();
+			this.getStateSnapshot().catch(() => {});
+
+			// The device may not get a buffer for the snapshot at all
+			clearTimeout(this.#snapshotRequestTimer);
+			this.#snapshotRequestTimer = setTimeout(() => {
+				this.#snapshotRequestTimer = undefined;
+				console.warn('State snapshot did not begin');
+				this.resync();
+			}, SNAPSHOT_TIMEOUT_MS);
+		}, wait);
+	}
+
+	timeSync() {
+		console.log("Sending Time Sync CMD");
+
+		const message = {
+			type: Number(MessageType.CMD),
+			subType: MessageSubType.TIME_SYNC,
+			payload: new Uint8Array([])
+		};
+
+		// With several dongles, all responses pair with this
+		this.#timeSyncSent = performance.now();
+
+		return this.#sendCMD(message);
+	}
+
+	/**
+	* Synchronize with the device clock now and every interval ms. The device
+	* keeps adding timestamps to its events until the next RESET.
+	*/
+	startTimeSync(interval = TIME_SYNC_INTERVAL_MS) {
+		this.stopTimeSync();
+
+		const sync = () => {
+			if (this.serviceIsConnected) {
+				this.timeSync().catch(() => {});
+			}
+		}
+
+		sync();
+		this.#timeSyncTimer = setInterval(sync, interval);
+	}
+
+	stopTimeSync() {
+		clearInterval(this.#timeSyncTimer);
+		this.#timeSyncTimer = undefined;
+	}
+
+	/**
+	* @returns	Map of dongle id (undefined with a single device) -> TimeSync
+	*/
+	getTimeSyncs() {
+		return this.#timeSyncs;
+	}
+
+	/**
+	* @returns	Map of event subType -> latency stats, see LatencyStats
+	*/
+	getEventLatencyStats() {
+		return this.#latency.getStats();
+	}
+
+	getScanFilterStats() {
+		console.log("Sending Get Scan Filter Stats CMD");
+
+		const message = {
+			type: Number(MessageType.CMD),
+			subType: MessageSubType.GET_SCAN_FILTER_STATS,
+			payload: new Uint8Array([])
+		};
+
+		return this.#sendCMD(message);
 	}
 
 	connectSink(sink) {
@@ -546,14 +1249,28 @@ export class AssistantModel extends EventTarget {
 		const message = {
 			type: Number(MessageType.CMD),
 			subType: MessageSubType.CONNECT_SINK,
-			seqNo: 123,
 			payload
 		};
 
-		this.#service.sendCMD(message);
+		const pending = this.#sendCMD(message);
 
 		sink.state = "connecting";
 		this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+
+		// E.g. no dongle with spare capacity, or another sink connected (-EAGAIN)
+		const failed = () => {
+			if (sink.state === "connecting") {
+				sink.state = "failed";
+				this.dispatchEvent(new CustomEvent('sink-updated', {detail: { sink }}));
+			}
+		}
+		pending.then(response => {
+			if (messageLtv(response).find([BT_DataType.BT_DATA_ERROR_CODE])?.value) {
+				failed();
+			}
+		}, failed);
+
+		return pending;
 	}
 
 	disconnectSink(sink) {
@@ -572,19 +1289,18 @@ export class AssistantModel extends EventTarget {
 		const message = {
 			type: Number(MessageType.CMD),
 			subType: MessageSubType.DISCONNECT_SINK,
-			seqNo: 123,
 			payload
 		};
 
-		this.#service.sendCMD(message);
+		return this.#sendCMD(message);
 	}
 }
 
 let _instance = null;
 
-export const initializeAssistantModel = deviceService => {
+export const initializeAssistantModel = (deviceService, store) => {
 	if (!_instance) {
-		_instance = new AssistantModel(deviceService);
+		_instance = new AssistantModel(deviceService, store);
 	}
 	return _instance;
 }
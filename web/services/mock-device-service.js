@@ -1,5 +1,22 @@
 // @ts-check
 
+import {
+	arrayToMsg,
+	msgToArray,
+	LtvView,
+	bufToAddressKey,
+	MessageType,
+	MessageSubType,
+	BT_DataType
+} from '../lib/message.js';
+import { cobsEncodeInto, cobsDecodeInto, cobsDecodedLengthMax } from '../lib/cobs.js';
+import { CommandEncoder } from '../lib/command-encoder.js';
+import { StreamDeframer } from '../lib/stream-deframer.js';
+import { CommandManager } from '../lib/command-manager.js';
+import { CaptureWriter, CaptureFlags } from '../lib/capture.js';
+import { Metrics } from '../lib/metrics.js';
+import { prng } from '../lib/helpers.js';
+
 /**
  * Mock Device Service
  *
@@ -7,8 +24,921 @@
  *
  * Simulates a connected Broadcast Audio Assistant device.
  *
+ * The simulated device builds its messages like the firmware does and sends
+ * them through the real path: msgToArray, COBS encoding, split into transfer
+ * sized chunks, deframing, COBS decoding and arrayToMsg. Commands take the
+ * same path in the other direction (encoded by CommandEncoder, as in the worker).
+ *
+ * Simulated are N sources and M sinks with RSSI jitter, sink RPA rotation,
+ * connect/disconnect (one sink at a time, like the firmware), and PA/BIS sync
+ * of connected sinks on ADD_SOURCE.
+ * SET_RSSI_REPORT is honored like in the firmware (rssi_report.c).
+ * Events are numbered and GET_STATE_SNAPSHOT is answered, eventLossRate
+ * drops state events (their numbers are skipped) to exercise the resync.
+ * After TIME_SYNC, events carry a TIMESTAMP from a device clock starting at
+ * connect and running clockDrift ppm off the host clock.
+ * The USB benchmark commands (ECHO, DISCARD, FLOOD) are answered as by the
+ * firmware, FLOOD sends at most FLOOD_MAX_PER_TICK events per step.
+ * See DEFAULT_OPTIONS for the knobs (configure() before connecting).
+ *
+ * Several MockDevices with the same seed simulate dongles in the same room,
+ * placement gives each its own position (RSSI per device).
+ *
  */
 
-export const MockDeviceService = new class extends EventTarget {
+const DEFAULT_OPTIONS = {
+	sources: 20,		// number of broadcast sources
+	sinks: 5,		// number of broadcast sinks
+	advRate: 2,		// scan reports per device per second
+	rssiJitter: 6,		// dB, +/- around the base RSSI of each device
+	rpaRotation: 0,		// seconds between RPA changes of sinks, 0 = never
+	latency: 5,		// ms from a command to its response
+	connectLatency: 300,	// ms from CONNECT_SINK to SINK_CONNECTED
+	syncLatency: 500,	// ms from ADD_SOURCE to PA/BIS synced
+	connectFailRate: 0,	// 0..1, share of connection attempts that fail
+	eventLossRate: 0,	// 0..1, share of state events (not scan reports) lost
+	clockDrift: 0,		// ppm, device clock rate relative to the host
+	chunkSize: 64,		// bytes per simulated USB transfer
+	seed: 0,		// devices generated from this seed, 0 = random
+	placement: 0,		// seed of the RSSI offsets (+/- 10 dB) per device, 0 = none
+};
+
+// Simulation step
+const TICK_MS = 20;
+
+// Stands in for the TX buffers of the firmware, FLOOD without a rate
+const FLOOD_MAX_PER_TICK = 50;
+
+// Value bytes per BENCH_DATA entry
+const BENCH_DATA_MAX = 254;
+
+// CONFIG_RSSI_REPORT_MAX_DEVICES
+const RSSI_REPORT_MAX_DEVICES = 32;
+
+// ba_sink_conn, the firmware connects one sink at a time
+const MAX_SINK_CONNECTIONS = 1;
+
+const BT_HCI_ERR_CONN_FAIL_TO_ESTAB = 0x3e;
+const ENOENT = 2;
+const EAGAIN = 11;
+const EINVAL = 22;
+const ENOTCONN = 128;
+
+// BASS PA sync states
+const PA_SYNC_STATE_NOT_SYNCED = 0;
+const PA_SYNC_STATE_SYNC_INFO_REQ = 1;
+const PA_SYNC_STATE_SYNCED = 2;
+
+const BT_UUID_BASS = 0x184f;
+const BT_UUID_PACS = 0x1850;
+const BT_UUID_BROADCAST_AUDIO = 0x1852;
+
+const ADDR_TYPES = [BT_DataType.BT_DATA_IDENTITY, BT_DataType.BT_DATA_RPA];
+
+const SCAN_REPORTS = [MessageSubType.SOURCE_FOUND, MessageSubType.SINK_FOUND];
+
+// CONN_STATE of SINK_STATE
+const SINK_CONN_STATE_CONNECTING = 1;
+const SINK_CONN_STATE_READY = 3;
+
+// SCAN_TARGET bits
+const SCAN_TARGET_SOURCE = 0x01;
+const SCAN_TARGET_SINK = 0x02;
+
+// Security level of paired sinks (BT_SECURITY_L2)
+const SECURITY_LEVEL_PAIRED = 2;
+
+const SOURCE_NAMES = ['TV', 'Lecture hall', 'Gate', 'Gym', 'Cinema', 'Museum guide', 'Bar', 'Church'];
+const SINK_NAMES = ['Earbuds', 'Headphones', 'Hearing aid', 'Speaker', 'Soundbar'];
+
+const randomInt = (min, max, random = Math.random) => min + Math.floor(random() * (max - min + 1));
+
+const le = (value, size) => Array.from({length: size}, (_, i) => (value >>> (8 * i)) & 0xff);
+
+const ltv = (type, bytes) => [bytes.length + 1, type, ...bytes];
+
+const utf8encoder = new TextEncoder();
+
+// Random address, the two MSBs select static random (0b11) or RPA (0b01)
+const randomAddr = (msbs, random = Math.random) => {
+	const addr = Uint8Array.from({length: 6}, () => randomInt(0, 255, random));
+	addr[5] = (addr[5] & 0x3f) | (msbs << 6);
+	return addr;
+}
+
+// Address LTV as sent by the firmware (type + 6 bytes)
+const addrLtv = (isIdentity, type, addr) =>
+	ltv(isIdentity ? BT_DataType.BT_DATA_IDENTITY : BT_DataType.BT_DATA_RPA, [type, ...addr]);
+
+const le64 = value => [...le(value % 0x100000000, 4), ...le(value / 0x100000000, 4)];
+
+// size bytes of BENCH_DATA entries, as bench_fill() in the firmware
+const benchData = size => {
+	const data = [];
+
+	while (size >= 2) {
+		let len = Math.min(size - 2, BENCH_DATA_MAX);
+		if (size - 2 - len === 1) {
+			len--;
+		}
+		data.push(...ltv(BT_DataType.BT_DATA_BENCH_DATA, new Array(len).fill(0)));
+		size -= 2 + len;
+	}
+
+	return data;
+}
+
+const errorLtv = err => ltv(BT_DataType.BT_DATA_ERROR_CODE, le(err, 4));
+
+const rssiLtv = rssi => ltv(BT_DataType.BT_DATA_RSSI, [rssi & 0xff]);
+
+export class MockDevice extends EventTarget {
+	#options
+	#commands
+	#commandEncoder
+	#connected
+	#timer
+	#lastTick
+	#scanning
+	#sources
+	#sinks
+	#sinksByAddr
+	#reportBudget
+	#reportsSent
+	#rssiConfig
+	#rssiDevices
+	#reportsHeld
+	#eventSeqNo
+	#bootTime
+	#timestamps
+	#flood
+	#benchDiscarded
+	#txChunks
+	#deframer
+	#heartbeat
+	#capture
+	#captureMaxBytes
+
+	constructor() {
+		super();
+
+		this.scan = this.scan.bind(this);
+		this.sendCMD = this.sendCMD.bind(this);
+		this.sendData = this.sendData.bind(this);
+
+		this.#options = { ...DEFAULT_OPTIONS };
+		this.#commands = new CommandManager(message => this.#sendCommand(message));
+		this.#commandEncoder = new CommandEncoder();
+		this.#connected = false;
+		this.#txChunks = [];
+		this.#deframer = new StreamDeframer();
+	}
+
+	/**
+	* @param options	See DEFAULT_OPTIONS, applied on the next connect
+	*/
+	configure(options) {
+		Object.assign(this.#options, options);
+	}
+
+	async reconnectPairedDevices() {
+		this.#connect();
+	}
+
+	scan() {
+		this.#connect();
+	}
+
+	/**
+	* Simulate unplugging the device
+	*/
+	disconnect() {
+		if (!this.#connected) {
+			return;
+		}
+
+		clearInterval(this.#timer);
+		clearInterval(this.#heartbeat);
+		this.#connected = false;
+		this.#commands.abort('Disconnected');
+		this.dispatchEvent(new CustomEvent('disconnected', { detail: {}}));
+	}
+
+	setReadsInFlight(count) {
+		// No transfers to pipeline
+	}
+
+	enableMetrics(enabled) {
+		// Decoding runs on the main thread, timed when Metrics.enabled
+	}
+
+	startCapture(maxBytes = 64 * 1024 * 1024) {
+		this.#capture = new CaptureWriter(performance.timeOrigin + performance.now());
+		this.#captureMaxBytes = maxBytes;
+	}
+
+	async stopCapture() {
+		const capture = this.#capture ?? new CaptureWriter();
+		this.#capture = undefined;
+
+		return capture.toArray();
+	}
+
+	#captureData(flags, data) {
+		if (this.#capture && this.#capture.length + data.length < this.#captureMaxBytes) {
+			this.#capture.add(performance.timeOrigin + performance.now(), CaptureFlags.RAW | flags, data);
+		}
+	}
+
+	async sendData(data) {
+		this.#captureData(CaptureFlags.OUT, data);
+		this.#deviceReceive(data);
+
+		return { status: "ok" };
+	}
+
+	sendCMD(message) {
+		return this.#commands.submit(message);
+	}
+
+	setCommandWindow(window) {
+		this.#commands.setWindow(window);
+	}
+
+	setCommandTimeout(timeout) {
+		this.#commands.setTimeout(timeout);
+	}
+
+	getCommandStats() {
+		return this.#commands.getStats();
+	}
+
+	async #sendCommand(message) {
+		// transferOut would copy the data as well
+		await this.sendData(this.#commandEncoder.encode(message).slice());
+
+		this.dispatchEvent(new CustomEvent('command-sent', {detail: { message }}));
+	}
+
+	#connect() {
+		if (this.#connected) {
+			return;
+		}
+
+		this.#createDevices();
+		this.#connected = true;
+		this.#scanning = false;
+		this.#heartbeat = 0;
+		this.#eventSeqNo = 0;
+		this.#bootTime = performance.now();
+		this.#timestamps = false;
+		this.#flood = undefined;
+		this.#benchDiscarded = 0;
+		this.#lastTick = performance.now();
+		this.#timer = setInterval(() => this.#tick(), TICK_MS);
+
+		this.dispatchEvent(new CustomEvent('connected', { detail: { device: { productName: 'Mock device' }}}));
+	}
+
+	#createDevices() {
+		const { sources, sinks, seed, placement } = this.#options;
+
+		const random = seed ? prng(seed) : Math.random;
+		const placementRandom = placement ? prng(placement) : undefined;
+		const offset = () => placementRandom ? randomInt(-10, 10, placementRandom) : 0;
+
+		this.#sources = Array.from({length: sources}, (_, i) => ({
+			isSource: true,
+			type: 1,
+			addr: randomAddr(0b11, random),
+			sid: randomInt(0, 15, random),
+			pa_interval: randomInt(0x18, 0x320, random),
+			broadcast_id: randomInt(0, 0xffffff, random),
+			name: `${SOURCE_NAMES[i % SOURCE_NAMES.length]} ${i + 1}`,
+			broadcast_name: `${SOURCE_NAMES[i % SOURCE_NAMES.length]} broadcast ${i + 1}`,
+			rssi: randomInt(-95, -40, random) + offset()
+		}));
+
+		this.#sinksByAddr = new Map();
+		this.#sinks = Array.from({length: sinks}, (_, i) => {
+			const sink = {
+				type: 1,
+				rpa: randomAddr(0b01, random),
+				identity: Uint8Array.from({length: 6}, () => randomInt(0, 255, random)),
+				name: `${SINK_NAMES[i % SINK_NAMES.length]} ${i + 1}`,
+				rssi: randomInt(-90, -35, random) + offset(),
+				lastRotation: performance.now(),
+				state: 'idle',
+				recvState: undefined,
+				nextSrcId: 0
+			};
+
+			this.#sinksByAddr.set(bufToAddressKey(sink.rpa), sink);
+			this.#sinksByAddr.set(bufToAddressKey(sink.identity), sink);
+
+			return sink;
+		});
+
+		this.#reportBudget = 0;
+		this.#reportsSent = 0;
+		this.#setRssiReport();
+	}
+
+	// Same as rssi_report_set() in the firmware
+	#setRssiReport(config = { smoothing: 0, interval: 0, threshold: 0 }) {
+		this.#rssiConfig = config;
+		this.#rssiDevices = new Map();
+		this.#reportsHeld = 0;
+	}
+
+	// Same as rssi_report_update() in the firmware, undefined if held back.
+	// The map is kept in the order devices were last heard.
+	#rssiReport(addr, rssi) {
+		const { smoothing, interval, threshold } = this.#rssiConfig;
+
+		if (!smoothing && !interval && !threshold) {
+			return { rssi };
+		}
+
+		const now = performance.now();
+		const key = bufToAddressKey(addr);
+		let device = this.#rssiDevices.get(key);
+		const isNew = !device;
+
+		if (isNew) {
+			if (this.#rssiDevices.size >= RSSI_REPORT_MAX_DEVICES) {
+				this.#rssiDevices.delete(this.#rssiDevices.keys().next().value);
+			}
+			device = { ewma: rssi * 256, min: rssi, max: rssi, count: 0, reported: 0, reportedAt: 0 };
+		} else {
+			this.#rssiDevices.delete(key);
+			device.ewma += (rssi * 256 - device.ewma) >> smoothing;
+			device.min = device.count ? Math.min(device.min, rssi) : rssi;
+			device.max = device.count ? Math.max(device.max, rssi) : rssi;
+		}
+		this.#rssiDevices.set(key, device);
+		device.count = Math.min(device.count + 1, 0xffff);
+
+		const filtered = (device.ewma + 128) >> 8;
+		const due = isNew || (!interval && !threshold) ||
+			(interval && now - device.reportedAt >= interval) ||
+			(threshold && Math.abs(filtered - device.reported) >= threshold);
+
+		if (!due) {
+			this.#reportsHeld++;
+			return;
+		}
+
+		const stats = { min: device.min, max: device.max, count: device.count };
+		device.reported = filtered;
+		device.reportedAt = now;
+		device.count = 0;
+
+		return { rssi: filtered, stats };
+	}
+
+	#rssiLtvs(addr, rssi) {
+		const report = this.#rssiReport(addr, this.#jitter(rssi));
+
+		return report && [
+			...rssiLtv(report.rssi),
+			...(report.stats ? ltv(BT_DataType.BT_DATA_RSSI_STATS,
+				[report.stats.min & 0xff, report.stats.max & 0xff, ...le(report.stats.count, 2)]) : [])
+		];
+	}
+
+	#jitter(rssi) {
+		const jitter = this.#options.rssiJitter;
+		return Math.max(-127, Math.min(20, rssi + randomInt(-jitter, jitter)));
+	}
+
+	#tick() {
+		const now = performance.now();
+		const dt = (now - this.#lastTick) / 1000;
+		this.#lastTick = now;
+
+		if (this.#options.rpaRotation) {
+			this.#rotateRPAs(now);
+		}
+
+		if (this.#scanning) {
+			this.#generateReports(dt);
+		}
+
+		if (this.#flood) {
+			this.#floodTick(now);
+		}
+
+		this.#flush();
+	}
+
+	#rotateRPAs(now) {
+		for (const sink of this.#sinks) {
+			if (sink.state !== 'idle' || now - sink.lastRotation < this.#options.rpaRotation * 1000) {
+				continue;
+			}
+
+			// The old RPA is no longer reachable
+			this.#sinksByAddr.delete(bufToAddressKey(sink.rpa));
+			sink.rpa = randomAddr(0b01);
+			sink.lastRotation = now;
+			this.#sinksByAddr.set(bufToAddressKey(sink.rpa), sink);
+		}
+	}
+
+	#generateReports(dt) {
+		const advertisers = [
+			...(this.#scanning.sources ? this.#sources : []),
+			...(this.#scanning.sinks ? this.#sinks.filter(s => s.state === 'idle') : [])
+		];
 
+		if (advertisers.length === 0) {
+			return;
+		}
+
+		this.#reportBudget += advertisers.length * this.#options.advRate * dt;
+
+		while (this.#reportBudget >= 1) {
+			this.#reportBudget--;
+
+			const device = advertisers[randomInt(0, advertisers.length - 1)];
+			if (device.isSource) {
+				this.#sourceFound(device);
+			} else {
+				this.#sinkFound(device);
+			}
+		}
+	}
+
+	#sourceFound(source) {
+		const rssi = this.#rssiLtvs(source.addr, source.rssi);
+		if (!rssi) {
+			return;
+		}
+
+		const name = [...utf8encoder.encode(source.name)];
+
+		// Same layout as scan_recv_cb(): AD data, RSSI, address, name, SID,
+		// PA interval and broadcast ID
+		this.#event(MessageSubType.SOURCE_FOUND, [
+			...ltv(BT_DataType.BT_DATA_SVC_DATA16, [...le(BT_UUID_BROADCAST_AUDIO, 2), ...le(source.broadcast_id, 3)]),
+			...ltv(BT_DataType.BT_DATA_BROADCAST_NAME, [...utf8encoder.encode(source.broadcast_name)]),
+			...ltv(BT_DataType.BT_DATA_NAME_COMPLETE, name),
+			...rssi,
+			// Static random addresses are identity addresses
+			...addrLtv(true, source.type, source.addr),
+			...ltv(BT_DataType.BT_DATA_NAME_COMPLETE, name),
+			...ltv(BT_DataType.BT_DATA_SID, [source.sid]),
+			...ltv(BT_DataType.BT_DATA_PA_INTERVAL, le(source.pa_interval, 2)),
+			...ltv(BT_DataType.BT_DATA_BROADCAST_ID, le(source.broadcast_id, 4)),
+		]);
+
+		this.#reportsSent++;
+	}
+
+	#sinkFound(sink) {
+		const rssi = this.#rssiLtvs(sink.rpa, sink.rssi);
+		if (!rssi) {
+			return;
+		}
+
+		const name = [...utf8encoder.encode(sink.name)];
+
+		this.#event(MessageSubType.SINK_FOUND, [
+			...ltv(BT_DataType.BT_DATA_UUID16_ALL, [...le(BT_UUID_BASS, 2), ...le(BT_UUID_PACS, 2)]),
+			...ltv(BT_DataType.BT_DATA_SVC_DATA16, le(BT_UUID_BASS, 2)),
+			...ltv(BT_DataType.BT_DATA_NAME_COMPLETE, name),
+			...rssi,
+			...addrLtv(false, sink.type, sink.rpa),
+			...ltv(BT_DataType.BT_DATA_NAME_COMPLETE, name),
+		]);
+
+		this.#reportsSent++;
+	}
+
+	#sinkAddrLtv(sink) {
+		return sink.state === 'connected' ?
+			addrLtv(true, 0, sink.identity) : addrLtv(false, sink.type, sink.rpa);
+	}
+
+	// Device side: queue an encoded message for the host
+	#send(type, subType, seqNo, payload) {
+		const data = msgToArray({ type, subType, seqNo, payload: new Uint8Array(payload) });
+
+		this.#txChunks.push(cobsEncodeInto(data, true).slice());
+	}
+
+	#event(subType, payload) {
+		const seqNo = this.#eventSeqNo++ & 0xff;
+
+		// Lost like a failed buffer allocation in the firmware, the number is used
+		if (!SCAN_REPORTS.includes(subType) && Math.random() < this.#options.eventLossRate) {
+			return;
+		}
+
+		this.#send(MessageType.EVT, subType, seqNo, this.#timestamps ? [...this.#timestampLtv(), ...payload] : payload);
+	}
+
+	// Device uptime in µs, as k_ticks_to_us_floor64(k_uptime_ticks())
+	#timestampLtv() {
+		const uptime = (performance.now() - this.#bootTime) * (1 + this.#options.clockDrift / 1e6);
+
+		return ltv(BT_DataType.BT_DATA_TIMESTAMP, le64(Math.floor(uptime * 1000)));
+	}
+
+	#response(subType, seqNo, err = 0, extra = []) {
+		this.#send(MessageType.RES, subType, seqNo, [...errorLtv(err), ...extra]);
+	}
+
+	// Host side: hand the queued data over in transfer sized chunks
+	#flush() {
+		if (this.#txChunks.length === 0) {
+			return;
+		}
+
+		let length = 0;
+		this.#txChunks.forEach(chunk => { length += chunk.length; });
+
+		const stream = new Uint8Array(length);
+		let ptr = 0;
+		this.#txChunks.forEach(chunk => { stream.set(chunk, ptr); ptr += chunk.length; });
+		this.#txChunks = [];
+
+		const onFrame = frame => {
+			const start = Metrics.enabled ? performance.now() : 0;
+			const decoded = new Uint8Array(cobsDecodedLengthMax(frame.length));
+			const message = arrayToMsg(cobsDecodeInto(frame, false, decoded));
+
+			if (Metrics.enabled) {
+				Metrics.add('usb.frames');
+				Metrics.add('decode', performance.now() - start);
+			}
+
+			if (message.type === MessageType.RES) {
+				this.#commands.handleResponse(message);
+			}
+
+			this.dispatchEvent(new CustomEvent('message', {detail: { message }}));
+		}
+
+		const { chunkSize } = this.#options;
+		for (let i = 0; i < stream.length; i += chunkSize) {
+			const chunk = stream.subarray(i, i + chunkSize);
+			this.#captureData(0, chunk);
+			this.#deframer.push(chunk, onFrame);
+		}
+
+		if (Metrics.enabled) {
+			Metrics.add('usb.bytes', stream.length);
+		}
+	}
+
+	#later(delay, fn) {
+		setTimeout(() => {
+			if (this.#connected) {
+				fn();
+			}
+		}, delay);
+	}
+
+	// Device side: receive and handle a command
+	#deviceReceive(data) {
+		const deframer = new StreamDeframer();
+
+		deframer.push(data, frame => {
+			const message = arrayToMsg(cobsDecodeInto(frame, false).slice());
+
+			this.#later(this.#options.latency, () => this.#handleCommand(message));
+		});
+	}
+
+	#sinkFromCommand(message) {
+		const addr = new LtvView(message.payload).find(ADDR_TYPES);
+
+		return addr && this.#sinksByAddr.get(bufToAddressKey(addr.value.addr));
+	}
+
+	#handleCommand(message) {
+		const { subType, seqNo } = message;
+
+		switch (subType) {
+			case MessageSubType.HEARTBEAT:
+			this.#toggleHeartbeat();
+			this.#response(subType, seqNo);
+			break;
+			case MessageSubType.START_SINK_SCAN:
+			this.#scanning = { sinks: true };
+			this.#response(subType, seqNo);
+			break;
+			case MessageSubType.START_SOURCE_SCAN:
+			this.#scanning = { sources: true };
+			this.#response(subType, seqNo);
+			break;
+			case MessageSubType.START_SCAN_ALL:
+			this.#scanning = { sinks: true, sources: true };
+			this.#response(subType, seqNo);
+			break;
+			case MessageSubType.STOP_SCAN:
+			this.#scanning = false;
+			this.#response(subType, seqNo);
+			break;
+			case MessageSubType.CONNECT_SINK:
+			this.#connectSink(message);
+			break;
+			case MessageSubType.DISCONNECT_SINK:
+			this.#disconnectSink(message);
+			break;
+			case MessageSubType.ADD_SOURCE:
+			this.#addSource(message);
+			break;
+			case MessageSubType.REMOVE_SOURCE:
+			this.#removeSource(message);
+			break;
+			case MessageSubType.SET_LINK_PARAMS:
+			case MessageSubType.SET_SCAN_FILTER:
+			this.#response(subType, seqNo);
+			break;
+			case MessageSubType.GET_SCAN_FILTER_STATS:
+			this.#response(subType, seqNo, 0, [
+				...ltv(BT_DataType.BT_DATA_FILTER_STATS, [0, ...le(this.#reportsSent + this.#reportsHeld, 4)]),
+				...ltv(BT_DataType.BT_DATA_FILTER_STATS, [BT_DataType.BT_DATA_RSSI_REPORT, ...le(this.#reportsHeld, 4)])
+			]);
+			break;
+			case MessageSubType.SET_RSSI_REPORT:
+			this.#setRssiReport(new LtvView(message.payload).find([BT_DataType.BT_DATA_RSSI_REPORT])?.value);
+			this.#response(subType, seqNo);
+			break;
+			case MessageSubType.GET_STATE_SNAPSHOT:
+			this.#response(subType, seqNo);
+			this.#stateSnapshot();
+			break;
+			case MessageSubType.ECHO:
+			this.#response(subType, seqNo, 0, [...message.payload]);
+			break;
+			case MessageSubType.DISCARD:
+			this.#benchDiscarded += message.payload.length;
+			this.#response(subType, seqNo, 0, ltv(BT_DataType.BT_DATA_BENCH_BYTES, le(this.#benchDiscarded, 4)));
+			break;
+			case MessageSubType.FLOOD:
+			{
+				const config = new LtvView(message.payload).find([BT_DataType.BT_DATA_BENCH_FLOOD])?.value;
+				if (config?.size === 1) {
+					this.#response(subType, seqNo, -EINVAL);
+					break;
+				}
+				this.#flood = config?.duration ? { ...config, start: performance.now(), sent: 0, dropped: 0 } : undefined;
+				this.#response(subType, seqNo);
+			}
+			break;
+			case MessageSubType.TIME_SYNC:
+			this.#timestamps = true;
+			this.#response(subType, seqNo, 0, this.#timestampLtv());
+			break;
+			case MessageSubType.RESET:
+			this.#scanning = false;
+			this.#setRssiReport();
+			this.#timestamps = false;
+			this.#flood = undefined;
+			this.#benchDiscarded = 0;
+			this.#response(MessageSubType.STOP_SCAN, seqNo);
+			this.#sinks.forEach(sink => {
+				sink.state = 'idle';
+				sink.recvState = undefined;
+			});
+			this.#response(subType, seqNo);
+			clearInterval(this.#heartbeat);
+			this.#heartbeat = 0;
+			break;
+			default:
+			this.#response(subType, seqNo, -1);
+		}
+	}
+
+	// As flood_work_handler in the firmware
+	#floodTick(now) {
+		const flood = this.#flood;
+		const elapsed = now - flood.start;
+
+		if (elapsed >= flood.duration) {
+			this.#flood = undefined;
+			this.#event(MessageSubType.FLOOD_END, ltv(BT_DataType.BT_DATA_BENCH_FLOOD_STATS, [...le(flood.sent, 4), ...le(flood.dropped, 4)]));
+			return;
+		}
+
+		const due = flood.rate ? Math.floor(elapsed * flood.rate / 1000) + 1 : flood.sent + FLOOD_MAX_PER_TICK;
+		const payload = benchData(flood.size);
+
+		for (let i = 0; i < FLOOD_MAX_PER_TICK && flood.sent + flood.dropped < due; i++) {
+			this.#event(MessageSubType.FLOOD_DATA, payload);
+			flood.sent++;
+		}
+
+		// Events not sent on time are not sent later
+		flood.dropped = Math.max(flood.dropped, due - flood.sent);
+	}
+
+	#toggleHeartbeat() {
+		if (this.#heartbeat) {
+			clearInterval(this.#heartbeat);
+			this.#heartbeat = 0;
+			return;
+		}
+
+		let count = 0;
+		this.#heartbeat = setInterval(() => {
+			this.#send(MessageType.EVT, MessageSubType.HEARTBEAT, count++ & 0xff, []);
+		}, 1000);
+	}
+
+	#connectSink(message) {
+		const sink = this.#sinkFromCommand(message);
+
+		if (!sink || sink.state !== 'idle') {
+			this.#response(message.subType, message.seqNo, -1);
+			return;
+		}
+
+		const busy = this.#sinks.filter(other => other.state === 'connecting' || other.state === 'connected');
+		if (busy.length >= MAX_SINK_CONNECTIONS) {
+			this.#response(message.subType, message.seqNo, -EAGAIN);
+			return;
+		}
+
+		this.#response(message.subType, message.seqNo);
+		sink.state = 'connecting';
+
+		this.#later(this.#options.connectLatency, () => {
+			if (Math.random() < this.#options.connectFailRate) {
+				sink.state = 'idle';
+				this.#event(MessageSubType.SINK_CONNECTED, [
+					...this.#sinkAddrLtv(sink), ...errorLtv(BT_HCI_ERR_CONN_FAIL_TO_ESTAB)
+				]);
+				return;
+			}
+
+			// Pairing resolves the identity before discovery completes
+			this.#event(MessageSubType.IDENTITY_RESOLVED, [
+				...addrLtv(false, sink.type, sink.rpa), ...addrLtv(true, 0, sink.identity)
+			]);
+
+			sink.state = 'connected';
+			this.#event(MessageSubType.SINK_CONNECTED, [...this.#sinkAddrLtv(sink), ...errorLtv(0)]);
+		});
+	}
+
+	#disconnectSink(message) {
+		const sink = this.#sinkFromCommand(message);
+
+		if (!sink || sink.state !== 'connected') {
+			this.#response(message.subType, message.seqNo, -1);
+			return;
+		}
+
+		this.#response(message.subType, message.seqNo);
+
+		this.#later(this.#options.latency, () => {
+			this.#event(MessageSubType.SINK_DISCONNECTED, [...this.#sinkAddrLtv(sink), ...errorLtv(0)]);
+
+			// Back to advertising, with a new RPA
+			sink.state = 'idle';
+			sink.recvState = undefined;
+			this.#sinksByAddr.delete(bufToAddressKey(sink.rpa));
+			sink.rpa = randomAddr(0b01);
+			this.#sinksByAddr.set(bufToAddressKey(sink.rpa), sink);
+		});
+	}
+
+	#stateSnapshot() {
+		const scanTarget = (this.#scanning?.sources ? SCAN_TARGET_SOURCE : 0) |
+			(this.#scanning?.sinks ? SCAN_TARGET_SINK : 0);
+
+		this.#event(MessageSubType.STATE_SNAPSHOT_BEGIN, [
+			...ltv(BT_DataType.BT_DATA_SCAN_TARGET, [scanTarget])
+		]);
+
+		for (const sink of this.#sinks) {
+			if (sink.state === 'idle') {
+				continue;
+			}
+
+			const connected = sink.state === 'connected';
+
+			this.#event(MessageSubType.SINK_STATE, [
+				...this.#sinkAddrLtv(sink),
+				...ltv(BT_DataType.BT_DATA_CONN_STATE, [connected ? SINK_CONN_STATE_READY : SINK_CONN_STATE_CONNECTING]),
+				...ltv(BT_DataType.BT_DATA_SECURITY_LEVEL, [connected ? SECURITY_LEVEL_PAIRED : 1])
+			]);
+
+			if (sink.recvState) {
+				this.#event(MessageSubType.RECV_STATE_CHANGED, [
+					...this.#sinkAddrLtv(sink),
+					...this.#recvStateLtvs(sink.recvState, sink.recvState)
+				]);
+			}
+		}
+
+		this.#event(MessageSubType.STATE_SNAPSHOT_END, [...errorLtv(0)]);
+	}
+
+	#recvStateLtvs(recvState, changes) {
+		const ltvs = [
+			...ltv(BT_DataType.BT_DATA_SOURCE_ID, [recvState.src_id]),
+			...ltv(BT_DataType.BT_DATA_BROADCAST_ID, le(recvState.broadcast_id, 4))
+		];
+
+		if (changes.pa_sync_state !== undefined) {
+			ltvs.push(...ltv(BT_DataType.BT_DATA_PA_SYNC_STATE, [changes.pa_sync_state]));
+		}
+		if (changes.enc_state !== undefined) {
+			ltvs.push(...ltv(BT_DataType.BT_DATA_ENC_STATE, [changes.enc_state]));
+		}
+		if (changes.bis_sync !== undefined) {
+			ltvs.push(...ltv(BT_DataType.BT_DATA_BIS_SYNC, [0, ...le(changes.bis_sync, 4)]));
+		}
+
+		return ltvs;
+	}
+
+	// Stores the changed fields (kept for snapshots) and sends them
+	#recvStateChanged(sink, changes) {
+		const { recvState } = sink;
+
+		Object.assign(recvState, changes);
+
+		this.#event(MessageSubType.RECV_STATE_CHANGED, [
+			...this.#sinkAddrLtv(sink),
+			...this.#recvStateLtvs(recvState, changes)
+		]);
+	}
+
+	#addSource(message) {
+		const broadcast_id = new LtvView(message.payload).find([BT_DataType.BT_DATA_BROADCAST_ID])?.value;
+		const connected = this.#sinks.filter(sink => sink.state === 'connected');
+
+		if (broadcast_id === undefined || connected.length === 0) {
+			this.#response(message.subType, message.seqNo, -1);
+			return;
+		}
+
+		// The result is reported with the SOURCE_ADDED event
+		this.#response(message.subType, message.seqNo);
+
+		for (const sink of connected) {
+			sink.recvState = { src_id: sink.nextSrcId++ & 0xff, broadcast_id };
+
+			this.#event(MessageSubType.SOURCE_ADDED, [
+				...this.#sinkAddrLtv(sink),
+				...ltv(BT_DataType.BT_DATA_BROADCAST_ID, le(broadcast_id, 4)),
+				...errorLtv(0)
+			]);
+
+			this.#recvStateChanged(sink, {
+				pa_sync_state: PA_SYNC_STATE_SYNC_INFO_REQ,
+				enc_state: 0,
+				bis_sync: 0
+			});
+
+			const recvState = sink.recvState;
+			this.#later(this.#options.syncLatency, () => {
+				if (sink.recvState !== recvState) {
+					return;
+				}
+
+				this.#recvStateChanged(sink, {
+					pa_sync_state: PA_SYNC_STATE_SYNCED,
+					bis_sync: 0x1
+				});
+			});
+		}
+	}
+
+	#removeSource(message) {
+		const connected = this.#sinks.filter(sink => sink.state === 'connected');
+		const withSource = connected.filter(sink => sink.recvState);
+
+		if (withSource.length === 0) {
+			this.#response(message.subType, message.seqNo, connected.length ? -ENOENT : -ENOTCONN);
+			return;
+		}
+
+		this.#response(message.subType, message.seqNo);
+
+		for (const sink of withSource) {
+
+			this.#recvStateChanged(sink, {
+				pa_sync_state: PA_SYNC_STATE_NOT_SYNCED,
+				bis_sync: 0
+			});
+
+			this.#event(MessageSubType.SOURCE_REMOVED, [
+				...this.#sinkAddrLtv(sink),
+				...ltv(BT_DataType.BT_DATA_SOURCE_ID, [sink.recvState.src_id]),
+				...errorLtv(0)
+			]);
+
+			sink.recvState = undefined;
+		}
+	}
 }
+
+export const MockDeviceService = new MockDevice();
@@ -0,0 +1,547 @@
+// @ts-check
+
+import {
+	arrayToMsg,
+	msgToArray,
+	messageLtv,
+	tvArrayToLtv,
+	bufToAddressKey,
+	LtvView,
+	MessageType,
+	MessageSubType,
+	BT_DataType
+} from '../lib/message.js';
+import { DongleRouter } from '../lib/dongle-router.js';
+import { CaptureWriter } from '../lib/capture.js';
+import { Metrics } from '../lib/metrics.js';
+
+/**
+* Multi Device Service
+*
+* Same interface (to the application) as the WebUSB Device service
+*
+* Drives several assistant dongles (each a device service, e.g. a
+* WebUSBDongle or a MockDevice) as one, to get past the connection limit
+* (CONFIG_BT_MAX_CONN) and radio time of a single dongle:
+*
+* - Scan reports are merged: a device is forwarded from the dongle hearing
+*   it best, duplicates from the other dongles are dropped (see
+*   DongleRouter). Heartbeats are forwarded from the first dongle only.
+* - CONNECT_SINK goes to the dongle with spare capacity that heard the sink
+*   best, DISCONNECT_SINK to the dongle the sink is connected through.
+*   ADD_SOURCE/REMOVE_SOURCE go to the dongles with connected sinks, a
+*   dongle without a source to remove (-ENOENT) does not fail REMOVE_SOURCE.
+*   The USB benchmark commands (ECHO, DISCARD, FLOOD) measure one link and
+*   go to the first dongle, as raw data does.
+* - Other commands concern the whole room and are sent to all dongles in
+*   parallel. The promise resolves with the first error response, or the
+*   first response if all succeeded. GET_SCAN_FILTER_STATS responses are
+*   summed up (and dispatched as one message). GET_STATE_SNAPSHOT makes
+*   every dongle send its snapshot, the router is updated from them.
+* - A dongle joining later is reset and gets the last scan, scan filter,
+*   RSSI report and link parameter commands, so it works like the others.
+*
+* 'connected' is dispatched when the first dongle connects, 'disconnected'
+* when the last one is gone, 'dongles-changed' on every change. Messages
+* carry the id of the dongle they came from (message.dongle). Events also
+* carry the number of events of that dongle dropped here since the previous
+* one (message.skipped), they are not a gap in its event sequence.
+*/
+
+// The firmware connects one sink at a time (connect_to_sink())
+const DEFAULT_DONGLE_CAPACITY = 1;
+
+const ADDR_TYPES = [BT_DataType.BT_DATA_IDENTITY, BT_DataType.BT_DATA_RPA];
+
+// CONN_STATE of SINK_STATE
+const SINK_CONN_STATE_CONNECTING = 1;
+
+// Commands replayed to dongles joining later, by the state they set
+const roomStateKey = subType => {
+	switch (subType) {
+		case MessageSubType.START_SINK_SCAN:
+		case MessageSubType.START_SOURCE_SCAN:
+		case MessageSubType.START_SCAN_ALL:
+		case MessageSubType.STOP_SCAN:
+		return 'scan';
+		case MessageSubType.SET_SCAN_FILTER:
+		case MessageSubType.SET_LINK_PARAMS:
+		case MessageSubType.SET_RSSI_REPORT:
+		return subType;
+	}
+}
+
+const addressKey = ltvs => {
+	const addr = ltvs.find(ADDR_TYPES);
+
+	return addr && bufToAddressKey(addr.value.addr);
+}
+
+const ENOENT = 2;
+
+const errorCode = message => messageLtv(message).find([BT_DataType.BT_DATA_ERROR_CODE])?.value ?? 0;
+
+const sumFilterStats = responses => {
+	const counts = new Map();
+
+	for (const response of responses) {
+		for (const item of messageLtv(response)) {
+			if (item.type === BT_DataType.BT_DATA_FILTER_STATS) {
+				counts.set(item.value.filter, (counts.get(item.value.filter) ?? 0) + item.value.count);
+			}
+		}
+	}
+
+	const { type, subType, seqNo } = responses[0];
+
+	return arrayToMsg(msgToArray({ type, subType, seqNo, payload: tvArrayToLtv([
+		{ type: BT_DataType.BT_DATA_ERROR_CODE, value: 0 },
+		...[...counts].map(([filter, count]) => ({ type: BT_DataType.BT_DATA_FILTER_STATS, value: { filter, count } }))
+	])}));
+}
+
+export class MultiDeviceService extends EventTarget {
+	#dongles
+	#router
+	#roomState
+	#capacity
+	#readsInFlight
+	#commandWindow
+	#commandTimeout
+	#metrics
+	#capturing
+	#captureMaxBytes
+
+	constructor() {
+		super();
+
+		this.scan = this.scan.bind(this);
+		this.sendCMD = this.sendCMD.bind(this);
+		this.sendData = this.sendData.bind(this);
+
+		this.#dongles = new Map();
+		this.#router = new DongleRouter();
+		this.#roomState = new Map();
+		this.#capacity = DEFAULT_DONGLE_CAPACITY;
+		this.#metrics = false;
+		this.#capturing = false;
+	}
+
+	/**
+	* Add a dongle (a device service), it takes part once it is connected
+	*
+	* @param {string} id
+	* @param {EventTarget & { [method: string]: any }} service
+	*/
+	addDongle(id, service) {
+		if (this.#dongles.has(id)) {
+			return;
+		}
+
+		const dongle = { id, service, connected: false, device: undefined, skipped: 0, snapshot: undefined };
+		this.#dongles.set(id, dongle);
+
+		service.addEventListener('connected', evt => this.#dongleConnected(dongle, evt.detail.device));
+		service.addEventListener('disconnected', () => this.#dongleDisconnected(dongle));
+		service.addEventListener('message', evt => this.#dongleMessage(dongle, evt.detail.message));
+		service.addEventListener('command-sent', evt => {
+			this.dispatchEvent(new CustomEvent('command-sent', {detail: { message: { ...evt.detail.message, dongle: id }}}));
+		});
+
+		if (this.#readsInFlight !== undefined) {
+			service.setReadsInFlight(this.#readsInFlight);
+		}
+		if (this.#commandWindow !== undefined) {
+			service.setCommandWindow(this.#commandWindow);
+		}
+		if (this.#commandTimeout !== undefined) {
+			service.setCommandTimeout(this.#commandTimeout);
+		}
+		service.enableMetrics(this.#metrics);
+	}
+
+	getDongle(id) {
+		return this.#dongles.get(id)?.service;
+	}
+
+	get connected() {
+		return this.#router.dongles.length > 0;
+	}
+
+	#primary() {
+		return this.#dongles.get(this.#router.dongles[0]);
+	}
+
+	#dongleConnected(dongle, device) {
+		if (dongle.connected) {
+			return;
+		}
+
+		const first = !this.connected;
+
+		dongle.connected = true;
+		dongle.device = device;
+		this.#router.addDongle(dongle.id, this.#capacity);
+
+		if (this.#capturing) {
+			dongle.service.startCapture(this.#captureMaxBytes);
+		}
+
+		this.dispatchEvent(new CustomEvent('dongles-changed'));
+
+		if (first) {
+			this.dispatchEvent(new CustomEvent('connected', { detail: { device, dongle: dongle.id }}));
+		} else {
+			this.#joinRoom(dongle);
+		}
+	}
+
+	#dongleDisconnected(dongle) {
+		if (!dongle.connected) {
+			return;
+		}
+
+		dongle.connected = false;
+		this.#router.removeDongle(dongle.id);
+
+		this.dispatchEvent(new CustomEvent('dongles-changed'));
+
+		if (!this.connected) {
+			this.dispatchEvent(new CustomEvent('disconnected', { detail: {}}));
+		}
+	}
+
+	// Bring a dongle joining later to the state of the others
+	async #joinRoom(dongle) {
+		const commands = [{ type: MessageType.CMD, subType: MessageSubType.RESET }, ...this.#roomState.values()];
+
+		try {
+			for (const message of commands) {
+				this.#router.commandSent(dongle.id);
+				await dongle.service.sendCMD(message);
+			}
+		} catch (error) {
+			console.warn(`Dongle ${dongle.id} could not join:`, error.message);
+		}
+	}
+
+	#dongleMessage(dongle, message) {
+		message.dongle = dongle.id;
+
+		if (message.type === MessageType.EVT) {
+			switch (message.subType) {
+				case MessageSubType.SINK_FOUND:
+				case MessageSubType.SOURCE_FOUND:
+				{
+					const entries = messageLtv(message);
+					const key = addressKey(entries);
+					if (key !== undefined && !this.#router.scanReport(dongle.id, key, entries.find([BT_DataType.BT_DATA_RSSI])?.value)) {
+						// Not a gap in the event sequence of the dongle
+						dongle.skipped++;
+						if (Metrics.enabled) {
+							Metrics.add('merged');
+						}
+						return;
+					}
+				}
+				break;
+				case MessageSubType.SINK_CONNECTED:
+				{
+					const key = addressKey(messageLtv(message));
+					if (key !== undefined) {
+						this.#router.connected(dongle.id, key, errorCode(message) === 0);
+					}
+				}
+				break;
+				case MessageSubType.SINK_DISCONNECTED:
+				{
+					const key = addressKey(messageLtv(message));
+					if (key !== undefined) {
+						this.#router.disconnected(dongle.id, key);
+					}
+				}
+				break;
+				case MessageSubType.IDENTITY_RESOLVED:
+				{
+					const entries = messageLtv(message);
+					const rpa = entries.find([BT_DataType.BT_DATA_RPA]);
+					const identity = entries.find([BT_DataType.BT_DATA_IDENTITY]);
+					if (rpa && identity) {
+						this.#router.identityResolved(dongle.id, bufToAddressKey(rpa.value.addr), bufToAddressKey(identity.value.addr));
+					}
+				}
+				break;
+				case MessageSubType.STATE_SNAPSHOT_BEGIN:
+				dongle.snapshot = new Set();
+				break;
+				case MessageSubType.SINK_STATE:
+				{
+					const entries = messageLtv(message);
+					const key = addressKey(entries);
+					if (key !== undefined) {
+						const connState = entries.find([BT_DataType.BT_DATA_CONN_STATE])?.value;
+						if (connState === SINK_CONN_STATE_CONNECTING) {
+							this.#router.connecting(dongle.id, key);
+						} else {
+							this.#router.connected(dongle.id, key, true);
+						}
+						dongle.snapshot?.add(key);
+					}
+				}
+				break;
+				case MessageSubType.STATE_SNAPSHOT_END:
+				// Sinks the dongle no longer has (the disconnect event was lost)
+				if (dongle.snapshot && errorCode(message) === 0) {
+					for (const key of this.#router.sinksOf(dongle.id)) {
+						if (!dongle.snapshot.has(key)) {
+							this.#router.disconnected(dongle.id, key);
+						}
+					}
+				}
+				dongle.snapshot = undefined;
+				break;
+				case MessageSubType.HEARTBEAT:
+				if (dongle !== this.#primary()) {
+					return;
+				}
+				break;
+			}
+
+			if (message.subType !== MessageSubType.HEARTBEAT) {
+				message.skipped = dongle.skipped;
+				dongle.skipped = 0;
+			}
+		} else if (message.type === MessageType.RES && message.subType === MessageSubType.GET_SCAN_FILTER_STATS) {
+			// Dispatched summed up when all dongles have responded
+			return;
+		}
+
+		this.dispatchEvent(new CustomEvent('message', {detail: { message }}));
+	}
+
+	#sendTo(id, message) {
+		this.#router.commandSent(id);
+
+		return this.#dongles.get(id).service.sendCMD(message);
+	}
+
+	async #fanOut(ids, message) {
+		const results = await Promise.allSettled(ids.map(id => this.#sendTo(id, message)));
+
+		const responses = [];
+		results.forEach((result, i) => {
+			if (result.status === 'fulfilled') {
+				responses.push(result.value);
+			} else if (ids.length > 1) {
+				console.warn(`Command 0x${message.subType.toString(16)} failed on dongle ${ids[i]}:`, result.reason.message);
+			}
+		});
+
+		if (responses.length === 0) {
+			throw results[0].status === 'rejected' ? results[0].reason : new Error('No response');
+		}
+
+		if (message.subType === MessageSubType.GET_SCAN_FILTER_STATS) {
+			return sumFilterStats(responses);
+		}
+
+		let merged = responses;
+		if (message.subType === MessageSubType.REMOVE_SOURCE) {
+			// Nothing to remove on one dongle is fine if another dongle removed a source
+			const removed = responses.filter(response => errorCode(response) !== -ENOENT);
+			merged = removed.length ? removed : responses;
+		}
+
+		return merged.find(response => errorCode(response) !== 0) ?? merged[0];
+	}
+
+	async #connectSink(message) {
+		const key = addressKey(new LtvView(message.payload));
+		const id = key === undefined ? this.#router.dongles[0] : this.#router.pickDongle(key);
+
+		if (id === undefined) {
+			throw new Error('No dongle with spare capacity');
+		}
+
+		if (key === undefined) {
+			return this.#sendTo(id, message);
+		}
+
+		this.#router.connecting(id, key);
+
+		try {
+			const response = await this.#sendTo(id, message);
+			if (errorCode(response) !== 0) {
+				this.#router.connected(id, key, false);
+			}
+			return response;
+		} catch (error) {
+			this.#router.connected(id, key, false);
+			throw error;
+		}
+	}
+
+	#targets(message) {
+		switch (message.subType) {
+			case MessageSubType.DISCONNECT_SINK:
+			{
+				const owner = this.#router.ownerOf(addressKey(new LtvView(message.payload)));
+				return owner === undefined ? this.#router.dongles : [owner];
+			}
+			case MessageSubType.ADD_SOURCE:
+			case MessageSubType.REMOVE_SOURCE:
+			{
+				const withSinks = this.#router.withSinks();
+				return withSinks.length ? withSinks : this.#router.dongles;
+			}
+			case MessageSubType.ECHO:
+			case MessageSubType.DISCARD:
+			case MessageSubType.FLOOD:
+			return this.#router.dongles.slice(0, 1);
+			default:
+			return this.#router.dongles;
+		}
+	}
+
+	/**
+	* Send a command to the dongle(s) it concerns
+	*
+	* @returns {Promise<any>}	Resolves with the (merged) response message
+	*/
+	sendCMD(message) {
+		if (!this.connected) {
+			return Promise.reject(new Error('Sending command failed (not-connected)'));
+		}
+
+		if (message.subType === MessageSubType.RESET) {
+			this.#roomState.clear();
+		}
+		const stateKey = roomStateKey(message.subType);
+		if (stateKey !== undefined) {
+			this.#roomState.set(stateKey, message);
+		}
+
+		if (message.subType === MessageSubType.CONNECT_SINK) {
+			return this.#connectSink(message);
+		}
+
+		const pending = this.#fanOut(this.#targets(message), message);
+
+		if (message.subType === MessageSubType.GET_SCAN_FILTER_STATS) {
+			pending.then(response => {
+				this.dispatchEvent(new CustomEvent('message', {detail: { message: response }}));
+			}, () => {});
+		}
+
+		return pending;
+	}
+
+	/**
+	* Raw data goes to the first dongle
+	*/
+	async sendData(data) {
+		return this.#primary()?.service.sendData(data) ?? { status: 'not-connected' };
+	}
+
+	scan() {
+		this.#dongles.forEach(dongle => dongle.service.scan());
+	}
+
+	async reconnectPairedDevices() {
+		await Promise.all([...this.#dongles.values()].map(dongle => dongle.service.reconnectPairedDevices()));
+	}
+
+	disconnect() {
+		this.#dongles.forEach(dongle => dongle.service.disconnect?.());
+	}
+
+	/**
+	* Max connected sinks per dongle (CONFIG_BT_MAX_CONN of the firmware)
+	*/
+	setDongleCapacity(capacity) {
+		this.#capacity = Math.max(1, Math.floor(capacity) || DEFAULT_DONGLE_CAPACITY);
+		this.#router.dongles.forEach(id => this.#router.setCapacity(id, this.#capacity));
+	}
+
+	setReadsInFlight(count) {
+		this.#readsInFlight = count;
+		this.#dongles.forEach(dongle => dongle.service.setReadsInFlight(count));
+	}
+
+	setCommandWindow(window) {
+		this.#commandWindow = window;
+		this.#dongles.forEach(dongle => dongle.service.setCommandWindow(window));
+	}
+
+	setCommandTimeout(timeout) {
+		this.#commandTimeout = timeout;
+		this.#dongles.forEach(dongle => dongle.service.setCommandTimeout(timeout));
+	}
+
+	enableMetrics(enabled) {
+		this.#metrics = enabled;
+		this.#dongles.forEach(dongle => dongle.service.enableMetrics(enabled));
+	}
+
+	/**
+	* Round trip time stats per command subType over all dongles (counts
+	* summed up, percentiles of the slowest dongle)
+	*/
+	getCommandStats() {
+		const result = new Map();
+
+		for (const dongle of this.#dongles.values()) {
+			for (const [subType, stats] of dongle.service.getCommandStats()) {
+				const merged = result.get(subType);
+				if (!merged) {
+					result.set(subType, { ...stats, histogram: [...stats.histogram] });
+					continue;
+				}
+
+				merged.count += stats.count;
+				merged.timeouts += stats.timeouts;
+				merged.errors += stats.errors;
+				merged.min = Math.min(merged.min ?? Infinity, stats.min ?? Infinity);
+				merged.max = Math.max(merged.max ?? 0, stats.max ?? 0);
+				merged.p50 = Math.max(merged.p50 ?? 0, stats.p50 ?? 0);
+				merged.p95 = Math.max(merged.p95 ?? 0, stats.p95 ?? 0);
+				stats.histogram.forEach((count, i) => { merged.histogram[i] += count; });
+			}
+		}
+
+		return result;
+	}
+
+	/**
+	* @returns	Per connected dongle: { id, device, capacity, sinks, connecting,
+	*		reports, forwarded, commands } (see DongleRouter.getStats())
+	*/
+	getDongleStats() {
+		return this.#router.getStats().map(stats => ({ ...stats, device: this.#dongles.get(stats.id)?.device }));
+	}
+
+	/**
+	* Captures are kept per dongle (the streams can not be interleaved),
+	* stopCapture() returns the one of the first dongle
+	*/
+	startCapture(maxBytes) {
+		this.#capturing = true;
+		this.#captureMaxBytes = maxBytes;
+		this.#dongles.forEach(dongle => {
+			if (dongle.connected) {
+				dongle.service.startCapture(maxBytes);
+			}
+		});
+	}
+
+	async stopCapture() {
+		this.#capturing = false;
+
+		const primary = this.#primary();
+		const captures = await Promise.all([...this.#dongles.values()]
+			.filter(dongle => dongle.connected)
+			.map(async dongle => [dongle, await dongle.service.stopCapture()]));
+
+		return captures.find(([dongle]) => dongle === primary)?.[1] ?? new CaptureWriter().toArray();
+	}
+}
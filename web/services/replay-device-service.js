@@ -0,0 +1,213 @@
+// @ts-check
+
+import { arrayToMsg, msgToArray, MessageType } from '../lib/message.js';
+import { cobsEncodeInto, cobsDecodeInto, cobsDecodedLengthMax } from '../lib/cobs.js';
+import { StreamDeframer } from '../lib/stream-deframer.js';
+import { readCapture, CaptureFlags } from '../lib/capture.js';
+import { Metrics } from '../lib/metrics.js';
+
+/**
+* Replay Device Service
+*
+* Same interface (to the application) as the WebUSB Device service
+*
+* Plays back a capture (see capture.js) as if it came from a device: the
+* received data goes through deframing, COBS decoding and arrayToMsg, and
+* is dispatched as 'message' events. Captured messages (e.g. an exported
+* activity log) are COBS encoded first, so they take the same path.
+*
+* Sent data in the capture is skipped. Commands sent during the replay are
+* not forwarded anywhere, they resolve at once with an OK response that is
+* not dispatched (the captured responses are).
+*
+* Replay speed: 0 plays back as fast as possible (yielding to the event loop
+* every YIELD_MS so the page keeps rendering), 1 uses the original timing,
+* other values scale it.
+*/
+
+const YIELD_MS = 10;
+
+const okResponse = message => arrayToMsg(msgToArray({
+	type: MessageType.RES,
+	subType: message.subType,
+	seqNo: message.seqNo,
+	// ERROR_CODE 0
+	payload: new Uint8Array([5, 0xfb, 0, 0, 0, 0])
+}));
+
+export const ReplayDeviceService = new class extends EventTarget {
+	#records
+	#speed
+	#connected
+	#replaying
+	#deframer
+	#seqNo
+
+	constructor() {
+		super();
+
+		this.scan = this.scan.bind(this);
+		this.sendCMD = this.sendCMD.bind(this);
+		this.sendData = this.sendData.bind(this);
+
+		this.#records = [];
+		this.#speed = 0;
+		this.#connected = false;
+		this.#deframer = new StreamDeframer();
+		this.#seqNo = 1;
+	}
+
+	/**
+	* @param {Uint8Array} data	Capture file content
+	*/
+	load(data) {
+		this.#records = readCapture(data).records.filter(record => !(record.flags & CaptureFlags.OUT));
+	}
+
+	/**
+	* @param {number} speed	0: as fast as possible, 1: original timing, ...
+	*/
+	setSpeed(speed) {
+		this.#speed = Math.max(0, Number(speed) || 0);
+	}
+
+	async reconnectPairedDevices() {
+		this.#connect();
+	}
+
+	scan() {
+		this.#connect();
+	}
+
+	disconnect() {
+		if (!this.#connected) {
+			return;
+		}
+
+		this.#connected = false;
+		this.dispatchEvent(new CustomEvent('disconnected', { detail: {}}));
+	}
+
+	setReadsInFlight(count) {
+		// No transfers to pipeline
+	}
+
+	setCommandWindow(window) {
+	}
+
+	setCommandTimeout(timeout) {
+	}
+
+	getCommandStats() {
+		return new Map();
+	}
+
+	enableMetrics(enabled) {
+		// Decoding runs on the main thread, timed when Metrics.enabled
+	}
+
+	async sendData(data) {
+		return { status: "ok" };
+	}
+
+	sendCMD(message) {
+		message = { ...message, seqNo: this.#seqNo };
+		this.#seqNo = this.#seqNo % 255 + 1;
+
+		this.dispatchEvent(new CustomEvent('command-sent', {detail: { message }}));
+
+		return Promise.resolve(okResponse(message));
+	}
+
+	#connect() {
+		if (this.#connected) {
+			return;
+		}
+
+		this.#connected = true;
+		this.dispatchEvent(new CustomEvent('connected', { detail: { device: { productName: 'Replay' }}}));
+	}
+
+	#onFrame = frame => {
+		const start = Metrics.enabled ? performance.now() : 0;
+		const decoded = new Uint8Array(cobsDecodedLengthMax(frame.length));
+
+		let message;
+		try {
+			message = arrayToMsg(cobsDecodeInto(frame, false, decoded));
+		} catch (error) {
+			console.warn('Dropping invalid frame', error);
+			if (Metrics.enabled) {
+				Metrics.add('dropped');
+			}
+			return;
+		}
+
+		if (Metrics.enabled) {
+			Metrics.add('usb.frames');
+			Metrics.add('decode', performance.now() - start);
+		}
+
+		this.dispatchEvent(new CustomEvent('message', {detail: { message }}));
+	}
+
+	#feed(record) {
+		const data = record.flags & CaptureFlags.RAW ? record.data : cobsEncodeInto(record.data, true);
+
+		if (Metrics.enabled) {
+			Metrics.add('usb.bytes', data.length);
+		}
+
+		this.#deframer.push(data, this.#onFrame);
+	}
+
+	/**
+	* Play back the loaded capture
+	*
+	* @returns {Promise<{ records: number, duration: number, elapsed: number }>}
+	*	Captured and replay duration in ms
+	*/
+	async replay() {
+		if (this.#replaying) {
+			throw new Error("Replay already running");
+		}
+
+		this.#connect();
+		this.#replaying = true;
+		this.#deframer.reset();
+
+		const records = this.#records;
+		const speed = this.#speed;
+		const captureStart = records[0]?.time ?? 0;
+		const start = performance.now();
+
+		let yielded = start;
+
+		try {
+			for (const record of records) {
+				if (!this.#connected) {
+					break;
+				}
+
+				if (speed > 0) {
+					const due = start + (record.time - captureStart) / speed;
+					const wait = due - performance.now();
+					if (wait > 0) {
+						await new Promise(resolve => setTimeout(resolve, wait));
+					}
+				} else if (performance.now() - yielded > YIELD_MS) {
+					await new Promise(resolve => setTimeout(resolve, 0));
+					yielded = performance.now();
+				}
+
+				this.#feed(record);
+			}
+		} finally {
+			this.#replaying = false;
+		}
+
+		const duration = records.length ? records[records.length - 1].time - captureStart : 0;
+
+		return { records: records.length, duration, elapsed: performance.now() - start };
+	}
+}
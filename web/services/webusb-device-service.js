@@ -1,120 +1,253 @@
 // @ts-check
 
-import { arrayToMsg, msgToArray, MessageType, MessageSubType } from '../lib/message.js';
-import { cobsEncode, cobsDecode } from '../lib/cobs.js';
+import { arrayToMsg, MessageType } from '../lib/message.js';
+import { CommandManager } from '../lib/command-manager.js';
+import { Metrics } from '../lib/metrics.js';
+import { MultiDeviceService } from './multi-device-service.js';
 
 /**
 * WebUSB Device Service
 *
 * Handles USB communication and COBS encoding/decoding of messages
 *
+* Several assistant devices (dongles) can be used at once, see
+* MultiDeviceService. Each dongle (WebUSBDongle) has its own transport
+* worker (webusb-worker.js). The main thread only requests device access
+* (needs a user gesture), forwards commands and turns the message batches
+* from the workers into 'message' events. The messages are views of the
+* transferred batch buffer.
+*
+* scan() adds a dongle, dongles granted earlier are opened by
+* reconnectPairedDevices() and when plugged in.
+*
+* Transfers can be captured for offline replay (startCapture/stopCapture).
+*
+* Commands go through a CommandManager per dongle: sendCMD() assigns the
+* seqNo and returns a promise for the matching response.
+*
 * (Early draft)
 *
 */
 
 const deviceFilter = { 'vendorId': 0x2fe3, 'productId': 0x00a };
 
-const MAX_BYTES_READ = 4096;
+const DEFAULT_READS_IN_FLIGHT = 4;
 
-export const WebUSBDeviceService = new class extends EventTarget {
-	#device
+const DEFAULT_CAPTURE_MAX_BYTES = 64 * 1024 * 1024;
 
-	constructor() {
+const matchesFilter = device => device.vendorId === deviceFilter.vendorId && device.productId === deviceFilter.productId;
+
+/**
+* One assistant device, opened by serial number (undefined: the first one)
+*/
+export class WebUSBDongle extends EventTarget {
+	#serialNumber
+	#worker
+	#readsInFlight = DEFAULT_READS_IN_FLIGHT
+	#nextId = 0
+	#pending = new Map()
+	#commands
+
+	constructor(serialNumber) {
 		super();
 
 		this.scan = this.scan.bind(this);
 		this.sendCMD = this.sendCMD.bind(this);
 		this.sendData = this.sendData.bind(this);
 
-		navigator.usb.addEventListener("disconnect", (event) => {
-			const { device } = event;
+		this.#serialNumber = serialNumber;
+
+		this.#worker = new Worker(new URL('./webusb-worker.js', import.meta.url), { type: 'module' });
+		this.#worker.addEventListener('message', evt => this.#workerMessage(evt.data));
+		this.#worker.addEventListener('error', evt => console.log('WebUSB worker error', evt));
+
+		this.#commands = new CommandManager(message => this.#sendCommand(message));
+	}
+
+	#workerMessage(data) {
+		switch (data.type) {
+			case 'messages':
+			if (Metrics.enabled) {
+				this.#addMetrics(data);
+			}
+			this.#dispatchMessages(new Uint8Array(data.buffer), data.offsets);
+			break;
+			case 'connected':
+			this.dispatchEvent(new CustomEvent('connected', { detail: { device: data.device }}));
+			break;
+			case 'disconnected':
+			console.log("Disconnected");
+			this.#commands.abort('Disconnected');
+			this.dispatchEvent(new CustomEvent('disconnected', { detail: {}}));
+			break;
+			case 'sent':
+			this.#pending.get(data.id)?.(data.status);
+			this.#pending.delete(data.id);
+			break;
+			case 'capture':
+			this.#pending.get(data.id)?.(data.data);
+			this.#pending.delete(data.id);
+			break;
+			default:
+			console.warn(`Unknown worker message ${data.type}`);
+		}
+	}
+
+	#addMetrics({ stats, coalesced }) {
+		Metrics.add('usb.frames', stats.frames);
+		Metrics.add('usb.bytes', stats.bytes);
+		Metrics.add('decode', stats.decodeTime, stats.frames);
+		Metrics.add('coalesced', coalesced);
+		Metrics.add('dropped', stats.dropped);
+	}
 
-			if (device === this.#device) {
-				console.log("Disconnected ", device);
-				this.dispatchEvent(new CustomEvent('disconnected', { detail: { device: this.#device }}));
+	#dispatchMessages(buffer, offsets) {
+		for (let i = 0; i + 1 < offsets.length; i++) {
+			const message = arrayToMsg(buffer.subarray(offsets[i], offsets[i + 1]));
+			if (message.type === MessageType.RES) {
+				this.#commands.handleResponse(message);
 			}
+			this.dispatchEvent(new CustomEvent('message', {detail: { message }}));
+		}
+	}
+
+	#request(request, transfer = []) {
+		const id = this.#nextId++;
+
+		return new Promise(resolve => {
+			this.#pending.set(id, resolve);
+			this.#worker.postMessage({ ...request, id }, transfer);
 		});
+	}
 
-		navigator.usb.addEventListener('connect', evt => this._openDevice(evt.device));
+	/**
+	* Open the device (if not open already)
+	*/
+	open() {
+		this.#worker.postMessage({
+			type: 'open',
+			filter: deviceFilter,
+			serialNumber: this.#serialNumber,
+			readsInFlight: this.#readsInFlight
+		});
 	}
 
 	async reconnectPairedDevices() {
-		const availableDevices = await navigator.usb.getDevices();
-
-		if (availableDevices.length) {
-		    this._openDevice(availableDevices[0]);
-		}
+		this.open();
 	}
 
 	scan() {
-		navigator.usb.requestDevice({ filters: [deviceFilter] })
-		.then(selectedDevice => {
-			this._openDevice(selectedDevice);
-		})
-		.catch(error => { console.log(error); });
+		this.open();
 	}
 
-	readLoop() {
-		const {
-			endpointNumber
-		} = this.#device.configuration.interfaces[0].alternate.endpoints[0]
-		this.#device.transferIn(endpointNumber, MAX_BYTES_READ).then(result => {
-			const buf = new Uint8Array(result.data.buffer);
+	/**
+	* Number of transferIn requests kept outstanding, applied on the next open
+	*/
+	setReadsInFlight(count) {
+		this.#readsInFlight = Math.max(1, Math.floor(count) || DEFAULT_READS_IN_FLIGHT);
+	}
 
-			if (buf.length === 0) {
-				console.log("Probably rebooted. Disconnecting!");
-				this.#device.close();
-			}
+	async sendData(data) {
+		const status = await this.#request({ type: 'send-data', data });
 
-			this.dispatchEvent(new CustomEvent('raw-data-received', {detail: { buf }}));
+		return { status };
+	}
 
-			// decode to message
-			let decoded = cobsDecode(buf, true);
-			const message = arrayToMsg(decoded);
-			this.dispatchEvent(new CustomEvent('message', {detail: { message }}));
+	/**
+	* Have the worker time the decoding (reported through Metrics)
+	*/
+	enableMetrics(enabled) {
+		this.#worker.postMessage({ type: 'metrics', enabled });
+	}
 
-			this.readLoop();
-		}, error => {
-			console.log('error', error);
-		});
+	/**
+	* Start capturing all transfers, both directions, with timestamps.
+	* Capturing stops adding records when the capture reaches maxBytes.
+	*/
+	startCapture(maxBytes = DEFAULT_CAPTURE_MAX_BYTES) {
+		this.#worker.postMessage({ type: 'capture-start', maxBytes });
+	}
+
+	/**
+	* @returns {Promise<Uint8Array>}	The capture (see capture.js)
+	*/
+	stopCapture() {
+		return this.#request({ type: 'capture-stop' });
 	}
 
-	sendData(data) {
-		if (!this.#device) {
-			console.warn('Device not connected');
-			return;
+	async #sendCommand(message) {
+		// Encoded in the worker
+		const status = await this.#request({ type: 'send', message });
+
+		if (status !== "ok") {
+			throw new Error(`Sending command failed (${status})`);
 		}
 
-		const {
-			endpointNumber
-		} = this.#device.configuration.interfaces[0].alternate.endpoints[1];
+		this.dispatchEvent(new CustomEvent('command-sent', {detail: { message }}));
+	}
 
-		return this.#device.transferOut(endpointNumber, data);
+	/**
+	* Send a command, the seqNo of the message is assigned here
+	*
+	* @returns {Promise<any>}	Resolves with the response message
+	*/
+	sendCMD(message) {
+		return this.#commands.submit(message);
 	}
 
-	async sendCMD(message) {
-		let arrayIn = msgToArray(message);
-		let encoded = cobsEncode(arrayIn, true);
+	/**
+	* Max number of commands sent without waiting for their response
+	*/
+	setCommandWindow(window) {
+		this.#commands.setWindow(window);
+	}
 
-		const result = await this.sendData(encoded);
+	setCommandTimeout(timeout) {
+		this.#commands.setTimeout(timeout);
+	}
 
-		if (result.status === "ok") {
-			this.dispatchEvent(new CustomEvent('command-sent', {detail: { message }}));
-		}
+	/**
+	* Round trip time stats per command subType, see CommandManager.getStats()
+	*/
+	getCommandStats() {
+		return this.#commands.getStats();
+	}
+}
+
+export const WebUSBDeviceService = new class extends MultiDeviceService {
+	constructor() {
+		super();
+
+		navigator.usb?.addEventListener('connect', evt => {
+			if (matchesFilter(evt.device)) {
+				this.#open(evt.device);
+			}
+		});
 	}
 
-	async _openDevice(device) {
-		await device.open()
-		if (device.configuration === null) {
-			return device.selectConfiguration(1);
+	// The worker of a dongle sees the same granted devices
+	#open(device) {
+		const id = device.serialNumber ?? '';
+
+		if (!this.getDongle(id)) {
+			this.addDongle(id, new WebUSBDongle(device.serialNumber ?? undefined));
 		}
 
-		await device.claimInterface(0);
+		this.getDongle(id).open();
+	}
 
-		this.#device = device;
+	async reconnectPairedDevices() {
+		const devices = (await navigator.usb.getDevices()).filter(matchesFilter);
 
-		this.dispatchEvent(new CustomEvent('connected', { detail: { device }}));
+		devices.forEach(device => this.#open(device));
+	}
 
-		this.readLoop();
+	/**
+	* Select a device to add (needs a user gesture)
+	*/
+	scan() {
+		navigator.usb.requestDevice({ filters: [deviceFilter] })
+		.then(selectedDevice => this.#open(selectedDevice))
+		.catch(error => { console.log(error); });
 	}
 }
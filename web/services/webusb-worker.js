@@ -0,0 +1,372 @@
+// @ts-check
+
+import {
+	arrayToMsg,
+	LtvView,
+	bufToAddressKey,
+	MessageType,
+	MessageSubType,
+	BT_DataType
+} from '../lib/message.js';
+import { cobsDecodeInto, cobsDecodedLengthMax } from '../lib/cobs.js';
+import { CommandEncoder } from '../lib/command-encoder.js';
+import { StreamDeframer } from '../lib/stream-deframer.js';
+import { CaptureWriter, CaptureFlags } from '../lib/capture.js';
+
+/**
+* WebUSB Worker
+*
+* Runs the USB transport off the main thread: transfers, deframing, COBS
+* decoding/encoding and message validation. Decoded messages are collected
+* and posted to the main thread in batches, as one transferable buffer.
+*
+* Optionally, all transfers (both directions) are captured with timestamps,
+* see capture.js.
+*
+* Within a batch, scan reports (SINK_FOUND/SOURCE_FOUND) for the same device
+* are coalesced: the report keeps the position of the first one and the
+* content of the latest one.
+*
+* requestDevice() needs a user gesture and stays on the main thread, the
+* worker opens devices that the page has been granted access to. Each worker
+* drives one device (dongle), picked by serial number. Reopening after a
+* replug is requested by the main thread.
+*
+* main -> worker:
+*	{ type: 'open', filter, serialNumber?, readsInFlight }
+*	{ type: 'send', id, message }		encode and send a command
+*	{ type: 'send-data', id, data }		send raw (already encoded) data
+*	{ type: 'capture-start', maxBytes }
+*	{ type: 'capture-stop', id }
+*	{ type: 'metrics', enabled }		time the decoding (see stats below)
+*
+* worker -> main:
+*	{ type: 'connected', device }		device: { productName, serialNumber }
+*	{ type: 'disconnected' }
+*	{ type: 'messages', buffer, offsets, coalesced, stats }
+*		buffer holds the decoded messages back to back, message i is
+*		[offsets[i], offsets[i + 1]). Both are transferred.
+*		stats: { frames, bytes, decodeTime, dropped } since the previous
+*		batch, decodeTime (ms) is only measured with metrics enabled
+*	{ type: 'sent', id, status }
+*	{ type: 'capture', id, data }		data: capture file content (transferred)
+*/
+
+const MAX_BYTES_READ = 4096;
+
+// Batches are flushed once per frame, or earlier when they grow large
+const BATCH_INTERVAL_MS = 16;
+const BATCH_MAX_BYTES = 64 * 1024;
+
+const isScanReport = (type, subType) => type === MessageType.EVT &&
+	(subType === MessageSubType.SINK_FOUND || subType === MessageSubType.SOURCE_FOUND);
+
+const ADDR_TYPES = [BT_DataType.BT_DATA_IDENTITY, BT_DataType.BT_DATA_RPA];
+
+class MessageBatch {
+	#storage
+	#length
+	#entries
+	#latest
+	#coalesced
+	#timer
+
+	constructor() {
+		this.#storage = new Uint8Array(BATCH_MAX_BYTES);
+		this.#length = 0;
+		this.#entries = [];
+		this.#latest = new Map([
+			[MessageSubType.SINK_FOUND, new Map()],
+			[MessageSubType.SOURCE_FOUND, new Map()]
+		]);
+		this.#coalesced = 0;
+	}
+
+	/**
+	* Decode a COBS frame straight into the batch storage
+	*
+	* @param {Uint8Array} frame	COBS frame without delimiter
+	*/
+	add(frame) {
+		const maxLength = cobsDecodedLengthMax(frame.length);
+
+		if (this.#length + maxLength > this.#storage.length) {
+			this.flush();
+
+			if (maxLength > this.#storage.length) {
+				this.#storage = new Uint8Array(maxLength);
+			}
+		}
+
+		const start = this.#length;
+		const decoded = cobsDecodeInto(frame, false, this.#storage.subarray(start));
+
+		// Throws on invalid messages, the storage is simply reused
+		const { type, subType, payload } = arrayToMsg(decoded);
+
+		this.#length += decoded.length;
+		const entry = [start, this.#length];
+
+		if (isScanReport(type, subType)) {
+			const addr = new LtvView(payload).find(ADDR_TYPES);
+
+			if (addr) {
+				const latest = this.#latest.get(subType);
+				const key = bufToAddressKey(addr.value.addr);
+				const index = latest.get(key);
+
+				if (index !== undefined) {
+					this.#entries[index] = entry;
+					this.#coalesced++;
+					return;
+				}
+
+				latest.set(key, this.#entries.length);
+			}
+		}
+
+		this.#entries.push(entry);
+
+		this.#timer ??= setTimeout(() => this.flush(), BATCH_INTERVAL_MS);
+	}
+
+	flush() {
+		clearTimeout(this.#timer);
+		this.#timer = undefined;
+
+		if (this.#entries.length === 0) {
+			return;
+		}
+
+		let size = 0;
+		for (const [start, end] of this.#entries) {
+			size += end - start;
+		}
+
+		const buffer = new Uint8Array(size);
+		const offsets = new Uint32Array(this.#entries.length + 1);
+
+		let ptr = 0;
+		this.#entries.forEach(([start, end], i) => {
+			offsets[i] = ptr;
+			buffer.set(this.#storage.subarray(start, end), ptr);
+			ptr += end - start;
+		});
+		offsets[this.#entries.length] = ptr;
+
+		self.postMessage({
+			type: 'messages',
+			buffer: buffer.buffer,
+			offsets,
+			coalesced: this.#coalesced,
+			stats: { ...stats }
+		}, [buffer.buffer, offsets.buffer]);
+
+		stats.frames = stats.bytes = stats.decodeTime = stats.dropped = 0;
+
+		this.#length = 0;
+		this.#entries = [];
+		this.#latest.forEach(latest => latest.clear());
+		this.#coalesced = 0;
+	}
+}
+
+let currentDevice;
+let opening = false;
+let filter;
+let readsInFlight = 4;
+const batch = new MessageBatch();
+const commandEncoder = new CommandEncoder();
+
+let capture;
+let captureMaxBytes;
+
+let metricsEnabled = false;
+const stats = { frames: 0, bytes: 0, decodeTime: 0, dropped: 0 };
+
+const now = () => performance.timeOrigin + performance.now();
+
+const captureData = (flags, data) => {
+	if (capture && capture.length + data.length < captureMaxBytes) {
+		capture.add(now(), CaptureFlags.RAW | flags, data);
+	}
+}
+
+const matchesFilter = device => filter &&
+	device.vendorId === filter.vendorId && device.productId === filter.productId;
+
+const readLoop = async device => {
+	const {
+		endpointNumber
+	} = device.configuration.interfaces[0].alternate.endpoints[0];
+
+	const deframer = new StreamDeframer();
+
+	const transferIn = () => {
+		const pending = device.transferIn(endpointNumber, MAX_BYTES_READ);
+		// Errors are handled when the transfer is awaited (in order)
+		pending.catch(() => {});
+		return pending;
+	}
+
+	// Keep N reads queued so the host controller always has a buffer
+	// ready. Transfers complete in submission order on a bulk endpoint.
+	const pending = [];
+	for (let i = 0; i < readsInFlight; i++) {
+		pending.push(transferIn());
+	}
+
+	const onFrame = frame => {
+		const start = metricsEnabled ? performance.now() : 0;
+
+		try {
+			batch.add(frame);
+			stats.frames++;
+		} catch (error) {
+			console.warn('Dropping invalid frame', error);
+			stats.dropped++;
+		}
+
+		if (metricsEnabled) {
+			stats.decodeTime += performance.now() - start;
+		}
+	}
+
+	let deframerDropped = 0;
+
+	while (device === currentDevice) {
+		let result;
+		try {
+			result = await pending.shift();
+		} catch (error) {
+			console.log('error', error);
+			break;
+		}
+
+		const buf = new Uint8Array(result.data.buffer, result.data.byteOffset, result.data.byteLength);
+
+		if (buf.length === 0) {
+			console.log("Probably rebooted. Disconnecting!");
+			device.close();
+			break;
+		}
+
+		pending.push(transferIn());
+
+		captureData(0, buf);
+		stats.bytes += buf.length;
+		deframer.push(buf, onFrame);
+
+		stats.dropped += deframer.dropped - deframerDropped;
+		deframerDropped = deframer.dropped;
+	}
+
+	batch.flush();
+}
+
+const openDevice = async device => {
+	await device.open();
+	if (device.configuration === null) {
+		await device.selectConfiguration(1);
+	}
+
+	await device.claimInterface(0);
+
+	currentDevice = device;
+
+	const { productName, serialNumber } = device;
+	self.postMessage({ type: 'connected', device: { productName, serialNumber } });
+
+	readLoop(device);
+}
+
+const open = async (serialNumber) => {
+	// Open requests are repeated on replug, the device may already be open(ing)
+	if (currentDevice || opening) {
+		return;
+	}
+
+	opening = true;
+	try {
+		const devices = (await navigator.usb.getDevices()).filter(matchesFilter);
+
+		const device = serialNumber === undefined ? devices[0] :
+			devices.find(d => d.serialNumber === serialNumber);
+
+		if (device) {
+			await openDevice(device);
+		}
+	} finally {
+		opening = false;
+	}
+}
+
+const sendData = async data => {
+	if (!currentDevice) {
+		console.warn('Device not connected');
+		return 'not-connected';
+	}
+
+	const {
+		endpointNumber
+	} = currentDevice.configuration.interfaces[0].alternate.endpoints[1];
+
+	captureData(CaptureFlags.OUT, data);
+	const result = await currentDevice.transferOut(endpointNumber, data);
+
+	return result.status;
+}
+
+navigator.usb.addEventListener('disconnect', evt => {
+	if (evt.device === currentDevice) {
+		console.log("Disconnected ", evt.device);
+		currentDevice = undefined;
+		self.postMessage({ type: 'disconnected' });
+	}
+});
+
+self.addEventListener('message', async evt => {
+	const { data } = evt;
+
+	try {
+		switch (data.type) {
+			case 'open':
+			filter = data.filter;
+			readsInFlight = data.readsInFlight;
+			await open(data.serialNumber);
+			break;
+			case 'send':
+			// transferOut copies the data, so the encoder buffer can be reused
+			self.postMessage({
+				type: 'sent',
+				id: data.id,
+				status: await sendData(commandEncoder.encode(data.message))
+			});
+			break;
+			case 'send-data':
+			self.postMessage({ type: 'sent', id: data.id, status: await sendData(data.data) });
+			break;
+			case 'metrics':
+			metricsEnabled = data.enabled;
+			break;
+			case 'capture-start':
+			capture = new CaptureWriter(now());
+			captureMaxBytes = data.maxBytes;
+			break;
+			case 'capture-stop':
+			{
+				const captured = (capture ?? new CaptureWriter(now())).toArray();
+				capture = undefined;
+				self.postMessage({ type: 'capture', id: data.id, data: captured }, [captured.buffer]);
+			}
+			break;
+			default:
+			console.warn(`Unknown request ${data.type}`);
+		}
+	} catch (error) {
+		console.log(error);
+		if (data.id !== undefined) {
+			self.postMessage({ type: 'sent', id: data.id, status: 'error' });
+		}
+	}
+});